@@ -102,6 +102,25 @@ namespace automl_zero {
       return true;
    }
 
+   inline void HashComponentFunction(
+         const vector<shared_ptr<const Instruction>>& component_function,
+         size_t* seed) {
+      // Include the size so that moving an instruction from the end of one
+      // component function to the start of the next changes the hash.
+      HashCombine(*seed, component_function.size());
+      for (const shared_ptr<const Instruction>& instruction : component_function) {
+         HashCombine(*seed, instruction->Hash());
+      }
+   }
+
+   size_t Algorithm::Hash() const {
+      size_t seed = 42;
+      HashComponentFunction(setup_, &seed);
+      HashComponentFunction(predict_, &seed);
+      HashComponentFunction(learn_, &seed);
+      return seed;
+   }
+
    string Algorithm::ToReadable() const {
       ostringstream stream;
       stream << "def Setup():" << std::endl;
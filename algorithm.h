@@ -61,6 +61,10 @@ namespace automl_zero {
          std::string ToReadable() const;
          std::string ToReadableEffective() const;
 
+         // Hashes the instructions of all the component functions. Equal
+         // algorithms built from the same instructions have equal hashes.
+         size_t Hash() const;
+
          // Serializes/deserializes a Algorithm to/from a amlz-specific proto.
          SerializedAlgorithm ToProto() const;
          void FromProto(const SerializedAlgorithm& checkpoint_algorithm);
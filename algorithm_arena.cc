@@ -0,0 +1,207 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "algorithm_arena.h"
+
+#include <new>
+
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+using ::std::make_pair;  // NOLINT
+using ::std::pair;  // NOLINT
+using ::std::shared_ptr;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace internal {
+
+namespace {
+
+inline size_t RoundUpToAlignment(const size_t size) {
+  return (size + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+}
+
+}  // namespace
+
+ArenaState::ArenaState()
+    : nursery_chunk_(0),
+      nursery_offset_(0),
+      num_nursery_blocks_(0),
+      num_nursery_rewinds_(0),
+      long_lived_chunk_(0),
+      long_lived_offset_(0),
+      num_long_lived_blocks_(0),
+      released_(false) {
+  free_lists_.fill(nullptr);
+}
+
+void* ArenaState::BumpAllocate(const size_t size,
+                               vector<unique_ptr<char[]>>* chunks,
+                               size_t* chunk, size_t* offset) {
+  if (*chunk < chunks->size() && *offset + size > kArenaChunkSize) {
+    ++*chunk;
+    *offset = 0;
+  }
+  if (*chunk == chunks->size()) {
+    // The alignment of new[] is that of std::max_align_t.
+    chunks->emplace_back(new char[kArenaChunkSize]);
+    *offset = 0;
+  }
+  void* block = (*chunks)[*chunk].get() + *offset;
+  *offset += size;
+  return block;
+}
+
+void* ArenaState::Allocate(size_t size, const bool young) {
+  size = RoundUpToAlignment(size);
+  if (size > kMaxArenaBlockSize) {
+    return ::operator new(size);
+  }
+  if (young) {
+    ++num_nursery_blocks_;
+    return BumpAllocate(size, &nursery_chunks_, &nursery_chunk_,
+                        &nursery_offset_);
+  }
+  ++num_long_lived_blocks_;
+  void*& free_list = free_lists_[size / kArenaAlignment];
+  if (free_list != nullptr) {
+    void* block = free_list;
+    free_list = *static_cast<void**>(block);
+    return block;
+  }
+  return BumpAllocate(size, &long_lived_chunks_, &long_lived_chunk_,
+                      &long_lived_offset_);
+}
+
+void ArenaState::Deallocate(void* block, size_t size, const bool young) {
+  size = RoundUpToAlignment(size);
+  if (size > kMaxArenaBlockSize) {
+    ::operator delete(block);
+    return;
+  }
+  if (young) {
+    CHECK_GT(num_nursery_blocks_, 0);
+    if (--num_nursery_blocks_ == 0) {
+      // Nothing in the nursery is alive, so it can start over.
+      nursery_chunk_ = 0;
+      nursery_offset_ = 0;
+      ++num_nursery_rewinds_;
+    }
+  } else {
+    CHECK_GT(num_long_lived_blocks_, 0);
+    --num_long_lived_blocks_;
+    void*& free_list = free_lists_[size / kArenaAlignment];
+    *static_cast<void**>(block) = free_list;
+    free_list = block;
+  }
+  if (released_ && num_nursery_blocks_ == 0 && num_long_lived_blocks_ == 0) {
+    delete this;
+  }
+}
+
+bool ArenaState::InNursery(const void* object) const {
+  const char* address = static_cast<const char*>(object);
+  for (const unique_ptr<char[]>& chunk : nursery_chunks_) {
+    if (address >= chunk.get() && address < chunk.get() + kArenaChunkSize) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ArenaState::Release() {
+  CHECK(!released_);
+  released_ = true;
+  if (num_nursery_blocks_ == 0 && num_long_lived_blocks_ == 0) {
+    delete this;
+  }
+}
+
+}  // namespace internal
+
+AlgorithmArena::AlgorithmArena() : state_(new internal::ArenaState()) {}
+
+AlgorithmArena::~AlgorithmArena() { state_->Release(); }
+
+void AlgorithmArena::Promote(shared_ptr<const Algorithm>* algorithm) {
+  if (!InNursery(algorithm->get())) {
+    return;
+  }
+  shared_ptr<Algorithm> promoted = std::allocate_shared<Algorithm>(
+      internal::ArenaAllocator<Algorithm>(state_, false), **algorithm);
+  // The copy constructor leaves out the effective instructions.
+  promoted->setupEffective_ = (*algorithm)->setupEffective_;
+  promoted->predictEffective_ = (*algorithm)->predictEffective_;
+  promoted->learnEffective_ = (*algorithm)->learnEffective_;
+
+  // The effective instructions are shared with the component functions, so
+  // each instruction is only copied once.
+  vector<pair<const Instruction*, shared_ptr<const Instruction>>>
+      promoted_instructions;
+  PromoteComponentFunction(&promoted->setup_, &promoted_instructions);
+  PromoteComponentFunction(&promoted->predict_, &promoted_instructions);
+  PromoteComponentFunction(&promoted->learn_, &promoted_instructions);
+  PromoteComponentFunction(&promoted->setupEffective_, &promoted_instructions);
+  PromoteComponentFunction(&promoted->predictEffective_,
+                           &promoted_instructions);
+  PromoteComponentFunction(&promoted->learnEffective_, &promoted_instructions);
+  *algorithm = std::move(promoted);
+}
+
+void AlgorithmArena::PromoteComponentFunction(
+    vector<shared_ptr<const Instruction>>* component_function,
+    vector<pair<const Instruction*, shared_ptr<const Instruction>>>*
+        promoted) {
+  for (shared_ptr<const Instruction>& instruction : *component_function) {
+    if (!InNursery(instruction.get())) {
+      continue;
+    }
+    bool found = false;
+    for (const pair<const Instruction*, shared_ptr<const Instruction>>&
+             original_and_copy : *promoted) {
+      if (original_and_copy.first == instruction.get()) {
+        instruction = original_and_copy.second;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      shared_ptr<const Instruction> copy = std::allocate_shared<Instruction>(
+          internal::ArenaAllocator<Instruction>(state_, false), *instruction);
+      promoted->push_back(make_pair(instruction.get(), copy));
+      instruction = std::move(copy);
+    }
+  }
+}
+
+bool AlgorithmArena::InNursery(const void* object) const {
+  return state_->InNursery(object);
+}
+
+IntegerT AlgorithmArena::NumNurseryObjects() const {
+  return state_->NumNurseryBlocks();
+}
+
+IntegerT AlgorithmArena::NumLongLivedObjects() const {
+  return state_->NumLongLivedBlocks();
+}
+
+IntegerT AlgorithmArena::NumNurseryRewinds() const {
+  return state_->NumNurseryRewinds();
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,188 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Storage for the algorithms and instructions created by a search. Most of
+// them are children that are evaluated and die within a generation, so they
+// are bump-allocated in a nursery, which is rewound as a whole once nothing in
+// it is alive anymore. The few that survive the selection are promoted, i.e.
+// copied, into long-lived storage with size-class free lists. This way, the
+// search recycles the same memory generation after generation instead of
+// going through the global allocator.
+//
+// Not thread-safe: the objects of one arena must be created and destroyed by
+// one thread at a time. Each search owns its arena, so concurrent searches
+// don't contend.
+
+#ifndef AUTOML_ZERO_ALGORITHM_ARENA_H_
+#define AUTOML_ZERO_ALGORITHM_ARENA_H_
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "instruction.h"
+
+namespace automl_zero {
+
+namespace internal {
+
+// All blocks are multiples of this size, and aligned to it.
+constexpr size_t kArenaAlignment = alignof(std::max_align_t);
+// Larger blocks bypass the arena.
+constexpr size_t kMaxArenaBlockSize = 4096;
+constexpr size_t kArenaChunkSize = 256 * 1024;
+
+// The memory of an AlgorithmArena. Outlives the arena while any object it
+// allocated is alive, since algorithms can be handed out of the search.
+class ArenaState {
+ public:
+  ArenaState();
+  ArenaState(const ArenaState& other) = delete;
+  ArenaState& operator=(const ArenaState& other) = delete;
+
+  // Allocates in the nursery if `young`, in the long-lived storage otherwise.
+  void* Allocate(size_t size, bool young);
+  void Deallocate(void* block, size_t size, bool young);
+
+  bool InNursery(const void* object) const;
+
+  // Called when the arena is destroyed. Deletes the state right away, or
+  // when the last object is deallocated.
+  void Release();
+
+  IntegerT NumNurseryBlocks() const { return num_nursery_blocks_; }
+  IntegerT NumLongLivedBlocks() const { return num_long_lived_blocks_; }
+  IntegerT NumNurseryRewinds() const { return num_nursery_rewinds_; }
+
+ private:
+  ~ArenaState() = default;
+
+  // Returns `size` bytes from the chunks, adding a chunk if needed. The
+  // chunks before `*chunk` are full.
+  void* BumpAllocate(size_t size,
+                     std::vector<std::unique_ptr<char[]>>* chunks,
+                     size_t* chunk, size_t* offset);
+
+  // Nursery.
+  std::vector<std::unique_ptr<char[]>> nursery_chunks_;
+  size_t nursery_chunk_;
+  size_t nursery_offset_;
+  IntegerT num_nursery_blocks_;
+  IntegerT num_nursery_rewinds_;
+
+  // Long-lived storage. The free blocks of each size class form a list
+  // through their first bytes.
+  std::vector<std::unique_ptr<char[]>> long_lived_chunks_;
+  size_t long_lived_chunk_;
+  size_t long_lived_offset_;
+  std::array<void*, kMaxArenaBlockSize / kArenaAlignment + 1> free_lists_;
+  IntegerT num_long_lived_blocks_;
+
+  bool released_;
+};
+
+// Allocates in an ArenaState. Used with std::allocate_shared, so that the
+// object and its reference counts share one arena block.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  ArenaAllocator(ArenaState* state, const bool young)
+      : state_(state), young_(young) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)  // NOLINT
+      : state_(other.state_), young_(other.young_) {}
+
+  T* allocate(const size_t n) {
+    static_assert(alignof(T) <= kArenaAlignment, "Over-aligned type.");
+    return static_cast<T*>(state_->Allocate(n * sizeof(T), young_));
+  }
+  void deallocate(T* block, const size_t n) {
+    state_->Deallocate(block, n * sizeof(T), young_);
+  }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return state_ == other.state_ && young_ == other.young_;
+  }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  template <typename U>
+  friend class ArenaAllocator;
+
+  ArenaState* state_;
+  bool young_;
+};
+
+}  // namespace internal
+
+class AlgorithmArena {
+ public:
+  AlgorithmArena();
+  ~AlgorithmArena();
+  AlgorithmArena(const AlgorithmArena& other) = delete;
+  AlgorithmArena& operator=(const AlgorithmArena& other) = delete;
+
+  // Creates an algorithm in the nursery. Takes the Algorithm constructor
+  // arguments, e.g. another algorithm to copy.
+  template <typename... Args>
+  std::shared_ptr<Algorithm> NewAlgorithm(Args&&... args) {
+    return std::allocate_shared<Algorithm>(
+        internal::ArenaAllocator<Algorithm>(state_, true),
+        std::forward<Args>(args)...);
+  }
+
+  // Creates an instruction in the nursery. Takes the Instruction constructor
+  // arguments.
+  template <typename... Args>
+  std::shared_ptr<const Instruction> NewInstruction(Args&&... args) {
+    return std::allocate_shared<Instruction>(
+        internal::ArenaAllocator<Instruction>(state_, true),
+        std::forward<Args>(args)...);
+  }
+
+  // If the algorithm is in the nursery, replaces it with a copy in the
+  // long-lived storage. Its instructions that are in the nursery are copied
+  // too, the others are shared with the original.
+  void Promote(std::shared_ptr<const Algorithm>* algorithm);
+
+  bool InNursery(const void* object) const;
+
+  // Numbers of live objects, and how many times the nursery was rewound.
+  IntegerT NumNurseryObjects() const;
+  IntegerT NumLongLivedObjects() const;
+  IntegerT NumNurseryRewinds() const;
+
+ private:
+  void PromoteComponentFunction(
+      std::vector<std::shared_ptr<const Instruction>>* component_function,
+      std::vector<std::pair<const Instruction*,
+                            std::shared_ptr<const Instruction>>>* promoted);
+
+  internal::ArenaState* const state_;
+};
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_ALGORITHM_ARENA_H_
@@ -0,0 +1,147 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "algorithm_arena.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "instruction.h"
+#include "instruction.pb.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::make_shared;  // NOLINT
+using ::std::shared_ptr;  // NOLINT
+
+Algorithm SimpleAlgorithm() {
+  Algorithm algorithm;
+  algorithm.setup_.push_back(
+      make_shared<const Instruction>(SCALAR_SUM_OP, 1, 2, 3));
+  algorithm.predict_.push_back(
+      make_shared<const Instruction>(VECTOR_SUM_OP, 2, 3, 4));
+  algorithm.learn_.push_back(
+      make_shared<const Instruction>(SCALAR_DIFF_OP, 3, 4, 5));
+  return algorithm;
+}
+
+TEST(AlgorithmArenaTest, CreatesObjectsInTheNursery) {
+  AlgorithmArena arena;
+  const Algorithm original = SimpleAlgorithm();
+  shared_ptr<const Algorithm> algorithm = arena.NewAlgorithm(original);
+  shared_ptr<const Instruction> instruction =
+      arena.NewInstruction(SCALAR_PRODUCT_OP, 4, 5, 6);
+  EXPECT_TRUE(arena.InNursery(algorithm.get()));
+  EXPECT_TRUE(arena.InNursery(instruction.get()));
+  EXPECT_FALSE(arena.InNursery(&original));
+  EXPECT_FALSE(arena.InNursery(original.setup_[0].get()));
+  EXPECT_TRUE(*algorithm == original);
+  EXPECT_TRUE(*instruction == Instruction(SCALAR_PRODUCT_OP, 4, 5, 6));
+  EXPECT_EQ(arena.NumNurseryObjects(), 2);
+  EXPECT_EQ(arena.NumLongLivedObjects(), 0);
+}
+
+TEST(AlgorithmArenaTest, RewindsTheNurseryWhenEmpty) {
+  AlgorithmArena arena;
+  shared_ptr<const Algorithm> first = arena.NewAlgorithm(SimpleAlgorithm());
+  shared_ptr<const Algorithm> second = arena.NewAlgorithm(SimpleAlgorithm());
+  const Algorithm* first_address = first.get();
+  first.reset();
+  EXPECT_EQ(arena.NumNurseryRewinds(), 0);
+  second.reset();
+  EXPECT_EQ(arena.NumNurseryRewinds(), 1);
+  EXPECT_EQ(arena.NumNurseryObjects(), 0);
+
+  // The memory is reused.
+  shared_ptr<const Algorithm> third = arena.NewAlgorithm(SimpleAlgorithm());
+  EXPECT_EQ(third.get(), first_address);
+}
+
+TEST(AlgorithmArenaTest, GrowsTheNursery) {
+  AlgorithmArena arena;
+  std::vector<shared_ptr<const Instruction>> instructions;
+  for (IntegerT i = 0; i < 100000; ++i) {
+    instructions.push_back(arena.NewInstruction(SCALAR_SUM_OP, 1, 2, 3));
+  }
+  for (const shared_ptr<const Instruction>& instruction : instructions) {
+    EXPECT_TRUE(arena.InNursery(instruction.get()));
+    EXPECT_EQ(instruction->op_, SCALAR_SUM_OP);
+  }
+  instructions.clear();
+  EXPECT_EQ(arena.NumNurseryRewinds(), 1);
+}
+
+TEST(AlgorithmArenaTest, PromotesOutOfTheNursery) {
+  AlgorithmArena arena;
+  shared_ptr<Algorithm> young = arena.NewAlgorithm(SimpleAlgorithm());
+  const shared_ptr<const Instruction> heap_instruction = young->setup_[0];
+  young->predict_[0] = arena.NewInstruction(VECTOR_DIFF_OP, 2, 3, 4);
+  young->CopyAllComponentsToEffective();
+  const Algorithm expected = *young;
+
+  shared_ptr<const Algorithm> algorithm = young;
+  young.reset();
+  arena.Promote(&algorithm);
+  EXPECT_FALSE(arena.InNursery(algorithm.get()));
+  EXPECT_TRUE(*algorithm == expected);
+  EXPECT_EQ(algorithm->predictEffective_.size(), 1);
+  // Only the instruction in the nursery was copied, and only once.
+  EXPECT_EQ(algorithm->setup_[0], heap_instruction);
+  EXPECT_FALSE(arena.InNursery(algorithm->predict_[0].get()));
+  EXPECT_EQ(algorithm->predict_[0], algorithm->predictEffective_[0]);
+  EXPECT_EQ(arena.NumLongLivedObjects(), 2);
+
+  // Only `expected` still refers to the nursery.
+  EXPECT_EQ(arena.NumNurseryObjects(), 1);
+
+  // Promoting again does nothing.
+  const Algorithm* promoted_address = algorithm.get();
+  arena.Promote(&algorithm);
+  EXPECT_EQ(algorithm.get(), promoted_address);
+}
+
+TEST(AlgorithmArenaTest, ReusesLongLivedMemory) {
+  AlgorithmArena arena;
+  shared_ptr<const Algorithm> algorithm = arena.NewAlgorithm(SimpleAlgorithm());
+  arena.Promote(&algorithm);
+  const Algorithm* promoted_address = algorithm.get();
+  algorithm.reset();
+  EXPECT_EQ(arena.NumLongLivedObjects(), 0);
+
+  algorithm = arena.NewAlgorithm(SimpleAlgorithm());
+  arena.Promote(&algorithm);
+  EXPECT_EQ(algorithm.get(), promoted_address);
+}
+
+TEST(AlgorithmArenaTest, ObjectsOutliveTheArena) {
+  shared_ptr<const Algorithm> young;
+  shared_ptr<const Algorithm> promoted;
+  {
+    AlgorithmArena arena;
+    young = arena.NewAlgorithm(SimpleAlgorithm());
+    promoted = arena.NewAlgorithm(SimpleAlgorithm());
+    arena.Promote(&promoted);
+  }
+  EXPECT_TRUE(*young == SimpleAlgorithm());
+  EXPECT_TRUE(*promoted == SimpleAlgorithm());
+  young.reset();
+  promoted.reset();
+}
+
+}  // namespace automl_zero
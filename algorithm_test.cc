@@ -114,6 +114,34 @@ TEST(AlgorithmTest, EqualsOperator) {
   EXPECT_FALSE(random_algorithm != same_random_algorithm);
 }
 
+TEST(AlgorithmTest, Hash) {
+  Algorithm algorithm = SimpleNoOpAlgorithm();
+  algorithm.predict_[1] =
+      make_shared<const Instruction>(VECTOR_SUM_OP, 1, 2, 3);
+
+  Algorithm algorithm_same = SimpleNoOpAlgorithm();
+  algorithm_same.predict_[1] =
+      make_shared<const Instruction>(VECTOR_SUM_OP, 1, 2, 3);
+
+  Algorithm algorithm_different_instruction = SimpleNoOpAlgorithm();
+  algorithm_different_instruction.predict_[1] =
+      make_shared<const Instruction>(VECTOR_SUM_OP, 1, 1, 3);
+
+  Algorithm algorithm_different_component_function = SimpleNoOpAlgorithm();
+  algorithm_different_component_function.learn_[1] =
+      make_shared<const Instruction>(VECTOR_SUM_OP, 1, 2, 3);
+
+  EXPECT_EQ(algorithm.Hash(), algorithm_same.Hash());
+  EXPECT_NE(algorithm.Hash(), algorithm_different_instruction.Hash());
+  EXPECT_NE(algorithm.Hash(), algorithm_different_component_function.Hash());
+
+  Algorithm random_algorithm = SimpleRandomAlgorithm();
+  Algorithm same_random_algorithm = random_algorithm;
+  EXPECT_EQ(random_algorithm.Hash(), same_random_algorithm.Hash());
+  EXPECT_EQ(random_algorithm.Hash(),
+            Algorithm(random_algorithm.ToProto()).Hash());
+}
+
 TEST(AlgorithmTest, ToFromProto) {
   Algorithm algorithm_src = SimpleRandomAlgorithm();
   Algorithm algorithm_dest;
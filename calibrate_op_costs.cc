@@ -0,0 +1,87 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the latency of every op on this machine and writes an OpCostTable
+// that can be used as the complexity objective of a search (see
+// SearchExperimentSpec.op_cost_table).
+
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+#include "op_cost_model.h"
+#include "op_cost_table.pb.h"
+#include "random_generator.h"
+#include "google/protobuf/text_format.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
+
+typedef automl_zero::IntegerT IntegerT;
+typedef automl_zero::RandomSeedT RandomSeedT;
+
+ABSL_FLAG(
+    std::vector<std::string>, features_sizes,
+    std::vector<std::string>({"4", "8", "16", "32"}),
+    "Comma-separated features sizes (F) to measure the ops for.");
+ABSL_FLAG(
+    IntegerT, num_rounds, 1000,
+    "Number of timed batches per op. The median batch is kept.");
+ABSL_FLAG(
+    RandomSeedT, random_seed, 1,
+    "Seed for the random instructions and memory.");
+ABSL_FLAG(
+    std::string, output, "",
+    "Path of the text-format OpCostTable to write. Required.");
+
+namespace automl_zero {
+
+using ::absl::GetFlag;  // NOLINT
+using ::std::cout;  // NOLINT
+using ::std::endl;  // NOLINT
+
+void Run() {
+  CHECK(!GetFlag(FLAGS_output).empty());
+  std::vector<FeatureIndexT> features_sizes;
+  for (const std::string& features_size : GetFlag(FLAGS_features_sizes)) {
+    FeatureIndexT value;
+    CHECK(absl::SimpleAtoi(features_size, &value))
+        << "Invalid features size: " << features_size << endl;
+    features_sizes.push_back(value);
+  }
+
+  std::mt19937 bit_gen(GetFlag(FLAGS_random_seed));
+  RandomGenerator rand_gen(&bit_gen);
+  const OpCostTable table =
+      CalibrateOpCosts(features_sizes, GetFlag(FLAGS_num_rounds), &rand_gen);
+
+  std::string table_text;
+  CHECK(google::protobuf::TextFormat::PrintToString(table, &table_text));
+  std::ofstream output(GetFlag(FLAGS_output));
+  CHECK(output.is_open()) << "Could not open " << GetFlag(FLAGS_output) << endl;
+  output << table_text;
+  cout << "Wrote the cost of " << table.costs_size() << " (op, F) pairs to "
+       << GetFlag(FLAGS_output) << "." << endl;
+}
+
+}  // namespace automl_zero
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  automl_zero::Run();
+  return 0;
+}
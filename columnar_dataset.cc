@@ -0,0 +1,250 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "columnar_dataset.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+
+namespace automl_zero {
+
+namespace {
+
+size_t AlignUp(const size_t offset) {
+  return (offset + kColumnarAlignment - 1) / kColumnarAlignment *
+         kColumnarAlignment;
+}
+
+bool IsLittleEndian() {
+  const uint16_t probe = 1;
+  return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+template <typename T>
+T ReadValue(const char* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void WriteValue(const T value, std::ofstream* stream) {
+  stream->write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void WritePadding(std::ofstream* stream) {
+  const size_t offset = stream->tellp();
+  const std::string padding(AlignUp(offset) - offset, '\0');
+  stream->write(padding.data(), padding.size());
+}
+
+void WriteFeatures(
+    const google::protobuf::RepeatedPtrField<FeatureVector>& features,
+    const IntegerT features_size, std::ofstream* stream) {
+  for (const FeatureVector& feature_vector : features) {
+    CHECK_EQ(feature_vector.features_size(), features_size);
+    for (const float value : feature_vector.features()) {
+      WriteValue<double>(value, stream);
+    }
+  }
+  WritePadding(stream);
+}
+
+void WriteLabels(const google::protobuf::RepeatedField<float>& labels,
+                 std::ofstream* stream) {
+  for (const float value : labels) {
+    WriteValue<double>(value, stream);
+  }
+  WritePadding(stream);
+}
+
+void WriteHeader(const IntegerT features_size, const IntegerT num_train,
+                 const IntegerT num_valid, const IntegerT num_test,
+                 std::ofstream* stream) {
+  stream->write(kColumnarMagic, kColumnarMagicSize);
+  WriteValue<uint32_t>(sizeof(double), stream);
+  WriteValue<uint32_t>(0, stream);
+  WriteValue<uint64_t>(features_size, stream);
+  WriteValue<uint64_t>(num_train, stream);
+  WriteValue<uint64_t>(num_valid, stream);
+  WriteValue<uint64_t>(num_test, stream);
+  WritePadding(stream);
+}
+
+// The layout of a file, as described by its header.
+struct ColumnarLayout {
+  IntegerT value_size;
+  IntegerT features_size;
+  IntegerT num_examples[3];
+  size_t features_offsets[3];
+  size_t labels_offsets[3];
+};
+
+// Reads the layout from the kColumnarHeaderSize bytes of `header`, the start
+// of a file of `file_size` bytes. Returns why the file is not a valid
+// columnar dataset, or "" if it is.
+std::string ReadLayout(const char* header, const size_t file_size,
+                       ColumnarLayout* layout) {
+  if (file_size < kColumnarHeaderSize) return "Truncated dataset";
+  if (std::memcmp(header, kColumnarMagic, kColumnarMagicSize) != 0) {
+    return "Not a columnar dataset";
+  }
+  layout->value_size = ReadValue<uint32_t>(header + 8);
+  if (layout->value_size != sizeof(float) &&
+      layout->value_size != sizeof(double)) {
+    return "Unsupported value size";
+  }
+  const uint64_t features_size = ReadValue<uint64_t>(header + 16);
+  layout->features_size = features_size;
+  size_t offset = kColumnarHeaderSize;
+  for (IntegerT split = 0; split < 3; ++split) {
+    const uint64_t num_examples = ReadValue<uint64_t>(header + 24 + 8 * split);
+    // Checked before the offsets are computed, so that they cannot overflow.
+    if (num_examples > file_size / layout->value_size ||
+        (features_size > 0 &&
+         num_examples * layout->value_size > file_size / features_size)) {
+      return "Truncated dataset";
+    }
+    layout->num_examples[split] = num_examples;
+    layout->features_offsets[split] = offset;
+    offset = AlignUp(offset +
+                     num_examples * features_size * layout->value_size);
+    layout->labels_offsets[split] = offset;
+    offset = AlignUp(offset + num_examples * layout->value_size);
+  }
+  if (offset > file_size) return "Truncated dataset";
+  return "";
+}
+
+void WriteArray(const double* values, const IntegerT size,
+                std::ofstream* stream) {
+  if (size > 0) {
+    stream->write(reinterpret_cast<const char*>(values),
+                  size * sizeof(double));
+  }
+  WritePadding(stream);
+}
+
+}  // namespace
+
+MappedColumnarDataset::MappedColumnarDataset(const std::string& path)
+    : path_(path), data_(nullptr), size_(0) {
+  CHECK(IsLittleEndian()) << "Columnar datasets are little-endian.";
+  const int fd = open(path.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Could not open " << path;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << "Could not stat " << path;
+  size_ = file_stat.st_size;
+  CHECK_GE(size_, kColumnarHeaderSize) << "Truncated dataset " << path;
+  void* mapping = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  CHECK(mapping != MAP_FAILED) << "Could not map " << path;
+  data_ = static_cast<const char*>(mapping);
+
+  ColumnarLayout layout;
+  const std::string error = ReadLayout(data_, size_, &layout);
+  CHECK(error.empty()) << error << " " << path;
+  value_size_ = layout.value_size;
+  features_size_ = layout.features_size;
+  for (IntegerT split = 0; split < 3; ++split) {
+    num_examples_[split] = layout.num_examples[split];
+    features_offsets_[split] = layout.features_offsets[split];
+    labels_offsets_[split] = layout.labels_offsets[split];
+  }
+}
+
+MappedColumnarDataset::~MappedColumnarDataset() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+const void* MappedColumnarDataset::FeaturesData(
+    const ColumnarSplit split) const {
+  return data_ + features_offsets_[split];
+}
+
+const void* MappedColumnarDataset::LabelsData(
+    const ColumnarSplit split) const {
+  return data_ + labels_offsets_[split];
+}
+
+bool IsColumnarDataset(const std::string& path) {
+  std::ifstream stream(path, std::ifstream::binary);
+  char magic[kColumnarMagicSize];
+  if (!stream.read(magic, kColumnarMagicSize)) return false;
+  return std::memcmp(magic, kColumnarMagic, kColumnarMagicSize) == 0;
+}
+
+bool IsCompleteColumnarDataset(const std::string& path) {
+  std::ifstream stream(path, std::ifstream::binary | std::ifstream::ate);
+  if (!stream) return false;
+  const std::streamoff file_size = stream.tellg();
+  char header[kColumnarHeaderSize];
+  if (file_size < kColumnarHeaderSize || !stream.seekg(0) ||
+      !stream.read(header, kColumnarHeaderSize)) {
+    return false;
+  }
+  ColumnarLayout layout;
+  return ReadLayout(header, file_size, &layout).empty();
+}
+
+void WriteColumnarDataset(const ScalarLabelDataset& dataset,
+                          const std::string& path) {
+  CHECK(IsLittleEndian()) << "Columnar datasets are little-endian.";
+  CHECK_GT(dataset.train_features_size(), 0);
+  CHECK_EQ(dataset.train_features_size(), dataset.train_labels_size());
+  CHECK_EQ(dataset.valid_features_size(), dataset.valid_labels_size());
+  CHECK_EQ(dataset.test_features_size(), dataset.test_labels_size());
+  const IntegerT features_size = dataset.train_features(0).features_size();
+
+  std::ofstream stream(path, std::ofstream::binary);
+  CHECK(stream.good()) << "Could not open " << path;
+  WriteHeader(features_size, dataset.train_features_size(),
+              dataset.valid_features_size(), dataset.test_features_size(),
+              &stream);
+
+  WriteFeatures(dataset.train_features(), features_size, &stream);
+  WriteLabels(dataset.train_labels(), &stream);
+  WriteFeatures(dataset.valid_features(), features_size, &stream);
+  WriteLabels(dataset.valid_labels(), &stream);
+  WriteFeatures(dataset.test_features(), features_size, &stream);
+  WriteLabels(dataset.test_labels(), &stream);
+  // Closing flushes the buffered data, which may fail too.
+  stream.close();
+  CHECK(!stream.fail()) << "Error while writing " << path;
+}
+
+bool WriteColumnarDataset(const IntegerT features_size,
+                          const std::vector<ColumnarSplitData>& splits,
+                          const std::string& path) {
+  CHECK(IsLittleEndian()) << "Columnar datasets are little-endian.";
+  CHECK_EQ(splits.size(), 3);
+  std::ofstream stream(path, std::ofstream::binary);
+  if (!stream.good()) return false;
+  WriteHeader(features_size, splits[kColumnarTrainSplit].num_examples,
+              splits[kColumnarValidSplit].num_examples,
+              splits[kColumnarTestSplit].num_examples, &stream);
+  for (const ColumnarSplitData& split : splits) {
+    WriteArray(split.features, split.num_examples * features_size, &stream);
+    WriteArray(split.labels, split.num_examples, &stream);
+  }
+  // Closing flushes the buffered data, which may fail too.
+  stream.close();
+  return !stream.fail();
+}
+
+}  // namespace automl_zero
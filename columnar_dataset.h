@@ -0,0 +1,189 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A columnar binary format for datasets, designed to be memory-mapped.
+//
+// Layout (all integers and values little-endian):
+//   Header (kColumnarHeaderSize bytes):
+//     char[8]  magic = "AMLZCOL1"
+//     uint32   value size in bytes (4 = float32, 8 = float64)
+//     uint32   reserved (0)
+//     uint64   features size
+//     uint64   number of train, valid and test examples (3 values)
+//   Followed by six arrays, each starting at a multiple of
+//   kColumnarAlignment bytes from the beginning of the file:
+//     train features (row-major, num_train x features size), train labels,
+//     valid features, valid labels, test features, test labels.
+//
+// With float64 values, the features of an example have the same memory layout
+// as a Vector<F>, so a whole split is loaded with a single copy.
+
+#ifndef AUTOML_ZERO_COLUMNAR_DATASET_H_
+#define AUTOML_ZERO_COLUMNAR_DATASET_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+#include "task.pb.h"
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+constexpr char kColumnarMagic[] = "AMLZCOL1";
+constexpr IntegerT kColumnarMagicSize = 8;
+constexpr IntegerT kColumnarHeaderSize = 64;
+constexpr IntegerT kColumnarAlignment = 64;
+
+enum ColumnarSplit : IntegerT {
+  kColumnarTrainSplit = 0,
+  kColumnarValidSplit = 1,
+  kColumnarTestSplit = 2
+};
+
+// A read-only memory mapping of a columnar dataset file. The data is paged in
+// lazily by the OS and shared between processes reading the same file.
+class MappedColumnarDataset {
+ public:
+  // Dies if the file cannot be mapped or is not a valid columnar dataset.
+  explicit MappedColumnarDataset(const std::string& path);
+  ~MappedColumnarDataset();
+  MappedColumnarDataset(const MappedColumnarDataset& other) = delete;
+  MappedColumnarDataset& operator=(const MappedColumnarDataset& other) =
+      delete;
+
+  IntegerT FeaturesSize() const { return features_size_; }
+  IntegerT ValueSize() const { return value_size_; }
+  IntegerT NumExamples(ColumnarSplit split) const {
+    return num_examples_[split];
+  }
+
+  // Raw pointers to the arrays of a split. The values have ValueSize() bytes.
+  const void* FeaturesData(ColumnarSplit split) const;
+  const void* LabelsData(ColumnarSplit split) const;
+
+  // Copies the first `features->size()` examples of a split into `features`
+  // and `labels`, which must have the same size.
+  template <FeatureIndexT F, typename FeaturesAllocator,
+            typename LabelsAllocator>
+  void CopyExamples(ColumnarSplit split,
+                    std::vector<Vector<F>, FeaturesAllocator>* features,
+                    std::vector<Scalar, LabelsAllocator>* labels) const;
+
+  // Copies a single example of a split. Unlike CopyExamples, does not check
+  // that the features size is F.
+  template <FeatureIndexT F>
+  void CopyExample(ColumnarSplit split, IntegerT index, Vector<F>* features,
+                   Scalar* label) const;
+
+ private:
+  const std::string path_;
+  const char* data_;
+  size_t size_;
+  IntegerT value_size_;
+  IntegerT features_size_;
+  IntegerT num_examples_[3];
+  // Offsets of the features and labels arrays of each split.
+  size_t features_offsets_[3];
+  size_t labels_offsets_[3];
+};
+
+// Whether the file starts with the columnar magic.
+bool IsColumnarDataset(const std::string& path);
+
+// Whether the file is a columnar dataset that MappedColumnarDataset can map:
+// its header is valid and the file holds all the arrays it describes, e.g. it
+// was not truncated by an interrupted write.
+bool IsCompleteColumnarDataset(const std::string& path);
+
+// Writes a ScalarLabelDataset in the columnar format with float64 values.
+void WriteColumnarDataset(const ScalarLabelDataset& dataset,
+                          const std::string& path);
+
+// The arrays of one split, in memory.
+struct ColumnarSplitData {
+  // num_examples x features size row-major values.
+  const double* features;
+  const double* labels;
+  IntegerT num_examples;
+};
+
+// Writes the train, valid and test splits, in this order, in the columnar
+// format with float64 values. Returns false if the file could not be opened
+// or written, e.g. because the disk is full, in which case it may be left
+// partially written.
+bool WriteColumnarDataset(IntegerT features_size,
+                          const std::vector<ColumnarSplitData>& splits,
+                          const std::string& path);
+
+template <FeatureIndexT F, typename FeaturesAllocator,
+          typename LabelsAllocator>
+void MappedColumnarDataset::CopyExamples(
+    const ColumnarSplit split,
+    std::vector<Vector<F>, FeaturesAllocator>* features,
+    std::vector<Scalar, LabelsAllocator>* labels) const {
+  const IntegerT num_examples = features->size();
+  CHECK_EQ(labels->size(), num_examples);
+  CHECK_EQ(features_size_, F) << "Incorrect feature size in " << path_;
+  CHECK_GE(num_examples_[split], num_examples)
+      << "Not enough examples in " << path_;
+  // Whether a vector of Vector<F> is a row-major array of doubles.
+  constexpr bool kContiguous = sizeof(Vector<F>) == F * sizeof(double);
+  if (value_size_ == sizeof(double) && kContiguous) {
+    std::memcpy(static_cast<void*>(features->data()->data()),
+                FeaturesData(split), num_examples * F * sizeof(double));
+    std::memcpy(labels->data(), LabelsData(split),
+                num_examples * sizeof(double));
+  } else if (value_size_ == sizeof(double)) {
+    const double* values = static_cast<const double*>(FeaturesData(split));
+    for (IntegerT k = 0; k < num_examples; ++k) {
+      for (FeatureIndexT i = 0; i < F; ++i) {
+        (*features)[k](i) = values[k * F + i];
+      }
+    }
+    std::memcpy(labels->data(), LabelsData(split),
+                num_examples * sizeof(double));
+  } else {
+    const float* values = static_cast<const float*>(FeaturesData(split));
+    const float* label_values = static_cast<const float*>(LabelsData(split));
+    for (IntegerT k = 0; k < num_examples; ++k) {
+      for (FeatureIndexT i = 0; i < F; ++i) {
+        (*features)[k](i) = values[k * F + i];
+      }
+      (*labels)[k] = label_values[k];
+    }
+  }
+}
+
+template <FeatureIndexT F>
+void MappedColumnarDataset::CopyExample(
+    const ColumnarSplit split, const IntegerT index, Vector<F>* features,
+    Scalar* label) const {
+  if (value_size_ == sizeof(double)) {
+    *features = Eigen::Map<const Vector<F>>(
+        static_cast<const double*>(FeaturesData(split)) + index * F);
+    *label = static_cast<const double*>(LabelsData(split))[index];
+  } else {
+    *features = Eigen::Map<const Eigen::Matrix<float, F, 1>>(
+        static_cast<const float*>(FeaturesData(split)) + index * F)
+        .template cast<double>();
+    *label = static_cast<const float*>(LabelsData(split))[index];
+  }
+}
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_COLUMNAR_DATASET_H_
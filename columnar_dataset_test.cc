@@ -0,0 +1,130 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "columnar_dataset.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+#include "task.pb.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::string;
+using ::std::vector;
+
+// A dataset whose values encode their position, with `num_examples` examples
+// in every split.
+ScalarLabelDataset MakeDataset(IntegerT features_size, IntegerT num_examples) {
+  ScalarLabelDataset dataset;
+  for (IntegerT k = 0; k < num_examples; ++k) {
+    FeatureVector* train = dataset.add_train_features();
+    FeatureVector* valid = dataset.add_valid_features();
+    FeatureVector* test = dataset.add_test_features();
+    for (IntegerT i = 0; i < features_size; ++i) {
+      train->add_features(k + i / 100.0);
+      valid->add_features(-k - i / 100.0);
+      test->add_features(1000.0 + k);
+    }
+    dataset.add_train_labels(k % 2);
+    dataset.add_valid_labels((k + 1) % 2);
+    dataset.add_test_labels(0.5);
+  }
+  return dataset;
+}
+
+string TestPath(const string& name) {
+  return ::testing::TempDir() + "/" + name;
+}
+
+TEST(ColumnarDatasetTest, RoundTrips) {
+  const string path = TestPath("round_trip");
+  WriteColumnarDataset(MakeDataset(4, 5), path);
+  ASSERT_TRUE(IsColumnarDataset(path));
+  MappedColumnarDataset mapped(path);
+  EXPECT_EQ(mapped.FeaturesSize(), 4);
+  EXPECT_EQ(mapped.ValueSize(), sizeof(double));
+  EXPECT_EQ(mapped.NumExamples(kColumnarTrainSplit), 5);
+  EXPECT_EQ(mapped.NumExamples(kColumnarTestSplit), 5);
+
+  vector<Vector<4>> features(3);
+  vector<Scalar> labels(3);
+  mapped.CopyExamples<4>(kColumnarValidSplit, &features, &labels);
+  for (IntegerT k = 0; k < 3; ++k) {
+    for (IntegerT i = 0; i < 4; ++i) {
+      EXPECT_FLOAT_EQ(features[k](i), -k - i / 100.0);
+    }
+    EXPECT_EQ(labels[k], (k + 1) % 2);
+  }
+}
+
+TEST(ColumnarDatasetTest, ArraysAreAligned) {
+  const string path = TestPath("aligned");
+  // Odd sizes, so that the arrays need padding.
+  WriteColumnarDataset(MakeDataset(2, 3), path);
+  MappedColumnarDataset mapped(path);
+  for (ColumnarSplit split :
+       {kColumnarTrainSplit, kColumnarValidSplit, kColumnarTestSplit}) {
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(mapped.FeaturesData(split)) %
+                  kColumnarAlignment, 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(mapped.LabelsData(split)) %
+                  kColumnarAlignment, 0);
+  }
+  vector<Vector<2>> features(3);
+  vector<Scalar> labels(3);
+  mapped.CopyExamples<2>(kColumnarTestSplit, &features, &labels);
+  EXPECT_EQ(features[2](1), 1002.0);
+  EXPECT_EQ(labels[2], 0.5);
+}
+
+TEST(ColumnarDatasetTest, DetectsProtos) {
+  const string path = TestPath("proto");
+  {
+    std::ofstream os(path, std::ofstream::binary);
+    os << MakeDataset(4, 2).SerializeAsString();
+  }
+  EXPECT_FALSE(IsColumnarDataset(path));
+  EXPECT_FALSE(IsColumnarDataset(TestPath("does_not_exist")));
+}
+
+TEST(ColumnarDatasetTest, DetectsTruncatedFiles) {
+  const string path = TestPath("truncated");
+  WriteColumnarDataset(MakeDataset(4, 5), path);
+  EXPECT_TRUE(IsCompleteColumnarDataset(path));
+  const uintmax_t size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size - kColumnarAlignment);
+  EXPECT_TRUE(IsColumnarDataset(path));
+  EXPECT_FALSE(IsCompleteColumnarDataset(path));
+  EXPECT_DEATH(MappedColumnarDataset mapped(path), "Truncated dataset");
+  std::filesystem::resize_file(path, kColumnarHeaderSize / 2);
+  EXPECT_FALSE(IsCompleteColumnarDataset(path));
+  EXPECT_FALSE(IsCompleteColumnarDataset(TestPath("does_not_exist")));
+}
+
+TEST(ColumnarDatasetTest, ChecksTheFeaturesSize) {
+  const string path = TestPath("features_size");
+  WriteColumnarDataset(MakeDataset(4, 2), path);
+  MappedColumnarDataset mapped(path);
+  vector<Vector<8>> features(2);
+  vector<Scalar> labels(2);
+  EXPECT_DEATH(mapped.CopyExamples<8>(kColumnarTrainSplit, &features, &labels),
+               "Incorrect feature size");
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,106 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Converts projected binary classification datasets saved as serialized
+// ScalarLabelDataset protos (see generate_datasets.py) into the columnar
+// format of columnar_dataset.h, which is memory-mapped instead of parsed when
+// a task is created. Either converts a single file (--input, --output) or every
+// proto dataset in a directory (--input_dir, --output_dir). The file names are
+// kept, so the converted directory can be used as the dataset path directly.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "columnar_dataset.h"
+#include "definitions.h"
+#include "task.pb.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+ABSL_FLAG(
+    std::string, input, "",
+    "Path of a serialized ScalarLabelDataset to convert.");
+ABSL_FLAG(
+    std::string, output, "",
+    "Path of the columnar dataset to write. Required with --input.");
+ABSL_FLAG(
+    std::string, input_dir, "",
+    "Directory whose datasets (files named binary_*) are all converted.");
+ABSL_FLAG(
+    std::string, output_dir, "",
+    "Directory to write the converted datasets to. Required with --input_dir. "
+    "Can be the same as --input_dir, to convert in place.");
+
+namespace automl_zero {
+
+using ::absl::GetFlag;  // NOLINT
+using ::std::cout;  // NOLINT
+using ::std::endl;  // NOLINT
+using ::std::string;  // NOLINT
+
+void Convert(const string& input, const string& output) {
+  ScalarLabelDataset dataset;
+  {
+    std::ifstream is(input, std::ifstream::binary);
+    CHECK(is.good()) << "Could not open " << input << endl;
+    const string read_buffer((std::istreambuf_iterator<char>(is)),
+                             std::istreambuf_iterator<char>());
+    CHECK(dataset.ParseFromString(read_buffer))
+        << "Error while parsing the proto from " << input << endl;
+  }
+  WriteColumnarDataset(dataset, output);
+}
+
+void Run() {
+  if (!GetFlag(FLAGS_input).empty()) {
+    CHECK(!GetFlag(FLAGS_output).empty());
+    Convert(GetFlag(FLAGS_input), GetFlag(FLAGS_output));
+    return;
+  }
+
+  CHECK(!GetFlag(FLAGS_input_dir).empty())
+      << "Either --input or --input_dir is required." << endl;
+  CHECK(!GetFlag(FLAGS_output_dir).empty());
+  std::filesystem::create_directories(GetFlag(FLAGS_output_dir));
+  IntegerT num_converted = 0;
+  IntegerT num_skipped = 0;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(GetFlag(FLAGS_input_dir))) {
+    const string filename = entry.path().filename().string();
+    if (!entry.is_regular_file() || filename.rfind("binary_", 0) != 0) {
+      continue;
+    }
+    const string output =
+        (std::filesystem::path(GetFlag(FLAGS_output_dir)) / filename).string();
+    if (IsColumnarDataset(entry.path().string())) {
+      ++num_skipped;
+      continue;
+    }
+    Convert(entry.path().string(), output);
+    ++num_converted;
+  }
+  cout << "Converted " << num_converted << " datasets, skipped "
+       << num_skipped << " already in the columnar format." << endl;
+}
+
+}  // namespace automl_zero
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  automl_zero::Run();
+  return 0;
+}
@@ -0,0 +1,207 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "cpu_topology.h"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+
+namespace automl_zero {
+
+using ::std::string;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace {
+
+constexpr char kNodeSysfsDir[] = "/sys/devices/system/node/";
+
+// The node the thread was pinned to, or -1 if it was not.
+thread_local IntegerT current_numa_node = -1;
+
+// The contents of a sysfs file, or "" if it cannot be read.
+string ReadSysfsFile(const string& path) {
+  std::ifstream stream(path);
+  if (!stream) return "";
+  return string(std::istreambuf_iterator<char>(stream),
+                std::istreambuf_iterator<char>());
+}
+
+// The CPUs in the affinity mask of the process.
+vector<int> AllowedCpus() {
+  vector<int> cpus;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpu_set)) cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    const int num_cpus = std::max(1U, std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < num_cpus; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+}  // namespace
+
+CpuTopology::CpuTopology(vector<vector<int>> node_cpus) {
+  for (vector<int>& cpus : node_cpus) {
+    if (cpus.empty()) continue;
+    std::sort(cpus.begin(), cpus.end());
+    node_cpus_.push_back(std::move(cpus));
+  }
+  CHECK(!node_cpus_.empty()) << "A topology needs at least one CPU.";
+}
+
+CpuTopology CpuTopology::Detect() {
+  const vector<int> allowed_cpus = AllowedCpus();
+  vector<vector<int>> node_cpus;
+  const string online_nodes =
+      ReadSysfsFile(absl::StrCat(kNodeSysfsDir, "online"));
+  if (!online_nodes.empty()) {
+    for (const int node : ParseCpuList(online_nodes)) {
+      vector<int> cpus = ParseCpuList(ReadSysfsFile(
+          absl::StrCat(kNodeSysfsDir, "node", node, "/cpulist")));
+      cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                                [&allowed_cpus](const int cpu) {
+                                  return !std::binary_search(
+                                      allowed_cpus.begin(),
+                                      allowed_cpus.end(), cpu);
+                                }),
+                 cpus.end());
+      node_cpus.push_back(std::move(cpus));
+    }
+  }
+  const bool has_cpus = std::any_of(
+      node_cpus.begin(), node_cpus.end(),
+      [](const vector<int>& cpus) { return !cpus.empty(); });
+  if (!has_cpus) return CpuTopology({allowed_cpus});
+  return CpuTopology(std::move(node_cpus));
+}
+
+IntegerT CpuTopology::NumCpus() const {
+  IntegerT num_cpus = 0;
+  for (const vector<int>& cpus : node_cpus_) num_cpus += cpus.size();
+  return num_cpus;
+}
+
+const vector<int>& CpuTopology::NodeCpus(const IntegerT node) const {
+  CHECK_GE(node, 0);
+  CHECK_LT(node, node_cpus_.size());
+  return node_cpus_[node];
+}
+
+IntegerT CpuTopology::ThreadNode(const IntegerT thread) const {
+  CHECK_GE(thread, 0);
+  return thread % NumNodes();
+}
+
+int CpuTopology::ThreadCpu(const IntegerT thread) const {
+  const vector<int>& cpus = NodeCpus(ThreadNode(thread));
+  return cpus[(thread / NumNodes()) % cpus.size()];
+}
+
+IntegerT CpuTopology::CpuNode(const int cpu) const {
+  for (IntegerT node = 0; node < NumNodes(); ++node) {
+    if (std::binary_search(node_cpus_[node].begin(), node_cpus_[node].end(),
+                           cpu)) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+string CpuTopology::ToString() const {
+  string description = absl::StrCat(
+      NumNodes(), NumNodes() == 1 ? " NUMA node, " : " NUMA nodes, ",
+      NumCpus(), NumCpus() == 1 ? " CPU (" : " CPUs (");
+  for (IntegerT node = 0; node < NumNodes(); ++node) {
+    absl::StrAppend(&description, node == 0 ? "" : ", ", "node ", node, ": ",
+                    FormatCpuList(node_cpus_[node]));
+  }
+  absl::StrAppend(&description, ")");
+  return description;
+}
+
+vector<int> ParseCpuList(const string& cpu_list) {
+  vector<int> cpus;
+  for (absl::string_view range :
+       absl::StrSplit(cpu_list, ',', absl::SkipWhitespace())) {
+    range = absl::StripAsciiWhitespace(range);
+    const vector<absl::string_view> bounds = absl::StrSplit(range, '-');
+    int first = 0, last = 0;
+    CHECK(bounds.size() <= 2 && absl::SimpleAtoi(bounds[0], &first) &&
+          absl::SimpleAtoi(bounds.back(), &last) && first <= last)
+        << "Invalid CPU list: " << cpu_list;
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+string FormatCpuList(vector<int> cpus) {
+  std::sort(cpus.begin(), cpus.end());
+  string cpu_list;
+  for (size_t i = 0; i < cpus.size();) {
+    size_t end = i + 1;
+    while (end < cpus.size() && cpus[end] == cpus[end - 1] + 1) ++end;
+    absl::StrAppend(&cpu_list, i == 0 ? "" : ",", cpus[i]);
+    if (end - i > 1) absl::StrAppend(&cpu_list, "-", cpus[end - 1]);
+    i = end;
+  }
+  return cpu_list;
+}
+
+bool PinCurrentThread(const vector<int>& cpus, const IntegerT node) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpu_set);
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) return false;
+  current_numa_node = node;
+  return true;
+}
+
+IntegerT CurrentNumaNode(const CpuTopology* topology) {
+  if (current_numa_node >= 0) return current_numa_node;
+  if (topology == nullptr) return 0;
+  const int cpu = sched_getcpu();
+  const IntegerT node = cpu < 0 ? -1 : topology->CpuNode(cpu);
+  return node < 0 ? 0 : node;
+}
+
+void RunOnNode(const CpuTopology& topology, const IntegerT node,
+               const std::function<void()>& function) {
+  std::thread thread([&topology, node, &function]() {
+    if (!PinCurrentThread(topology.NodeCpus(node), node)) {
+      LOG(WARNING) << "Could not pin a thread to NUMA node " << node << ".";
+    }
+    function();
+  });
+  thread.join();
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,89 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// The NUMA topology of the CPUs the process may run on, and the placement of
+// threads and data on it.
+//
+// The topology is read from sysfs, so it needs no libnuma. Memory is placed by
+// first touch: Linux allocates a page on the node of the thread that first
+// writes it, so data built by a thread pinned to a node stays local to the
+// threads pinned to that node.
+
+#ifndef AUTOML_ZERO_CPU_TOPOLOGY_H_
+#define AUTOML_ZERO_CPU_TOPOLOGY_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+
+namespace automl_zero {
+
+class CpuTopology {
+ public:
+  // The CPUs of each node. Nodes without CPUs are dropped.
+  explicit CpuTopology(std::vector<std::vector<int>> node_cpus);
+
+  // The topology of this machine, restricted to the affinity mask of the
+  // process. Without a NUMA sysfs, e.g. outside of Linux, all the CPUs the
+  // process may run on make up a single node.
+  static CpuTopology Detect();
+
+  IntegerT NumNodes() const { return node_cpus_.size(); }
+  IntegerT NumCpus() const;
+  const std::vector<int>& NodeCpus(IntegerT node) const;
+
+  // The node and CPU of the `thread`-th pinned thread. Consecutive threads
+  // alternate between the nodes, so that a few threads already use the memory
+  // bandwidth of all of them. Past one thread per CPU, they wrap around.
+  IntegerT ThreadNode(IntegerT thread) const;
+  int ThreadCpu(IntegerT thread) const;
+
+  // The node of `cpu`, or -1 if it is not in the topology.
+  IntegerT CpuNode(int cpu) const;
+
+  // E.g. "2 NUMA nodes, 8 CPUs (node 0: 0-3, node 1: 4-7)".
+  std::string ToString() const;
+
+ private:
+  std::vector<std::vector<int>> node_cpus_;
+};
+
+// Parses a sysfs CPU list, such as "0-3,8,10-11".
+std::vector<int> ParseCpuList(const std::string& cpu_list);
+
+// Formats the CPUs as a sysfs CPU list.
+std::string FormatCpuList(std::vector<int> cpus);
+
+// Restricts the calling thread to the `cpus` of `node`, which becomes its
+// CurrentNumaNode. Returns false, leaving the thread as it was, if the CPUs
+// are not available to it.
+bool PinCurrentThread(const std::vector<int>& cpus, IntegerT node);
+
+// The node the calling thread was pinned to. For a thread that was not
+// pinned, such as one that calls ThreadPool::ParallelFor, the node of
+// `topology` holding the CPU it currently runs on, or 0 if `topology` is
+// nullptr or does not hold that CPU.
+IntegerT CurrentNumaNode(const CpuTopology* topology = nullptr);
+
+// Calls `function` on a new thread pinned to the CPUs of `node`, so that the
+// memory it touches first is allocated on that node, and waits for it.
+void RunOnNode(const CpuTopology& topology, IntegerT node,
+               const std::function<void()>& function);
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_CPU_TOPOLOGY_H_
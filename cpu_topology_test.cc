@@ -0,0 +1,136 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "cpu_topology.h"
+
+#include <sched.h>
+
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "definitions.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::vector;  // NOLINT
+
+TEST(ParseCpuListTest, ParsesRangesAndSingleCpus) {
+  EXPECT_EQ(ParseCpuList("0-3,8,10-11\n"),
+            vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseCpuList("5"), vector<int>({5}));
+  EXPECT_TRUE(ParseCpuList("\n").empty());
+}
+
+TEST(FormatCpuListTest, MergesConsecutiveCpus) {
+  EXPECT_EQ(FormatCpuList({8, 0, 1, 2, 3, 10, 11}), "0-3,8,10-11");
+  EXPECT_EQ(FormatCpuList({5}), "5");
+  EXPECT_EQ(FormatCpuList({}), "");
+}
+
+TEST(CpuTopologyTest, DropsNodesWithoutCpus) {
+  const CpuTopology topology({{4, 5}, {}, {0, 1}});
+  EXPECT_EQ(topology.NumNodes(), 2);
+  EXPECT_EQ(topology.NumCpus(), 4);
+  EXPECT_EQ(topology.NodeCpus(1), vector<int>({0, 1}));
+  EXPECT_EQ(topology.ToString(),
+            "2 NUMA nodes, 4 CPUs (node 0: 4-5, node 1: 0-1)");
+}
+
+TEST(CpuTopologyTest, SpreadsTheThreadsOverTheNodes) {
+  const CpuTopology topology({{0, 1, 2}, {3, 4}});
+  vector<IntegerT> nodes;
+  vector<int> cpus;
+  for (IntegerT thread = 0; thread < 6; ++thread) {
+    nodes.push_back(topology.ThreadNode(thread));
+    cpus.push_back(topology.ThreadCpu(thread));
+  }
+  EXPECT_EQ(nodes, vector<IntegerT>({0, 1, 0, 1, 0, 1}));
+  EXPECT_EQ(cpus, vector<int>({0, 3, 1, 4, 2, 3}));
+}
+
+TEST(CpuTopologyTest, FindsTheNodeOfACpu) {
+  const CpuTopology topology({{0, 1, 2}, {3, 4}});
+  EXPECT_EQ(topology.CpuNode(1), 0);
+  EXPECT_EQ(topology.CpuNode(4), 1);
+  EXPECT_EQ(topology.CpuNode(5), -1);
+}
+
+TEST(CpuTopologyTest, DetectsTheAvailableCpus) {
+  const CpuTopology topology = CpuTopology::Detect();
+  EXPECT_GE(topology.NumNodes(), 1);
+  EXPECT_LE(topology.NumCpus(), CPU_SETSIZE);
+  cpu_set_t cpu_set;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set), &cpu_set), 0);
+  for (IntegerT node = 0; node < topology.NumNodes(); ++node) {
+    for (const int cpu : topology.NodeCpus(node)) {
+      EXPECT_TRUE(CPU_ISSET(cpu, &cpu_set));
+    }
+  }
+}
+
+TEST(RunOnNodeTest, RunsOnAThreadPinnedToTheNode) {
+  const int cpu = CpuTopology::Detect().NodeCpus(0)[0];
+  const CpuTopology topology({{cpu}, {cpu}});
+  IntegerT node = -1;
+  int current_cpu = -1;
+  RunOnNode(topology, 1, [&node, &current_cpu]() {
+    node = CurrentNumaNode();
+    current_cpu = sched_getcpu();
+  });
+  EXPECT_EQ(node, 1);
+  EXPECT_EQ(current_cpu, cpu);
+  EXPECT_EQ(CurrentNumaNode(), 0);
+}
+
+TEST(CurrentNumaNodeTest, UsesTheCpuOfUnpinnedThreads) {
+  const int cpu = CpuTopology::Detect().NodeCpus(0)[0];
+  const CpuTopology topology({{cpu + 1}, {cpu}});
+  IntegerT node = -1;
+  IntegerT node_without_topology = -1;
+  std::thread thread([cpu, &topology, &node, &node_without_topology]() {
+    // Restricts the thread to `cpu` without pinning it to a node.
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    ASSERT_EQ(sched_setaffinity(0, sizeof(cpu_set), &cpu_set), 0);
+    node = CurrentNumaNode(&topology);
+    node_without_topology = CurrentNumaNode();
+  });
+  thread.join();
+  EXPECT_EQ(node, 1);
+  EXPECT_EQ(node_without_topology, 0);
+}
+
+TEST(CurrentNumaNodeTest, PrefersThePinnedNode) {
+  const int cpu = CpuTopology::Detect().NodeCpus(0)[0];
+  const CpuTopology topology({{cpu}, {cpu + 1}});
+  IntegerT node = -1;
+  RunOnNode(CpuTopology({{cpu}, {cpu}}), 1, [&topology, &node]() {
+    node = CurrentNumaNode(&topology);
+  });
+  EXPECT_EQ(node, 1);
+}
+
+TEST(PinCurrentThreadTest, FailsOnUnavailableCpus) {
+  std::thread thread([]() {
+    EXPECT_FALSE(PinCurrentThread({}, 3));
+    EXPECT_EQ(CurrentNumaNode(), 0);
+  });
+  thread.join();
+}
+
+}  // namespace automl_zero
@@ -65,6 +65,12 @@
   #define MAX_MATRIX_ADDRESSES 20
 #endif
 
+// If 1, the execution of the algorithms is profiled (see profiler.h). If 0,
+// the profiling code is compiled out.
+#ifndef PROFILE_EXECUTION
+  #define PROFILE_EXECUTION 0
+#endif
+
 namespace automl_zero {
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -93,8 +99,18 @@ typedef double Scalar;
 template <FeatureIndexT F>
 using Vector = ::Eigen::Matrix<double, F, 1>;
 
+// Matrices of up to this features size are fixed-size and held by value.
+// Larger ones would not fit on the stack (and would thrash the cache when a
+// Memory is copied), so they are heap-allocated with Eigen's aligned
+// allocator, with their size set once when the Memory is constructed.
+constexpr FeatureIndexT kMaxFixedSizeMatrixFeatures = 32;
+
 template <FeatureIndexT F>
-using Matrix = ::Eigen::Matrix<double, F, F, ::Eigen::RowMajor>;
+using Matrix = ::Eigen::Matrix<
+    double,
+    F <= kMaxFixedSizeMatrixFeatures ? F : ::Eigen::Dynamic,
+    F <= kMaxFixedSizeMatrixFeatures ? F : ::Eigen::Dynamic,
+    ::Eigen::RowMajor>;
 
 enum Choice2T : IntegerT {
   kChoice0of2 = 0,
@@ -146,6 +162,7 @@ constexpr double kMaxFitness = 1.0;
 
 //skelly, required for intron removal
 constexpr bool SKIP_INTRONS = false;
+constexpr bool kProfileExecution = PROFILE_EXECUTION;
 constexpr uint8_t NUM_MEMORY_TYPES = 3;
 constexpr uint8_t SCALAR_TYPE = 0;
 constexpr uint8_t VECTOR_TYPE = 1;
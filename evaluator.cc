@@ -22,12 +22,15 @@
 #include <string>
 #include "compute_cost.h"
 #include "compute_cost_new.h"
+#include "cpu_topology.h"
 
 #include "task.h"
 #include "task_util.h"
 #include "task.pb.h"
 #include "definitions.h"
 #include "executor.h"
+#include "parallel.h"
+#include "profiler.h"
 #include "random_generator.h"
 #include "train_budget.h"
 #include "google/protobuf/text_format.h"
@@ -40,16 +43,16 @@ namespace automl_zero {
 
 using ::absl::c_linear_search;  // NOLINT
 using ::absl::GetFlag;  // NOLINT
-using ::absl::make_unique;  // NOLINT
 using ::std::cout;  // NOLINT
 using ::std::endl;  // NOLINT
 using ::std::fixed;  // NOLINT
 using ::std::make_shared;  // NOLINT
+using ::std::make_unique;  // NOLINT
 using ::std::min;  // NOLINT
-using ::std::mt19937;  // NOLINT
 using ::std::nth_element;  // NOLINT
 using ::std::pair;  // NOLINT
 using ::std::setprecision;  // NOLINT
+using ::std::shared_ptr;  // NOLINT
 using ::std::vector;  // NOLINT
 using ::std::unique_ptr;  // NOLINT
 using internal::CombineFitnessesSingle;
@@ -58,25 +61,69 @@ using internal::CombineFitnessesMulti;
 constexpr IntegerT kMinNumTrainExamples = 10;
 constexpr RandomSeedT kFunctionalCacheRandomSeed = 235732282;
 
+namespace {
+
+// The train and validation errors of the functional cache lookups of the
+// calling thread. Reused, so that the lookups don't allocate.
+pair<vector<double>, vector<double>>* ThreadFunctionalCacheErrors() {
+  static thread_local pair<vector<double>, vector<double>> errors;
+  return &errors;
+}
+
+// The Philox stream of the evaluation numbered `evaluation` on a task, so
+// that the tasks, and the algorithms of a batch, can be evaluated in any
+// order, or concurrently.
+uint64_t EvaluationStream(const IntegerT evaluation,
+                          const IntegerT task_index) {
+  return (static_cast<uint64_t>(evaluation) << 32) | task_index;
+}
+
+vector<const Algorithm*> AlgorithmPointers(
+    const vector<shared_ptr<const Algorithm>>& algorithms) {
+  vector<const Algorithm*> pointers;
+  pointers.reserve(algorithms.size());
+  for (const shared_ptr<const Algorithm>& algorithm : algorithms) {
+    pointers.push_back(algorithm.get());
+  }
+  return pointers;
+}
+
+}  // namespace
+
 Evaluator::Evaluator(const FitnessCombinationMode fitness_combination_mode,
                      const TaskCollection& task_collection,
                      RandomGenerator* rand_gen,
                      FECCache* functional_cache,
                      TrainBudget* train_budget,
-                     const double max_abs_error)
+                     const double max_abs_error,
+                     const OpCostModel* op_cost_model,
+                     TaskStore* task_store,
+                     ExecutionWatchdog* watchdog,
+                     ThreadPool* thread_pool)
     : fitness_combination_mode_(fitness_combination_mode),
       task_collection_(task_collection),
       train_budget_(train_budget),
-      rand_gen_(rand_gen),
+      evaluation_seed_(rand_gen->UniformRandomSeed()),
+      topology_(nullptr),
       functional_cache_(functional_cache),
-      functional_cache_bit_gen_owned_(
-          make_unique<mt19937>(kFunctionalCacheRandomSeed)),
-      functional_cache_rand_gen_owned_(
-          make_unique<RandomGenerator>(functional_cache_bit_gen_owned_.get())),
-      functional_cache_rand_gen_(functional_cache_rand_gen_owned_.get()),
       max_abs_error_(max_abs_error),
-      num_train_steps_completed_(0) {
-  FillTasks(task_collection_, &tasks_);
+      op_cost_model_(op_cost_model),
+      num_train_steps_completed_(0),
+      num_functional_cache_hits_(0),
+      num_functional_cache_misses_(0),
+      watchdog_(watchdog),
+      num_timeouts_(0),
+      thread_pool_(thread_pool) {
+  if (task_store == nullptr) {
+    vector<unique_ptr<TaskInterface>> tasks;
+    FillTasks(task_collection_, &tasks);
+    tasks_.assign(std::make_move_iterator(tasks.begin()),
+                  std::make_move_iterator(tasks.end()));
+  } else {
+    node_tasks_ = task_store->GetNodeTasks(task_collection_);
+    tasks_ = node_tasks_[0];
+    topology_ = task_store->topology();
+  }
   CHECK_GT(tasks_.size(), 0);
   num_evaluations_ = 0;
   best_error_ = std::numeric_limits<double>::max();
@@ -84,29 +131,8 @@ Evaluator::Evaluator(const FitnessCombinationMode fitness_combination_mode,
 
 double Evaluator::EvaluateSingle(const Algorithm& algorithm) {
   // Compute the mean fitness across all tasks.
-  vector<double> task_fitnesses;
-  task_fitnesses.reserve(tasks_.size());
-  vector<double> debug_fitnesses;
-  vector<IntegerT> debug_num_train_examples;
-  vector<IntegerT> task_indexes;  // Tasks to use.
-  // Use all the tasks.
-
-  for (IntegerT i = 0; i < tasks_.size(); ++i) {
-    task_indexes.push_back(i);
-  }
-
-  for (IntegerT task_index : task_indexes) {
-    const unique_ptr<TaskInterface>& task = tasks_[task_index]; 
-    // cout << "Examples: " << task->MaxTrainExamples() << endl;
-    CHECK_GE(task->MaxTrainExamples(), kMinNumTrainExamples);
-    const IntegerT num_train_examples =
-        train_budget_ == nullptr ?
-        task->MaxTrainExamples() :
-        train_budget_->TrainExamples(algorithm, task->MaxTrainExamples());
-    double curr_fitness = -1.0;
-    curr_fitness = Execute(*task, num_train_examples, algorithm);
-    task_fitnesses.push_back(curr_fitness);
-  }
+  EvaluateTasks(algorithm, &task_fitnesses_);
+  const vector<double>& task_fitnesses = task_fitnesses_;
 
 
   double combined_fitness =
@@ -123,33 +149,22 @@ double Evaluator::EvaluateSingle(const Algorithm& algorithm) {
 
 
 std::pair<std::vector<double>, std::vector<double>> Evaluator::EvaluateMulti(const Algorithm& algorithm) {
-  // Compute the mean fitness across all tasks.
-  vector<double> task_fitnesses;
-  task_fitnesses.reserve(tasks_.size());
-  vector<double> debug_fitnesses;
-  vector<IntegerT> debug_num_train_examples;
-  vector<IntegerT> task_indexes;  // Tasks to use.
-  // Use all the tasks.
-  for (IntegerT i = 0; i < tasks_.size(); ++i) {
-    task_indexes.push_back(i);
-  }
+  std::pair<std::vector<double>, std::vector<double>> combined_fitness;
+  EvaluateMulti(algorithm, &combined_fitness);
+  return combined_fitness;
+}
 
-  for (IntegerT task_index : task_indexes) {
-    const unique_ptr<TaskInterface>& task = tasks_[task_index];
-    CHECK_GE(task->MaxTrainExamples(), kMinNumTrainExamples);
-    const IntegerT num_train_examples =
-        train_budget_ == nullptr ?
-        task->MaxTrainExamples() :
-        train_budget_->TrainExamples(algorithm, task->MaxTrainExamples());
-    double curr_fitness = -1.0;
-    curr_fitness = Execute(*task, num_train_examples, algorithm);
-    task_fitnesses.push_back(curr_fitness);
-  }
+void Evaluator::EvaluateMulti(
+    const Algorithm& algorithm,
+    std::pair<std::vector<double>, std::vector<double>>* fitness) {
+  // Compute the mean fitness across all tasks.
+  EvaluateTasks(algorithm, &task_fitnesses_);
+  const vector<double>& task_fitnesses = task_fitnesses_;
 
 //  std::cout << "Inside evaluator" << std::endl;
 
-  std::pair<std::vector<double>, std::vector<double>> combined_fitness = CombineFitnessesMulti(
-		  task_fitnesses, fitness_combination_mode_, algorithm);
+  CombineFitnessesMulti(task_fitnesses, fitness_combination_mode_, algorithm,
+                        op_cost_model_, fitness);
 
   ++num_evaluations_;
 
@@ -158,40 +173,440 @@ std::pair<std::vector<double>, std::vector<double>> Evaluator::EvaluateMulti(con
   //     best_error_ = combined_fitness.second;
   //     best_error_found_ = num_evaluations_;
   //   }
+}
 
-  return combined_fitness;
+void Evaluator::EvaluateTasks(const Algorithm& algorithm,
+                              vector<double>* task_fitnesses) {
+  task_fitnesses->resize(tasks_.size());
+  if (watchdog_ != nullptr) watchdog_->Start();
+  if (thread_pool_ != nullptr) {
+    // As a batch of one, so that the functional cache lookups are made in
+    // the order of the tasks, whichever threads run them.
+    EvaluateBatch({&algorithm}, [](IntegerT) {});
+    task_fitnesses->swap(batch_task_fitnesses_[0]);
+  } else {
+    for (IntegerT task_index = 0; task_index < tasks_.size(); ++task_index) {
+      (*task_fitnesses)[task_index] = EvaluateTask(algorithm, task_index);
+    }
+  }
+  if (watchdog_ != nullptr && watchdog_->Expired()) ++num_timeouts_;
+}
+
+void Evaluator::EvaluateMultiBatch(
+    const vector<shared_ptr<const Algorithm>>& algorithms,
+    vector<pair<vector<double>, vector<double>>>* fitnesses) {
+  fitnesses->resize(algorithms.size());
+  if (thread_pool_ == nullptr || watchdog_ != nullptr) {
+    for (IntegerT i = 0; i < algorithms.size(); ++i) {
+      EvaluateMulti(*algorithms[i], &(*fitnesses)[i]);
+    }
+    return;
+  }
+  EvaluateBatch(AlgorithmPointers(algorithms), [&](const IntegerT i) {
+    CombineFitnessesMulti(batch_task_fitnesses_[i], fitness_combination_mode_,
+                          *algorithms[i], op_cost_model_, &(*fitnesses)[i]);
+  });
+  num_evaluations_ += algorithms.size();
+}
+
+void Evaluator::EvaluateSingleBatch(
+    const vector<shared_ptr<const Algorithm>>& algorithms,
+    vector<double>* fitnesses) {
+  fitnesses->resize(algorithms.size());
+  if (thread_pool_ == nullptr || watchdog_ != nullptr) {
+    for (IntegerT i = 0; i < algorithms.size(); ++i) {
+      (*fitnesses)[i] = EvaluateSingle(*algorithms[i]);
+    }
+    return;
+  }
+  EvaluateBatch(AlgorithmPointers(algorithms), [&](const IntegerT i) {
+    const double combined_fitness = CombineFitnessesSingle(
+        batch_task_fitnesses_[i], fitness_combination_mode_);
+    CHECK_GE(combined_fitness, kMinFitness);
+    CHECK_LE(combined_fitness, kMaxFitness);
+    (*fitnesses)[i] = combined_fitness;
+  });
+  num_evaluations_ += algorithms.size();
+}
+
+void Evaluator::EvaluateBatch(
+    const vector<const Algorithm*>& algorithms,
+    const std::function<void(IntegerT)>& algorithm_done) {
+  CHECK(thread_pool_ != nullptr);
+  CHECK(watchdog_ == nullptr || algorithms.size() == 1);
+  const IntegerT num_tasks = tasks_.size();
+  const IntegerT num_pairs = algorithms.size() * num_tasks;
+  batch_task_fitnesses_.resize(algorithms.size());
+  for (vector<double>& task_fitnesses : batch_task_fitnesses_) {
+    task_fitnesses.resize(num_tasks);
+  }
+  batch_pairs_.resize(num_pairs);
+  batch_executed_pairs_.clear();
+  for (IntegerT pair_index = 0; pair_index < num_pairs; ++pair_index) {
+    const Algorithm& algorithm = *algorithms[pair_index / num_tasks];
+    const TaskInterface& task = *tasks_[pair_index % num_tasks];
+    CHECK_GE(task.MaxTrainExamples(), kMinNumTrainExamples);
+    batch_pairs_[pair_index].num_train_examples =
+        NumTrainExamples(algorithm, task);
+    batch_pairs_[pair_index].next_reusing_pair = -1;
+    batch_pairs_[pair_index].timed_out = false;
+  }
+
+  if (functional_cache_ == nullptr) {
+    for (IntegerT pair_index = 0; pair_index < num_pairs; ++pair_index) {
+      batch_executed_pairs_.push_back(pair_index);
+    }
+  } else {
+    // The probes are independent of each other.
+    thread_pool_->ParallelFor(num_pairs, [&](const IntegerT pair_index) {
+      BatchPair& batch_pair = batch_pairs_[pair_index];
+      if (watchdog_ != nullptr && watchdog_->Expired()) {
+        batch_pair.timed_out = true;
+        batch_pair.probe_train_steps = 0;
+        return;
+      }
+      ProbeBatchPair(*algorithms[pair_index / num_tasks],
+                     num_evaluations_ + pair_index / num_tasks,
+                     pair_index % num_tasks, &batch_pair);
+    });
+    // The cache lookups and insertions are not: they are made in the order
+    // of the sequential evaluations, so that the cache ends up in the same
+    // state. The fitness of an executed pair is only known later, so it is
+    // inserted as a placeholder, and the later pairs that find it reuse the
+    // execution instead.
+    batch_cache_owners_.clear();
+    for (IntegerT pair_index = 0; pair_index < num_pairs; ++pair_index) {
+      BatchPair& batch_pair = batch_pairs_[pair_index];
+      double& fitness =
+          batch_task_fitnesses_[pair_index / num_tasks][pair_index % num_tasks];
+      // Only the executed pairs keep their executor.
+      unique_ptr<SuspendedExecution> suspended_execution =
+          std::move(batch_pair.suspended_execution);
+      if (batch_pair.timed_out) {
+        // The errors are incomplete, so they can't be looked up.
+        fitness = kMinFitness;
+        num_train_steps_completed_ += batch_pair.probe_train_steps;
+        continue;
+      }
+      const pair<double, bool> fitness_and_found =
+          functional_cache_->Find(batch_pair.hash);
+      if (fitness_and_found.second) {
+        // Cache hit.
+        ++num_functional_cache_hits_;
+        num_train_steps_completed_ += batch_pair.probe_train_steps;
+        auto owner = batch_cache_owners_.find(batch_pair.hash);
+        if (owner == batch_cache_owners_.end()) {
+          fitness = fitness_and_found.first;
+        } else {
+          BatchPair& owner_pair = batch_pairs_[owner->second];
+          batch_pair.next_reusing_pair = owner_pair.next_reusing_pair;
+          owner_pair.next_reusing_pair = pair_index;
+        }
+        continue;
+      }
+      // Cache miss. If the probe stopped early, so would the full execution.
+      ++num_functional_cache_misses_;
+      if (batch_pair.resumable && !batch_pair.probe_completed) {
+        fitness = kMinFitness;
+        num_train_steps_completed_ += batch_pair.probe_train_steps;
+        functional_cache_->InsertOrDie(batch_pair.hash, fitness);
+        batch_cache_owners_.erase(batch_pair.hash);
+        continue;
+      }
+      // A resumable probe is part of the full execution, which counts its
+      // train steps.
+      if (!batch_pair.resumable) {
+        num_train_steps_completed_ += batch_pair.probe_train_steps;
+      }
+      functional_cache_->InsertOrDie(batch_pair.hash, kMinFitness);
+      batch_cache_owners_[batch_pair.hash] = pair_index;
+      batch_pair.suspended_execution = std::move(suspended_execution);
+      batch_executed_pairs_.push_back(pair_index);
+    }
+  }
+
+  // The continuation of an algorithm runs once the executions it waits for,
+  // its own and those it reuses, are all done.
+  vector<std::atomic<IntegerT>> num_unfinished(algorithms.size());
+  for (std::atomic<IntegerT>& count : num_unfinished) count = 0;
+  for (const IntegerT pair_index : batch_executed_pairs_) {
+    for (IntegerT reusing_pair = pair_index; reusing_pair != -1;
+         reusing_pair = batch_pairs_[reusing_pair].next_reusing_pair) {
+      ++num_unfinished[reusing_pair / num_tasks];
+    }
+  }
+  for (IntegerT i = 0; i < algorithms.size(); ++i) {
+    if (num_unfinished[i] == 0) algorithm_done(i);
+  }
+  thread_pool_->ParallelFor(
+      batch_executed_pairs_.size(), [&](const IntegerT executed_pair_index) {
+        const IntegerT pair_index = batch_executed_pairs_[executed_pair_index];
+        const IntegerT algorithm_index = pair_index / num_tasks;
+        const IntegerT task_index = pair_index % num_tasks;
+        BatchPair& batch_pair = batch_pairs_[pair_index];
+        IntegerT num_train_steps = 0;
+        double fitness;
+        if (watchdog_ != nullptr && watchdog_->Expired()) {
+          fitness = kMinFitness;
+          batch_pair.timed_out = true;
+        } else if (batch_pair.suspended_execution != nullptr) {
+          fitness = batch_pair.suspended_execution->Resume(
+              &num_train_steps, &batch_pair.timed_out);
+        } else {
+          PhiloxBitGen bit_gen(
+              evaluation_seed_,
+              EvaluationStream(num_evaluations_ + algorithm_index, task_index));
+          RandomGenerator rand_gen(&bit_gen);
+          fitness = ExecuteUncached(
+              LocalTask(task_index), batch_pair.num_train_examples,
+              *algorithms[algorithm_index], &rand_gen, watchdog_,
+              &num_train_steps, &batch_pair.timed_out);
+        }
+        batch_pair.suspended_execution.reset();
+        num_train_steps_completed_ += num_train_steps;
+        for (IntegerT reusing_pair = pair_index; reusing_pair != -1;
+             reusing_pair = batch_pairs_[reusing_pair].next_reusing_pair) {
+          batch_task_fitnesses_[reusing_pair / num_tasks]
+                               [reusing_pair % num_tasks] = fitness;
+          if (--num_unfinished[reusing_pair / num_tasks] == 0) {
+            algorithm_done(reusing_pair / num_tasks);
+          }
+        }
+      });
+
+  if (functional_cache_ != nullptr) {
+    // Fill in the placeholders that are still in the cache. Those of the
+    // executions ended by the watchdog are removed instead, as their fitness
+    // is not that of the algorithm.
+    for (const IntegerT pair_index : batch_executed_pairs_) {
+      const size_t hash = batch_pairs_[pair_index].hash;
+      auto owner = batch_cache_owners_.find(hash);
+      if (owner == batch_cache_owners_.end() || owner->second != pair_index) {
+        continue;
+      }
+      if (batch_pairs_[pair_index].timed_out) {
+        functional_cache_->Erase(hash);
+      } else {
+        functional_cache_->UpdateFitness(
+            hash,
+            batch_task_fitnesses_[pair_index / num_tasks]
+                                 [pair_index % num_tasks]);
+      }
+    }
+  }
+}
+
+void Evaluator::ProbeBatchPair(const Algorithm& algorithm,
+                               const IntegerT evaluation,
+                               const IntegerT task_index,
+                               BatchPair* batch_pair) {
+  const TaskInterface& task = LocalTask(task_index);
+  switch (task.FeaturesSize()) {
+    case 2:
+      ProbeBatchPairImpl<2>(*SafeDowncast<2>(&task), algorithm, evaluation,
+                            task_index, batch_pair);
+      return;
+    case 4:
+      ProbeBatchPairImpl<4>(*SafeDowncast<4>(&task), algorithm, evaluation,
+                            task_index, batch_pair);
+      return;
+    case 8:
+      ProbeBatchPairImpl<8>(*SafeDowncast<8>(&task), algorithm, evaluation,
+                            task_index, batch_pair);
+      return;
+    case 16:
+      ProbeBatchPairImpl<16>(*SafeDowncast<16>(&task), algorithm, evaluation,
+                             task_index, batch_pair);
+      return;
+    case 32:
+      ProbeBatchPairImpl<32>(*SafeDowncast<32>(&task), algorithm, evaluation,
+                             task_index, batch_pair);
+      return;
+    case 64:
+      ProbeBatchPairImpl<64>(*SafeDowncast<64>(&task), algorithm, evaluation,
+                             task_index, batch_pair);
+      return;
+    case 128:
+      ProbeBatchPairImpl<128>(*SafeDowncast<128>(&task), algorithm,
+                              evaluation, task_index, batch_pair);
+      return;
+    case 256:
+      ProbeBatchPairImpl<256>(*SafeDowncast<256>(&task), algorithm,
+                              evaluation, task_index, batch_pair);
+      return;
+    default:
+      LOG(FATAL) << "Unsupported features size." << endl;
+  }
+}
 
+double Evaluator::EvaluateTask(const Algorithm& algorithm,
+                               const IntegerT task_index) {
+  const TaskInterface& task = LocalTask(task_index);
+  CHECK_GE(task.MaxTrainExamples(), kMinNumTrainExamples);
+  if (watchdog_ != nullptr && watchdog_->Expired()) {
+    return kMinFitness;
+  }
+  return Execute(task, task_index, NumTrainExamples(algorithm, task),
+                 algorithm);
+}
+
+const TaskInterface& Evaluator::LocalTask(const IntegerT task_index) const {
+  if (node_tasks_.size() <= 1) return *tasks_[task_index];
+  const IntegerT node = CurrentNumaNode(topology_);
+  if (node >= node_tasks_.size()) return *tasks_[task_index];
+  return *node_tasks_[node][task_index];
+}
+
+IntegerT Evaluator::NumTrainExamples(const Algorithm& algorithm,
+                                     const TaskInterface& task) const {
+  return train_budget_ == nullptr ?
+      task.MaxTrainExamples() :
+      train_budget_->TrainExamples(algorithm, task.MaxTrainExamples());
 }
 
 double Evaluator::Execute(const TaskInterface& task,
+                          const IntegerT task_index,
                           const IntegerT num_train_examples,
                           const Algorithm& algorithm) {
   switch (task.FeaturesSize()) {
     case 2: {
       const Task<2>& downcasted_task = *SafeDowncast<2>(&task);
-      return ExecuteImpl<2>(downcasted_task, num_train_examples, algorithm);
+      return ExecuteImpl<2>(downcasted_task, task_index, num_train_examples,
+                            algorithm);
     }
     case 4: {
       const Task<4>& downcasted_task = *SafeDowncast<4>(&task);
-      return ExecuteImpl<4>(downcasted_task, num_train_examples, algorithm);
+      return ExecuteImpl<4>(downcasted_task, task_index, num_train_examples,
+                            algorithm);
     }
     case 8: {
       const Task<8>& downcasted_task = *SafeDowncast<8>(&task);
-      return ExecuteImpl<8>(downcasted_task, num_train_examples, algorithm);
+      return ExecuteImpl<8>(downcasted_task, task_index, num_train_examples,
+                            algorithm);
     }
     case 16: {
       const Task<16>& downcasted_task = *SafeDowncast<16>(&task);
-      return ExecuteImpl<16>(downcasted_task, num_train_examples, algorithm);
+      return ExecuteImpl<16>(downcasted_task, task_index, num_train_examples,
+                            algorithm);
     }
     case 32: {
       const Task<32>& downcasted_task = *SafeDowncast<32>(&task);
-      return ExecuteImpl<32>(downcasted_task, num_train_examples, algorithm);
+      return ExecuteImpl<32>(downcasted_task, task_index, num_train_examples,
+                            algorithm);
+    }
+    case 64: {
+      const Task<64>& downcasted_task = *SafeDowncast<64>(&task);
+      return ExecuteImpl<64>(downcasted_task, task_index, num_train_examples,
+                             algorithm);
+    }
+    case 128: {
+      const Task<128>& downcasted_task = *SafeDowncast<128>(&task);
+      return ExecuteImpl<128>(downcasted_task, task_index, num_train_examples,
+                              algorithm);
+    }
+    case 256: {
+      const Task<256>& downcasted_task = *SafeDowncast<256>(&task);
+      return ExecuteImpl<256>(downcasted_task, task_index, num_train_examples,
+                              algorithm);
     }
     default:
       LOG(FATAL) << "Unsupported features size." << endl;
   }
 }
 
+vector<double> Evaluator::Complexity(const Algorithm& algorithm) const {
+  return AlgorithmComplexity(algorithm, op_cost_model_);
+}
+
+IntegerT Evaluator::NumTasks() const {
+  return tasks_.size();
+}
+
+double Evaluator::EvaluateOnTask(const Algorithm& algorithm,
+                                 const IntegerT task_index,
+                                 const RandomSeedT seed) const {
+  CHECK_GE(task_index, 0);
+  CHECK_LT(task_index, tasks_.size());
+  const TaskInterface& task = LocalTask(task_index);
+  CHECK_GE(task.MaxTrainExamples(), kMinNumTrainExamples);
+  PhiloxBitGen bit_gen(seed);
+  RandomGenerator rand_gen(&bit_gen);
+  return ExecuteUncached(task, NumTrainExamples(algorithm, task), algorithm,
+                         &rand_gen,
+                         nullptr,  // watchdog
+                         nullptr,  // num_train_steps
+                         nullptr);  // timed_out
+}
+
+pair<vector<double>, vector<double>> Evaluator::CombineTaskFitnesses(
+    const vector<double>& task_fitnesses, const Algorithm& algorithm) const {
+  CHECK_EQ(task_fitnesses.size(), tasks_.size());
+  return CombineFitnessesMulti(
+      task_fitnesses, fitness_combination_mode_, algorithm, op_cost_model_);
+}
+
+double Evaluator::ExecuteUncached(const TaskInterface& task,
+                                  const IntegerT num_train_examples,
+                                  const Algorithm& algorithm,
+                                  RandomGenerator* rand_gen,
+                                  ExecutionWatchdog* watchdog,
+                                  IntegerT* num_train_steps,
+                                  bool* timed_out) const {
+  switch (task.FeaturesSize()) {
+    case 2: {
+      const Task<2>& downcasted_task = *SafeDowncast<2>(&task);
+      return ExecuteUncachedImpl<2>(downcasted_task, num_train_examples,
+                                    algorithm, rand_gen, watchdog,
+                                    num_train_steps, timed_out);
+    }
+    case 4: {
+      const Task<4>& downcasted_task = *SafeDowncast<4>(&task);
+      return ExecuteUncachedImpl<4>(downcasted_task, num_train_examples,
+                                    algorithm, rand_gen, watchdog,
+                                    num_train_steps, timed_out);
+    }
+    case 8: {
+      const Task<8>& downcasted_task = *SafeDowncast<8>(&task);
+      return ExecuteUncachedImpl<8>(downcasted_task, num_train_examples,
+                                    algorithm, rand_gen, watchdog,
+                                    num_train_steps, timed_out);
+    }
+    case 16: {
+      const Task<16>& downcasted_task = *SafeDowncast<16>(&task);
+      return ExecuteUncachedImpl<16>(downcasted_task, num_train_examples,
+                                     algorithm, rand_gen, watchdog,
+                                     num_train_steps, timed_out);
+    }
+    case 32: {
+      const Task<32>& downcasted_task = *SafeDowncast<32>(&task);
+      return ExecuteUncachedImpl<32>(downcasted_task, num_train_examples,
+                                     algorithm, rand_gen, watchdog,
+                                     num_train_steps, timed_out);
+    }
+    case 64: {
+      const Task<64>& downcasted_task = *SafeDowncast<64>(&task);
+      return ExecuteUncachedImpl<64>(downcasted_task, num_train_examples,
+                                     algorithm, rand_gen, watchdog,
+                                     num_train_steps, timed_out);
+    }
+    case 128: {
+      const Task<128>& downcasted_task = *SafeDowncast<128>(&task);
+      return ExecuteUncachedImpl<128>(downcasted_task, num_train_examples,
+                                      algorithm, rand_gen, watchdog,
+                                      num_train_steps, timed_out);
+    }
+    case 256: {
+      const Task<256>& downcasted_task = *SafeDowncast<256>(&task);
+      return ExecuteUncachedImpl<256>(downcasted_task, num_train_examples,
+                                      algorithm, rand_gen, watchdog,
+                                      num_train_steps, timed_out);
+    }
+    default:
+      LOG(FATAL) << "Unsupported features size." << endl;
+  }
+}
+
+
 IntegerT Evaluator::GetNumTrainStepsCompleted() const {
   return num_train_steps_completed_;
 }
@@ -200,49 +615,282 @@ IntegerT Evaluator::GetNumEvaluations(){
   return num_evaluations_;
 }
 
+IntegerT Evaluator::NumFunctionalCacheHits() const {
+  return num_functional_cache_hits_;
+}
+
+IntegerT Evaluator::NumFunctionalCacheMisses() const {
+  return num_functional_cache_misses_;
+}
+
+IntegerT Evaluator::NumTimeouts() const {
+  return num_timeouts_;
+}
+
+// The executor of a resumable probe, with the random generator of its
+// evaluation.
+template <FeatureIndexT F>
+class Evaluator::SuspendedExecutionImpl : public SuspendedExecution {
+ public:
+  SuspendedExecutionImpl(const RandomSeedT seed, const uint64_t stream)
+      : bit_gen_(seed, stream), rand_gen_(&bit_gen_) {}
+
+  Executor<F>& executor() { return *executor_; }
+  RandomGenerator* rand_gen() { return &rand_gen_; }
+
+  double Resume(IntegerT* num_train_steps, bool* timed_out) override {
+    PhaseProfileScope<kProfileExecution> profile_scope(
+        kEvaluationProfilePhase);
+    const double fitness = executor_->Execute();
+    *num_train_steps = executor_->GetNumTrainStepsCompleted();
+    *timed_out = executor_->TimedOut();
+    return fitness;
+  }
+
+ private:
+  PhiloxBitGen bit_gen_;
+  RandomGenerator rand_gen_;
+  ScopedExecutor<F> executor_;
+};
+
 template <FeatureIndexT F>
 double Evaluator::ExecuteImpl(const Task<F>& task,
+                              const IntegerT task_index,
                               const IntegerT num_train_examples,
                               const Algorithm& algorithm) {
+  PhaseProfileScope<kProfileExecution> profile_scope(kEvaluationProfilePhase);
+  PhiloxBitGen bit_gen(evaluation_seed_,
+                       EvaluationStream(num_evaluations_, task_index));
+  RandomGenerator rand_gen(&bit_gen);
   if (functional_cache_ != nullptr) {
     CHECK_LE(functional_cache_->NumTrainExamples(), task.MaxTrainExamples());
     CHECK_LE(functional_cache_->NumValidExamples(), task.ValidSteps());
-    functional_cache_bit_gen_owned_->seed(kFunctionalCacheRandomSeed);
-    Executor<F> functional_cache_executor(
-        algorithm, task, functional_cache_->NumTrainExamples(),
-        functional_cache_->NumValidExamples(), functional_cache_rand_gen_,
-        max_abs_error_);
-    vector<double> train_errors;
-    vector<double> valid_errors;
-    functional_cache_executor.Execute(&train_errors, &valid_errors);
-    num_train_steps_completed_ +=
-        functional_cache_executor.GetNumTrainStepsCompleted();
+    if (!UsesRandomOps(algorithm) &&
+        Executor<F>::CanProbe(task, num_train_examples,
+                              functional_cache_->NumTrainExamples())) {
+      // The probe is the beginning of the full execution, so a cache miss
+      // resumes it instead of starting over. Without random ops, the random
+      // generators don't matter, so the errors are the same as those of the
+      // separate probe below.
+      ScopedExecutor<F> executor;
+      executor->Reset(algorithm, task, num_train_examples, task.ValidSteps(),
+                      &rand_gen, max_abs_error_);
+      executor->SetWatchdog(watchdog_);
+      vector<double>& train_errors = ThreadFunctionalCacheErrors()->first;
+      vector<double>& valid_errors = ThreadFunctionalCacheErrors()->second;
+      train_errors.clear();
+      valid_errors.clear();
+      bool probe_completed;
+      {
+        PhaseProfileScope<kProfileExecution> functional_cache_profile_scope(
+            kFunctionalCacheProfilePhase);
+        probe_completed = executor->Probe(
+            functional_cache_->NumTrainExamples(),
+            functional_cache_->NumValidExamples(), &train_errors,
+            &valid_errors);
+      }
+      if (executor->TimedOut()) {
+        // The errors are incomplete, so they can't be looked up.
+        num_train_steps_completed_ += executor->GetNumTrainStepsCompleted();
+        return kMinFitness;
+      }
+      const size_t hash = functional_cache_->Hash(
+          train_errors, valid_errors, task_index, num_train_examples);
+      pair<double, bool> fitness_and_found = functional_cache_->Find(hash);
+      if (fitness_and_found.second) {
+        // Cache hit.
+        ++num_functional_cache_hits_;
+        num_train_steps_completed_ += executor->GetNumTrainStepsCompleted();
+        functional_cache_->UpdateOrDie(hash, fitness_and_found.first);
+        return fitness_and_found.first;
+      }
+      // Cache miss. If the probe stopped early, so would the full execution.
+      ++num_functional_cache_misses_;
+      const double fitness =
+          probe_completed ? executor->Execute() : kMinFitness;
+      num_train_steps_completed_ += executor->GetNumTrainStepsCompleted();
+      if (!executor->TimedOut()) {
+        functional_cache_->InsertOrDie(hash, fitness);
+      }
+      return fitness;
+    }
+
+    // Cheap to seed, unlike a std::mt19937.
+    PhiloxBitGen functional_cache_bit_gen(kFunctionalCacheRandomSeed);
+    RandomGenerator functional_cache_rand_gen(&functional_cache_bit_gen);
+    ScopedExecutor<F> executor;
+    vector<double>& train_errors = ThreadFunctionalCacheErrors()->first;
+    vector<double>& valid_errors = ThreadFunctionalCacheErrors()->second;
+    train_errors.clear();
+    valid_errors.clear();
+    {
+      PhaseProfileScope<kProfileExecution> functional_cache_profile_scope(
+          kFunctionalCacheProfilePhase);
+      executor->Reset(algorithm, task, functional_cache_->NumTrainExamples(),
+                      functional_cache_->NumValidExamples(),
+                      &functional_cache_rand_gen, max_abs_error_);
+      executor->SetWatchdog(watchdog_);
+      executor->Execute(&train_errors, &valid_errors);
+      num_train_steps_completed_ += executor->GetNumTrainStepsCompleted();
+    }
+    if (executor->TimedOut()) {
+      return kMinFitness;
+    }
     const size_t hash = functional_cache_->Hash(
-        train_errors, valid_errors, task.index_, num_train_examples);
+        train_errors, valid_errors, task_index, num_train_examples);
     pair<double, bool> fitness_and_found = functional_cache_->Find(hash);
     if (fitness_and_found.second) {
       // Cache hit.
+      ++num_functional_cache_hits_;
       functional_cache_->UpdateOrDie(hash, fitness_and_found.first);
       return fitness_and_found.first;
     } else {
       // Cache miss.
-      Executor<F> executor(algorithm, task, num_train_examples,
-                           task.ValidSteps(), rand_gen_, max_abs_error_);
-      double fitness = executor.Execute();
-      num_train_steps_completed_ += executor.GetNumTrainStepsCompleted();
-      functional_cache_->InsertOrDie(hash, fitness);
+      ++num_functional_cache_misses_;
+      executor->Reset(algorithm, task, num_train_examples, task.ValidSteps(),
+                      &rand_gen, max_abs_error_);
+      executor->SetWatchdog(watchdog_);
+      double fitness = executor->Execute();
+      num_train_steps_completed_ += executor->GetNumTrainStepsCompleted();
+      if (!executor->TimedOut()) {
+        functional_cache_->InsertOrDie(hash, fitness);
+      }
       return fitness;
     }
   } else {
-    Executor<F> executor(
-        algorithm, task, num_train_examples, task.ValidSteps(),
-        rand_gen_, max_abs_error_);
-    const double fitness = executor.Execute();
-    num_train_steps_completed_ += executor.GetNumTrainStepsCompleted();
+    ScopedExecutor<F> executor;
+    executor->Reset(algorithm, task, num_train_examples, task.ValidSteps(),
+                    &rand_gen, max_abs_error_);
+    executor->SetWatchdog(watchdog_);
+    const double fitness = executor->Execute();
+    num_train_steps_completed_ += executor->GetNumTrainStepsCompleted();
     return fitness;
   }
 }
 
+template <FeatureIndexT F>
+double Evaluator::ExecuteUncachedImpl(const Task<F>& task,
+                                      const IntegerT num_train_examples,
+                                      const Algorithm& algorithm,
+                                      RandomGenerator* rand_gen,
+                                      ExecutionWatchdog* watchdog,
+                                      IntegerT* num_train_steps,
+                                      bool* timed_out) const {
+  PhaseProfileScope<kProfileExecution> profile_scope(kEvaluationProfilePhase);
+  ScopedExecutor<F> executor;
+  executor->Reset(algorithm, task, num_train_examples, task.ValidSteps(),
+                  rand_gen, max_abs_error_);
+  executor->SetWatchdog(watchdog);
+  const double fitness = executor->Execute();
+  if (num_train_steps != nullptr) {
+    *num_train_steps = executor->GetNumTrainStepsCompleted();
+  }
+  if (timed_out != nullptr) *timed_out = executor->TimedOut();
+  return fitness;
+}
+
+template <FeatureIndexT F>
+void Evaluator::ProbeBatchPairImpl(const Task<F>& task,
+                                   const Algorithm& algorithm,
+                                   const IntegerT evaluation,
+                                   const IntegerT task_index,
+                                   BatchPair* batch_pair) {
+  // The same probe as that of ExecuteImpl, so that it gets the same hash.
+  CHECK_LE(functional_cache_->NumTrainExamples(), task.MaxTrainExamples());
+  CHECK_LE(functional_cache_->NumValidExamples(), task.ValidSteps());
+  PhaseProfileScope<kProfileExecution> functional_cache_profile_scope(
+      kFunctionalCacheProfilePhase);
+  vector<double>& train_errors = ThreadFunctionalCacheErrors()->first;
+  vector<double>& valid_errors = ThreadFunctionalCacheErrors()->second;
+  train_errors.clear();
+  valid_errors.clear();
+  batch_pair->resumable =
+      !UsesRandomOps(algorithm) &&
+      Executor<F>::CanProbe(task, batch_pair->num_train_examples,
+                            functional_cache_->NumTrainExamples());
+  batch_pair->suspended_execution.reset();
+  if (batch_pair->resumable) {
+    auto suspended_execution = make_unique<SuspendedExecutionImpl<F>>(
+        evaluation_seed_, EvaluationStream(evaluation, task_index));
+    Executor<F>& executor = suspended_execution->executor();
+    executor.Reset(algorithm, task, batch_pair->num_train_examples,
+                   task.ValidSteps(), suspended_execution->rand_gen(),
+                   max_abs_error_);
+    executor.SetWatchdog(watchdog_);
+    batch_pair->probe_completed = executor.Probe(
+        functional_cache_->NumTrainExamples(),
+        functional_cache_->NumValidExamples(), &train_errors, &valid_errors);
+    batch_pair->probe_train_steps = executor.GetNumTrainStepsCompleted();
+    batch_pair->timed_out = executor.TimedOut();
+    if (batch_pair->probe_completed) {
+      batch_pair->suspended_execution = std::move(suspended_execution);
+    }
+  } else {
+    PhiloxBitGen functional_cache_bit_gen(kFunctionalCacheRandomSeed);
+    RandomGenerator functional_cache_rand_gen(&functional_cache_bit_gen);
+    ScopedExecutor<F> executor;
+    executor->Reset(algorithm, task, functional_cache_->NumTrainExamples(),
+                    functional_cache_->NumValidExamples(),
+                    &functional_cache_rand_gen, max_abs_error_);
+    executor->SetWatchdog(watchdog_);
+    executor->Execute(&train_errors, &valid_errors);
+    batch_pair->probe_completed = true;
+    batch_pair->probe_train_steps = executor->GetNumTrainStepsCompleted();
+    batch_pair->timed_out = executor->TimedOut();
+  }
+  batch_pair->hash = functional_cache_->Hash(
+      train_errors, valid_errors, task_index, batch_pair->num_train_examples);
+}
+
+vector<vector<double>> EvaluateTaskFitnesses(
+    const Evaluator& evaluator,
+    const vector<shared_ptr<const Algorithm>>& algorithms,
+    const RandomSeedT seed, const IntegerT num_threads) {
+  const IntegerT num_tasks = evaluator.NumTasks();
+  vector<vector<double>> fitnesses(algorithms.size(),
+                                   vector<double>(num_tasks));
+  // A pair is the unit of work, so that a few slow algorithms or tasks don't
+  // leave the other threads idle.
+  ThreadPool thread_pool(
+      std::min<IntegerT>(num_threads, algorithms.size() * num_tasks));
+  thread_pool.ParallelFor(
+      algorithms.size() * num_tasks, [&](const IntegerT pair_index) {
+        const IntegerT algorithm_index = pair_index / num_tasks;
+        const IntegerT task_index = pair_index % num_tasks;
+        const RandomSeedT pair_seed = HashMix<RandomSeedT>(
+            {seed, static_cast<RandomSeedT>(algorithm_index),
+             static_cast<RandomSeedT>(task_index)});
+        fitnesses[algorithm_index][task_index] = evaluator.EvaluateOnTask(
+            *algorithms[algorithm_index], task_index, pair_seed);
+      });
+  return fitnesses;
+}
+
+std::vector<double> AlgorithmComplexity(const Algorithm& algorithm,
+                                        const OpCostModel* op_cost_model) {
+  vector<double> complexity;
+  AlgorithmComplexity(algorithm, op_cost_model, &complexity);
+  return complexity;
+}
+
+void AlgorithmComplexity(const Algorithm& algorithm,
+                         const OpCostModel* op_cost_model,
+                         vector<double>* complexity) {
+  double setup_complexity, learn_complexity, predict_complexity;
+  if (op_cost_model == nullptr) {
+    setup_complexity = ComputeCostNew(algorithm.setup_);
+    learn_complexity = ComputeCostNew(algorithm.learn_);
+    predict_complexity = ComputeCostNew(algorithm.predict_);
+  } else {
+    setup_complexity = op_cost_model->Cost(algorithm.setup_);
+    learn_complexity = op_cost_model->Cost(algorithm.learn_);
+    predict_complexity = op_cost_model->Cost(algorithm.predict_);
+  }
+  complexity->assign(
+      {predict_complexity, learn_complexity, setup_complexity,
+       setup_complexity + learn_complexity + predict_complexity});
+}
+
 namespace internal {
 
 double Median(vector<double> values) {  // Intentional copy.
@@ -271,42 +919,31 @@ double CombineFitnessesSingle(
 std::pair<std::vector<double>, std::vector<double>> CombineFitnessesMulti(
     const vector<double>& task_fitnesses,
     const FitnessCombinationMode mode,
-	const Algorithm& algorithm) {
+	const Algorithm& algorithm,
+	const OpCostModel* op_cost_model) {
+  std::pair<std::vector<double>, std::vector<double>> combined_fitness;
+  CombineFitnessesMulti(task_fitnesses, mode, algorithm, op_cost_model,
+                        &combined_fitness);
+  return combined_fitness;
+}
+
+void CombineFitnessesMulti(
+    const vector<double>& task_fitnesses, const FitnessCombinationMode mode,
+    const Algorithm& algorithm, const OpCostModel* op_cost_model,
+    std::pair<std::vector<double>, std::vector<double>>* combined_fitness) {
   if (mode == MULTI_OBJECTIVE) {
     double sum = std::accumulate(task_fitnesses.begin(), task_fitnesses.end(), 0.0);
     double avg_fitness = sum / task_fitnesses.size();
 
-    std::vector<double> diff(task_fitnesses.size());
-    std::transform(task_fitnesses.begin(), task_fitnesses.end(), diff.begin(),
-                  std::bind2nd(std::minus<double>(), avg_fitness));
-    double sq_sum = std::inner_product(diff.begin(), diff.end(), diff.begin(), 0.0);
+    double sq_sum = 0.0;
+    for (const double fitness : task_fitnesses) {
+      sq_sum += (fitness - avg_fitness) * (fitness - avg_fitness);
+    }
     double stdev = std::sqrt(sq_sum / task_fitnesses.size());
 
-
-    double algorithm_length = static_cast<double>(algorithm.setup_.size() + algorithm.learn_.size() + algorithm.predict_.size());
     double avg_error = 1-avg_fitness;
-
-    std::vector<double> algorithm_complexity;
-    std::vector<double> error;
-    error.push_back(avg_error);
-    error.push_back(stdev);
-
-    double setup_complexity, predict_complexity, learn_complexity, overall_original_complexity;
-
-    setup_complexity = ComputeCostNew(algorithm.setup_);
-    learn_complexity = ComputeCostNew(algorithm.learn_);
-    predict_complexity = ComputeCostNew(algorithm.predict_);
-
-    overall_original_complexity = setup_complexity + learn_complexity + predict_complexity;
-
-    algorithm_complexity.push_back(predict_complexity);
-    algorithm_complexity.push_back(learn_complexity);
-    algorithm_complexity.push_back(setup_complexity);
-    algorithm_complexity.push_back(overall_original_complexity);
-
-    std::pair<std::vector<double>, std::vector<double>> combined_fitness(error, algorithm_complexity);
-
-    return combined_fitness;
+    combined_fitness->first.assign({avg_error, stdev});
+    AlgorithmComplexity(algorithm, op_cost_model, &combined_fitness->second);
   }
   else {
     LOG(FATAL) << "Unsupported fitness combination." << endl;
@@ -15,18 +15,27 @@
 #ifndef AUTOML_ZERO_EVALUATOR_H_
 #define AUTOML_ZERO_EVALUATOR_H_
 
+#include <atomic>
 #include <cstdio>
+#include <functional>
 #include <memory>
 #include <random>
+#include <unordered_map>
 #include <vector>
 
 #include "algorithm.h"
 #include "task.h"
 #include "task.pb.h"
+#include "cpu_topology.h"
 #include "definitions.h"
+#include "execution_watchdog.h"
 #include "experiment.pb.h"
 #include "fec_cache.h"
+#include "op_cost_model.h"
+#include "parallel.h"
+#include "philox.h"
 #include "random_generator.h"
+#include "task_store.h"
 #include "train_budget.h"
 
 namespace automl_zero {
@@ -42,8 +51,10 @@ class Evaluator {
       // Tasks to use. Will be filtered to only keep tasks targeted
       // to this worker.
       const TaskCollection& task_collection,
-      // The random generator seed to use for any random operations that
-      // may be executed by the component function (e.g. VectorRandomInit).
+      // Draws the seed of the random operations that may be executed by the
+      // component function (e.g. VectorRandomInit). Each evaluation of each
+      // task then gets its own Philox stream of that seed, so the random
+      // numbers of an evaluation don't depend on those before it.
       RandomGenerator* rand_gen,
       // An cache to avoid reevaluating models that are functionally
       // identical. Can be nullptr.
@@ -52,7 +63,21 @@ class Evaluator {
       TrainBudget* train_budget,
       // Errors larger than this trigger early stopping, as they signal
       // models that likely have runnaway behavior.
-      double max_abs_error);
+      double max_abs_error,
+      // Measured op latencies to use as the complexity objective. Can be
+      // nullptr, in which case the complexity is the FLOP count.
+      const OpCostModel* op_cost_model = nullptr,
+      // Shares the tasks with other Evaluators. Can be nullptr, in which
+      // case this Evaluator generates its own copy of the tasks.
+      TaskStore* task_store = nullptr,
+      // Bounds the work of each evaluation. The evaluations that go over it
+      // get the minimum fitness on the tasks they had left, and are not
+      // stored in the functional cache. Can be nullptr.
+      ExecutionWatchdog* watchdog = nullptr,
+      // Evaluates the tasks of each algorithm concurrently on these threads.
+      // Can be shared with other Evaluators. Can be nullptr, in which case
+      // the tasks are evaluated in order on the calling thread.
+      ThreadPool* thread_pool = nullptr);
       // If false, suppresses all logging output. Finer grain control
       // available through logging flags.
 
@@ -65,19 +90,160 @@ class Evaluator {
 
   // Multi-objective
   std::pair<std::vector<double>, std::vector<double>> EvaluateMulti(const Algorithm& algorithm);
+  // Like above, but writes the fitness into `fitness`, reusing its vectors.
+  // Once the caches and buffers have warmed up, does not allocate.
+  void EvaluateMulti(
+      const Algorithm& algorithm,
+      std::pair<std::vector<double>, std::vector<double>>* fitness);
+  // Evaluates the algorithms as the same sequence of EvaluateMulti calls
+  // would, with the same results, and writes their fitnesses into
+  // `fitnesses`. With a thread pool, the (algorithm, task) pairs of all the
+  // algorithms are scheduled together, so that the threads don't wait for the
+  // slowest task of each algorithm, and the fitness of an algorithm is
+  // combined as soon as its tasks are done. Without one, or with a watchdog,
+  // which times each evaluation on its own, the algorithms are evaluated one
+  // after the other. With a watchdog, the pairs can't be batched across
+  // algorithms: a pair that reuses the execution of another algorithm's pair
+  // would get the minimum fitness when that algorithm runs out of budget, and
+  // the time limit would count the time spent waiting for the other
+  // algorithms.
+  void EvaluateMultiBatch(
+      const std::vector<std::shared_ptr<const Algorithm>>& algorithms,
+      std::vector<std::pair<std::vector<double>, std::vector<double>>>*
+          fitnesses);
+  // Like above, as a sequence of EvaluateSingle calls.
+  void EvaluateSingleBatch(
+      const std::vector<std::shared_ptr<const Algorithm>>& algorithms,
+      std::vector<double>* fitnesses);
+
+  // The complexity objectives of an algorithm, as returned by EvaluateMulti.
+  std::vector<double> Complexity(const Algorithm& algorithm) const;
+
+  // The number of tasks.
+  IntegerT NumTasks() const;
+
+  // Evaluates an algorithm on the task at `task_index` only. The algorithm
+  // draws its random numbers from a generator seeded with `seed`. Does not use
+  // the functional cache nor update the counters of this Evaluator, so it can
+  // be called concurrently.
+  double EvaluateOnTask(const Algorithm& algorithm, IntegerT task_index,
+                        RandomSeedT seed) const;
+
+  // Combines the fitnesses of an algorithm on each of the tasks, as
+  // EvaluateMulti does.
+  std::pair<std::vector<double>, std::vector<double>> CombineTaskFitnesses(
+      const std::vector<double>& task_fitnesses,
+      const Algorithm& algorithm) const;
+
   // Get the number of train steps this evaluator has performed.
   IntegerT GetNumTrainStepsCompleted() const; 
 
   // Get the best error and corresponding number of evaluations found for this evaluator.
   IntegerT GetNumEvaluations(); 
 
+  // The number of task evaluations that were found in / missing from the
+  // functional cache. Both are 0 if there is no functional cache.
+  IntegerT NumFunctionalCacheHits() const;
+  IntegerT NumFunctionalCacheMisses() const;
+
+  // The number of evaluations ended by the watchdog.
+  IntegerT NumTimeouts() const;
+
  private:
-  double Execute(const TaskInterface& task, IntegerT num_train_examples,
-                 const Algorithm& algorithm);
+  // Writes the fitness of the algorithm on each task into `task_fitnesses`.
+  void EvaluateTasks(const Algorithm& algorithm,
+                     std::vector<double>* task_fitnesses);
+  // Evaluates the algorithm on one task, on the calling thread.
+  double EvaluateTask(const Algorithm& algorithm, IntegerT task_index);
+
+  // A functional cache probe that is the beginning of the full execution,
+  // suspended until EvaluateBatch knows whether to finish it.
+  class SuspendedExecution {
+   public:
+    virtual ~SuspendedExecution() = default;
+    // Runs the rest of the execution, possibly on another thread. Returns its
+    // fitness, writes the train steps of the whole execution, probe included,
+    // into `num_train_steps` and whether the watchdog ended it into
+    // `timed_out`.
+    virtual double Resume(IntegerT* num_train_steps, bool* timed_out) = 0;
+  };
+  template <FeatureIndexT F>
+  class SuspendedExecutionImpl;
 
+  // An (algorithm, task) pair of EvaluateBatch.
+  struct BatchPair {
+    IntegerT num_train_examples;
+    // The functional cache probe, as in ExecuteImpl: its hash, whether it ran
+    // to the end, the train steps it took and whether it is the beginning of
+    // the full execution.
+    size_t hash;
+    bool probe_completed;
+    IntegerT probe_train_steps;
+    bool resumable;
+    // The executor of a resumable probe that ran to the end, so that the full
+    // execution resumes it rather than starting over. Only kept on the pairs
+    // that are then executed, until they are.
+    std::unique_ptr<SuspendedExecution> suspended_execution;
+    // Whether the watchdog ended the probe or the execution of the pair.
+    bool timed_out;
+    // The next pair whose fitness is that of the full execution of this one,
+    // because it got the same hash, or -1. Only set on the executed pairs and
+    // the pairs that reuse them.
+    IntegerT next_reusing_pair;
+  };
+
+  // Evaluates the algorithms as the evaluations numbered from
+  // num_evaluations_ on, writing the fitness of algorithm i on each task into
+  // batch_task_fitnesses_[i] and then calling `algorithm_done(i)`, possibly
+  // concurrently for different i. The functional cache ends up as after the
+  // serial evaluations. Requires a thread pool. With a watchdog, which bounds
+  // each evaluation, takes a single algorithm.
+  void EvaluateBatch(const std::vector<const Algorithm*>& algorithms,
+                     const std::function<void(IntegerT)>& algorithm_done);
+
+  // Runs the functional cache probe of `algorithm` on a task, with the random
+  // numbers of the evaluation numbered `evaluation`. Thread-safe.
+  void ProbeBatchPair(const Algorithm& algorithm, IntegerT evaluation,
+                      IntegerT task_index, BatchPair* batch_pair);
   template <FeatureIndexT F>
-  double ExecuteImpl(const Task<F>& task, IntegerT num_train_examples,
-                     const Algorithm& algorithm);
+  void ProbeBatchPairImpl(const Task<F>& task, const Algorithm& algorithm,
+                          IntegerT evaluation, IntegerT task_index,
+                          BatchPair* batch_pair);
+
+  // The copy of the task in tasks_ on the NUMA node of the calling thread. For
+  // a thread that was not pinned, this is the node of the CPU it runs on.
+  const TaskInterface& LocalTask(IntegerT task_index) const;
+
+  // The number of examples to train `algorithm` on `task`.
+  IntegerT NumTrainExamples(const Algorithm& algorithm,
+                            const TaskInterface& task) const;
+
+  // `task_index` is the index of the task in tasks_.
+  double Execute(const TaskInterface& task, IntegerT task_index,
+                 IntegerT num_train_examples, const Algorithm& algorithm);
+
+  template <FeatureIndexT F>
+  double ExecuteImpl(const Task<F>& task, IntegerT task_index,
+                     IntegerT num_train_examples, const Algorithm& algorithm);
+
+  // Like Execute, but without the functional cache and with the given random
+  // generator and watchdog, which can be nullptr. Writes the train steps it
+  // took into `num_train_steps` and whether the watchdog ended it into
+  // `timed_out`, if not nullptr.
+  double ExecuteUncached(const TaskInterface& task,
+                         IntegerT num_train_examples,
+                         const Algorithm& algorithm,
+                         RandomGenerator* rand_gen,
+                         ExecutionWatchdog* watchdog,
+                         IntegerT* num_train_steps, bool* timed_out) const;
+
+  template <FeatureIndexT F>
+  double ExecuteUncachedImpl(const Task<F>& task, IntegerT num_train_examples,
+                             const Algorithm& algorithm,
+                             RandomGenerator* rand_gen,
+                             ExecutionWatchdog* watchdog,
+                             IntegerT* num_train_steps,
+                             bool* timed_out) const;
 
   double CapFitness(double fitness);
 
@@ -87,17 +253,37 @@ class Evaluator {
   const TaskCollection task_collection_;
 
   TrainBudget* train_budget_;
-  RandomGenerator* rand_gen_;
-  std::vector<std::unique_ptr<TaskInterface>> tasks_;
+  // The key of the Philox streams of the (evaluation, task) pairs.
+  const RandomSeedT evaluation_seed_;
+  std::vector<std::shared_ptr<const TaskInterface>> tasks_;
+  // The copies of tasks_ on each NUMA node, see TaskStore::GetNodeTasks. Only
+  // set with a task store.
+  std::vector<std::vector<std::shared_ptr<const TaskInterface>>> node_tasks_;
+  // The topology of node_tasks_, or nullptr.
+  const CpuTopology* topology_;
   FECCache* functional_cache_;
-  std::unique_ptr<std::mt19937> functional_cache_bit_gen_owned_;
-  std::unique_ptr<RandomGenerator> functional_cache_rand_gen_owned_;
-  RandomGenerator* functional_cache_rand_gen_;
   const std::vector<RandomSeedT> first_param_seeds_;
   const std::vector<RandomSeedT> first_data_seeds_;
 
   const double max_abs_error_;
-  IntegerT num_train_steps_completed_;
+  const OpCostModel* op_cost_model_;
+  // Updated by the tasks concurrently.
+  std::atomic<IntegerT> num_train_steps_completed_;
+  std::atomic<IntegerT> num_functional_cache_hits_;
+  std::atomic<IntegerT> num_functional_cache_misses_;
+  ExecutionWatchdog* watchdog_;
+  IntegerT num_timeouts_;
+  ThreadPool* thread_pool_;
+  // The fitness on each task of the algorithm being evaluated. Reused across
+  // evaluations.
+  std::vector<double> task_fitnesses_;
+  // The state of EvaluateBatch, reused across batches.
+  std::vector<std::vector<double>> batch_task_fitnesses_;
+  std::vector<BatchPair> batch_pairs_;
+  std::vector<IntegerT> batch_executed_pairs_;
+  // The last executed pair that inserted each hash into the functional cache,
+  // while the hash stays there.
+  std::unordered_map<size_t, IntegerT> batch_cache_owners_;
   // count the number of evaluations
   IntegerT num_evaluations_;
 
@@ -105,6 +291,26 @@ class Evaluator {
   IntegerT best_error_found_;
 };
 
+// Evaluates each of the algorithms on each of the tasks of `evaluator`,
+// spreading the (algorithm, task) pairs over up to `num_threads` threads. The
+// random generator of each pair is seeded from `seed` and the indexes of the
+// pair, so the results do not depend on the number of threads. Returns the
+// fitnesses indexed by [algorithm][task].
+std::vector<std::vector<double>> EvaluateTaskFitnesses(
+    const Evaluator& evaluator,
+    const std::vector<std::shared_ptr<const Algorithm>>& algorithms,
+    RandomSeedT seed, IntegerT num_threads);
+
+// The complexity objectives of an algorithm: {predict, learn, setup, overall}.
+// Does not require executing the algorithm. If `op_cost_model` is nullptr, the
+// complexity is the FLOP count of ComputeCostNew.
+std::vector<double> AlgorithmComplexity(
+    const Algorithm& algorithm, const OpCostModel* op_cost_model = nullptr);
+// Like above, but reuses the `complexity` vector.
+void AlgorithmComplexity(const Algorithm& algorithm,
+                         const OpCostModel* op_cost_model,
+                         std::vector<double>* complexity);
+
 namespace internal {
 
 double CombineFitnessesSingle(
@@ -114,7 +320,15 @@ double CombineFitnessesSingle(
 std::pair<std::vector<double>, std::vector<double>> CombineFitnessesMulti(
 		const std::vector<double>& task_fitnesses,
 		const FitnessCombinationMode mode,
-		const Algorithm& algorithm);
+		const Algorithm& algorithm,
+		const OpCostModel* op_cost_model = nullptr);
+
+// Like above, but reuses the vectors of `combined_fitness`.
+void CombineFitnessesMulti(
+    const std::vector<double>& task_fitnesses,
+    FitnessCombinationMode mode, const Algorithm& algorithm,
+    const OpCostModel* op_cost_model,
+    std::pair<std::vector<double>, std::vector<double>>* combined_fitness);
 
 }  // namespace internal
 
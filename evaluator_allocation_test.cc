@@ -0,0 +1,171 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Checks that the evaluation of an algorithm does not allocate once the
+// caches and buffers have warmed up. The global operator new is replaced, to
+// count the allocations of the calling thread. Eigen allocates its dynamic
+// matrices with malloc, so only feature sizes with fixed-size matrices are
+// covered.
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "evaluator.h"
+#include "experiment.pb.h"
+#include "fec_cache.h"
+#include "fec_cache.pb.h"
+#include "generator.h"
+#include "instruction.pb.h"
+#include "random_generator.h"
+#include "task.pb.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+
+namespace {
+
+thread_local int64_t num_allocations = 0;
+
+void* CountedAllocation(const std::size_t size) {
+  ++num_allocations;
+  void* allocated = std::malloc(size == 0 ? 1 : size);
+  if (allocated == nullptr) throw std::bad_alloc();
+  return allocated;
+}
+
+}  // namespace
+
+void* operator new(const std::size_t size) { return CountedAllocation(size); }
+void* operator new[](const std::size_t size) {
+  return CountedAllocation(size);
+}
+void operator delete(void* allocated) noexcept { std::free(allocated); }
+void operator delete[](void* allocated) noexcept { std::free(allocated); }
+void operator delete(void* allocated, std::size_t) noexcept {
+  std::free(allocated);
+}
+void operator delete[](void* allocated, std::size_t) noexcept {
+  std::free(allocated);
+}
+
+namespace automl_zero {
+
+using ::absl::make_unique;  // NOLINT
+using ::absl::StrCat;  // NOLINT
+using ::std::pair;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+constexpr IntegerT kNumTasks = 4;
+constexpr IntegerT kNumAlgorithms = 16;
+constexpr IntegerT kNumWarmUpRounds = 3;
+constexpr double kLargeMaxAbsError = 1000000000.0;
+
+// Evaluates a few random algorithms round after round, and returns the number
+// of allocations of the last round.
+template <FeatureIndexT F>
+int64_t CountSteadyStateAllocations(const vector<Op>& ops,
+                                    const bool use_functional_cache) {
+  std::mt19937 bit_gen(100000);
+  RandomGenerator rand_gen(&bit_gen);
+  Generator generator(RANDOM_ALGORITHM, 10, 2, 8, ops, ops, ops, &bit_gen,
+                      &rand_gen);
+  vector<Algorithm> algorithms(kNumAlgorithms);
+  for (Algorithm& algorithm : algorithms) {
+    algorithm = generator.Random();
+  }
+  unique_ptr<FECCache> functional_cache;
+  if (use_functional_cache) {
+    FECSpec fec_spec;
+    fec_spec.set_num_train_examples(10);
+    fec_spec.set_num_valid_examples(10);
+    // Smaller than the number of evaluations in a round, so that there are
+    // both hits and evictions.
+    fec_spec.set_cache_size(kNumTasks * kNumAlgorithms / 2);
+    fec_spec.set_forget_every(3);
+    functional_cache = make_unique<FECCache>(fec_spec);
+  }
+  const auto task_collection = ParseTextFormat<TaskCollection>(StrCat(
+      "tasks { "
+      "  scalar_linear_regression_task {} "
+      "  features_size: ", F, " "
+      "  num_train_examples: 100 "
+      "  num_valid_examples: 100 "
+      "  num_tasks: ", kNumTasks, " "
+      "  eval_type: RMS_ERROR "
+      "} "));
+  Evaluator evaluator(MULTI_OBJECTIVE, task_collection, &rand_gen,
+                      functional_cache.get(),
+                      nullptr,  // train_budget
+                      kLargeMaxAbsError);
+
+  pair<vector<double>, vector<double>> fitness;
+  for (IntegerT round = 0; round < kNumWarmUpRounds; ++round) {
+    for (const Algorithm& algorithm : algorithms) {
+      evaluator.EvaluateMulti(algorithm, &fitness);
+    }
+  }
+  const int64_t num_allocations_before = num_allocations;
+  for (const Algorithm& algorithm : algorithms) {
+    evaluator.EvaluateMulti(algorithm, &fitness);
+  }
+  return num_allocations - num_allocations_before;
+}
+
+const vector<Op>& DeterministicOps() {
+  static const vector<Op>* const ops = new vector<Op>(
+      {SCALAR_CONST_SET_OP, VECTOR_INNER_PRODUCT_OP, SCALAR_DIFF_OP,
+       SCALAR_PRODUCT_OP, SCALAR_VECTOR_PRODUCT_OP, VECTOR_SUM_OP,
+       MATRIX_VECTOR_PRODUCT_OP, VECTOR_OUTER_PRODUCT_OP});
+  return *ops;
+}
+
+// With random ops, the functional cache probe runs on its own executor.
+const vector<Op>& RandomOps() {
+  static const vector<Op>* const ops = new vector<Op>(
+      {SCALAR_CONST_SET_OP, VECTOR_INNER_PRODUCT_OP, SCALAR_DIFF_OP,
+       SCALAR_PRODUCT_OP, VECTOR_GAUSSIAN_SET_OP, MATRIX_UNIFORM_SET_OP,
+       MATRIX_VECTOR_PRODUCT_OP});
+  return *ops;
+}
+
+TEST(EvaluatorAllocationTest, CountsAllocations) {
+  const int64_t num_allocations_before = num_allocations;
+  unique_ptr<vector<double>> allocated = make_unique<vector<double>>(10);
+  EXPECT_EQ(num_allocations - num_allocations_before, 2);
+}
+
+TEST(EvaluatorAllocationTest, DoesNotAllocateWithoutCache) {
+  EXPECT_EQ(CountSteadyStateAllocations<4>(DeterministicOps(), false), 0);
+  EXPECT_EQ(CountSteadyStateAllocations<16>(RandomOps(), false), 0);
+}
+
+TEST(EvaluatorAllocationTest, DoesNotAllocateWithCache) {
+  EXPECT_EQ(CountSteadyStateAllocations<4>(DeterministicOps(), true), 0);
+  EXPECT_EQ(CountSteadyStateAllocations<8>(DeterministicOps(), true), 0);
+}
+
+TEST(EvaluatorAllocationTest, DoesNotAllocateWithCacheAndRandomOps) {
+  EXPECT_EQ(CountSteadyStateAllocations<4>(RandomOps(), true), 0);
+  EXPECT_EQ(CountSteadyStateAllocations<16>(RandomOps(), true), 0);
+}
+
+}  // namespace automl_zero
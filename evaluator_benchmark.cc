@@ -0,0 +1,134 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Microbenchmarks of the evaluation of an algorithm on the search tasks, with
+// and without the functional equivalence cache (FEC).
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "evaluator.h"
+#include "experiment.pb.h"
+#include "fec_cache.h"
+#include "fec_cache.pb.h"
+#include "generator.h"
+#include "instruction.pb.h"
+#include "random_generator.h"
+#include "task.pb.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+
+namespace automl_zero {
+
+using ::absl::make_unique;  // NOLINT
+using ::absl::StrCat;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace {
+
+constexpr RandomSeedT kBenchmarkSeed = 100000;
+constexpr IntegerT kNumTasks = 10;
+constexpr IntegerT kNumAlgorithms = 256;
+constexpr double kLargeMaxAbsError = 1000000000.0;
+
+enum CacheMode {
+  kNoCache = 0,
+  // The same algorithm is evaluated every time, so almost every evaluation
+  // is a cache hit.
+  kCacheHits = 1,
+  // Different algorithms in a cache of size 2, so every evaluation is a
+  // cache miss and pays for both the FEC probe and the full evaluation.
+  kCacheMisses = 2
+};
+
+// The setting of run_linreg_nsga2.sh: 10 linear regression tasks with 100
+// train and 100 valid examples, probed with 10 + 10 examples by the FEC.
+template <FeatureIndexT F>
+void BM_EvaluateMulti(benchmark::State& state) {
+  const CacheMode cache_mode = static_cast<CacheMode>(state.range(0));
+  std::mt19937 bit_gen(kBenchmarkSeed);
+  RandomGenerator rand_gen(&bit_gen);
+  const vector<Op> ops = {SCALAR_CONST_SET_OP,      VECTOR_INNER_PRODUCT_OP,
+                          SCALAR_DIFF_OP,           SCALAR_PRODUCT_OP,
+                          SCALAR_VECTOR_PRODUCT_OP, VECTOR_SUM_OP};
+  Generator generator(RANDOM_ALGORITHM, 10, 2, 8, ops, ops, ops, &bit_gen,
+                      &rand_gen);
+  vector<Algorithm> algorithms(
+      cache_mode == kCacheHits ? 1 : kNumAlgorithms);
+  for (Algorithm& algorithm : algorithms) {
+    algorithm = generator.Random();
+    algorithm.SetEffectiveInstructions();
+  }
+
+  unique_ptr<FECCache> functional_cache;
+  if (cache_mode != kNoCache) {
+    FECSpec fec_spec;
+    fec_spec.set_num_train_examples(10);
+    fec_spec.set_num_valid_examples(10);
+    if (cache_mode == kCacheMisses) fec_spec.set_cache_size(2);
+    functional_cache = make_unique<FECCache>(fec_spec);
+  }
+  const auto task_collection = ParseTextFormat<TaskCollection>(StrCat(
+      "tasks { "
+      "  scalar_linear_regression_task {} "
+      "  features_size: ", F, " "
+      "  num_train_examples: 100 "
+      "  num_valid_examples: 100 "
+      "  num_tasks: ", kNumTasks, " "
+      "  eval_type: RMS_ERROR "
+      "} "));
+  Evaluator evaluator(MULTI_OBJECTIVE, task_collection, &rand_gen,
+                      functional_cache.get(),
+                      nullptr,  // train_budget
+                      kLargeMaxAbsError);
+
+  size_t next_algorithm = 0;
+  std::pair<vector<double>, vector<double>> fitness;
+  for (auto _ : state) {
+    evaluator.EvaluateMulti(algorithms[next_algorithm], &fitness);
+    benchmark::DoNotOptimize(fitness);
+    next_algorithm = (next_algorithm + 1) % algorithms.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["train_steps_per_second"] = benchmark::Counter(
+      evaluator.GetNumTrainStepsCompleted(), benchmark::Counter::kIsRate);
+  state.counters["cache_hit_rate"] =
+      evaluator.NumFunctionalCacheHits() /
+      std::max<double>(1.0, evaluator.NumFunctionalCacheHits() +
+                                evaluator.NumFunctionalCacheMisses());
+}
+
+void CacheModeArguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgName("cache");
+  for (const CacheMode mode : {kNoCache, kCacheHits, kCacheMisses}) {
+    benchmark->Arg(mode);
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_EvaluateMulti, 4)->Apply(CacheModeArguments);
+BENCHMARK_TEMPLATE(BM_EvaluateMulti, 16)->Apply(CacheModeArguments);
+
+}  // namespace
+
+}  // namespace automl_zero
+
+BENCHMARK_MAIN();
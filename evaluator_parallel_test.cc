@@ -0,0 +1,284 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "algorithm.h"
+#include "cpu_topology.h"
+#include "definitions.h"
+#include "evaluator.h"
+#include "experiment.pb.h"
+#include "fec_cache.h"
+#include "fec_cache.pb.h"
+#include "generator.h"
+#include "instruction.pb.h"
+#include "parallel.h"
+#include "random_generator.h"
+#include "task.pb.h"
+#include "task_store.h"
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+
+namespace automl_zero {
+
+using ::absl::make_unique;  // NOLINT
+using ::absl::StrCat;  // NOLINT
+using ::std::pair;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+constexpr IntegerT kNumTasks = 10;
+constexpr IntegerT kNumAlgorithms = 50;
+constexpr double kLargeMaxAbsError = 1000000000.0;
+
+struct EvaluationResults {
+  vector<pair<vector<double>, vector<double>>> fitnesses;
+  IntegerT num_train_steps;
+  IntegerT num_functional_cache_hits;
+  IntegerT num_functional_cache_misses;
+};
+
+// Evaluates the same random algorithms, with the tasks of each evaluated on
+// `thread_pool` if not nullptr. With a `batch_size`, evaluates them with
+// EvaluateMultiBatch, that many at a time.
+EvaluationResults Evaluate(const vector<Op>& ops,
+                           const bool use_functional_cache,
+                           ThreadPool* thread_pool,
+                           const IntegerT batch_size = 0,
+                           const IntegerT cache_size =
+                               kNumTasks * kNumAlgorithms * 2,
+                           const IntegerT forget_every = 100,
+                           TaskStore* task_store = nullptr) {
+  std::mt19937 bit_gen(100000);
+  RandomGenerator rand_gen(&bit_gen);
+  Generator generator(RANDOM_ALGORITHM, 10, 2, 8, ops, ops, ops, &bit_gen,
+                      &rand_gen);
+  unique_ptr<FECCache> functional_cache;
+  if (use_functional_cache) {
+    FECSpec fec_spec;
+    fec_spec.set_num_train_examples(10);
+    fec_spec.set_num_valid_examples(10);
+    // By default, large enough that nothing is evicted.
+    fec_spec.set_cache_size(cache_size);
+    fec_spec.set_forget_every(forget_every);
+    functional_cache = make_unique<FECCache>(fec_spec);
+  }
+  const auto task_collection = ParseTextFormat<TaskCollection>(StrCat(
+      "tasks { "
+      "  scalar_linear_regression_task {} "
+      "  features_size: 4 "
+      "  num_train_examples: 100 "
+      "  num_valid_examples: 100 "
+      "  num_tasks: ", kNumTasks, " "
+      "  eval_type: RMS_ERROR "
+      "} "));
+  Evaluator evaluator(MULTI_OBJECTIVE, task_collection, &rand_gen,
+                      functional_cache.get(),
+                      nullptr,  // train_budget
+                      kLargeMaxAbsError,
+                      nullptr,  // op_cost_model
+                      task_store,
+                      nullptr,  // watchdog
+                      thread_pool);
+  vector<std::shared_ptr<const Algorithm>> algorithms;
+  for (IntegerT i = 0; i < kNumAlgorithms; ++i) {
+    algorithms.push_back(std::make_shared<const Algorithm>(generator.Random()));
+    // Evaluated twice, for the functional cache hits.
+    algorithms.push_back(algorithms.back());
+  }
+  EvaluationResults results;
+  if (batch_size == 0) {
+    for (const std::shared_ptr<const Algorithm>& algorithm : algorithms) {
+      results.fitnesses.push_back(evaluator.EvaluateMulti(*algorithm));
+    }
+  } else {
+    for (IntegerT start = 0; start < algorithms.size(); start += batch_size) {
+      const vector<std::shared_ptr<const Algorithm>> batch(
+          algorithms.begin() + start,
+          algorithms.begin() +
+              std::min<IntegerT>(start + batch_size, algorithms.size()));
+      vector<pair<vector<double>, vector<double>>> fitnesses;
+      evaluator.EvaluateMultiBatch(batch, &fitnesses);
+      results.fitnesses.insert(results.fitnesses.end(), fitnesses.begin(),
+                               fitnesses.end());
+    }
+  }
+  results.num_train_steps = evaluator.GetNumTrainStepsCompleted();
+  results.num_functional_cache_hits = evaluator.NumFunctionalCacheHits();
+  results.num_functional_cache_misses = evaluator.NumFunctionalCacheMisses();
+  return results;
+}
+
+void ExpectSameResults(const EvaluationResults& expected,
+                       const EvaluationResults& actual) {
+  EXPECT_EQ(actual.fitnesses, expected.fitnesses);
+  EXPECT_EQ(actual.num_train_steps, expected.num_train_steps);
+  EXPECT_EQ(actual.num_functional_cache_hits,
+            expected.num_functional_cache_hits);
+  EXPECT_EQ(actual.num_functional_cache_misses,
+            expected.num_functional_cache_misses);
+}
+
+// Without random ops, the functional cache probe is resumed on a miss.
+const vector<Op>& DeterministicOps() {
+  static const vector<Op>* const ops = new vector<Op>(
+      {SCALAR_CONST_SET_OP, VECTOR_INNER_PRODUCT_OP, SCALAR_DIFF_OP,
+       SCALAR_PRODUCT_OP, SCALAR_VECTOR_PRODUCT_OP, VECTOR_SUM_OP});
+  return *ops;
+}
+
+const vector<Op>& RandomOps() {
+  static const vector<Op>* const ops = new vector<Op>(
+      {SCALAR_CONST_SET_OP, VECTOR_INNER_PRODUCT_OP, SCALAR_DIFF_OP,
+       SCALAR_PRODUCT_OP, VECTOR_GAUSSIAN_SET_OP, MATRIX_UNIFORM_SET_OP,
+       MATRIX_VECTOR_PRODUCT_OP, SCALAR_VECTOR_PRODUCT_OP, VECTOR_SUM_OP});
+  return *ops;
+}
+
+TEST(EvaluatorParallelTest, MatchesTheSerialEvaluation) {
+  const EvaluationResults serial = Evaluate(RandomOps(), false, nullptr);
+  ThreadPool thread_pool(4);
+  ExpectSameResults(serial, Evaluate(RandomOps(), false, &thread_pool));
+}
+
+TEST(EvaluatorParallelTest, MatchesTheSerialEvaluationWithCache) {
+  const EvaluationResults serial = Evaluate(RandomOps(), true, nullptr);
+  EXPECT_GT(serial.num_functional_cache_hits, 0);
+  ThreadPool thread_pool(4);
+  ExpectSameResults(serial, Evaluate(RandomOps(), true, &thread_pool));
+}
+
+TEST(EvaluatorParallelTest, MatchesTheSerialEvaluationWithSmallCache) {
+  ThreadPool thread_pool(4);
+  for (const vector<Op>* ops : {&RandomOps(), &DeterministicOps()}) {
+    // The lookups and insertions of the tasks are made in the task order, so
+    // the evictions and the forgotten hashes are the same too.
+    const EvaluationResults serial =
+        Evaluate(*ops, true, nullptr, 0, IntegerT{15}, 2);
+    EXPECT_GT(serial.num_functional_cache_hits, 0);
+    ExpectSameResults(serial, Evaluate(*ops, true, &thread_pool, 0,
+                                       IntegerT{15}, 2));
+  }
+}
+
+TEST(EvaluatorParallelTest, SharesThePoolBetweenEvaluators) {
+  const EvaluationResults serial = Evaluate(RandomOps(), true, nullptr);
+  ThreadPool thread_pool(4);
+  vector<EvaluationResults> results(3);
+  ParallelFor(results.size(), results.size(), [&](const IntegerT i) {
+    results[i] = Evaluate(RandomOps(), true, &thread_pool);
+  });
+  for (const EvaluationResults& result : results) {
+    ExpectSameResults(serial, result);
+  }
+}
+
+TEST(EvaluatorParallelTest, BatchMatchesTheSerialEvaluation) {
+  const EvaluationResults serial = Evaluate(RandomOps(), false, nullptr);
+  ThreadPool thread_pool(4);
+  for (const IntegerT batch_size :
+       {IntegerT{1}, IntegerT{7}, 2 * kNumAlgorithms}) {
+    ExpectSameResults(serial,
+                      Evaluate(RandomOps(), false, &thread_pool, batch_size));
+  }
+}
+
+TEST(EvaluatorParallelTest, BatchMatchesTheSerialEvaluationWithCache) {
+  ThreadPool thread_pool(4);
+  for (const vector<Op>* ops : {&RandomOps(), &DeterministicOps()}) {
+    // The batch makes the cache lookups and insertions in the serial order,
+    // so the evictions and the forgotten hashes are the same too.
+    for (const IntegerT cache_size :
+         {kNumTasks * kNumAlgorithms * 2, IntegerT{15}}) {
+      for (const IntegerT forget_every : {100, 2}) {
+        const EvaluationResults serial =
+            Evaluate(*ops, true, nullptr, 0, cache_size, forget_every);
+        EXPECT_GT(serial.num_functional_cache_hits, 0);
+        for (const IntegerT batch_size : {IntegerT{7}, 2 * kNumAlgorithms}) {
+          ExpectSameResults(serial, Evaluate(*ops, true, &thread_pool,
+                                             batch_size, cache_size,
+                                             forget_every));
+        }
+      }
+    }
+  }
+}
+
+TEST(EvaluatorParallelTest, PinnedThreadsMatchTheSerialEvaluation) {
+  const EvaluationResults serial = Evaluate(RandomOps(), true, nullptr);
+  // Two nodes that share a CPU that is surely available, so that the threads
+  // read the tasks from either copy.
+  const int cpu = CpuTopology::Detect().NodeCpus(0)[0];
+  const CpuTopology topology({{cpu}, {cpu}});
+  TaskStore task_store(1, nullptr, &topology);
+  ThreadPool thread_pool(4, &topology);
+  for (const IntegerT batch_size : {IntegerT{0}, IntegerT{7}}) {
+    ExpectSameResults(serial,
+                      Evaluate(RandomOps(), true, &thread_pool, batch_size,
+                               kNumTasks * kNumAlgorithms * 2, 100,
+                               &task_store));
+  }
+}
+
+TEST(EvaluatorParallelTest, EvaluatesTaskFitnessesIndependentlyOfThreads) {
+  std::mt19937 bit_gen(100000);
+  RandomGenerator rand_gen(&bit_gen);
+  Generator generator(RANDOM_ALGORITHM, 10, 2, 8, RandomOps(), RandomOps(),
+                      RandomOps(), &bit_gen, &rand_gen);
+  const auto task_collection = ParseTextFormat<TaskCollection>(
+      "tasks { "
+      "  scalar_linear_regression_task {} "
+      "  features_size: 4 "
+      "  num_train_examples: 100 "
+      "  num_valid_examples: 100 "
+      "  num_tasks: 3 "
+      "  eval_type: RMS_ERROR "
+      "} ");
+  Evaluator evaluator(MULTI_OBJECTIVE, task_collection, &rand_gen,
+                      nullptr,  // functional_cache
+                      nullptr,  // train_budget
+                      kLargeMaxAbsError);
+  ASSERT_EQ(evaluator.NumTasks(), 3);
+  vector<std::shared_ptr<const Algorithm>> algorithms;
+  for (IntegerT i = 0; i < 3; ++i) {
+    algorithms.push_back(std::make_shared<const Algorithm>(generator.Random()));
+  }
+
+  const vector<vector<double>> fitnesses =
+      EvaluateTaskFitnesses(evaluator, algorithms, 12345, 1);
+  ASSERT_EQ(fitnesses.size(), algorithms.size());
+  for (const vector<double>& algorithm_fitnesses : fitnesses) {
+    EXPECT_EQ(algorithm_fitnesses.size(), 3);
+  }
+  EXPECT_EQ(EvaluateTaskFitnesses(evaluator, algorithms, 12345, 4), fitnesses);
+  EXPECT_EQ(fitnesses[1][2],
+            evaluator.EvaluateOnTask(
+                *algorithms[1], 2, HashMix<RandomSeedT>({12345, 1, 2})));
+  // The counters of the evaluator are not updated.
+  EXPECT_EQ(evaluator.GetNumEvaluations(), 0);
+  EXPECT_EQ(evaluator.GetNumTrainStepsCompleted(), 0);
+}
+
+TEST(EvaluatorParallelTest, BatchWithoutAPoolEvaluatesInOrder) {
+  const EvaluationResults serial = Evaluate(RandomOps(), true, nullptr);
+  ExpectSameResults(serial, Evaluate(RandomOps(), true, nullptr, 7));
+}
+
+}  // namespace automl_zero
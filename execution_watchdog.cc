@@ -0,0 +1,56 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution_watchdog.h"
+
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+using ::std::chrono::duration_cast;  // NOLINT
+using ::std::chrono::steady_clock;  // NOLINT
+
+ExecutionWatchdog::ExecutionWatchdog(const IntegerT max_instructions,
+                                     const double max_secs)
+    : max_instructions_(max_instructions),
+      max_duration_(duration_cast<steady_clock::duration>(
+          std::chrono::duration<double>(max_secs))),
+      num_instructions_(0),
+      expired_(false) {
+  CHECK_GE(max_instructions, 0);
+  CHECK_GE(max_secs, 0.0);
+}
+
+void ExecutionWatchdog::Start() {
+  start_ = steady_clock::now();
+  num_instructions_ = 0;
+  expired_ = false;
+}
+
+bool ExecutionWatchdog::Check(const IntegerT num_instructions) {
+  const IntegerT total_instructions =
+      num_instructions_.fetch_add(num_instructions,
+                                  std::memory_order_relaxed) +
+      num_instructions;
+  if (Expired()) return true;
+  if ((max_instructions_ > 0 && total_instructions > max_instructions_) ||
+      (max_duration_.count() > 0 &&
+       steady_clock::now() - start_ > max_duration_)) {
+    expired_.store(true, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,64 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_EXECUTION_WATCHDOG_H_
+#define AUTOML_ZERO_EXECUTION_WATCHDOG_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT
+
+#include "definitions.h"
+
+namespace automl_zero {
+
+// The executors check the watchdog once every this many train or validation
+// steps, so that the checks cost next to nothing.
+constexpr IntegerT kWatchdogCheckPeriod = 32;
+
+// Bounds the instructions executed and the wall time of the evaluation of an
+// algorithm, across all its tasks. Unlike max_abs_error, this catches the
+// algorithms that are merely slow, e.g. with many matrix products at a large
+// feature size. Check is thread-safe, so the tasks of an evaluation can run
+// concurrently; the other methods are not.
+class ExecutionWatchdog {
+ public:
+  // A limit of 0 means no limit.
+  ExecutionWatchdog(IntegerT max_instructions, double max_secs);
+  ExecutionWatchdog(const ExecutionWatchdog& other) = delete;
+  ExecutionWatchdog& operator=(const ExecutionWatchdog& other) = delete;
+
+  // Starts timing a new evaluation.
+  void Start();
+
+  // Adds `num_instructions` executed instructions to those of the current
+  // evaluation, and returns whether the evaluation went over a limit. Once
+  // expired, stays so until the next Start.
+  bool Check(IntegerT num_instructions);
+
+  bool Expired() const { return expired_.load(std::memory_order_relaxed); }
+
+  // The instructions counted since Start.
+  IntegerT NumInstructions() const { return num_instructions_; }
+
+ private:
+  const IntegerT max_instructions_;
+  const std::chrono::steady_clock::duration max_duration_;
+  std::chrono::steady_clock::time_point start_;
+  std::atomic<IntegerT> num_instructions_;
+  std::atomic<bool> expired_;
+};
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_EXECUTION_WATCHDOG_H_
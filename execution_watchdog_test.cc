@@ -0,0 +1,61 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "execution_watchdog.h"
+
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "definitions.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+TEST(ExecutionWatchdogTest, ExpiresAfterTheMaxInstructions) {
+  ExecutionWatchdog watchdog(100, 0.0);
+  watchdog.Start();
+  EXPECT_FALSE(watchdog.Check(60));
+  EXPECT_FALSE(watchdog.Check(40));
+  EXPECT_FALSE(watchdog.Expired());
+  EXPECT_TRUE(watchdog.Check(1));
+  EXPECT_TRUE(watchdog.Expired());
+  EXPECT_EQ(watchdog.NumInstructions(), 101);
+
+  // Stays expired until the next evaluation starts.
+  EXPECT_TRUE(watchdog.Check(0));
+  watchdog.Start();
+  EXPECT_FALSE(watchdog.Expired());
+  EXPECT_EQ(watchdog.NumInstructions(), 0);
+  EXPECT_FALSE(watchdog.Check(100));
+}
+
+TEST(ExecutionWatchdogTest, ExpiresAfterTheMaxTime) {
+  ExecutionWatchdog watchdog(0, 0.01);
+  watchdog.Start();
+  EXPECT_FALSE(watchdog.Check(1000000000));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_TRUE(watchdog.Check(0));
+  watchdog.Start();
+  EXPECT_FALSE(watchdog.Check(0));
+}
+
+TEST(ExecutionWatchdogTest, ZeroMeansNoLimit) {
+  ExecutionWatchdog watchdog(0, 0.0);
+  watchdog.Start();
+  EXPECT_FALSE(watchdog.Check(1000000000000));
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_FALSE(watchdog.Check(0));
+}
+
+}  // namespace automl_zero
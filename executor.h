@@ -16,6 +16,7 @@
 #define AUTOML_ZERO_EXECUTOR_H_
 
 #include <algorithm>
+#include <bitset>
 #include <cmath>
 #include <complex>
 #include <iomanip>
@@ -32,9 +33,13 @@
 #include "definitions.h"
 #include "instruction.pb.h"
 #include "algorithm.h"
+#include "execution_watchdog.h"
+#include "huge_page_allocator.h"
 #include "instruction.h"
 #include "memory.h"
+#include "profiler.h"
 #include "random_generator.h"
+#include "streaming_task.h"
 #include "gtest/gtest_prod.h"
 
 namespace automl_zero {
@@ -58,9 +63,20 @@ namespace automl_zero {
                 // large. If early stopping is triggered, the fitness for the
                 // execution will be set to the minimum value.
                  double max_abs_error);
+        // Constructs an executor that must be Reset before it is used. Lets the
+        // memory be allocated once and reused across executions; see
+        // ScopedExecutor.
+        Executor();
         Executor(const Executor& other) = delete;
         Executor& operator=(const Executor& other) = delete;
 
+        // Makes this executor as if it had just been constructed with these
+        // arguments: wipes the memory and executes the setup component function.
+        // Only the matrices that the algorithm may use are wiped.
+        void Reset(const Algorithm& algorithm, const Task<F>& dataset,
+                   IntegerT num_all_train_examples, IntegerT num_valid_examples,
+                   RandomGenerator* rand_gen, double max_abs_error);
+
         // Most code should use only the Execute method. Other methods below provide
         // lower-level access and can be used by tests and dataset generators. Returns
         // the fitness, according to the EvalType enum for the relevant dataset.
@@ -71,6 +87,35 @@ namespace automl_zero {
         // Get the number of train steps this executor has performed.
         IntegerT GetNumTrainStepsCompleted() const;
 
+        // Reports the instructions executed to `watchdog`, which ends the
+        // execution with the minimum fitness once it expires. Must be called
+        // after each Reset, which clears it. Can be nullptr.
+        void SetWatchdog(ExecutionWatchdog* watchdog);
+
+        // Whether the watchdog ended the execution.
+        bool TimedOut() const {return timed_out_;}
+
+        // Trains on the first `num_train_steps` examples and validates on the
+        // first `num_valid_examples`, recording the errors, like an Execute with
+        // these many examples would. The memory is then restored to its state
+        // before the validation, so that Execute resumes the training where the
+        // probe left it, without repeating the setup and the first training
+        // steps. The resumed execution gives the same result as a direct one only
+        // if the algorithm draws no random numbers (see UsesRandomOps), since the
+        // validation advances the random generator. Must be called before
+        // anything else. Returns false if the training stopped early, in which
+        // case the execution must not be resumed.
+        bool Probe(IntegerT num_train_steps, IntegerT num_valid_examples,
+                   std::vector<double>* train_errors,
+                   std::vector<double>* valid_errors);
+
+        // Whether Probe can be called with these many train steps, on an executor
+        // constructed with `dataset` and `num_all_train_examples`: they must be
+        // fewer than the executor will perform, and fit in the first epoch.
+        static bool CanProbe(const Task<F>& dataset,
+                             IntegerT num_all_train_examples,
+                             IntegerT num_train_steps);
+
         // Use only from unit tests.
         inline Memory<F>& MemoryRef() {return memory_;}
 
@@ -108,26 +153,104 @@ namespace automl_zero {
                 // See `Train` for more details about the following args.
                           TaskIterator<F>* train_it);
 
+        // Counts the instructions of one more step and checks the watchdog, if
+        // any, once every kWatchdogCheckPeriod steps. Returns whether the
+        // execution must stop.
+        inline bool WatchdogExpired(IntegerT step,
+                                    IntegerT num_step_instructions) {
+            if (watchdog_ == nullptr) return false;
+            num_unchecked_instructions_ += num_step_instructions;
+            if (step % kWatchdogCheckPeriod != 0) return false;
+            if (watchdog_->Check(num_unchecked_instructions_)) {
+                ProfileEarlyStop<kProfileExecution>(kTimeoutStop);
+                timed_out_ = true;
+            }
+            num_unchecked_instructions_ = 0;
+            return timed_out_;
+        }
+
+        // Starts train_it_, unless it already is, for `num_steps` first steps.
+        void StartTraining(IntegerT num_steps);
+
         // Performs validation and returns the loss.
         double Validate(std::vector<double>* errors);
+        double Validate(IntegerT num_valid_examples, std::vector<double>* errors);
 
         // Copies memory_ into *memory. Useful for tests.
         void GetMemory(Memory<F>* memory);
 
         // The Algorithm being trained.
-        const Algorithm& algorithm_;
+        const Algorithm* algorithm_;
 
         // The dataset used for training.
-        const Task<F>& dataset_;
+        const Task<F>* dataset_;
 
-        const IntegerT num_all_train_examples_;
-        const IntegerT num_valid_examples_;
+        IntegerT num_all_train_examples_;
+        IntegerT num_valid_examples_;
         RandomGenerator* rand_gen_;
         Memory<F> memory_;
 
-        const double max_abs_error_;
+        double max_abs_error_;
         IntegerT num_train_steps_completed_;
 
+        ExecutionWatchdog* watchdog_;
+        // Executed since the last check of the watchdog.
+        IntegerT num_unchecked_instructions_;
+        bool timed_out_;
+
+        // Tracks the progress of training, across Probe and Execute. Started by
+        // the first training, which knows how many examples it needs first.
+        TaskIterator<F> train_it_;
+        bool train_it_started_;
+
+        // Read the examples of streaming tasks. Reused across the executions,
+        // along with their buffers and prefetching threads.
+        StreamingReader<F> train_reader_;
+        StreamingReader<F> valid_reader_;
+
+        // The matrices that the algorithm may use.
+        std::bitset<kMaxMatrixAddresses> used_matrix_addresses_;
+
+        // Where Probe saves the memory during the validation. Allocated on the
+        // first Probe, then reused.
+        HugePageUniquePtr<Memory<F>> saved_memory_;
+    };
+
+    // Hands out an idle executor of the calling thread, and gives it back when
+    // it goes out of scope. The executors are reused across executions, so that
+    // each thread allocates their memory once rather than for every execution.
+    // They are allocated with the HugePageAllocator, since their memory is
+    // accessed at random addresses. The executor must be Reset before each use.
+    template <FeatureIndexT F>
+    class ScopedExecutor {
+    public:
+        ScopedExecutor() {
+            std::vector<HugePageUniquePtr<Executor<F>>>& idle = IdleExecutors();
+            if (idle.empty()) {
+                executor_ = MakeHugePageUnique<Executor<F>>();
+            } else {
+                executor_ = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        ScopedExecutor(const ScopedExecutor& other) = delete;
+        ScopedExecutor& operator=(const ScopedExecutor& other) = delete;
+
+        ~ScopedExecutor() {
+            IdleExecutors().push_back(std::move(executor_));
+        }
+
+        Executor<F>& operator*() const {return *executor_;}
+        Executor<F>* operator->() const {return executor_.get();}
+
+    private:
+        static std::vector<HugePageUniquePtr<Executor<F>>>& IdleExecutors() {
+            static thread_local std::vector<HugePageUniquePtr<Executor<F>>>
+                    idle;
+            return idle;
+        }
+
+        HugePageUniquePtr<Executor<F>> executor_;
     };
 
     // Fills the training and validation labels, using the given Algorithm and
@@ -561,7 +684,10 @@ namespace automl_zero {
     inline void ExecuteVectorOuterProductOp(
             const Instruction& instruction, RandomGenerator* rand_gen,
             Memory<F>* memory) {
-        memory->matrix_[instruction.out_] =
+        // The output cannot alias the (vector) inputs. This also avoids a F x F
+        // temporary, which would be too large for the stack above
+        // kMaxFixedSizeMatrixFeatures.
+        memory->matrix_[instruction.out_].noalias() =
                 memory->vector_[instruction.in1_] *
                 memory->vector_[instruction.in2_].transpose();
     }
@@ -630,8 +756,17 @@ namespace automl_zero {
     inline void ExecuteMatrixMatrixProductOp(
             const Instruction& instruction, RandomGenerator* rand_gen,
             Memory<F>* memory) {
-        memory->matrix_[instruction.out_] =
-                memory->matrix_[instruction.in1_] * memory->matrix_[instruction.in2_];
+        if (F > kMaxFixedSizeMatrixFeatures) {
+            // Eigen's cache-blocked product into a preallocated buffer, which
+            // then takes the place of the output. Safe if the output aliases an
+            // input and does not allocate.
+            memory->product_buffer_.noalias() =
+                    memory->matrix_[instruction.in1_] * memory->matrix_[instruction.in2_];
+            memory->matrix_[instruction.out_].swap(memory->product_buffer_);
+        } else {
+            memory->matrix_[instruction.out_] =
+                    memory->matrix_[instruction.in1_] * memory->matrix_[instruction.in2_];
+        }
     }
 
     template<FeatureIndexT F>
@@ -937,6 +1072,7 @@ namespace automl_zero {
     inline void ExecuteInstruction(
             const Instruction& instruction, RandomGenerator* rand_gen,
             Memory<F>* memory) {
+        OpProfileScope<kProfileExecution> profile_scope(instruction.op_);
         (*kOpIndexToExecuteFunction<F>[instruction.op_])(
                 instruction, rand_gen, memory);
     }
@@ -977,6 +1113,62 @@ namespace automl_zero {
         }
     };
 
+    // The addresses of the matrices that an algorithm may use. Conservatively
+    // includes every operand address of every instruction, whatever its type.
+    inline std::bitset<kMaxMatrixAddresses> UsedMatrixAddresses(
+            const Algorithm& algorithm) {
+        std::bitset<kMaxMatrixAddresses> addresses;
+        for (const std::vector<std::shared_ptr<const Instruction>>* component :
+                {&algorithm.setup_, &algorithm.predict_, &algorithm.learn_}) {
+            for (const std::shared_ptr<const Instruction>& instruction : *component) {
+                for (const AddressT address :
+                        {instruction->in1_, instruction->in2_, instruction->out_}) {
+                    if (address < kMaxMatrixAddresses) {
+                        addresses.set(address);
+                    }
+                }
+            }
+        }
+        return addresses;
+    }
+
+    // Whether an algorithm may draw from the random generator, i.e. whether its
+    // execution depends on the state of the generator.
+    inline bool UsesRandomOps(const Algorithm& algorithm) {
+        for (const std::vector<std::shared_ptr<const Instruction>>* component :
+                {&algorithm.setup_, &algorithm.predict_, &algorithm.learn_}) {
+            for (const std::shared_ptr<const Instruction>& instruction : *component) {
+                switch (instruction->op_) {
+                    case SCALAR_GAUSSIAN_SET_OP:
+                    case VECTOR_GAUSSIAN_SET_OP:
+                    case MATRIX_GAUSSIAN_SET_OP:
+                    case SCALAR_UNIFORM_SET_OP:
+                    case VECTOR_UNIFORM_SET_OP:
+                    case MATRIX_UNIFORM_SET_OP:
+                        return true;
+                    default:
+                        break;
+                }
+            }
+        }
+        return false;
+    }
+
+    template <FeatureIndexT F>
+    Executor<F>::Executor()
+            : algorithm_(nullptr),
+              dataset_(nullptr),
+              num_all_train_examples_(0),
+              num_valid_examples_(0),
+              rand_gen_(nullptr),
+              max_abs_error_(0.0),
+              num_train_steps_completed_(0),
+              watchdog_(nullptr),
+              num_unchecked_instructions_(0),
+              timed_out_(false),
+              train_it_(nullptr, nullptr, nullptr),
+              train_it_started_(false) {}
+
     template <FeatureIndexT F>
     Executor<F>::Executor(const Algorithm& algorithm,
                           const Task<F>& dataset,
@@ -984,23 +1176,43 @@ namespace automl_zero {
                           const IntegerT num_valid_examples,
                           RandomGenerator* rand_gen,
                           const double max_abs_error)
-            : algorithm_(algorithm),
-              dataset_(dataset),
-              num_all_train_examples_(num_all_train_examples),
-              num_valid_examples_(num_valid_examples),
-              rand_gen_(rand_gen),
-              max_abs_error_(max_abs_error),
-              num_train_steps_completed_(0){
-        memory_.Wipe();
+            : Executor() {
+        Reset(algorithm, dataset, num_all_train_examples, num_valid_examples,
+              rand_gen, max_abs_error);
+    }
+
+    template <FeatureIndexT F>
+    void Executor<F>::Reset(const Algorithm& algorithm,
+                            const Task<F>& dataset,
+                            const IntegerT num_all_train_examples,
+                            const IntegerT num_valid_examples,
+                            RandomGenerator* rand_gen,
+                            const double max_abs_error) {
+        PhaseProfileScope<kProfileExecution> profile_scope(kSetupProfilePhase);
+        algorithm_ = &algorithm;
+        dataset_ = &dataset;
+        num_all_train_examples_ = num_all_train_examples;
+        num_valid_examples_ = num_valid_examples;
+        rand_gen_ = rand_gen;
+        max_abs_error_ = max_abs_error;
+        num_train_steps_completed_ = 0;
+        watchdog_ = nullptr;
+        num_unchecked_instructions_ = 0;
+        timed_out_ = false;
+        train_it_started_ = false;
+        // The other matrices are never read, so they can keep the values left
+        // by previous executions.
+        used_matrix_addresses_ = UsedMatrixAddresses(algorithm);
+        memory_.Wipe(used_matrix_addresses_);
         if (SKIP_INTRONS) {
             for (const std::shared_ptr<const Instruction>& instruction :
-                    algorithm_.setupEffective_) {
+                    algorithm_->setupEffective_) {
                 ExecuteInstruction(*instruction, rand_gen_, &memory_);
             }
         }
         else {
             for (const std::shared_ptr<const Instruction>& instruction :
-                    algorithm_.setup_) {
+                    algorithm_->setup_) {
                 ExecuteInstruction(*instruction, rand_gen_, &memory_);
             }
         }
@@ -1011,45 +1223,52 @@ namespace automl_zero {
     template <FeatureIndexT F>
     double Executor<F>::Execute(std::vector<double>* train_errors,
                                 std::vector<double>* valid_errors) {
-        CHECK_GE(dataset_.NumTrainEpochs(), 1);
+        CHECK_GE(dataset_->NumTrainEpochs(), 1);
 //       std::cout << "Memory before execution: " << std::endl;
 //       memory_.Display();
 
-        // Iterators that track the progresss of training.
-        TaskIterator<F> train_it = dataset_.TrainIterator();
-
-
         // Train for multiple epochs, evaluate on validation set
         // after each epoch and take the best validation result as fitness.
         const IntegerT num_all_train_examples =
                 std::min(num_all_train_examples_,
-                         static_cast<IntegerT>(dataset_.MaxTrainExamples()));
+                         static_cast<IntegerT>(dataset_->MaxTrainExamples()));
         const IntegerT num_examples_per_epoch =
-                dataset_.TrainExamplesPerEpoch() == kNumTrainExamplesNotSet ?
-                num_all_train_examples : dataset_.TrainExamplesPerEpoch();
-        IntegerT num_remaining = num_all_train_examples;
+                dataset_->TrainExamplesPerEpoch() == kNumTrainExamplesNotSet ?
+                num_all_train_examples : dataset_->TrainExamplesPerEpoch();
+        // After a Probe, part of the first epoch is already done.
+        IntegerT num_remaining =
+                num_all_train_examples - num_train_steps_completed_;
+        IntegerT num_remaining_in_epoch =
+                num_examples_per_epoch - num_train_steps_completed_;
+        bool validated = false;
         double best_fitness = kMinFitness;
         double current_fitness = kMinFitness;
 
 //       std::cout << "Memory before train: " << std::endl;
 //       memory_.Display();
         while (num_remaining > 0) {
+            StartTraining(std::min(num_remaining_in_epoch, num_remaining));
             if (!Train( //SK
-                    std::min(num_examples_per_epoch, num_remaining),
-                    train_errors, &train_it)) {
+                    std::min(num_remaining_in_epoch, num_remaining),
+                    train_errors, &train_it_)) {
 //                std::cout << "Memory after train: " << std::endl;
 //                memory_.Display();
 //                std::cout << "algorithm inside execute: ";
 //                std::cout << algorithm_.ToReadable() << std::endl;
-                if (num_remaining == num_all_train_examples) {
+                if (!validated || timed_out_) {
                     return kMinFitness;
                 } else {
                     break;
                 }
 
             }
-            num_remaining -= num_examples_per_epoch;
+            num_remaining -= num_remaining_in_epoch;
+            num_remaining_in_epoch = num_examples_per_epoch;
             current_fitness = Validate(valid_errors);
+            if (timed_out_) {
+                return kMinFitness;
+            }
+            validated = true;
 
             best_fitness = std::max(current_fitness, best_fitness);
             // Only save the errors of the first epoch.
@@ -1067,16 +1286,65 @@ namespace automl_zero {
         return num_train_steps_completed_;
     }
 
+    template <FeatureIndexT F>
+    void Executor<F>::SetWatchdog(ExecutionWatchdog* watchdog) {
+        watchdog_ = watchdog;
+    }
+
+    template <FeatureIndexT F>
+    bool Executor<F>::CanProbe(const Task<F>& dataset,
+                               const IntegerT num_all_train_examples,
+                               const IntegerT num_train_steps) {
+        return num_train_steps <
+               std::min(num_all_train_examples,
+                        static_cast<IntegerT>(dataset.MaxTrainExamples())) &&
+               (dataset.TrainExamplesPerEpoch() == kNumTrainExamplesNotSet ||
+                num_train_steps <= dataset.TrainExamplesPerEpoch());
+    }
+
+    template <FeatureIndexT F>
+    bool Executor<F>::Probe(const IntegerT num_train_steps,
+                            const IntegerT num_valid_examples,
+                            std::vector<double>* train_errors,
+                            std::vector<double>* valid_errors) {
+        CHECK_EQ(num_train_steps_completed_, 0);
+        CHECK(CanProbe(*dataset_, num_all_train_examples_, num_train_steps));
+        StartTraining(num_train_steps);
+        if (!Train(num_train_steps, train_errors, &train_it_)) {
+            return false;
+        }
+
+        // The validation runs the predict component function, which may write
+        // to the memory.
+        if (saved_memory_ == nullptr) {
+            saved_memory_ = MakeHugePageUnique<Memory<F>>();
+        }
+        saved_memory_->CopyFrom(memory_, used_matrix_addresses_);
+        Validate(num_valid_examples, valid_errors);
+        memory_.CopyFrom(*saved_memory_, used_matrix_addresses_);
+        return !timed_out_;
+    }
+
+    template <FeatureIndexT F>
+    void Executor<F>::StartTraining(const IntegerT num_steps) {
+        if (train_it_started_) return;
+        train_it_ = dataset_->TrainIterator(&train_reader_,
+                                            std::max<IntegerT>(num_steps, 1));
+        train_it_started_ = true;
+    }
+
     template <FeatureIndexT F>
     bool Executor<F>::Train(std::vector<double>* errors) {
+        // Reads the examples directly, so it cannot be used with streaming.
+        CHECK(!dataset_->IsStreaming());
         // Iterators that tracks the progresss of training.
-        typename std::vector<Vector<F>>::const_iterator train_feature_it =
-                dataset_.train_features_.begin();
-        typename std::vector<Scalar>::const_iterator train_label_it =
-                dataset_.train_labels_.begin();
+        typename HugePageVector<Vector<F>>::const_iterator train_feature_it =
+                dataset_->train_features_.begin();
+        typename HugePageVector<Scalar>::const_iterator train_label_it =
+                dataset_->train_labels_.begin();
         const IntegerT num_all_train_examples =
                 std::min(num_all_train_examples_,
-                         static_cast<IntegerT>(dataset_.train_features_.size()));
+                         static_cast<IntegerT>(dataset_->train_features_.size()));
         return Train(num_all_train_examples, errors, &train_feature_it,
                      &train_label_it);
     }
@@ -1090,17 +1358,18 @@ namespace automl_zero {
         CHECK(errors == nullptr || max_steps <= 100) <<
                                                      "You should only record the training errors for few training steps."
                                                      << std::endl;
+            PhaseProfileScope<kProfileExecution> profile_scope(kTrainProfilePhase);
 
             if (max_steps < kTrainStepsOptThreshold) {
                 return TrainNoOptImpl(max_steps, errors, train_it);
             } else {
-                if (algorithm_.predict_.size() <= 10 && algorithm_.learn_.size() <= 10) {
+                if (algorithm_->predict_.size() <= 10 && algorithm_->learn_.size() <= 10) {
                     return TrainOptImpl<10>(max_steps, errors, train_it);
-                } else if (algorithm_.predict_.size() <= 100 &&
-                           algorithm_.learn_.size() <= 100) {
+                } else if (algorithm_->predict_.size() <= 100 &&
+                           algorithm_->learn_.size() <= 100) {
                     return TrainOptImpl<100>(max_steps, errors, train_it);
-                } else if (algorithm_.predict_.size() <= 1000 &&
-                           algorithm_.learn_.size() <= 1000) {
+                } else if (algorithm_->predict_.size() <= 1000 &&
+                           algorithm_->learn_.size() <= 1000) {
                     return TrainOptImpl<1000>(max_steps, errors, train_it);
                 } else {
                     LOG(FATAL) << "ComponentFunction size not yet supported." << std::endl;
@@ -1118,8 +1387,16 @@ namespace automl_zero {
         if (errors != nullptr) {
             errors->reserve(max_steps);
         }
+        const IntegerT num_step_instructions = SKIP_INTRONS ?
+                algorithm_->predictEffective_.size() +
+                algorithm_->learnEffective_.size() :
+                algorithm_->predict_.size() + algorithm_->learn_.size();
         for (IntegerT step = 0; step < max_steps; ++step) {
             num_train_steps_completed_++;
+            if (WatchdogExpired(num_train_steps_completed_,
+                                num_step_instructions)) {
+                return false;
+            }
             // Run predict component function for this example.
             const Vector<F>& features = train_it->GetFeatures();
             memory_.vector_[kFeaturesVectorAddress] = features;
@@ -1132,18 +1409,18 @@ namespace automl_zero {
             ZeroLabelAssigner<F>::Assign(&memory_);
             if (SKIP_INTRONS) {
                 for (const std::shared_ptr<const Instruction>& instruction :
-                        algorithm_.predictEffective_) {
+                        algorithm_->predictEffective_) {
                     ExecuteInstruction(*instruction, rand_gen_, &memory_);
                 }
             }
             else {
                 for (const std::shared_ptr<const Instruction>& instruction :
-                        algorithm_.predict_) {
+                        algorithm_->predict_) {
                     ExecuteInstruction(*instruction, rand_gen_, &memory_);
                 }
             }
 
-            if (dataset_.eval_type_ == ACCURACY) {
+            if (dataset_->eval_type_ == ACCURACY) {
                 ProbabilityConverter<F>::Convert(&memory_);
             }
 
@@ -1153,6 +1430,8 @@ namespace automl_zero {
 //            std::cout << memory_.scalar_[kPredictionsScalarAddress] << std::endl;
             const double abs_error = ErrorComputer<F>::Compute(memory_, label);
             if (isnan(abs_error) || abs_error > max_abs_error_) {
+                ProfileEarlyStop<kProfileExecution>(
+                        isnan(abs_error) ? kTrainNanErrorStop : kTrainLargeErrorStop);
                 return false;
             }
             if (errors != nullptr) {
@@ -1164,13 +1443,13 @@ namespace automl_zero {
             LabelAssigner<F>::Assign(label, &memory_);
             if (SKIP_INTRONS) {
                 for (const std::shared_ptr<const Instruction>& instruction :
-                        algorithm_.learnEffective_) {
+                        algorithm_->learnEffective_) {
                     ExecuteInstruction(*instruction, rand_gen_, &memory_);
                 }
             }
             else {
                 for (const std::shared_ptr<const Instruction>& instruction :
-                        algorithm_.learn_) {
+                        algorithm_->learn_) {
                     ExecuteInstruction(*instruction, rand_gen_, &memory_);
                 }
             }
@@ -1201,20 +1480,20 @@ namespace automl_zero {
                 optimized_predict_instr_it = optimized_predict_component_function.begin();
         if (SKIP_INTRONS) {
             for (const std::shared_ptr<const Instruction>& predict_instr :
-                    algorithm_.predictEffective_) {
+                    algorithm_->predictEffective_) {
                 *optimized_predict_instr_it = *predict_instr;
                 ++optimized_predict_instr_it;
             }
         }
         else {
             for (const std::shared_ptr<const Instruction>& predict_instr :
-                    algorithm_.predict_) {
+                    algorithm_->predict_) {
                 *optimized_predict_instr_it = *predict_instr;
                 ++optimized_predict_instr_it;
             }
         }
 
-        const IntegerT num_predict_instr = algorithm_.predict_.size();
+        const IntegerT num_predict_instr = algorithm_->predict_.size();
 
         std::array<Instruction, max_component_function_size>
                 optimized_learn_component_function;
@@ -1222,22 +1501,26 @@ namespace automl_zero {
                 optimized_learn_instr_it = optimized_learn_component_function.begin();
         if (SKIP_INTRONS) {
             for (const std::shared_ptr<const Instruction>& learn_instr :
-                    algorithm_.learnEffective_) {
+                    algorithm_->learnEffective_) {
                 *optimized_learn_instr_it = *learn_instr;
                 ++optimized_learn_instr_it;
             }
         }
         else {
             for (const std::shared_ptr<const Instruction>& learn_instr :
-                    algorithm_.learn_) {
+                    algorithm_->learn_) {
                 *optimized_learn_instr_it = *learn_instr;
                 ++optimized_learn_instr_it;
             }
         }
-        const IntegerT num_learn_instr = algorithm_.learn_.size();
+        const IntegerT num_learn_instr = algorithm_->learn_.size();
 
         for (IntegerT step = 0; step < max_steps; ++step) {
             num_train_steps_completed_++;
+            if (WatchdogExpired(num_train_steps_completed_,
+                                num_predict_instr + num_learn_instr)) {
+                return false;
+            }
             // Run predict component function for this example.
             const Vector<F>& features = train_it->GetFeatures();
             memory_.vector_[kFeaturesVectorAddress] = features;
@@ -1252,7 +1535,7 @@ namespace automl_zero {
                 ++predict_instr_num;
             }
 
-            if (dataset_.eval_type_ == ACCURACY) {
+            if (dataset_->eval_type_ == ACCURACY) {
                 ProbabilityConverter<F>::Convert(&memory_);
             }
 
@@ -1260,6 +1543,8 @@ namespace automl_zero {
             const Scalar& label = train_it->GetLabel();
             const double abs_error = ErrorComputer<F>::Compute(memory_, label);
             if (isnan(abs_error) || abs_error > max_abs_error_) {
+                ProfileEarlyStop<kProfileExecution>(
+                        isnan(abs_error) ? kTrainNanErrorStop : kTrainLargeErrorStop);
                 return false;
             }
             if (errors != nullptr) {
@@ -1320,29 +1605,43 @@ namespace automl_zero {
 
     template <FeatureIndexT F>
     double Executor<F>::Validate(std::vector<double>* errors) {
+        return Validate(num_valid_examples_, errors);
+    }
+
+    template <FeatureIndexT F>
+    double Executor<F>::Validate(const IntegerT num_valid_examples,
+                                 std::vector<double>* errors) {
 //       std::cout << "Memory before validation: " << std::endl;
 //       memory_.Display();
+        PhaseProfileScope<kProfileExecution> profile_scope(kValidateProfilePhase);
         double loss = 0.0;
         if (errors != nullptr) {
-            errors->reserve(dataset_.ValidSteps());
+            errors->reserve(dataset_->ValidSteps());
         }
         const IntegerT num_steps =
-                std::min(num_valid_examples_,
-                         static_cast<IntegerT>(dataset_.ValidSteps()));
+                std::min(num_valid_examples,
+                         static_cast<IntegerT>(dataset_->ValidSteps()));
 
         CHECK(errors == nullptr || num_steps <= 100) <<
                                                      "You should only record the validation errors for few validation steps."
                                                      << std::endl;
 
-        TaskIterator<F> valid_it = dataset_.ValidIterator();
+        const IntegerT num_step_instructions = SKIP_INTRONS ?
+                algorithm_->predictEffective_.size() :
+                algorithm_->predict_.size();
+        TaskIterator<F> valid_it = dataset_->ValidIterator(
+                &valid_reader_, std::max<IntegerT>(num_steps, 1));
         for (IntegerT step = 0; step < num_steps; ++step) {
+            if (WatchdogExpired(step + 1, num_step_instructions)) {
+                return kMinFitness;
+            }
             // Run predict component function for this example.
             const Vector<F>& features = valid_it.GetFeatures();
             memory_.vector_[kFeaturesVectorAddress] = features;
             ZeroLabelAssigner<F>::Assign(&memory_);
             if (SKIP_INTRONS) {
                 for (const std::shared_ptr<const Instruction>& instruction :
-                        algorithm_.predictEffective_) {
+                        algorithm_->predictEffective_) {
                     ExecuteInstruction(*instruction, rand_gen_, &memory_);
                 }
             }
@@ -1354,7 +1653,7 @@ namespace automl_zero {
 //                std::cout << "Memory before instructions: " << std::endl;
 //                memory_.Display();
                 for (const std::shared_ptr<const Instruction>& instruction :
-                        algorithm_.predict_) {
+                        algorithm_->predict_) {
                     ExecuteInstruction(*instruction, rand_gen_, &memory_);
                 }
 //                std::cout << "Memory after instructions: " << std::endl;
@@ -1365,7 +1664,7 @@ namespace automl_zero {
             // Accumulate the loss.
             double error = 0.0;
             const Scalar& label = valid_it.GetLabel();
-            switch (dataset_.eval_type_) {
+            switch (dataset_->eval_type_) {
                 case RMS_ERROR: {
                     SquashedRmseLossAccumulator<F>::Accumulate(memory_, label, &error,
                                                                &loss);
@@ -1384,6 +1683,8 @@ namespace automl_zero {
             const double abs_error = std::abs(error);
             if (isnan(abs_error) || abs_error > max_abs_error_) {
                 // Stop early. Return infinite loss.
+                ProfileEarlyStop<kProfileExecution>(
+                        isnan(abs_error) ? kValidNanErrorStop : kValidLargeErrorStop);
                 return kMinFitness;
             }
             if (errors != nullptr) {
@@ -1397,15 +1698,15 @@ namespace automl_zero {
         }
         // Convert to fitness.
         double fitness;
-        switch (dataset_.eval_type_) {
+        switch (dataset_->eval_type_) {
             case INVALID_EVAL_TYPE:
                 LOG(FATAL) << "Invalid eval type." << std::endl;
             case RMS_ERROR:
-                loss /= static_cast<double>(dataset_.ValidSteps());
+                loss /= static_cast<double>(dataset_->ValidSteps());
                 fitness = FlipAndSquash(sqrt(loss));
                 break;
             case ACCURACY:
-                loss /= static_cast<double>(dataset_.ValidSteps());
+                loss /= static_cast<double>(dataset_->ValidSteps());
                 fitness = 1.0 - loss;
                 break;
         }
@@ -1425,7 +1726,7 @@ namespace automl_zero {
                               TaskBuffer<F>* buffer,
                               RandomGenerator* rand_gen) {
         // Fill training labels.
-        typename std::vector<Scalar>::iterator train_label_it =
+        typename HugePageVector<Scalar>::iterator train_label_it =
                 buffer->train_labels_.begin();
         for (const Vector<F>& train_features : buffer->train_features_) {
             // Run predict component function for this example.
@@ -1440,7 +1741,7 @@ namespace automl_zero {
         }
 
         // Fill validation labels.
-        std::vector<Scalar>::iterator valid_label_it =
+        HugePageVector<Scalar>::iterator valid_label_it =
                 buffer->valid_labels_.begin();
         for (const Vector<F>& valid_features : buffer->valid_features_) {
             // Run predict component function for this example.
@@ -0,0 +1,203 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Microbenchmarks of the op kernels, for every features size, and of the
+// execution of whole programs. See "Benchmarks" in README.md.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "executor.h"
+#include "generator.h"
+#include "instruction.h"
+#include "instruction.pb.h"
+#include "memory.h"
+#include "random_generator.h"
+#include "task.h"
+#include "task_util.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+
+namespace automl_zero {
+
+using ::absl::StrCat;  // NOLINT
+using ::std::vector;  // NOLINT
+using test_only::GenerateTask;
+
+namespace {
+
+// Number of instructions executed per benchmark iteration, so that the
+// overhead of the benchmark loop is negligible even for scalar ops.
+constexpr IntegerT kOpBatchSize = 256;
+constexpr RandomSeedT kBenchmarkSeed = 100000;
+constexpr IntegerT kNumTrainExamples = 1000;
+constexpr IntegerT kNumValidExamples = 100;
+constexpr double kLargeMaxAbsError = 1000000000.0;
+
+// Random values in a range that is valid for every op (e.g. log, arcsin).
+template <FeatureIndexT F>
+void RandomizeMemory(RandomGenerator* rand_gen, Memory<F>* memory) {
+  for (Scalar& value : memory->scalar_) {
+    value = rand_gen->UniformDouble(0.1, 0.9);
+  }
+  for (Vector<F>& value : memory->vector_) {
+    for (FeatureIndexT i = 0; i < F; ++i) {
+      value(i) = rand_gen->UniformDouble(0.1, 0.9);
+    }
+  }
+  for (Matrix<F>& value : memory->matrix_) {
+    for (FeatureIndexT i = 0; i < F; ++i) {
+      for (FeatureIndexT j = 0; j < F; ++j) {
+        value(i, j) = rand_gen->UniformDouble(0.1, 0.9);
+      }
+    }
+  }
+}
+
+// Executes a batch of random instructions with the given op. The memory is
+// randomized again before every batch, outside of the timed region, so that
+// repeated ops do not drift into infinities or denormals.
+template <FeatureIndexT F>
+void BM_ExecuteOp(benchmark::State& state, const Op op) {
+  std::mt19937 bit_gen(kBenchmarkSeed);
+  RandomGenerator rand_gen(&bit_gen);
+  vector<Instruction> instructions;
+  instructions.reserve(kOpBatchSize);
+  for (IntegerT i = 0; i < kOpBatchSize; ++i) {
+    instructions.emplace_back(op, &rand_gen);
+  }
+  Memory<F> memory;
+  for (auto _ : state) {
+    state.PauseTiming();
+    RandomizeMemory<F>(&rand_gen, &memory);
+    state.ResumeTiming();
+    for (const Instruction& instruction : instructions) {
+      ExecuteInstruction<F>(instruction, &rand_gen, &memory);
+    }
+    benchmark::DoNotOptimize(memory.scalar_[0]);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * kOpBatchSize);
+}
+
+template <FeatureIndexT F>
+void RegisterOpBenchmarks() {
+  for (int op = 0; op < Op_ARRAYSIZE; ++op) {
+    if (!Op_IsValid(op)) continue;
+    benchmark::RegisterBenchmark(
+        StrCat("BM_ExecuteOp<", F, ">/", Op_Name(static_cast<Op>(op)))
+            .c_str(),
+        BM_ExecuteOp<F>, static_cast<Op>(op));
+  }
+}
+
+// The programs whose execution is benchmarked.
+enum BenchmarkProgram {
+  kLinearModelProgram = 0,
+  kNeuralNetProgram = 1,
+  // Random instructions of the ops used by the linear regression searches.
+  kRandomProgram = 2
+};
+
+Algorithm MakeProgram(const BenchmarkProgram program, std::mt19937* bit_gen,
+                      RandomGenerator* rand_gen) {
+  const vector<Op> ops = {SCALAR_CONST_SET_OP,      VECTOR_INNER_PRODUCT_OP,
+                          SCALAR_DIFF_OP,           SCALAR_PRODUCT_OP,
+                          SCALAR_VECTOR_PRODUCT_OP, VECTOR_SUM_OP};
+  Generator generator(NO_OP_ALGORITHM, 10, 2, 8, ops, ops, ops, bit_gen,
+                      rand_gen);
+  Algorithm algorithm;
+  switch (program) {
+    case kLinearModelProgram:
+      algorithm = generator.LinearModel(0.01);
+      break;
+    case kNeuralNetProgram:
+      algorithm = generator.NeuralNet(0.01, 0.1, 0.1);
+      break;
+    case kRandomProgram:
+      algorithm = generator.Random();
+      break;
+  }
+  // The hand-written programs are padded with no-ops, which the ineffective
+  // code removal does not support.
+  algorithm.CopyAllComponentsToEffective();
+  return algorithm;
+}
+
+// Trains and validates a program on a linear regression task. Includes the
+// construction of the Executor (i.e. the setup), as in the Evaluator.
+template <FeatureIndexT F>
+void BM_ExecutorExecute(benchmark::State& state) {
+  const BenchmarkProgram program =
+      static_cast<BenchmarkProgram>(state.range(0));
+  std::mt19937 bit_gen(kBenchmarkSeed);
+  RandomGenerator rand_gen(&bit_gen);
+  const Algorithm algorithm = MakeProgram(program, &bit_gen, &rand_gen);
+  const Task<F> task = GenerateTask<F>(StrCat(
+      "scalar_linear_regression_task {} "
+      "eval_type: RMS_ERROR "
+      "num_train_examples: ", kNumTrainExamples, " "
+      "num_valid_examples: ", kNumValidExamples, " "
+      "param_seeds: 1000 "
+      "data_seeds: 2000 "));
+  IntegerT train_steps = 0;
+  // Reused, like the evaluator does.
+  Executor<F> executor;
+  for (auto _ : state) {
+    executor.Reset(algorithm, task, kNumTrainExamples, kNumValidExamples,
+                   &rand_gen, kLargeMaxAbsError);
+    benchmark::DoNotOptimize(executor.Execute());
+    train_steps += executor.GetNumTrainStepsCompleted();
+  }
+  state.counters["train_steps_per_second"] =
+      benchmark::Counter(train_steps, benchmark::Counter::kIsRate);
+}
+
+void ProgramArguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgName("program");
+  for (const BenchmarkProgram program :
+       {kLinearModelProgram, kNeuralNetProgram, kRandomProgram}) {
+    benchmark->Arg(program);
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_ExecutorExecute, 4)->Apply(ProgramArguments);
+BENCHMARK_TEMPLATE(BM_ExecutorExecute, 16)->Apply(ProgramArguments);
+BENCHMARK_TEMPLATE(BM_ExecutorExecute, 64)->Apply(ProgramArguments);
+
+}  // namespace
+
+}  // namespace automl_zero
+
+int main(int argc, char** argv) {
+  // The op benchmarks are registered at run time, for every valid op.
+  automl_zero::RegisterOpBenchmarks<2>();
+  automl_zero::RegisterOpBenchmarks<4>();
+  automl_zero::RegisterOpBenchmarks<8>();
+  automl_zero::RegisterOpBenchmarks<16>();
+  automl_zero::RegisterOpBenchmarks<32>();
+  automl_zero::RegisterOpBenchmarks<64>();
+  automl_zero::RegisterOpBenchmarks<128>();
+  automl_zero::RegisterOpBenchmarks<256>();
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
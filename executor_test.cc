@@ -25,6 +25,7 @@
 #include "definitions.h"
 #include "instruction.pb.h"
 #include "algorithm.h"
+#include "execution_watchdog.h"
 #include "generator.h"
 #include "generator_test_util.h"
 #include "instruction.h"
@@ -924,7 +925,7 @@ namespace automl_zero {
                algorithm, dataset, kNumTrainExamples, kNumValidExamples,
                &rand_gen, kLargeMaxAbsError);
          // Iterators that tracks the progresss of training.
-         TaskIterator<4> train_it = executor.dataset_.TrainIterator();
+         TaskIterator<4> train_it = executor.dataset_->TrainIterator();
          EXPECT_TRUE(executor.TrainNoOptImpl(kNumTrainExamples, nullptr, &train_it));
          fitness_no_opt = executor.Validate(nullptr);
       }
@@ -934,7 +935,7 @@ namespace automl_zero {
                algorithm, dataset, kNumTrainExamples, kNumValidExamples,
                &rand_gen, kLargeMaxAbsError);
          // Iterators that tracks the progresss of training.
-         TaskIterator<4> train_it = executor.dataset_.TrainIterator();
+         TaskIterator<4> train_it = executor.dataset_->TrainIterator();
          EXPECT_TRUE(
                executor.TrainOptImpl<10>(kNumTrainExamples, nullptr, &train_it));
          fitness_opt = executor.Validate(nullptr);
@@ -942,6 +943,196 @@ namespace automl_zero {
       EXPECT_FLOAT_EQ(fitness_no_opt, fitness_opt);
    }
 
+   TEST(ExecutorTest, ResumesTheExecutionAfterAProbe) {
+      Task<4> dataset =
+         GenerateTask<4>(StrCat("scalar_2layer_nn_regression_task {} "
+                  "num_train_examples: ",
+                  kNumTrainExamples,
+                  " "
+                  "num_valid_examples: ",
+                  kNumValidExamples,
+                  " "
+                  "eval_type: RMS_ERROR "
+                  "param_seeds: ",
+                  kFirstParamSeedForTest,
+                  " "
+                  "data_seeds: ",
+                  kFirstDataSeedForTest));
+      Algorithm algorithm = SimpleGz();
+      algorithm.CopyAllComponentsToEffective();
+      ASSERT_FALSE(UsesRandomOps(algorithm));
+      constexpr IntegerT kNumProbeTrainExamples = 10;
+      constexpr IntegerT kNumProbeValidExamples = 10;
+      ASSERT_TRUE(Executor<4>::CanProbe(
+            dataset, kNumTrainExamples, kNumProbeTrainExamples));
+      EXPECT_FALSE(Executor<4>::CanProbe(
+            dataset, kNumProbeTrainExamples, kNumProbeTrainExamples));
+      RandomGenerator rand_gen;
+
+      // A short execution...
+      vector<double> short_train_errors;
+      vector<double> short_valid_errors;
+      {
+         Executor<4> executor(
+               algorithm, dataset, kNumProbeTrainExamples,
+               kNumProbeValidExamples, &rand_gen, kLargeMaxAbsError);
+         executor.Execute(&short_train_errors, &short_valid_errors);
+      }
+      // ...and a full one.
+      double fitness;
+      {
+         Executor<4> executor(
+               algorithm, dataset, kNumTrainExamples, kNumValidExamples,
+               &rand_gen, kLargeMaxAbsError);
+         fitness = executor.Execute();
+      }
+
+      // The probe matches the short execution, and the resumed execution
+      // matches the full one.
+      Executor<4> executor(
+            algorithm, dataset, kNumTrainExamples, kNumValidExamples,
+            &rand_gen, kLargeMaxAbsError);
+      vector<double> probe_train_errors;
+      vector<double> probe_valid_errors;
+      EXPECT_TRUE(executor.Probe(kNumProbeTrainExamples, kNumProbeValidExamples,
+                                 &probe_train_errors, &probe_valid_errors));
+      EXPECT_EQ(probe_train_errors, short_train_errors);
+      EXPECT_EQ(probe_valid_errors, short_valid_errors);
+      EXPECT_EQ(executor.GetNumTrainStepsCompleted(), kNumProbeTrainExamples);
+      EXPECT_EQ(executor.Execute(), fitness);
+      EXPECT_EQ(executor.GetNumTrainStepsCompleted(), kNumTrainExamples);
+   }
+
+   TEST(ExecutorTest, ResetMatchesConstruction) {
+      Task<4> dataset =
+         GenerateTask<4>(StrCat("scalar_2layer_nn_regression_task {} "
+                  "num_train_examples: ",
+                  kNumTrainExamples,
+                  " "
+                  "num_valid_examples: ",
+                  kNumValidExamples,
+                  " "
+                  "eval_type: RMS_ERROR "
+                  "param_seeds: ",
+                  kFirstParamSeedForTest,
+                  " "
+                  "data_seeds: ",
+                  kFirstDataSeedForTest));
+      Algorithm linear = SimpleGz();
+      linear.CopyAllComponentsToEffective();
+      Algorithm neural_net = SimpleGrTildeGrWithBias();
+      neural_net.CopyAllComponentsToEffective();
+      mt19937 bit_gen(100000);
+      RandomGenerator rand_gen(&bit_gen);
+      double linear_fitness;
+      double neural_net_fitness;
+      {
+         bit_gen.seed(100000);
+         Executor<4> executor(
+               linear, dataset, kNumTrainExamples, kNumValidExamples,
+               &rand_gen, kLargeMaxAbsError);
+         linear_fitness = executor.Execute();
+      }
+      {
+         bit_gen.seed(100000);
+         Executor<4> executor(
+               neural_net, dataset, kNumTrainExamples, kNumValidExamples,
+               &rand_gen, kLargeMaxAbsError);
+         neural_net_fitness = executor.Execute();
+      }
+
+      // The matrices left by the neural net must not change the linear model.
+      Executor<4> executor;
+      for (IntegerT i = 0; i < 2; ++i) {
+         bit_gen.seed(100000);
+         executor.Reset(neural_net, dataset, kNumTrainExamples,
+                        kNumValidExamples, &rand_gen, kLargeMaxAbsError);
+         EXPECT_EQ(executor.Execute(), neural_net_fitness);
+         bit_gen.seed(100000);
+         executor.Reset(linear, dataset, kNumTrainExamples, kNumValidExamples,
+                        &rand_gen, kLargeMaxAbsError);
+         EXPECT_EQ(executor.Execute(), linear_fitness);
+         EXPECT_EQ(executor.GetNumTrainStepsCompleted(), kNumTrainExamples);
+      }
+   }
+
+   TEST(ExecutorTest, StopsWhenTheWatchdogExpires) {
+      Task<4> dataset =
+         GenerateTask<4>(StrCat("scalar_2layer_nn_regression_task {} "
+                  "num_train_examples: ",
+                  kNumTrainExamples,
+                  " "
+                  "num_valid_examples: ",
+                  kNumValidExamples,
+                  " "
+                  "eval_type: RMS_ERROR "
+                  "param_seeds: ",
+                  kFirstParamSeedForTest,
+                  " "
+                  "data_seeds: ",
+                  kFirstDataSeedForTest));
+      Algorithm algorithm = SimpleGz();
+      algorithm.CopyAllComponentsToEffective();
+      RandomGenerator rand_gen;
+      Executor<4> executor(
+            algorithm, dataset, kNumTrainExamples, kNumValidExamples,
+            &rand_gen, kLargeMaxAbsError);
+      const double fitness = executor.Execute();
+      ASSERT_GT(fitness, kMinFitness);
+
+      // Within the limits, the watchdog changes nothing.
+      ExecutionWatchdog loose_watchdog(1000000000, 0.0);
+      loose_watchdog.Start();
+      executor.Reset(algorithm, dataset, kNumTrainExamples, kNumValidExamples,
+                     &rand_gen, kLargeMaxAbsError);
+      executor.SetWatchdog(&loose_watchdog);
+      EXPECT_EQ(executor.Execute(), fitness);
+      EXPECT_FALSE(executor.TimedOut());
+      EXPECT_GE(loose_watchdog.NumInstructions(),
+                kNumTrainExamples * (algorithm.predict_.size() +
+                                     algorithm.learn_.size()) -
+                kWatchdogCheckPeriod * (algorithm.predict_.size() +
+                                        algorithm.learn_.size()));
+
+      // Over them, the execution stops at the next check.
+      ExecutionWatchdog tight_watchdog(1, 0.0);
+      tight_watchdog.Start();
+      executor.Reset(algorithm, dataset, kNumTrainExamples, kNumValidExamples,
+                     &rand_gen, kLargeMaxAbsError);
+      executor.SetWatchdog(&tight_watchdog);
+      EXPECT_EQ(executor.Execute(), kMinFitness);
+      EXPECT_TRUE(executor.TimedOut());
+      EXPECT_TRUE(tight_watchdog.Expired());
+      EXPECT_EQ(executor.GetNumTrainStepsCompleted(), kWatchdogCheckPeriod);
+
+      // Reset clears the watchdog.
+      executor.Reset(algorithm, dataset, kNumTrainExamples, kNumValidExamples,
+                     &rand_gen, kLargeMaxAbsError);
+      EXPECT_EQ(executor.Execute(), fitness);
+      EXPECT_FALSE(executor.TimedOut());
+   }
+
+   TEST(ExecutorTest, ReusesTheScopedExecutors) {
+      Executor<4>* executor_ptr;
+      {
+         ScopedExecutor<4> executor;
+         executor_ptr = &*executor;
+      }
+      {
+         ScopedExecutor<4> executor;
+         EXPECT_EQ(&*executor, executor_ptr);
+         // Executors in use are not handed out again.
+         ScopedExecutor<4> other_executor;
+         EXPECT_NE(&*other_executor, executor_ptr);
+      }
+   }
+
+   TEST(ExecutorTest, FindsRandomOps) {
+      EXPECT_FALSE(UsesRandomOps(SimpleGz()));
+      // Initializes the weights randomly.
+      EXPECT_TRUE(UsesRandomOps(SimpleGrTildeGrWithBias()));
+   }
+
    // TODO(crazydonkey): the number of examples passed to the executor is not
    // correct, it should be multiplied by the number of epochs, so right now the
    // executor is only training one epoch. This means this test cannot be testing
@@ -1787,6 +1978,56 @@ namespace automl_zero {
             201.527, 2.3792, -139.4326, -150.6448});
    }
 
+   TEST(ExecuteInstructionLargeFeaturesTest, MatrixMatrixProductOp) {
+      mt19937 bit_gen(100000);
+      RandomGenerator rand_gen(&bit_gen);
+      Memory<64> memory;
+      memory.Wipe();
+      memory.matrix_[0].setRandom();
+      memory.matrix_[1].setRandom();
+      const Matrix<64> matrix0 = memory.matrix_[0];
+      const Matrix<64> matrix1 = memory.matrix_[1];
+      Matrix<64> expected(64, 64);
+      for (IntegerT i = 0; i < 64; ++i) {
+         for (IntegerT j = 0; j < 64; ++j) {
+            expected(i, j) = 0.0;
+            for (IntegerT k = 0; k < 64; ++k) {
+               expected(i, j) += matrix0(i, k) * matrix1(k, j);
+            }
+         }
+      }
+
+      // The output aliases the first input.
+      ExecuteInstruction(Instruction(MATRIX_MATRIX_PRODUCT_OP, 0, 1, 0),
+                         &rand_gen, &memory);
+      EXPECT_TRUE(memory.matrix_[0].isApprox(expected));
+      EXPECT_EQ(memory.matrix_[1], matrix1);
+
+      // The output aliases the second input.
+      memory.matrix_[0] = matrix0;
+      ExecuteInstruction(Instruction(MATRIX_MATRIX_PRODUCT_OP, 0, 1, 1),
+                         &rand_gen, &memory);
+      EXPECT_TRUE(memory.matrix_[1].isApprox(expected));
+      EXPECT_EQ(memory.matrix_[0], matrix0);
+   }
+
+   TEST(ExecuteInstructionLargeFeaturesTest, VectorOuterProductOp) {
+      mt19937 bit_gen(100000);
+      RandomGenerator rand_gen(&bit_gen);
+      Memory<256> memory;
+      memory.Wipe();
+      memory.vector_[0].setRandom();
+      memory.vector_[1].setRandom();
+      ExecuteInstruction(Instruction(VECTOR_OUTER_PRODUCT_OP, 0, 1, 2),
+                         &rand_gen, &memory);
+      for (IntegerT i = 0; i < 256; ++i) {
+         for (IntegerT j = 0; j < 256; ++j) {
+            EXPECT_DOUBLE_EQ(memory.matrix_[2](i, j),
+                             memory.vector_[0](i) * memory.vector_[1](j));
+         }
+      }
+   }
+
    TEST_F(ExecuteInstructionTest, ProbabilityRelated_VectorMeanOp) {
       VerifyVectorToScalarEquals(
             MakeOneInputInstruction(VECTOR_MEAN_OP),
@@ -58,12 +58,15 @@ V* LRUCache::MutableLookup(const K key) {
     return nullptr;
   } else {
     // If found, move it to the front and return it.
-    const V value = found->second->second;
-    EraseImpl(found);
-    return InsertImpl(key, value);
+    return MoveToFront(found);
   }
 }
 
+V* LRUCache::MutablePeek(const K key) {
+  MapIterator found = map_.find(key);
+  return found == map_.end() ? nullptr : &found->second->second;
+}
+
 void LRUCache::Erase(const K key) {
   MapIterator found = map_.find(key);
   CHECK(found != map_.end());
@@ -73,17 +76,32 @@ void LRUCache::Erase(const K key) {
 void LRUCache::Clear() {
   map_.clear();
   list_.clear();
+  free_list_.clear();
+  free_map_nodes_.clear();
 }
 
 void LRUCache::EraseImpl(MapIterator it) {
-  list_.erase(it->second);
-  map_.erase(it);
+  free_list_.splice(free_list_.begin(), list_, it->second);
+  free_map_nodes_.push_back(map_.extract(it));
 }
 
 V* LRUCache::InsertImpl(const K key, const V& value) {
-  list_.push_front(make_pair(key, value));
+  if (free_list_.empty()) {
+    list_.push_front(make_pair(key, value));
+  } else {
+    list_.splice(list_.begin(), free_list_, free_list_.begin());
+    list_.front() = make_pair(key, value);
+  }
   ListIterator pushed = list_.begin();
-  map_.insert(make_pair(key, pushed));
+  if (free_map_nodes_.empty()) {
+    map_.insert(make_pair(key, pushed));
+  } else {
+    Map::node_type node = std::move(free_map_nodes_.back());
+    free_map_nodes_.pop_back();
+    node.key() = key;
+    node.mapped() = pushed;
+    map_.insert(std::move(node));
+  }
   return &pushed->second;
 }
 
@@ -91,12 +109,16 @@ void LRUCache::MaybeResize() {
   // Keep within size limit.
   while (list_.size() > max_size_) {
     // Erase last element.
-    const K erasing = list_.back().first;
-    list_.pop_back();
-    map_.erase(erasing);
+    EraseImpl(map_.find(list_.back().first));
   }
 }
 
+V* LRUCache::MoveToFront(MapIterator it) {
+  // Splicing keeps the iterators valid, so the map needs no update.
+  list_.splice(list_.begin(), list_, it->second);
+  return &it->second->second;
+}
+
 FECCache::FECCache(const FECSpec& spec)
     : spec_(spec), cache_(spec_.cache_size()) {
   CHECK_GT(spec_.num_train_examples(), 0);
@@ -114,6 +136,7 @@ size_t FECCache::Hash(
 }
 
 std::pair<double, bool> FECCache::Find(const size_t hash) {
+  std::lock_guard<std::mutex> lock(mutex_);
   CachedEvaluation* cached = cache_.MutableLookup(hash);
   if (cached == nullptr) {
     return make_pair(kMinFitness, false);
@@ -129,12 +152,25 @@ std::pair<double, bool> FECCache::Find(const size_t hash) {
 
 void FECCache::InsertOrDie(
     const size_t hash, const double fitness) {
+  std::lock_guard<std::mutex> lock(mutex_);
   CHECK(cache_.Lookup(hash) == nullptr);
   CachedEvaluation* inserted = cache_.Insert(hash, CachedEvaluation(fitness));
   CHECK(inserted != nullptr);
 }
 
+void FECCache::UpdateFitness(const size_t hash, const double fitness) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CachedEvaluation* cached = cache_.MutablePeek(hash);
+  if (cached != nullptr) cached->fitness = fitness;
+}
+
+void FECCache::Erase(const size_t hash) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cache_.MutablePeek(hash) != nullptr) cache_.Erase(hash);
+}
+
 void FECCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
   cache_.Clear();
 }
 
@@ -17,12 +17,14 @@
 
 #include <functional>
 #include <list>
+#include <mutex>  // NOLINT
 #include <unordered_map>
 #include <vector>
 
 #include "definitions.h"
 #include "executor.h"
 #include "fec_cache.pb.h"
+#include "huge_page_allocator.h"
 
 namespace automl_zero {
 
@@ -44,13 +46,19 @@ class LRUCache {
   V* Insert(K key, const V& value);
   const V* Lookup(K key);
   V* MutableLookup(K key);
+  // Like MutableLookup, but leaves the key where it is in the LRU order.
+  V* MutablePeek(K key);
   void Erase(K key);
   void Clear();
 
  private:
-  typedef std::list<std::pair<K, V>> List;
+  // Looked up at random, so allocated with the HugePageAllocator.
+  typedef std::list<std::pair<K, V>, HugePageAllocator<std::pair<K, V>>> List;
   typedef List::iterator ListIterator;
-  typedef std::unordered_map<K, ListIterator> Map;
+  typedef std::unordered_map<
+      K, ListIterator, std::hash<K>, std::equal_to<K>,
+      HugePageAllocator<std::pair<const K, ListIterator>>>
+      Map;
   typedef Map::iterator MapIterator;
 
   void EraseImpl(MapIterator it);
@@ -61,8 +69,14 @@ class LRUCache {
   const IntegerT max_size_;
   List list_;  // Least recently used at back.
   Map map_;
+
+  // The nodes of erased entries, reused by later insertions, so that a cache
+  // that has filled up no longer allocates.
+  List free_list_;
+  std::vector<Map::node_type> free_map_nodes_;
 };
 
+// Thread-safe, so that the tasks of an evaluation can use it concurrently.
 class FECCache {
  public:
   explicit FECCache(const FECSpec& spec);
@@ -87,6 +101,13 @@ class FECCache {
   // was found.
   void UpdateOrDie(size_t hash, double fitness) {}
 
+  // Replaces the fitness of a hash, if it is still in the cache. Does not
+  // count as seeing it again.
+  void UpdateFitness(size_t hash, double fitness);
+
+  // Removes a hash, if it is still in the cache.
+  void Erase(size_t hash);
+
   // Removes all items in the cache.
   void Clear();
 
@@ -98,7 +119,8 @@ class FECCache {
  private:
   const FECSpec spec_;
 
-  LRUCache cache_;
+  std::mutex mutex_;
+  LRUCache cache_;  // Guarded by mutex_.
 };
 
 }  // namespace automl_zero
@@ -18,6 +18,7 @@
 
 #include "definitions.h"
 #include "fec_cache.pb.h"
+#include "parallel.h"
 #include "gtest/gtest.h"
 #include "absl/strings/str_cat.h"
 
@@ -136,6 +137,23 @@ TEST_F(FECCacheTest, LRUPolicyConsidersReinserts) {
   EXPECT_TRUE(cache.Find(7).second);
 }
 
+TEST_F(FECCacheTest, ErasesCorrectly) {
+  FECCache cache(ParseTextFormat<FECSpec>(StrCat(
+      "num_train_examples: ", kNumTrainExamples, " "
+      "num_valid_examples: ", kNumValidExamples, " "
+      "cache_size: ", kCacheSize, " "
+      "forget_every: ", 0, " "
+      )));
+  InsertAndVerify(1, 0.1, true, &cache);
+  InsertAndVerify(2, 0.2, true, &cache);
+  cache.Erase(1);
+  // Erasing a missing hash does nothing.
+  cache.Erase(3);
+  EXPECT_FALSE(cache.Find(1).second);
+  EXPECT_TRUE(cache.Find(2).second);
+  InsertAndVerify(1, 0.3, true, &cache);
+}
+
 TEST_F(FECCacheTest, NumTrainExamplesWorks) {
   FECCache cache(ParseTextFormat<FECSpec>(StrCat(
       "num_train_examples: ", kNumTrainExamples, " "
@@ -156,4 +174,25 @@ TEST_F(FECCacheTest, NumValidExamplesWorks) {
   EXPECT_EQ(cache.NumValidExamples(), kNumValidExamples);
 }
 
+TEST_F(FECCacheTest, IsThreadSafe) {
+  constexpr IntegerT kNumThreads = 8;
+  constexpr IntegerT kNumHashesPerThread = 1000;
+  FECCache cache(ParseTextFormat<FECSpec>(StrCat(
+      "num_train_examples: ", kNumTrainExamples, " "
+      "num_valid_examples: ", kNumValidExamples, " "
+      "cache_size: ", kNumThreads * kNumHashesPerThread, " "
+      "forget_every: ", 0, " "
+      )));
+  ParallelFor(kNumThreads, kNumThreads, [&cache](const IntegerT thread) {
+    for (IntegerT i = 0; i < kNumHashesPerThread; ++i) {
+      const size_t hash = thread * kNumHashesPerThread + i;
+      EXPECT_FALSE(cache.Find(hash).second);
+      cache.InsertOrDie(hash, static_cast<double>(hash));
+    }
+  });
+  for (size_t hash = 0; hash < kNumThreads * kNumHashesPerThread; ++hash) {
+    EXPECT_EQ(cache.Find(hash), std::make_pair(static_cast<double>(hash), true));
+  }
+}
+
 }  // namespace automl_zero
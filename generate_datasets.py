@@ -21,6 +21,7 @@ from __future__ import division
 from __future__ import print_function
 
 import os
+import struct
 
 from absl import app
 from absl import flags
@@ -72,8 +73,18 @@ flags.DEFINE_list('class_ids', '0,1,2,3,4,5,6,7,8,9',
                   'Classes included to generate binary'
                   ' classification datasets.')
 
+flags.DEFINE_enum('output_format', 'proto', ['proto', 'columnar'],
+                  'Format of the saved datasets: a serialized '
+                  'ScalarLabelDataset proto, or the memory-mappable '
+                  'columnar format described in columnar_dataset.h.')
+
 FLAGS = flags.FLAGS
 
+# Must match columnar_dataset.h.
+COLUMNAR_MAGIC = b'AMLZCOL1'
+COLUMNAR_HEADER_SIZE = 64
+COLUMNAR_ALIGNMENT = 64
+
 
 def create_projected_binary_dataset(
     dataset_name, positive_class, negative_class,
@@ -176,6 +187,26 @@ def load_projected_binary_dataset(saved_dataset):
           test_data, test_labels)
 
 
+def write_columnar_dataset(saved_dataset, path):
+  """Write a ScalarLabelDataset proto in the columnar format."""
+  (train_data, train_labels, valid_data, valid_labels,
+   test_data, test_labels) = load_projected_binary_dataset(saved_dataset)
+  feature_size = train_data.shape[1]
+  if test_data is None:
+    test_data = np.zeros((0, feature_size))
+    test_labels = np.zeros(0)
+  header = struct.pack(
+      '<8sIIQQQQ', COLUMNAR_MAGIC, 8, 0, feature_size,
+      train_data.shape[0], valid_data.shape[0], test_data.shape[0])
+  with open(path, 'wb') as f:
+    f.write(header.ljust(COLUMNAR_HEADER_SIZE, b'\0'))
+    for array in (train_data, train_labels, valid_data, valid_labels,
+                  test_data, test_labels):
+      data = np.ascontiguousarray(array, dtype='<f8').tobytes()
+      padding = -len(data) % COLUMNAR_ALIGNMENT
+      f.write(data + b'\0' * padding)
+
+
 def get_dataset(
     name, num_samples_per_class=None, class_ids=None, load_fn=tfds.load,
     data_dir=None):
@@ -326,10 +357,13 @@ def main(unused_argv):
         filename = 'binary_{}-pos_{}-neg_{}-dim_{}-seed_{}'.format(
             FLAGS.dataset_name, positive_class, negative_class,
             FLAGS.projected_dim, seed)
-        serialized_dataset = dataset.SerializeToString()
-
-        with open(os.path.join(FLAGS.data_dir, filename), 'wb') as f:
-          f.write(serialized_dataset)
+        path = os.path.join(FLAGS.data_dir, filename)
+        if FLAGS.output_format == 'columnar':
+          write_columnar_dataset(dataset, path)
+        else:
+          serialized_dataset = dataset.SerializeToString()
+          with open(path, 'wb') as f:
+            f.write(serialized_dataset)
 
 if __name__ == '__main__':
   app.run(main)
@@ -0,0 +1,329 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "huge_page_allocator.h"
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <mutex>  // NOLINT
+
+namespace automl_zero {
+
+namespace {
+
+// Allocations larger than this get chunks of their own.
+constexpr size_t kMaxSharedChunkAllocation = kHugePageSize / 2;
+
+// The address space reserved for the chunks. Only reserved, so it costs no
+// memory until the chunks are mapped into it.
+constexpr size_t kArenaSize = size_t{1} << 38;
+
+size_t RoundUp(const size_t size, const size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Reserves kArenaSize bytes of address space, aligned to kHugePageSize.
+// Returns 0 if it could not.
+uintptr_t ReserveArena() {
+  // Over-reserve, then trim down to an aligned range.
+  const size_t reserved_size = kArenaSize + kHugePageSize;
+  void* const reservation =
+      mmap(nullptr, reserved_size, PROT_NONE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reservation == MAP_FAILED) return 0;
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(reservation);
+  const uintptr_t aligned_begin = RoundUp(begin, kHugePageSize);
+  if (aligned_begin > begin) {
+    munmap(reservation, aligned_begin - begin);
+  }
+  const uintptr_t end = begin + reserved_size;
+  if (end > aligned_begin + kArenaSize) {
+    munmap(reinterpret_cast<void*>(aligned_begin + kArenaSize),
+           end - aligned_begin - kArenaSize);
+  }
+  return aligned_begin;
+}
+
+// Maps `size` bytes of anonymous memory at `begin`, in place of the
+// reservation. Returns whether it could.
+bool MapAt(const uintptr_t begin, const size_t size, const int flags) {
+  return mmap(reinterpret_cast<void*>(begin), size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | flags, -1,
+              0) != MAP_FAILED;
+}
+
+// The chunks the allocations are carved out of, by their address. They are
+// all mapped into an arena of reserved address space, so that the frees can
+// tell the chunk memory apart without taking the lock.
+class ChunkPool {
+ public:
+  ChunkPool()
+      : current_chunk_(0), arena_reserved_(false), arena_full_logged_(false),
+        stats_(), arena_begin_(0) {}
+
+  // Returns nullptr if the arena could not be reserved or is full.
+  void* Allocate(size_t size, size_t alignment, HugePageMode mode);
+
+  // `pointer` must be in the arena.
+  void Deallocate(void* pointer, size_t size);
+
+  HugePageStats Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  // Whether `pointer` is in the arena. Lock-free, so that the allocations
+  // made with operator new are freed without taking the lock.
+  bool Contains(const void* pointer) const {
+    const uintptr_t begin = arena_begin_.load(std::memory_order_acquire);
+    return begin != 0 &&
+           reinterpret_cast<uintptr_t>(pointer) - begin < kArenaSize;
+  }
+
+ private:
+  struct Chunk {
+    size_t size;
+    // Bytes handed out, from the start.
+    size_t used;
+    // Bytes freed while other allocations of the chunk are still alive.
+    size_t freed;
+    IntegerT num_allocations;
+    // kNoHugePages for a chunk on regular pages.
+    HugePageMode backing;
+  };
+  typedef std::map<uintptr_t, Chunk> ChunkMap;
+
+  // Returns chunks_.end() if the arena is full.
+  ChunkMap::iterator MapChunk(size_t size, HugePageMode mode);
+  void UnmapChunk(ChunkMap::iterator chunk);
+  // Takes `size` bytes of the arena, first fit. Returns 0 if none are left.
+  uintptr_t TakeRange(size_t size);
+  void ReleaseRange(uintptr_t begin, size_t size);
+  IntegerT* BackingBytes(HugePageMode backing);
+
+  std::mutex mutex_;
+  ChunkMap chunks_;  // Guarded by mutex_.
+  // The begin of the chunk the small allocations are carved out of, or 0.
+  uintptr_t current_chunk_;  // Guarded by mutex_.
+  // The free ranges of the arena, by their begin.
+  std::map<uintptr_t, size_t> free_ranges_;  // Guarded by mutex_.
+  bool arena_reserved_;  // Guarded by mutex_.
+  bool arena_full_logged_;  // Guarded by mutex_.
+  HugePageStats stats_;  // Guarded by mutex_.
+  // Set once, when the first chunk is mapped.
+  std::atomic<uintptr_t> arena_begin_;
+};
+
+void* ChunkPool::Allocate(const size_t size, const size_t alignment,
+                          const HugePageMode mode) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!arena_reserved_) {
+    arena_reserved_ = true;
+    const uintptr_t begin = ReserveArena();
+    if (begin == 0) {
+      LOG(WARNING) << "Could not reserve the huge page arena. Allocating "
+                   << "with operator new instead.";
+      return nullptr;
+    }
+    free_ranges_.emplace(begin, kArenaSize);
+    arena_begin_.store(begin, std::memory_order_release);
+  }
+  if (arena_begin_.load(std::memory_order_relaxed) == 0) return nullptr;
+  if (size > kMaxSharedChunkAllocation) {
+    ChunkMap::iterator chunk = MapChunk(RoundUp(size, kHugePageSize), mode);
+    if (chunk == chunks_.end()) return nullptr;
+    chunk->second.used = size;
+    chunk->second.num_allocations = 1;
+    return reinterpret_cast<void*>(chunk->first);
+  }
+  ChunkMap::iterator chunk = chunks_.find(current_chunk_);
+  if (chunk == chunks_.end() ||
+      RoundUp(chunk->second.used, alignment) + size > chunk->second.size) {
+    if (chunk != chunks_.end() && chunk->second.num_allocations == 0) {
+      UnmapChunk(chunk);
+    }
+    current_chunk_ = 0;
+    chunk = MapChunk(kHugePageSize, mode);
+    if (chunk == chunks_.end()) return nullptr;
+    current_chunk_ = chunk->first;
+  }
+  const size_t offset = RoundUp(chunk->second.used, alignment);
+  chunk->second.used = offset + size;
+  ++chunk->second.num_allocations;
+  return reinterpret_cast<void*>(chunk->first + offset);
+}
+
+void ChunkPool::Deallocate(void* const pointer, const size_t size) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+  std::lock_guard<std::mutex> lock(mutex_);
+  ChunkMap::iterator chunk = chunks_.upper_bound(address);
+  CHECK(chunk != chunks_.begin());
+  --chunk;
+  CHECK_LT(address, chunk->first + chunk->second.size);
+  CHECK_GT(chunk->second.num_allocations, 0);
+  if (--chunk->second.num_allocations == 0) {
+    stats_.stranded_bytes -= chunk->second.freed;
+    if (chunk->first == current_chunk_) {
+      chunk->second.used = 0;
+      chunk->second.freed = 0;
+    } else {
+      UnmapChunk(chunk);
+    }
+  } else {
+    chunk->second.freed += size;
+    stats_.stranded_bytes += size;
+  }
+}
+
+ChunkPool::ChunkMap::iterator ChunkPool::MapChunk(const size_t size,
+                                                  const HugePageMode mode) {
+  const uintptr_t begin = TakeRange(size);
+  if (begin == 0) {
+    if (!arena_full_logged_) {
+      arena_full_logged_ = true;
+      LOG(WARNING) << "The huge page arena is full. Allocating with "
+                   << "operator new instead.";
+    }
+    return chunks_.end();
+  }
+  HugePageMode backing = mode;
+  bool mapped = false;
+  if (mode == kExplicitHugePages) {
+    // The arena is aligned to the huge page size, and so are the chunks.
+    mapped = MapAt(begin, size, MAP_HUGETLB);
+    if (!mapped) {
+      ++stats_.num_fallbacks;
+      backing = kTransparentHugePages;
+    }
+  }
+  if (!mapped) {
+    CHECK(MapAt(begin, size, 0)) << "Could not map " << size << " bytes.";
+    if (backing == kTransparentHugePages &&
+        madvise(reinterpret_cast<void*>(begin), size, MADV_HUGEPAGE) != 0) {
+      backing = kNoHugePages;
+    }
+  }
+  *BackingBytes(backing) += size;
+  return chunks_.emplace(begin, Chunk{size, 0, 0, 0, backing}).first;
+}
+
+void ChunkPool::UnmapChunk(const ChunkMap::iterator chunk) {
+  // Mapped over with a reservation again, which frees the memory.
+  CHECK(mmap(reinterpret_cast<void*>(chunk->first), chunk->second.size,
+             PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+             -1, 0) != MAP_FAILED);
+  ReleaseRange(chunk->first, chunk->second.size);
+  *BackingBytes(chunk->second.backing) -= chunk->second.size;
+  if (chunk->first == current_chunk_) current_chunk_ = 0;
+  chunks_.erase(chunk);
+}
+
+uintptr_t ChunkPool::TakeRange(const size_t size) {
+  for (auto range = free_ranges_.begin(); range != free_ranges_.end();
+       ++range) {
+    if (range->second < size) continue;
+    const uintptr_t begin = range->first;
+    const size_t remaining = range->second - size;
+    free_ranges_.erase(range);
+    if (remaining > 0) free_ranges_.emplace(begin + size, remaining);
+    return begin;
+  }
+  return 0;
+}
+
+void ChunkPool::ReleaseRange(uintptr_t begin, size_t size) {
+  // Merged with the adjacent free ranges.
+  auto next = free_ranges_.lower_bound(begin);
+  if (next != free_ranges_.end() && begin + size == next->first) {
+    size += next->second;
+    next = free_ranges_.erase(next);
+  }
+  if (next != free_ranges_.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == begin) {
+      previous->second += size;
+      return;
+    }
+  }
+  free_ranges_.emplace_hint(next, begin, size);
+}
+
+IntegerT* ChunkPool::BackingBytes(const HugePageMode backing) {
+  switch (backing) {
+    case kExplicitHugePages:
+      return &stats_.explicit_bytes;
+    case kTransparentHugePages:
+      return &stats_.transparent_bytes;
+    case kNoHugePages:
+      return &stats_.regular_bytes;
+  }
+  LOG(FATAL) << "Unknown huge page mode.";
+}
+
+std::atomic<int> huge_page_mode(kNoHugePages);
+
+ChunkPool* Pool() {
+  // Never destroyed, so that it outlives the static objects it backs.
+  static ChunkPool* const pool = new ChunkPool();
+  return pool;
+}
+
+void* OperatorNew(const size_t size, const size_t alignment) {
+  if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+  return ::operator new(size);
+}
+
+}  // namespace
+
+void SetHugePageMode(const HugePageMode mode) {
+  huge_page_mode.store(mode, std::memory_order_relaxed);
+}
+
+HugePageMode GetHugePageMode() {
+  return static_cast<HugePageMode>(
+      huge_page_mode.load(std::memory_order_relaxed));
+}
+
+void* HugePageAllocate(size_t size, const size_t alignment) {
+  CHECK_LE(alignment, 4096);
+  const HugePageMode mode = GetHugePageMode();
+  if (mode == kNoHugePages) return OperatorNew(size, alignment);
+  void* const pointer =
+      Pool()->Allocate(size == 0 ? 1 : size, alignment, mode);
+  return pointer != nullptr ? pointer : OperatorNew(size, alignment);
+}
+
+void HugePageDeallocate(void* const pointer, const size_t size,
+                        const size_t alignment) {
+  if (pointer == nullptr) return;
+  if (Pool()->Contains(pointer)) {
+    Pool()->Deallocate(pointer, size == 0 ? 1 : size);
+  } else if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    ::operator delete(pointer, std::align_val_t(alignment));
+  } else {
+    ::operator delete(pointer);
+  }
+}
+
+HugePageStats GetHugePageStats() {
+  return Pool()->Stats();
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,141 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// An optional allocator that backs the long-lived, randomly accessed data of
+// a search with 2 MB huge pages, to cut its TLB misses: the examples of the
+// tasks, which are read in shuffled order, the functional cache and the
+// executors with their memory.
+//
+// The allocations are carved out of 2 MB-aligned chunks, so that the many
+// small vectors of the tasks share huge pages. The chunks are mapped into an
+// arena of address space reserved on the first allocation, so that a free
+// tells them apart from operator new memory with a range check, without
+// taking a lock. If the arena cannot be reserved or is full, the allocations
+// fall back to operator new. With kNoHugePages, the default, everything is
+// allocated with operator new, as by std::allocator.
+//
+// The small allocations are bump-allocated from the current chunk, with no
+// free lists: the space of a freed allocation is only reused once all the
+// allocations of its chunk are freed, when the chunk is unmapped. So a chunk
+// holding a single long-lived allocation keeps its whole 2 MB mapped. This
+// suits the data above, which is mostly allocated up front and freed
+// together, but not allocations with interleaved lifetimes. The freed space
+// held this way is reported as HugePageStats::stranded_bytes.
+
+#ifndef AUTOML_ZERO_HUGE_PAGE_ALLOCATOR_H_
+#define AUTOML_ZERO_HUGE_PAGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "definitions.h"
+
+namespace automl_zero {
+
+constexpr size_t kHugePageSize = 2 << 20;
+
+enum HugePageMode {
+  kNoHugePages = 0,
+  // Chunks advised with madvise(MADV_HUGEPAGE), for the kernel to back with
+  // transparent huge pages when it can.
+  kTransparentHugePages = 1,
+  // Chunks mapped with MAP_HUGETLB, from the huge pages reserved in
+  // /proc/sys/vm/nr_hugepages. When none are left, falls back to transparent
+  // huge pages.
+  kExplicitHugePages = 2
+};
+
+// Sets how the allocations made from now on are backed. The earlier ones
+// stay as they are and can still be freed. Thread-safe, but meant to be set
+// once, before the tasks are generated.
+void SetHugePageMode(HugePageMode mode);
+HugePageMode GetHugePageMode();
+
+// Like ::operator new and ::operator delete, with the current mode.
+// `alignment` must be a power of two no larger than 4096. Thread-safe.
+void* HugePageAllocate(size_t size, size_t alignment);
+void HugePageDeallocate(void* pointer, size_t size, size_t alignment);
+
+// The chunks currently mapped. A chunk is counted as transparent if the
+// kernel accepted the advice, which does not guarantee that it got huge
+// pages; see AnonHugePages in /proc/self/smaps for that.
+struct HugePageStats {
+  IntegerT explicit_bytes;
+  IntegerT transparent_bytes;
+  // Chunks on regular pages, because transparent huge pages are disabled.
+  IntegerT regular_bytes;
+  // The explicit chunks that could not be mapped, since the start.
+  IntegerT num_fallbacks;
+  // The bytes freed in the chunks that still have allocations alive, which
+  // cannot be reused until those are freed too.
+  IntegerT stranded_bytes;
+};
+HugePageStats GetHugePageStats();
+
+template <typename T>
+class HugePageAllocator {
+ public:
+  typedef T value_type;
+
+  HugePageAllocator() noexcept {}
+  template <typename U>
+  HugePageAllocator(const HugePageAllocator<U>& other) noexcept {}  // NOLINT
+
+  T* allocate(const size_t n) {
+    return static_cast<T*>(HugePageAllocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* const pointer, const size_t n) noexcept {
+    HugePageDeallocate(pointer, n * sizeof(T), alignof(T));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const HugePageAllocator<T>& allocator1,
+                const HugePageAllocator<U>& allocator2) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const HugePageAllocator<T>& allocator1,
+                const HugePageAllocator<U>& allocator2) {
+  return false;
+}
+
+template <typename T>
+using HugePageVector = std::vector<T, HugePageAllocator<T>>;
+
+template <typename T>
+struct HugePageDeleter {
+  void operator()(T* const pointer) const {
+    pointer->~T();
+    HugePageDeallocate(pointer, sizeof(T), alignof(T));
+  }
+};
+
+template <typename T>
+using HugePageUniquePtr = std::unique_ptr<T, HugePageDeleter<T>>;
+
+// Like std::make_unique, with the object allocated by HugePageAllocate.
+template <typename T, typename... Args>
+HugePageUniquePtr<T> MakeHugePageUnique(Args&&... args) {
+  void* const storage = HugePageAllocate(sizeof(T), alignof(T));
+  return HugePageUniquePtr<T>(new (storage) T(std::forward<Args>(args)...));
+}
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_HUGE_PAGE_ALLOCATOR_H_
@@ -0,0 +1,154 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "huge_page_allocator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "definitions.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+class HugePageAllocatorTest : public ::testing::Test {
+ protected:
+  void TearDown() override { SetHugePageMode(kNoHugePages); }
+};
+
+IntegerT MappedBytes() {
+  const HugePageStats stats = GetHugePageStats();
+  return stats.explicit_bytes + stats.transparent_bytes + stats.regular_bytes;
+}
+
+uintptr_t ChunkOf(const void* pointer) {
+  return reinterpret_cast<uintptr_t>(pointer) & ~(kHugePageSize - 1);
+}
+
+TEST_F(HugePageAllocatorTest, UsesOperatorNewWithoutHugePages) {
+  const IntegerT mapped_bytes = MappedBytes();
+  void* const pointer = HugePageAllocate(100, 64);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(pointer) % 64, 0);
+  EXPECT_EQ(MappedBytes(), mapped_bytes);
+  HugePageDeallocate(pointer, 100, 64);
+}
+
+TEST_F(HugePageAllocatorTest, PacksSmallAllocationsIntoAChunk) {
+  SetHugePageMode(kTransparentHugePages);
+  std::vector<void*> pointers;
+  for (IntegerT i = 0; i < 100; ++i) {
+    pointers.push_back(HugePageAllocate(1000 + i, 32));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(pointers.back()) % 32, 0);
+    memset(pointers.back(), 1, 1000 + i);
+  }
+  for (void* const pointer : pointers) {
+    EXPECT_EQ(ChunkOf(pointer), ChunkOf(pointers[0]));
+  }
+  for (IntegerT i = 0; i < pointers.size(); ++i) {
+    HugePageDeallocate(pointers[i], 1000 + i, 32);
+  }
+}
+
+TEST_F(HugePageAllocatorTest, UnmapsLargeAllocationsWhenFreed) {
+  SetHugePageMode(kTransparentHugePages);
+  const IntegerT mapped_bytes = MappedBytes();
+  const size_t size = kHugePageSize + 1;
+  void* const pointer = HugePageAllocate(size, 8);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(pointer) % kHugePageSize, 0);
+  memset(pointer, 1, size);
+  EXPECT_EQ(MappedBytes(), mapped_bytes + 2 * kHugePageSize);
+  HugePageDeallocate(pointer, size, 8);
+  EXPECT_EQ(MappedBytes(), mapped_bytes);
+}
+
+TEST_F(HugePageAllocatorTest, FreesAcrossModeChanges) {
+  SetHugePageMode(kTransparentHugePages);
+  void* const pooled = HugePageAllocate(kHugePageSize, 8);
+  SetHugePageMode(kNoHugePages);
+  void* const unpooled = HugePageAllocate(100, 8);
+  const IntegerT mapped_bytes = MappedBytes();
+  HugePageDeallocate(pooled, kHugePageSize, 8);
+  EXPECT_EQ(MappedBytes(), mapped_bytes - kHugePageSize);
+  SetHugePageMode(kTransparentHugePages);
+  HugePageDeallocate(unpooled, 100, 8);
+}
+
+TEST_F(HugePageAllocatorTest, ExplicitHugePagesFallBack) {
+  SetHugePageMode(kExplicitHugePages);
+  const HugePageStats before = GetHugePageStats();
+  void* const pointer = HugePageAllocate(kHugePageSize, 8);
+  memset(pointer, 1, kHugePageSize);
+  const HugePageStats after = GetHugePageStats();
+  // Whether the system has huge pages reserved or not.
+  EXPECT_TRUE(after.explicit_bytes > before.explicit_bytes ||
+              after.num_fallbacks == before.num_fallbacks + 1);
+  HugePageDeallocate(pointer, kHugePageSize, 8);
+}
+
+TEST_F(HugePageAllocatorTest, CountsStrandedBytes) {
+  SetHugePageMode(kTransparentHugePages);
+  const IntegerT stranded_bytes = GetHugePageStats().stranded_bytes;
+  void* const first = HugePageAllocate(1000, 8);
+  void* const second = HugePageAllocate(3000, 8);
+  ASSERT_EQ(ChunkOf(first), ChunkOf(second));
+  HugePageDeallocate(first, 1000, 8);
+  EXPECT_EQ(GetHugePageStats().stranded_bytes, stranded_bytes + 1000);
+  HugePageDeallocate(second, 3000, 8);
+  EXPECT_EQ(GetHugePageStats().stranded_bytes, stranded_bytes);
+}
+
+TEST_F(HugePageAllocatorTest, ReusesTheAddressSpaceOfFreedChunks) {
+  SetHugePageMode(kTransparentHugePages);
+  const size_t size = 3 * kHugePageSize;
+  void* const pointer = HugePageAllocate(size, 8);
+  HugePageDeallocate(pointer, size, 8);
+  void* const reused = HugePageAllocate(size, 8);
+  EXPECT_EQ(reused, pointer);
+  memset(reused, 1, size);
+  HugePageDeallocate(reused, size, 8);
+}
+
+TEST_F(HugePageAllocatorTest, BacksVectors) {
+  for (const HugePageMode mode :
+       {kNoHugePages, kTransparentHugePages, kExplicitHugePages}) {
+    SetHugePageMode(mode);
+    HugePageVector<double> values;
+    for (IntegerT i = 0; i < 100000; ++i) values.push_back(i);
+    HugePageVector<double> copy = values;
+    for (IntegerT i = 0; i < 100000; ++i) EXPECT_EQ(copy[i], i);
+  }
+}
+
+struct Counted {
+  explicit Counted(IntegerT* num_alive) : num_alive(num_alive) {
+    ++*num_alive;
+  }
+  ~Counted() { --*num_alive; }
+  IntegerT* num_alive;
+};
+
+TEST_F(HugePageAllocatorTest, MakesUniquePointers) {
+  SetHugePageMode(kTransparentHugePages);
+  IntegerT num_alive = 0;
+  {
+    HugePageUniquePtr<Counted> counted =
+        MakeHugePageUnique<Counted>(&num_alive);
+    EXPECT_EQ(num_alive, 1);
+  }
+  EXPECT_EQ(num_alive, 0);
+}
+
+}  // namespace automl_zero
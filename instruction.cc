@@ -825,6 +825,18 @@ void Instruction::AlterData(RandomGenerator* rand_gen) {
   }
 }
 
+size_t Instruction::Hash() const {
+  size_t seed = static_cast<size_t>(op_);
+  HashCombine(seed, in1_);
+  HashCombine(seed, in2_);
+  HashCombine(seed, out_);
+  HashCombine(seed, activation_data_);
+  HashCombine(seed, float_data_0_);
+  HashCombine(seed, float_data_1_);
+  HashCombine(seed, float_data_2_);
+  return seed;
+}
+
 std::string Instruction::ToString() const {
   ostringstream stream;
   switch (op_) {
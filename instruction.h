@@ -158,6 +158,10 @@ class Instruction {
   std::string ToString() const;
   SerializedInstruction Serialize() const;
 
+  // Hashes all the fields of the instruction exactly, so instructions equal
+  // within the tolerance of the == operator may hash differently.
+  size_t Hash() const;
+
   void Deserialize(const SerializedInstruction& checkpoint_instruction);
 
   Op op_;
@@ -402,6 +402,28 @@ TEST(InstructionTest, EqualsOperatorConsidersStuffOtherThanOp) {
   }
 }
 
+TEST(InstructionTest, HashConsidersAllFields) {
+  Instruction instruction(VECTOR_SUM_OP, 1, 2, 3);
+  Instruction instruction_same(VECTOR_SUM_OP, 1, 2, 3);
+  EXPECT_EQ(instruction.Hash(), instruction_same.Hash());
+  EXPECT_NE(instruction.Hash(), Instruction(SCALAR_DIFF_OP, 1, 2, 3).Hash());
+  EXPECT_NE(instruction.Hash(), Instruction(VECTOR_SUM_OP, 2, 1, 3).Hash());
+  EXPECT_NE(instruction.Hash(), Instruction(VECTOR_SUM_OP, 1, 2, 2).Hash());
+
+  RandomGenerator rand_gen;
+  for (Op op : TestableOps()) {
+    Instruction instr;
+    instr.SetOpAndRandomizeParams(op, &rand_gen);
+    Instruction same_instr(instr);
+    EXPECT_EQ(instr.Hash(), same_instr.Hash());
+    Instruction other_instr(instr);
+    other_instr.AlterParam(&rand_gen);
+    if (!Differences(instr, other_instr).empty()) {
+      EXPECT_NE(instr.Hash(), other_instr.Hash());
+    }
+  }
+}
+
 TEST(InstructionTest, RandomizesIn1) {
   CHECK_GE(kMaxScalarAddresses, 4);
   CHECK_GE(kMaxVectorAddresses, 3);
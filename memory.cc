@@ -17,11 +17,15 @@
 namespace automl_zero {
 
 // Define here all the class-instances of the template that will be compiled.
-// Bigger than 32 leads to allocs too large for dense-storage in Eigen in stack.
+// Bigger than 32 leads to allocs too large for dense-storage in Eigen in stack,
+// so the matrices of the larger sizes are heap-allocated (see Matrix<F>).
 template class Memory<2>;
 template class Memory<4>;
 template class Memory<8>;
 template class Memory<16>;
 template class Memory<32>;
+template class Memory<64>;
+template class Memory<128>;
+template class Memory<256>;
 
 }  // namespace automl_zero
@@ -16,6 +16,7 @@
 #define AUTOML_ZERO_MEMORY_H_
 
 #include <array>
+#include <bitset>
 
 #include "definitions.h"
 #include "absl/flags/flag.h"
@@ -36,12 +37,30 @@ class Memory {
   // Sets the Scalars, Vectors and Matrices to zero. Serves as a way to
   // initialize the memory.
   void Wipe();
+
+  // Like Wipe(), but only sets the matrices at the given addresses to zero.
+  // The other matrices are left uninitialized, so they must not be read. Above
+  // kMaxFixedSizeMatrixFeatures, where the matrices are large and
+  // heap-allocated, this avoids writing (and faulting in) the matrices that
+  // an algorithm never uses.
+  void Wipe(const std::bitset<kMaxMatrixAddresses>& matrix_addresses);
+
+  // Copies the Scalars, the Vectors and the Matrices at the given addresses
+  // from `other`. The other Matrices are left as they are.
+  void CopyFrom(const Memory& other,
+                const std::bitset<kMaxMatrixAddresses>& matrix_addresses);
+
   void Display();
 
   // Three typed-memory spaces.
   ::std::array<Scalar, kMaxScalarAddresses> scalar_;
   ::std::array<Vector<F>, kMaxVectorAddresses> vector_;
   ::std::array<Matrix<F>, kMaxMatrixAddresses> matrix_;
+
+  // Scratch space for the output of a matrix product, which is then swapped
+  // into matrix_. Lets the products of heap-allocated matrices be computed
+  // without aliasing and without allocating a temporary.
+  Matrix<F> product_buffer_;
 };
 
 // Does NOT serve as a way to initialize the Memory.
@@ -55,6 +74,7 @@ Memory<F>::Memory() {
   for (Matrix<F>& value : matrix_) {
     value.resize(F, F);
   }
+  product_buffer_.resize(F, F);
 }
 
 template<FeatureIndexT F>
@@ -70,6 +90,34 @@ void Memory<F>::Wipe() {
   }
 }
 
+template<FeatureIndexT F>
+void Memory<F>::Wipe(const std::bitset<kMaxMatrixAddresses>& matrix_addresses) {
+  for (Scalar& value : scalar_) {
+    value = 0.0;
+  }
+  for (Vector<F>& value : vector_) {
+    value.setZero();
+  }
+  for (AddressT address = 0; address < kMaxMatrixAddresses; ++address) {
+    if (matrix_addresses.test(address)) {
+      matrix_[address].setZero();
+    }
+  }
+}
+
+template<FeatureIndexT F>
+void Memory<F>::CopyFrom(
+    const Memory& other,
+    const std::bitset<kMaxMatrixAddresses>& matrix_addresses) {
+  scalar_ = other.scalar_;
+  vector_ = other.vector_;
+  for (AddressT address = 0; address < kMaxMatrixAddresses; ++address) {
+    if (matrix_addresses.test(address)) {
+      matrix_[address] = other.matrix_[address];
+    }
+  }
+}
+
 template<FeatureIndexT F>
 void Memory<F>::Display() {
     for (Scalar& value : scalar_) {
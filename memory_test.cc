@@ -14,6 +14,7 @@
 
 #include "memory.h"
 
+#include <bitset>
 #include <cassert>
 #include <iostream>
 
@@ -61,4 +62,30 @@ TEST(MemoryTest, RespectsFeaturesSize) {
   EXPECT_EQ(memory8.matrix_[0].cols(), 8);
 }
 
+TEST(MemoryTest, SupportsLargeFeaturesSize) {
+  Memory<128> memory;
+  EXPECT_EQ(memory.vector_[0].size(), 128);
+  EXPECT_EQ(memory.matrix_[0].rows(), 128);
+  EXPECT_EQ(memory.matrix_[0].cols(), 128);
+  EXPECT_EQ(memory.product_buffer_.rows(), 128);
+  EXPECT_EQ(memory.product_buffer_.cols(), 128);
+}
+
+TEST(MemoryTest, WipesSelectedMatrices) {
+  Memory<64> memory;
+  memory.scalar_[1] = 2.0;
+  memory.vector_[1](2, 0) = 4.0;
+  memory.matrix_[1].setConstant(0.5);
+  memory.matrix_[2].setConstant(0.5);
+
+  std::bitset<kMaxMatrixAddresses> matrix_addresses;
+  matrix_addresses.set(1);
+  memory.Wipe(matrix_addresses);
+  EXPECT_EQ(memory.scalar_[1], 0.0);
+  EXPECT_EQ(memory.vector_[1](2, 0), 0.0);
+  EXPECT_TRUE(memory.matrix_[1].isZero(0.0));
+  // Not selected, so left as is.
+  EXPECT_EQ(memory.matrix_[2](3, 4), 0.5);
+}
+
 }  // namespace automl_zero
@@ -0,0 +1,481 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+using ::std::map;  // NOLINT
+using ::std::ostream;  // NOLINT
+using ::std::string;  // NOLINT
+using ::std::vector;  // NOLINT
+using ::std::chrono::milliseconds;  // NOLINT
+using ::std::chrono::steady_clock;  // NOLINT
+
+namespace {
+
+// Adds `value` to an atomic double.
+void AtomicAdd(std::atomic<double>* sum, double value) {
+  double current = sum->load(std::memory_order_relaxed);
+  while (!sum->compare_exchange_weak(current, current + value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+string Escape(const string& value) {
+  string escaped;
+  for (const char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// JSON has no infinities or NaNs.
+void WriteJsonNumber(double value, ostream* output) {
+  if (std::isfinite(value)) {
+    *output << value;
+  } else {
+    *output << "null";
+  }
+}
+
+void WritePrometheusNumber(double value, ostream* output) {
+  if (std::isnan(value)) {
+    *output << "NaN";
+  } else if (std::isinf(value)) {
+    *output << (value > 0.0 ? "+Inf" : "-Inf");
+  } else {
+    *output << value;
+  }
+}
+
+void WriteJsonLabels(const MetricLabels& labels, ostream* output) {
+  *output << "{";
+  bool first = true;
+  for (const auto& label : labels) {
+    if (!first) *output << ",";
+    first = false;
+    *output << "\"" << Escape(label.first) << "\":\""
+            << Escape(label.second) << "\"";
+  }
+  *output << "}";
+}
+
+// Writes `{name="value",...}`, with `extra` appended, or nothing if there are
+// no labels.
+void WritePrometheusLabels(const MetricLabels& labels, const string& extra,
+                           ostream* output) {
+  if (labels.empty() && extra.empty()) return;
+  *output << "{";
+  bool first = true;
+  for (const auto& label : labels) {
+    if (!first) *output << ",";
+    first = false;
+    *output << label.first << "=\"" << Escape(label.second) << "\"";
+  }
+  if (!extra.empty()) {
+    if (!first) *output << ",";
+    *output << extra;
+  }
+  *output << "}";
+}
+
+// A key identifying a counter, to compute its rate between flushes.
+string CounterKey(const string& name, const MetricLabels& labels) {
+  std::ostringstream key;
+  key << name;
+  WriteJsonLabels(labels, &key);
+  return key.str();
+}
+
+}  // namespace
+
+Histogram::Histogram(vector<double> upper_bounds)
+    : upper_bounds_(std::move(upper_bounds)),
+      bucket_counts_(new std::atomic<IntegerT>[upper_bounds_.size() + 1]),
+      count_(0),
+      sum_(0.0) {
+  for (size_t i = 1; i < upper_bounds_.size(); ++i) {
+    CHECK_LT(upper_bounds_[i - 1], upper_bounds_[i]);
+  }
+  for (size_t i = 0; i <= upper_bounds_.size(); ++i) {
+    bucket_counts_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::Observe(const double value) {
+  const size_t bucket =
+      std::lower_bound(upper_bounds_.begin(), upper_bounds_.end(), value) -
+      upper_bounds_.begin();
+  bucket_counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  AtomicAdd(&sum_, value);
+}
+
+vector<IntegerT> Histogram::BucketCounts() const {
+  vector<IntegerT> counts(upper_bounds_.size() + 1);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    counts[i] = bucket_counts_[i].load(std::memory_order_relaxed);
+  }
+  return counts;
+}
+
+IntegerT Histogram::Count() const {
+  return count_.load(std::memory_order_relaxed);
+}
+
+double Histogram::Sum() const { return sum_.load(std::memory_order_relaxed); }
+
+vector<double> ExponentialBuckets(const double start, const double factor,
+                                  const IntegerT num_buckets) {
+  CHECK_GT(start, 0.0);
+  CHECK_GT(factor, 1.0);
+  vector<double> upper_bounds;
+  double bound = start;
+  for (IntegerT i = 0; i < num_buckets; ++i) {
+    upper_bounds.push_back(bound);
+    bound *= factor;
+  }
+  return upper_bounds;
+}
+
+MetricsRegistry::Family* MetricsRegistry::GetFamily(
+    const string& name, const MetricType type, const string& help,
+    const vector<double>& upper_bounds) {
+  auto inserted = families_.emplace(name, Family());
+  Family* family = &inserted.first->second;
+  if (inserted.second) {
+    family->type = type;
+    family->help = help;
+    family->upper_bounds = upper_bounds;
+  } else {
+    CHECK(family->type == type) << "Metric " << name << " changed type.";
+    CHECK(family->upper_bounds == upper_bounds)
+        << "Metric " << name << " changed buckets.";
+  }
+  return family;
+}
+
+Counter* MetricsRegistry::GetCounter(const string& name, const string& help,
+                                     const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<Counter>& counter =
+      GetFamily(name, kCounter, help, {})->counters[labels];
+  if (counter == nullptr) counter.reset(new Counter());
+  return counter.get();
+}
+
+Gauge* MetricsRegistry::GetGauge(const string& name, const string& help,
+                                 const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<Gauge>& gauge =
+      GetFamily(name, kGauge, help, {})->gauges[labels];
+  if (gauge == nullptr) gauge.reset(new Gauge());
+  return gauge.get();
+}
+
+Histogram* MetricsRegistry::GetHistogram(const string& name,
+                                         const string& help,
+                                         const vector<double>& upper_bounds,
+                                         const MetricLabels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<Histogram>& histogram =
+      GetFamily(name, kHistogram, help, upper_bounds)->histograms[labels];
+  if (histogram == nullptr) histogram.reset(new Histogram(upper_bounds));
+  return histogram.get();
+}
+
+void MetricsRegistry::WriteJsonLine(const double timestamp_secs,
+                                    const double interval_secs,
+                                    map<string, IntegerT>* previous_counters,
+                                    ostream* output) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream line;
+  line << std::setprecision(10);
+  line << "{\"timestamp_secs\":" << timestamp_secs << ",\"metrics\":[";
+  bool first = true;
+  auto begin_metric = [&](const string& name, const MetricLabels& labels) {
+    if (!first) line << ",";
+    first = false;
+    line << "{\"name\":\"" << Escape(name) << "\",\"labels\":";
+    WriteJsonLabels(labels, &line);
+  };
+  for (const auto& name_family : families_) {
+    const string& name = name_family.first;
+    const Family& family = name_family.second;
+    for (const auto& labels_counter : family.counters) {
+      const IntegerT value = labels_counter.second->Value();
+      begin_metric(name, labels_counter.first);
+      line << ",\"value\":" << value;
+      IntegerT& previous =
+          (*previous_counters)[CounterKey(name, labels_counter.first)];
+      if (interval_secs > 0.0) {
+        line << ",\"rate\":";
+        WriteJsonNumber((value - previous) / interval_secs, &line);
+      }
+      previous = value;
+      line << "}";
+    }
+    for (const auto& labels_gauge : family.gauges) {
+      begin_metric(name, labels_gauge.first);
+      line << ",\"value\":";
+      WriteJsonNumber(labels_gauge.second->Value(), &line);
+      line << "}";
+    }
+    for (const auto& labels_histogram : family.histograms) {
+      const Histogram& histogram = *labels_histogram.second;
+      begin_metric(name, labels_histogram.first);
+      line << ",\"count\":" << histogram.Count() << ",\"sum\":";
+      WriteJsonNumber(histogram.Sum(), &line);
+      line << ",\"upper_bounds\":[";
+      for (size_t i = 0; i < histogram.UpperBounds().size(); ++i) {
+        if (i > 0) line << ",";
+        line << histogram.UpperBounds()[i];
+      }
+      line << "],\"bucket_counts\":[";
+      const vector<IntegerT> counts = histogram.BucketCounts();
+      for (size_t i = 0; i < counts.size(); ++i) {
+        if (i > 0) line << ",";
+        line << counts[i];
+      }
+      line << "]}";
+    }
+  }
+  line << "]}\n";
+  *output << line.str();
+}
+
+void MetricsRegistry::WritePrometheusText(ostream* output) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream text;
+  text << std::setprecision(10);
+  for (const auto& name_family : families_) {
+    const string& name = name_family.first;
+    const Family& family = name_family.second;
+    text << "# HELP " << name << " " << family.help << "\n";
+    switch (family.type) {
+      case kCounter:
+        text << "# TYPE " << name << " counter\n";
+        for (const auto& labels_counter : family.counters) {
+          text << name;
+          WritePrometheusLabels(labels_counter.first, "", &text);
+          text << " " << labels_counter.second->Value() << "\n";
+        }
+        break;
+      case kGauge:
+        text << "# TYPE " << name << " gauge\n";
+        for (const auto& labels_gauge : family.gauges) {
+          text << name;
+          WritePrometheusLabels(labels_gauge.first, "", &text);
+          text << " ";
+          WritePrometheusNumber(labels_gauge.second->Value(), &text);
+          text << "\n";
+        }
+        break;
+      case kHistogram:
+        text << "# TYPE " << name << " histogram\n";
+        for (const auto& labels_histogram : family.histograms) {
+          const MetricLabels& labels = labels_histogram.first;
+          const Histogram& histogram = *labels_histogram.second;
+          const vector<IntegerT> counts = histogram.BucketCounts();
+          IntegerT cumulative = 0;
+          for (size_t i = 0; i < counts.size(); ++i) {
+            cumulative += counts[i];
+            std::ostringstream le;
+            le << std::setprecision(10) << "le=\"";
+            WritePrometheusNumber(i < histogram.UpperBounds().size()
+                                      ? histogram.UpperBounds()[i]
+                                      : HUGE_VAL,
+                                  &le);
+            le << "\"";
+            text << name << "_bucket";
+            WritePrometheusLabels(labels, le.str(), &text);
+            text << " " << cumulative << "\n";
+          }
+          text << name << "_sum";
+          WritePrometheusLabels(labels, "", &text);
+          text << " ";
+          WritePrometheusNumber(histogram.Sum(), &text);
+          text << "\n" << name << "_count";
+          WritePrometheusLabels(labels, "", &text);
+          text << " " << histogram.Count() << "\n";
+        }
+        break;
+    }
+  }
+  *output << text.str();
+}
+
+MetricsFormat ParseMetricsFormat(const string& format) {
+  if (format == "jsonl") return kJsonLinesMetrics;
+  if (format == "prometheus") return kPrometheusTextMetrics;
+  LOG(FATAL) << "Unknown metrics format: " << format << std::endl;
+}
+
+MetricsExporter::MetricsExporter(const MetricsRegistry* registry,
+                                 string path, const MetricsFormat format,
+                                 const milliseconds flush_interval)
+    : registry_(registry),
+      path_(std::move(path)),
+      format_(format),
+      flush_interval_(flush_interval),
+      start_time_(steady_clock::now()),
+      last_flush_time_(start_time_),
+      stop_(false) {
+  CHECK(registry_ != nullptr);
+  CHECK_GT(flush_interval_.count(), 0);
+  if (format_ == kJsonLinesMetrics) {
+    // Start a new stream rather than appending to a previous run's.
+    std::ofstream output(path_, std::ios::trunc);
+    CHECK(output.good()) << "Could not open " << path_ << std::endl;
+  }
+  thread_ = std::thread(&MetricsExporter::Run, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+  {
+    std::lock_guard<std::mutex> lock(stop_mutex_);
+    stop_ = true;
+  }
+  stop_condition_.notify_all();
+  thread_.join();
+  Flush();
+}
+
+void MetricsExporter::Flush() {
+  std::lock_guard<std::mutex> lock(flush_mutex_);
+  const steady_clock::time_point now = steady_clock::now();
+  const double timestamp_secs =
+      std::chrono::duration<double>(now - start_time_).count();
+  const double interval_secs =
+      std::chrono::duration<double>(now - last_flush_time_).count();
+  last_flush_time_ = now;
+  switch (format_) {
+    case kJsonLinesMetrics: {
+      std::ofstream output(path_, std::ios::app);
+      registry_->WriteJsonLine(timestamp_secs, interval_secs,
+                               &previous_counters_, &output);
+      if (!output.good()) LOG(ERROR) << "Could not write " << path_;
+      break;
+    }
+    case kPrometheusTextMetrics: {
+      // Readers must never see a partially written file.
+      const string temp_path = path_ + ".tmp";
+      {
+        std::ofstream output(temp_path, std::ios::trunc);
+        registry_->WritePrometheusText(&output);
+        if (!output.good()) {
+          LOG(ERROR) << "Could not write " << temp_path;
+          return;
+        }
+      }
+      if (std::rename(temp_path.c_str(), path_.c_str()) != 0) {
+        LOG(ERROR) << "Could not rename " << temp_path << " to " << path_;
+      }
+      break;
+    }
+  }
+}
+
+void MetricsExporter::Run() {
+  std::unique_lock<std::mutex> lock(stop_mutex_);
+  while (!stop_) {
+    if (stop_condition_.wait_for(lock, flush_interval_,
+                                 [this] { return stop_; })) {
+      break;
+    }
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
+
+SearchMetrics::SearchMetrics(MetricsRegistry* registry,
+                             const IntegerT experiment) {
+  CHECK(registry != nullptr);
+  const MetricLabels labels = {{"experiment", std::to_string(experiment)}};
+  const vector<double> secs_buckets = ExponentialBuckets(0.0001, 4.0, 12);
+  evaluations = registry->GetCounter(
+      "moaz_evaluations_total", "Individuals evaluated.", labels);
+  train_steps = registry->GetCounter(
+      "moaz_train_steps_total", "Train steps executed.", labels);
+  functional_cache_hits = registry->GetCounter(
+      "moaz_functional_cache_hits_total",
+      "Task evaluations answered by the functional equivalence cache.",
+      labels);
+  functional_cache_misses = registry->GetCounter(
+      "moaz_functional_cache_misses_total",
+      "Task evaluations missing the functional equivalence cache.", labels);
+  timeouts = registry->GetCounter(
+      "moaz_timeouts_total",
+      "Evaluations ended for going over the watchdog limits.", labels);
+  generations = registry->GetCounter(
+      "moaz_generations_total", "Generations completed.", labels);
+  front_size = registry->GetGauge(
+      "moaz_front_size", "Algorithms in the Pareto archive.", labels);
+  hypervolume = registry->GetGauge(
+      "moaz_hypervolume", "Hypervolume of the Pareto archive.", labels);
+  best_error = registry->GetGauge(
+      "moaz_best_error", "Lowest error found so far.", labels);
+  variation_secs = registry->GetHistogram(
+      "moaz_variation_seconds",
+      "Time per generation spent selecting parents and crossing them over.",
+      secs_buckets, labels);
+  evaluation_secs = registry->GetHistogram(
+      "moaz_evaluation_seconds",
+      "Time per generation spent mutating and evaluating the children.",
+      secs_buckets, labels);
+  selection_secs = registry->GetHistogram(
+      "moaz_selection_seconds",
+      "Time per generation spent selecting the survivors.", secs_buckets,
+      labels);
+  generation_secs = registry->GetHistogram(
+      "moaz_generation_seconds", "Time per generation.", secs_buckets,
+      labels);
+  const std::string huge_page_help =
+      "Bytes mapped by the huge page allocator, by backing.";
+  explicit_huge_page_bytes = registry->GetGauge(
+      "moaz_huge_page_allocator_bytes", huge_page_help,
+      {{"backing", "explicit"}});
+  transparent_huge_page_bytes = registry->GetGauge(
+      "moaz_huge_page_allocator_bytes", huge_page_help,
+      {{"backing", "transparent"}});
+  regular_page_bytes = registry->GetGauge(
+      "moaz_huge_page_allocator_bytes", huge_page_help,
+      {{"backing", "regular"}});
+  stranded_huge_page_bytes = registry->GetGauge(
+      "moaz_huge_page_allocator_stranded_bytes",
+      "Bytes freed in the chunks of the huge page allocator that cannot be "
+      "reused until the rest of their chunk is freed.",
+      {});
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,228 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_METRICS_H_
+#define AUTOML_ZERO_METRICS_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <ostream>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "definitions.h"
+
+namespace automl_zero {
+
+// Metrics that a search updates as it runs and that a MetricsExporter writes
+// out from a background thread. Updating a metric is a few relaxed atomic
+// operations and never blocks, so the search only pays for the metrics it
+// updates, and never for the formatting or the I/O.
+
+// A monotonically increasing count.
+class Counter {
+ public:
+  Counter() : value_(0) {}
+  Counter(const Counter& other) = delete;
+  Counter& operator=(const Counter& other) = delete;
+
+  void Add(IntegerT delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+  IntegerT Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<IntegerT> value_;
+};
+
+// A value that can go up and down.
+class Gauge {
+ public:
+  Gauge() : value_(0.0) {}
+  Gauge(const Gauge& other) = delete;
+  Gauge& operator=(const Gauge& other) = delete;
+
+  void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+  double Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<double> value_;
+};
+
+// The distribution of observed values, in fixed buckets.
+class Histogram {
+ public:
+  // `upper_bounds` must be increasing. Values above the last bound are
+  // counted in an extra overflow bucket.
+  explicit Histogram(std::vector<double> upper_bounds);
+  Histogram(const Histogram& other) = delete;
+  Histogram& operator=(const Histogram& other) = delete;
+
+  void Observe(double value);
+
+  const std::vector<double>& UpperBounds() const { return upper_bounds_; }
+  // The number of values in each bucket (not cumulative), including the
+  // overflow bucket.
+  std::vector<IntegerT> BucketCounts() const;
+  IntegerT Count() const;
+  double Sum() const;
+
+ private:
+  const std::vector<double> upper_bounds_;
+  std::unique_ptr<std::atomic<IntegerT>[]> bucket_counts_;
+  std::atomic<IntegerT> count_;
+  std::atomic<double> sum_;
+};
+
+// `num_buckets` bounds starting at `start` and growing by `factor`.
+std::vector<double> ExponentialBuckets(double start, double factor,
+                                       IntegerT num_buckets);
+
+// Label names and values that distinguish metrics with the same name.
+typedef std::map<std::string, std::string> MetricLabels;
+
+// Owns the metrics, by name and labels.
+//
+// Thread-safe. Looking a metric up takes a lock, so it is meant to be done
+// once at setup; the returned metrics can then be updated lock-free.
+class MetricsRegistry {
+ public:
+  MetricsRegistry() {}
+  MetricsRegistry(const MetricsRegistry& other) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry& other) = delete;
+
+  // Return the metric with the given name and labels, creating it on first
+  // use. A name always refers to the same kind of metric, with the same help
+  // and bucket bounds. The metrics live as long as the registry.
+  Counter* GetCounter(const std::string& name, const std::string& help,
+                      const MetricLabels& labels = {});
+  Gauge* GetGauge(const std::string& name, const std::string& help,
+                  const MetricLabels& labels = {});
+  Histogram* GetHistogram(const std::string& name, const std::string& help,
+                          const std::vector<double>& upper_bounds,
+                          const MetricLabels& labels = {});
+
+  // Writes the current values as a single JSON object, on one line. Counters
+  // also get their rate of increase since `previous_counters`, over
+  // `interval_secs` seconds, and `previous_counters` is updated.
+  void WriteJsonLine(double timestamp_secs, double interval_secs,
+                     std::map<std::string, IntegerT>* previous_counters,
+                     std::ostream* output) const;
+
+  // Writes the current values in the Prometheus text exposition format.
+  void WritePrometheusText(std::ostream* output) const;
+
+ private:
+  enum MetricType { kCounter, kGauge, kHistogram };
+  struct Family {
+    MetricType type;
+    std::string help;
+    std::vector<double> upper_bounds;
+    std::map<MetricLabels, std::unique_ptr<Counter>> counters;
+    std::map<MetricLabels, std::unique_ptr<Gauge>> gauges;
+    std::map<MetricLabels, std::unique_ptr<Histogram>> histograms;
+  };
+
+  Family* GetFamily(const std::string& name, MetricType type,
+                    const std::string& help,
+                    const std::vector<double>& upper_bounds);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+};
+
+enum MetricsFormat {
+  // One JSON object per flush, appended to the file.
+  kJsonLinesMetrics = 0,
+  // The Prometheus text format, replacing the file on every flush, e.g. for
+  // the textfile collector of the node exporter.
+  kPrometheusTextMetrics = 1
+};
+
+// Parses "jsonl" or "prometheus".
+MetricsFormat ParseMetricsFormat(const std::string& format);
+
+// Writes the metrics of a registry to a file every `flush_interval`, from a
+// background thread.
+class MetricsExporter {
+ public:
+  // The registry must outlive the exporter.
+  MetricsExporter(const MetricsRegistry* registry, std::string path,
+                  MetricsFormat format,
+                  std::chrono::milliseconds flush_interval);
+  MetricsExporter(const MetricsExporter& other) = delete;
+  MetricsExporter& operator=(const MetricsExporter& other) = delete;
+
+  // Flushes one last time.
+  ~MetricsExporter();
+
+  // Writes the metrics now.
+  void Flush();
+
+ private:
+  void Run();
+
+  const MetricsRegistry* registry_;
+  const std::string path_;
+  const MetricsFormat format_;
+  const std::chrono::milliseconds flush_interval_;
+  const std::chrono::steady_clock::time_point start_time_;
+
+  // Guards the file and the state of the last flush.
+  std::mutex flush_mutex_;
+  std::chrono::steady_clock::time_point last_flush_time_;
+  std::map<std::string, IntegerT> previous_counters_;
+
+  std::mutex stop_mutex_;
+  std::condition_variable stop_condition_;
+  bool stop_;
+  std::thread thread_;
+};
+
+// The metrics of one search experiment, labeled with its index.
+struct SearchMetrics {
+  SearchMetrics(MetricsRegistry* registry, IntegerT experiment);
+
+  Counter* evaluations;
+  Counter* train_steps;
+  Counter* functional_cache_hits;
+  Counter* functional_cache_misses;
+  // Evaluations ended by the ExecutionWatchdog.
+  Counter* timeouts;
+  Counter* generations;
+  // The size of the Pareto archive.
+  Gauge* front_size;
+  Gauge* hypervolume;
+  Gauge* best_error;
+  // Seconds spent in each phase of a generation.
+  Histogram* variation_secs;
+  Histogram* evaluation_secs;
+  Histogram* selection_secs;
+  Histogram* generation_secs;
+  // The memory mapped by the HugePageAllocator, by how it is backed. Not
+  // labeled with the experiment, as the experiments share it.
+  Gauge* explicit_huge_page_bytes;
+  Gauge* transparent_huge_page_bytes;
+  Gauge* regular_page_bytes;
+  // The freed bytes it cannot reuse yet. See HugePageStats.
+  Gauge* stranded_huge_page_bytes;
+};
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_METRICS_H_
@@ -0,0 +1,219 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "metrics.h"
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "definitions.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::string;
+using ::std::vector;
+
+string ReadFile(const string& path) {
+  std::ifstream input(path);
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
+IntegerT CountLines(const string& text) {
+  IntegerT lines = 0;
+  for (const char c : text) {
+    if (c == '\n') ++lines;
+  }
+  return lines;
+}
+
+TEST(MetricsTest, CountersAddUpAcrossThreads) {
+  Counter counter;
+  vector<std::thread> threads;
+  for (IntegerT i = 0; i < 4; ++i) {
+    threads.emplace_back([&counter]() {
+      for (IntegerT j = 0; j < 10000; ++j) counter.Add(1);
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(counter.Value(), 40000);
+}
+
+TEST(MetricsTest, GaugeKeepsTheLastValue) {
+  Gauge gauge;
+  EXPECT_EQ(gauge.Value(), 0.0);
+  gauge.Set(2.5);
+  gauge.Set(1.5);
+  EXPECT_EQ(gauge.Value(), 1.5);
+}
+
+TEST(MetricsTest, HistogramBuckets) {
+  Histogram histogram({1.0, 2.0, 4.0});
+  histogram.Observe(0.5);
+  histogram.Observe(1.0);
+  histogram.Observe(3.0);
+  histogram.Observe(10.0);
+  EXPECT_EQ(histogram.BucketCounts(), vector<IntegerT>({2, 0, 1, 1}));
+  EXPECT_EQ(histogram.Count(), 4);
+  EXPECT_DOUBLE_EQ(histogram.Sum(), 14.5);
+}
+
+TEST(MetricsTest, HistogramAddsUpAcrossThreads) {
+  Histogram histogram(ExponentialBuckets(1.0, 2.0, 4));
+  vector<std::thread> threads;
+  for (IntegerT i = 0; i < 4; ++i) {
+    threads.emplace_back([&histogram]() {
+      for (IntegerT j = 0; j < 10000; ++j) histogram.Observe(3.0);
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(histogram.Count(), 40000);
+  EXPECT_DOUBLE_EQ(histogram.Sum(), 120000.0);
+  EXPECT_EQ(histogram.BucketCounts(), vector<IntegerT>({0, 0, 40000, 0, 0}));
+}
+
+TEST(MetricsTest, ExponentialBuckets) {
+  EXPECT_EQ(ExponentialBuckets(0.5, 4.0, 3), vector<double>({0.5, 2.0, 8.0}));
+}
+
+TEST(MetricsTest, RegistryReturnsTheSameMetric) {
+  MetricsRegistry registry;
+  Counter* counter = registry.GetCounter("c", "A counter.", {{"k", "1"}});
+  EXPECT_EQ(registry.GetCounter("c", "A counter.", {{"k", "1"}}), counter);
+  EXPECT_NE(registry.GetCounter("c", "A counter.", {{"k", "2"}}), counter);
+}
+
+TEST(MetricsTest, WritesJsonLines) {
+  MetricsRegistry registry;
+  registry.GetCounter("evals", "Evaluations.", {{"experiment", "0"}})->Add(10);
+  registry.GetGauge("size", "Size.")->Set(3.0);
+  registry.GetHistogram("secs", "Seconds.", {1.0})->Observe(0.5);
+  std::map<string, IntegerT> previous_counters;
+  std::ostringstream output;
+  registry.WriteJsonLine(1.0, 2.0, &previous_counters, &output);
+  EXPECT_EQ(output.str(),
+            "{\"timestamp_secs\":1,\"metrics\":["
+            "{\"name\":\"evals\",\"labels\":{\"experiment\":\"0\"},"
+            "\"value\":10,\"rate\":5},"
+            "{\"name\":\"secs\",\"labels\":{},\"count\":1,\"sum\":0.5,"
+            "\"upper_bounds\":[1],\"bucket_counts\":[1,0]},"
+            "{\"name\":\"size\",\"labels\":{},\"value\":3}]}\n");
+
+  // The rate is computed since the previous line.
+  registry.GetCounter("evals", "Evaluations.", {{"experiment", "0"}})->Add(4);
+  std::ostringstream next_output;
+  registry.WriteJsonLine(3.0, 2.0, &previous_counters, &next_output);
+  EXPECT_NE(next_output.str().find("\"value\":14,\"rate\":2}"), string::npos);
+}
+
+TEST(MetricsTest, WritesPrometheusText) {
+  MetricsRegistry registry;
+  registry.GetCounter("evals", "Evaluations.", {{"experiment", "0"}})->Add(10);
+  registry.GetGauge("size", "Size.")->Set(3.0);
+  Histogram* histogram =
+      registry.GetHistogram("secs", "Seconds.", {1.0, 2.0}, {{"e", "1"}});
+  histogram->Observe(0.5);
+  histogram->Observe(1.5);
+  histogram->Observe(5.0);
+  std::ostringstream output;
+  registry.WritePrometheusText(&output);
+  EXPECT_EQ(output.str(),
+            "# HELP evals Evaluations.\n"
+            "# TYPE evals counter\n"
+            "evals{experiment=\"0\"} 10\n"
+            "# HELP secs Seconds.\n"
+            "# TYPE secs histogram\n"
+            "secs_bucket{e=\"1\",le=\"1\"} 1\n"
+            "secs_bucket{e=\"1\",le=\"2\"} 2\n"
+            "secs_bucket{e=\"1\",le=\"+Inf\"} 3\n"
+            "secs_sum{e=\"1\"} 7\n"
+            "secs_count{e=\"1\"} 3\n"
+            "# HELP size Size.\n"
+            "# TYPE size gauge\n"
+            "size 3\n");
+}
+
+TEST(MetricsTest, ExporterFlushesPeriodicallyAndAtTheEnd) {
+  const string path = ::testing::TempDir() + "/metrics_test.jsonl";
+  MetricsRegistry registry;
+  Counter* counter = registry.GetCounter("evals", "Evaluations.");
+  {
+    MetricsExporter exporter(&registry, path, kJsonLinesMetrics,
+                             std::chrono::milliseconds(10));
+    counter->Add(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    counter->Add(1);
+  }
+  const string contents = ReadFile(path);
+  EXPECT_GE(CountLines(contents), 2);
+  // The last line was written by the destructor.
+  const string last_line = contents.substr(
+      contents.rfind('\n', contents.size() - 2) + 1);
+  EXPECT_NE(last_line.find("\"value\":2"), string::npos);
+  std::remove(path.c_str());
+}
+
+TEST(MetricsTest, ExporterReplacesPrometheusFile) {
+  const string path = ::testing::TempDir() + "/metrics_test.prom";
+  MetricsRegistry registry;
+  Counter* counter = registry.GetCounter("evals", "Evaluations.");
+  MetricsExporter exporter(&registry, path, kPrometheusTextMetrics,
+                           std::chrono::hours(1));
+  counter->Add(1);
+  exporter.Flush();
+  EXPECT_NE(ReadFile(path).find("evals 1\n"), string::npos);
+  counter->Add(1);
+  exporter.Flush();
+  EXPECT_EQ(ReadFile(path).find("evals 1\n"), string::npos);
+  EXPECT_NE(ReadFile(path).find("evals 2\n"), string::npos);
+  std::remove(path.c_str());
+}
+
+TEST(MetricsTest, SearchMetricsAreLabeledByExperiment) {
+  MetricsRegistry registry;
+  SearchMetrics first(&registry, 0);
+  SearchMetrics second(&registry, 1);
+  EXPECT_NE(first.evaluations, second.evaluations);
+  first.evaluations->Add(3);
+  std::ostringstream output;
+  registry.WritePrometheusText(&output);
+  EXPECT_NE(output.str().find("moaz_evaluations_total{experiment=\"0\"} 3\n"),
+            string::npos);
+  EXPECT_NE(output.str().find("moaz_evaluations_total{experiment=\"1\"} 0\n"),
+            string::npos);
+}
+
+TEST(MetricsTest, ExperimentsShareTheHugePageGauges) {
+  MetricsRegistry registry;
+  SearchMetrics first(&registry, 0);
+  SearchMetrics second(&registry, 1);
+  EXPECT_EQ(first.transparent_huge_page_bytes,
+            second.transparent_huge_page_bytes);
+  first.transparent_huge_page_bytes->Set(4194304);
+  std::ostringstream output;
+  registry.WritePrometheusText(&output);
+  EXPECT_NE(output.str().find("moaz_huge_page_allocator_bytes{backing="
+                              "\"transparent\"} 4194304\n"),
+            string::npos);
+}
+
+}  // namespace automl_zero
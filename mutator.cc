@@ -25,7 +25,6 @@ namespace automl_zero {
 
 using ::absl::make_unique;  // NOLINT
 using ::std::endl;  // NOLINT
-using ::std::make_shared;  // NOLINT
 using ::std::mt19937;  // NOLINT
 using ::std::shared_ptr;  // NOLINT
 using ::std::vector;  // NOLINT
@@ -65,7 +64,8 @@ Mutator::Mutator(
           allowed_predict_ops_,
           allowed_learn_ops_,
           bit_gen_,
-          rand_gen_) {}
+          rand_gen_),
+      arena_(nullptr) {}
 
 vector<MutationType> ConvertToMutationType(
     const vector<IntegerT>& mutation_actions_as_ints) {
@@ -99,6 +99,17 @@ void Mutator::Mutate(const IntegerT num_mutations,
   }
 }
 
+void Mutator::Mutate(const IntegerT num_mutations, AlgorithmArena* arena,
+                     Algorithm* algorithm) {
+  if (mutate_prob_ >= 1.0 || rand_gen_->UniformProbability() < mutate_prob_) {
+    arena_ = arena;
+    for (IntegerT i = 0; i < num_mutations; ++i) {
+      MutateImpl(algorithm);
+    }
+    arena_ = nullptr;
+  }
+}
+
 Mutator::Mutator()
     : allowed_actions_(ParseTextFormat<MutationTypeList>(
         "mutation_types: [ "
@@ -131,7 +142,8 @@ Mutator::Mutator()
           allowed_predict_ops_,
           allowed_learn_ops_,
           bit_gen_,
-          rand_gen_) {}
+          rand_gen_),
+      arena_(nullptr) {}
 
 std::vector <std::pair<IntegerT, IntegerT>> Mutator::get_algo_len_limits(){
 	std::vector <std::pair<IntegerT, IntegerT>> algo_len;
@@ -146,8 +158,7 @@ std::vector <std::pair<IntegerT, IntegerT>> Mutator::get_algo_len_limits(){
 void Mutator::MutateImpl(Algorithm* algorithm) {
   CHECK(!allowed_actions_.mutation_types().empty());
   const size_t action_index =
-      absl::Uniform<size_t>(*bit_gen_, 0,
-                            allowed_actions_.mutation_types_size());
+      rand_gen_->Uniform<size_t>(0, allowed_actions_.mutation_types_size());
   const MutationType action = allowed_actions_.mutation_types(action_index);
   switch (action) {
     case ALTER_PARAM_MUTATION_TYPE:
@@ -183,8 +194,7 @@ void Mutator::AlterParam(Algorithm* algorithm) {
       if (!algorithm->setup_.empty()) {
         InstructionIndexT index = InstructionIndex(algorithm->setup_.size());
         algorithm->setup_[index] =
-            make_shared<const Instruction>(
-                *algorithm->setup_[index], rand_gen_);
+            NewInstruction(*algorithm->setup_[index], rand_gen_);
       }
       return;
     }
@@ -192,8 +202,7 @@ void Mutator::AlterParam(Algorithm* algorithm) {
       if (!algorithm->predict_.empty()) {
         InstructionIndexT index = InstructionIndex(algorithm->predict_.size());
         algorithm->predict_[index] =
-            make_shared<const Instruction>(
-                *algorithm->predict_[index], rand_gen_);
+            NewInstruction(*algorithm->predict_[index], rand_gen_);
       }
       return;
     }
@@ -201,8 +210,7 @@ void Mutator::AlterParam(Algorithm* algorithm) {
       if (!algorithm->learn_.empty()) {
         InstructionIndexT index = InstructionIndex(algorithm->learn_.size());
         algorithm->learn_[index] =
-            make_shared<const Instruction>(
-                *algorithm->learn_[index], rand_gen_);
+            NewInstruction(*algorithm->learn_[index], rand_gen_);
       }
       return;
     }
@@ -216,7 +224,7 @@ void Mutator::RandomizeInstruction(Algorithm* algorithm) {
       if (!algorithm->setup_.empty()) {
         InstructionIndexT index = InstructionIndex(algorithm->setup_.size());
         algorithm->setup_[index] =
-            make_shared<const Instruction>(SetupOp(), rand_gen_);
+            NewInstruction(SetupOp(), rand_gen_);
       }
       return;
     }
@@ -224,7 +232,7 @@ void Mutator::RandomizeInstruction(Algorithm* algorithm) {
       if (!algorithm->predict_.empty()) {
         InstructionIndexT index = InstructionIndex(algorithm->predict_.size());
         algorithm->predict_[index] =
-            make_shared<const Instruction>(PredictOp(), rand_gen_);
+            NewInstruction(PredictOp(), rand_gen_);
       }
       return;
     }
@@ -232,7 +240,7 @@ void Mutator::RandomizeInstruction(Algorithm* algorithm) {
       if (!algorithm->learn_.empty()) {
         InstructionIndexT index = InstructionIndex(algorithm->learn_.size());
         algorithm->learn_[index] =
-            make_shared<const Instruction>(LearnOp(), rand_gen_);
+            NewInstruction(LearnOp(), rand_gen_);
       }
       return;
     }
@@ -350,7 +358,7 @@ void Mutator::InsertInstructionUnconditionally(
       InstructionIndex(component_function->size() + 1);
   component_function->insert(
       component_function->begin() + position,
-      make_shared<const Instruction>(op, rand_gen_));
+      NewInstruction(op, rand_gen_));
 }
 
 void Mutator::RemoveInstructionUnconditionally(
@@ -362,27 +370,26 @@ void Mutator::RemoveInstructionUnconditionally(
 }
 
 Op Mutator::SetupOp() {
-  IntegerT op_index = absl::Uniform<DeprecatedOpIndexT>(
-      *bit_gen_, 0, allowed_setup_ops_.size());
+  IntegerT op_index = rand_gen_->Uniform<DeprecatedOpIndexT>(
+      0, allowed_setup_ops_.size());
   return allowed_setup_ops_[op_index];
 }
 
 Op Mutator::PredictOp() {
-  IntegerT op_index = absl::Uniform<DeprecatedOpIndexT>(
-      *bit_gen_, 0, allowed_predict_ops_.size());
+  IntegerT op_index = rand_gen_->Uniform<DeprecatedOpIndexT>(
+      0, allowed_predict_ops_.size());
   return allowed_predict_ops_[op_index];
 }
 
 Op Mutator::LearnOp() {
-  IntegerT op_index = absl::Uniform<DeprecatedOpIndexT>(
-      *bit_gen_, 0, allowed_learn_ops_.size());
+  IntegerT op_index = rand_gen_->Uniform<DeprecatedOpIndexT>(
+      0, allowed_learn_ops_.size());
   return allowed_learn_ops_[op_index];
 }
 
 InstructionIndexT Mutator::InstructionIndex(
     const InstructionIndexT component_function_size) {
-  return absl::Uniform<InstructionIndexT>(
-      *bit_gen_, 0, component_function_size);
+  return rand_gen_->Uniform<InstructionIndexT>(0, component_function_size);
 }
 
 ComponentFunctionT Mutator::ComponentFunction() {
@@ -400,7 +407,7 @@ ComponentFunctionT Mutator::ComponentFunction() {
   CHECK(!allowed_component_functions.empty())
       << "Must mutate at least one component function." << endl;
   const IntegerT index =
-      absl::Uniform<IntegerT>(*bit_gen_, 0, allowed_component_functions.size());
+      rand_gen_->Uniform<IntegerT>(0, allowed_component_functions.size());
   return allowed_component_functions[index];
 }
 
@@ -17,9 +17,11 @@
 
 #include <memory>
 #include <random>
+#include <utility>
 #include <vector>
 
 #include "algorithm.h"
+#include "algorithm_arena.h"
 #include "definitions.h"
 #include "instruction.pb.h"
 #include "mutator.pb.h"
@@ -52,7 +54,8 @@ class Mutator {
       const IntegerT predict_size_max,
       const IntegerT learn_size_min,
       const IntegerT learn_size_max,
-      // The random bit generator.
+      // Only kept for the callers; all the draws go through rand_gen. Can be a
+      // nullptr.
       std::mt19937* bit_gen,
       // The random number generator.
       RandomGenerator* rand_gen);
@@ -64,6 +67,11 @@ class Mutator {
   void Mutate(IntegerT num_mutations,
               std::shared_ptr<const Algorithm>* algorithm);
 
+  // Mutates the algorithm in place. The new instructions are created in the
+  // arena, or on the heap if it is null.
+  void Mutate(IntegerT num_mutations, AlgorithmArena* arena,
+              Algorithm* algorithm);
+
   // Used to create a simple instance for tests.
   Mutator();
 
@@ -87,6 +95,16 @@ class Mutator {
 
   void MutateImpl(Algorithm* algorithm);
 
+  // Creates an instruction in arena_, if set. Takes the Instruction
+  // constructor arguments.
+  template <typename... Args>
+  std::shared_ptr<const Instruction> NewInstruction(Args&&... args) {
+    if (arena_ == nullptr) {
+      return std::make_shared<const Instruction>(std::forward<Args>(args)...);
+    }
+    return arena_->NewInstruction(std::forward<Args>(args)...);
+  }
+
   // Randomizes a single parameter within one instruction. Keeps the same op.
   void AlterParam(Algorithm* algorithm);
 
@@ -149,6 +167,8 @@ class Mutator {
   std::unique_ptr<RandomGenerator> rand_gen_owned_;
   RandomGenerator* rand_gen_;
   Randomizer randomizer_;
+  // Where the instructions are created during an in-place Mutate call.
+  AlgorithmArena* arena_;
 };
 
 }  // namespace automl_zero
@@ -0,0 +1,101 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Microbenchmarks of the mutations and of the ineffective code removal.
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "generator.h"
+#include "instruction.pb.h"
+#include "mutator.h"
+#include "mutator.pb.h"
+#include "random_generator.h"
+#include "benchmark/benchmark.h"
+
+namespace automl_zero {
+
+using ::std::make_shared;  // NOLINT
+using ::std::shared_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace {
+
+constexpr RandomSeedT kBenchmarkSeed = 100000;
+
+const vector<Op>& BenchmarkOps() {
+  static const vector<Op>* const ops = new vector<Op>(
+      {SCALAR_CONST_SET_OP, VECTOR_INNER_PRODUCT_OP, SCALAR_DIFF_OP,
+       SCALAR_PRODUCT_OP, SCALAR_VECTOR_PRODUCT_OP, VECTOR_SUM_OP,
+       SCALAR_SUM_OP, VECTOR_HEAVYSIDE_OP, MATRIX_VECTOR_PRODUCT_OP});
+  return *ops;
+}
+
+// An algorithm with `size` random instructions in each component function.
+Algorithm RandomAlgorithm(const IntegerT size, std::mt19937* bit_gen,
+                          RandomGenerator* rand_gen) {
+  Generator generator(NO_OP_ALGORITHM, size, size, size, BenchmarkOps(),
+                      BenchmarkOps(), BenchmarkOps(), bit_gen, rand_gen);
+  return generator.Random();
+}
+
+// One mutation, including the copy of the parent and the ineffective code
+// removal of the child, as done for every child of a search.
+void BM_Mutate(benchmark::State& state) {
+  const IntegerT size = state.range(0);
+  std::mt19937 bit_gen(kBenchmarkSeed);
+  RandomGenerator rand_gen(&bit_gen);
+  MutationTypeList allowed_actions;
+  allowed_actions.add_mutation_types(ALTER_PARAM_MUTATION_TYPE);
+  allowed_actions.add_mutation_types(INSERT_INSTRUCTION_MUTATION_TYPE);
+  allowed_actions.add_mutation_types(REMOVE_INSTRUCTION_MUTATION_TYPE);
+  Mutator mutator(allowed_actions, 1.0, BenchmarkOps(), BenchmarkOps(),
+                  BenchmarkOps(), size / 2, size * 2, size / 2, size * 2,
+                  size / 2, size * 2, &bit_gen, &rand_gen);
+  const shared_ptr<const Algorithm> parent =
+      make_shared<const Algorithm>(RandomAlgorithm(size, &bit_gen, &rand_gen));
+  for (auto _ : state) {
+    shared_ptr<const Algorithm> child = parent;
+    mutator.Mutate(1, &child);
+    benchmark::DoNotOptimize(child);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Mutate)->ArgName("size")->RangeMultiplier(4)->Range(4, 256);
+
+void BM_SetEffectiveInstructions(benchmark::State& state) {
+  const IntegerT size = state.range(0);
+  std::mt19937 bit_gen(kBenchmarkSeed);
+  RandomGenerator rand_gen(&bit_gen);
+  Algorithm algorithm = RandomAlgorithm(size, &bit_gen, &rand_gen);
+  for (auto _ : state) {
+    algorithm.SetEffectiveInstructions();
+    benchmark::DoNotOptimize(algorithm.SizeEffective());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetEffectiveInstructions)
+    ->ArgName("size")
+    ->RangeMultiplier(4)
+    ->Range(4, 256);
+
+}  // namespace
+
+}  // namespace automl_zero
+
+BENCHMARK_MAIN();
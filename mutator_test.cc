@@ -20,6 +20,7 @@
 #include "definitions.h"
 #include "instruction.pb.h"
 #include "algorithm.h"
+#include "algorithm_arena.h"
 #include "algorithm_test_util.h"
 #include "generator.h"
 #include "generator_test_util.h"
@@ -827,4 +828,48 @@ TEST(MutatorTest, RandomizeAlgorithm) {
       Range<IntegerT>(0, num_instr + 1), {num_instr}));
 }
 
+TEST(MutatorTest, MutatesInPlaceInTheArena) {
+  const Algorithm algorithm = SimpleRandomAlgorithm();
+  const MutationTypeList actions = ParseTextFormat<MutationTypeList>(
+      "mutation_types: [ "
+      "  ALTER_PARAM_MUTATION_TYPE, "
+      "  RANDOMIZE_INSTRUCTION_MUTATION_TYPE, "
+      "  INSERT_INSTRUCTION_MUTATION_TYPE, "
+      "  REMOVE_INSTRUCTION_MUTATION_TYPE "
+      "] ");
+  mt19937 copying_bit_gen(1000);
+  RandomGenerator copying_rand_gen(&copying_bit_gen);
+  Mutator copying_mutator(
+      actions, 0.5,
+      {SCALAR_SUM_OP, VECTOR_SUM_OP},  // allowed_setup_ops
+      {SCALAR_DIFF_OP, VECTOR_DIFF_OP},  // allowed_predict_ops
+      {SCALAR_PRODUCT_OP, VECTOR_PRODUCT_OP},  // allowed_learn_ops
+      0, 10000, 0, 10000, 0, 10000,  // min/max component function sizes
+      &copying_bit_gen, &copying_rand_gen);
+  mt19937 in_place_bit_gen(1000);
+  RandomGenerator in_place_rand_gen(&in_place_bit_gen);
+  Mutator in_place_mutator(
+      actions, 0.5,
+      {SCALAR_SUM_OP, VECTOR_SUM_OP},  // allowed_setup_ops
+      {SCALAR_DIFF_OP, VECTOR_DIFF_OP},  // allowed_predict_ops
+      {SCALAR_PRODUCT_OP, VECTOR_PRODUCT_OP},  // allowed_learn_ops
+      0, 10000, 0, 10000, 0, 10000,  // min/max component function sizes
+      &in_place_bit_gen, &in_place_rand_gen);
+
+  AlgorithmArena arena;
+  shared_ptr<const Algorithm> copied = make_shared<const Algorithm>(algorithm);
+  shared_ptr<Algorithm> in_place = arena.NewAlgorithm(algorithm);
+  bool created_in_arena = false;
+  for (IntegerT i = 0; i < 100; ++i) {
+    copying_mutator.Mutate(3, &copied);
+    in_place_mutator.Mutate(3, &arena, in_place.get());
+    ASSERT_EQ(*in_place, *copied);
+    for (const shared_ptr<const Instruction>& instruction :
+         in_place->predict_) {
+      created_in_arena |= arena.InNursery(instruction.get());
+    }
+  }
+  EXPECT_TRUE(created_in_arena);
+}
+
 }  // namespace automl_zero
@@ -6,23 +6,26 @@
 #include <cstdlib>
 #include <iomanip>
 #include <ios>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <utility>
 #include <algorithm>
 #include <string>
 #include <limits>
-#include <fstream>
 #include <iostream>
 #include <stdlib.h>
 #include <cstdlib>
 #include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "algorithm.h"
 #include "algorithm.pb.h"
 #include "task_util.h"
 #include "definitions.h"
 #include "executor.h"
+#include "huge_page_allocator.h"
 #include "instruction.h"
 #include "random_generator.h"
 #include "absl/flags/flag.h"
@@ -111,6 +114,43 @@ namespace automl_zero {
          return 0.0;
    }
 
+   SeenFitnessCache::SeenFitnessCache(const IntegerT max_size)
+      : max_size_(max_size) {
+      CHECK_GE(max_size_, 0);
+   }
+
+   const SeenFitnessCache::Fitness* SeenFitnessCache::Lookup(const size_t hash) {
+      auto it = map_.find(hash);
+      if(it == map_.end())
+         return nullptr;
+      list_.splice(list_.begin(), list_, it->second);
+      return &it->second->second;
+   }
+
+   bool SeenFitnessCache::Contains(const size_t hash) const {
+      return map_.count(hash) > 0;
+   }
+
+   void SeenFitnessCache::Insert(const size_t hash, const Fitness& fitness) {
+      auto it = map_.find(hash);
+      if(it != map_.end()){
+         list_.splice(list_.begin(), list_, it->second);
+         it->second->second = fitness;
+         return;
+      }
+      if(max_size_ > 0 && map_.size() >= max_size_){
+         // Reuses the evicted node and its vectors.
+         map_.erase(list_.back().first);
+         list_.splice(list_.begin(), list_, std::prev(list_.end()));
+         list_.front().first = hash;
+         list_.front().second = fitness;
+      }
+      else{
+         list_.emplace_front(hash, fitness);
+      }
+      map_[hash] = list_.begin();
+   }
+
    // Main implementation of NSGA2.
    NSGA2::NSGA2(
          RandomGenerator* rand_gen, 
@@ -133,7 +173,16 @@ namespace automl_zero {
          double max_allowed_error,
          double max_allowed_complexity,
          double feasible_error,
-         double max_error_sd_consider):
+         double max_error_sd_consider,
+         std::pair<double, double> hv_reference_point,
+         IntegerT hv_stop_generations,
+         double hv_stop_epsilon,
+         ParetoArchiveObjectives archive_objectives,
+         DuplicateHandling duplicate_handling,
+         IntegerT max_duplicate_remutations,
+         IntegerT max_seen_fitnesses,
+         const SurrogateSpec* surrogate_spec,
+         SearchMetrics* metrics):
 
       evaluator_(evaluator),
       rand_gen_(rand_gen),
@@ -148,6 +197,31 @@ namespace automl_zero {
       max_mut_(max_mut),
       crossover_(crossover),
       cross_prob_(cross_prob),
+      metrics_(metrics),
+      metrics_individuals_(0),
+      metrics_train_steps_(0),
+      metrics_functional_cache_hits_(0),
+      metrics_functional_cache_misses_(0),
+      metrics_timeouts_(0),
+      archive_(archive_objectives),
+      hv_stop_generations_(hv_stop_generations),
+      hv_stop_epsilon_(hv_stop_epsilon),
+      hv_converged_(false),
+      duplicate_handling_(duplicate_handling),
+      max_duplicate_remutations_(max_duplicate_remutations),
+      seen_fitness_(max_seen_fitnesses),
+      num_generation_duplicates_(0),
+      num_seen_duplicates_(0),
+      num_remutations_(0),
+      num_reused_fitness_(0),
+      surrogate_exploration_rate_(0.0),
+      surrogate_dominance_margin_(0.0),
+      last_inserted_into_archive_(false),
+      num_surrogate_predictions_(0),
+      surrogate_abs_error_sum_(0.0),
+      num_surrogate_filtered_(0),
+      num_surrogate_explored_(0),
+      num_surrogate_explored_dominated_(0),
       population_size_(population_size),
       population(population_size_, make_shared<Algorithm>()),
       fitness(population_size_),
@@ -171,32 +245,40 @@ namespace automl_zero {
          best_error_ = std::numeric_limits<double>::infinity();
          first_feasible_error_found_ = -1;
          iter_no_ = 0;
-         animation_out_.open("/home/ritz/projects/coin_lab/Research_Directions/AutoML/moaz_outputs/"
-                             "pf_animation_moaz_output.txt", std::ofstream::out);
+         if(archive_objectives == kErrorAndComplexityObjectives){
+            archive_.TrackHypervolume(hv_reference_point.first, hv_reference_point.second);
+         }
+         else{
+            CHECK_EQ(hv_stop_generations_, 0)
+               << "Hypervolume-based stopping needs the 2-D archive." << std::endl;
+         }
+         if(surrogate_spec != nullptr){
+            surrogate_ = make_unique<KnnSurrogate>(*surrogate_spec);
+            surrogate_exploration_rate_ = surrogate_spec->exploration_rate();
+            surrogate_dominance_margin_ = surrogate_spec->dominance_margin();
+         }
       }
 
    IntegerT NSGA2::Init() {
       // Function to initialize a number of population members.
       const IntegerT start_individuals = num_individuals_;
-      std::vector<std::pair<std::vector<double>, std::vector<double>>>::iterator fitness_it = fitness.begin();
 
       for (shared_ptr<const Algorithm>& algorithm : population) {
          // Initialize the algorithm.
          InitAlgorithm(&algorithm);
-         // Execute it and get the objective values.
-         *fitness_it = Execute(algorithm);
-         std::pair<std::vector<double>, std::vector<double>> temp = *fitness_it;
-         ++fitness_it;
       }
-      CHECK(fitness_it == fitness.end());
+      // Execute them and get the objective values.
+      ExecuteBatch(population, &fitness);
+      CHECK_EQ(fitness.size(), population.size());
 
       // Initialization done.
       initialized_ = true;
+      UpdateMetrics();
       return num_individuals_ - start_individuals;
    }
 
    IntegerT NSGA2::Run(const IntegerT max_train_steps,
-         const IntegerT max_nanos) {
+         const IntegerT max_nanos, const std::atomic<bool>* stop) {
 
       // The main driver function.
       CHECK(initialized_) << "NSGA2 not initialized." << std::endl;
@@ -208,9 +290,13 @@ namespace automl_zero {
       std::vector<std::pair<std::vector<double>, std::vector<double>>> child_fitness;
 
       // Loop until stopping criteria are met.
+      hv_converged_ = false;
       while (evaluator_->GetNumTrainStepsCompleted() - start_train_steps <
             max_train_steps &&
-            GetCurrentTimeNanos() - start_nanos < max_nanos) {
+            GetCurrentTimeNanos() - start_nanos < max_nanos &&
+            !hv_converged_ &&
+            (stop == nullptr || !*stop)) {
+         const IntegerT generation_start_nanos = GetCurrentTimeNanos();
 
          // code the NSGA2 process 
          // Clear the child population of the last generation.
@@ -236,6 +322,19 @@ namespace automl_zero {
          // fill_non_dominated_sort(merged_population, merged_fitness, survived_id);
          survival(child_population, child_fitness);
 
+         // Record the hypervolume of this generation and check for a plateau.
+         if(archive_.TracksHypervolume()){
+            hv_history_.push_back(archive_.Hypervolume());
+            hv_converged_ = CheckHypervolumeConverged();
+         }
+
+         if(metrics_ != nullptr){
+            metrics_->generations->Add(1);
+            metrics_->generation_secs->Observe(
+               static_cast<double>(GetCurrentTimeNanos() - generation_start_nanos) / kNanosPerSecond);
+            UpdateMetrics();
+         }
+
          //  Analyze the population and print the details.
          MaybePrintProgress();
 
@@ -275,6 +374,7 @@ namespace automl_zero {
       child_population.clear();
       child_fitness.clear();
 
+      const IntegerT variation_start_nanos = GetCurrentTimeNanos();
       if(crossover_){
          // Calculate the population crowding distance which will be used for tournament selection.
          compute_population_crowding_dist();
@@ -284,7 +384,9 @@ namespace automl_zero {
          child_population = population;
       }
 
+      const IntegerT evaluation_start_nanos = GetCurrentTimeNanos();
       child_fitness = mutation(child_population); // perform mutation
+      const IntegerT selection_start_nanos = GetCurrentTimeNanos();
       std::vector<IntegerT> survived_id;
 
       // //  Merge the parent and child population.	
@@ -296,6 +398,18 @@ namespace automl_zero {
 
       //  Create the final population afrer nds and cds.
       fill_non_dominated_sort(merged_population, merged_fitness, survived_id);
+      for(std::shared_ptr<const Algorithm>& survivor : population)
+         arena_.Promote(&survivor);
+
+      if(metrics_ != nullptr){
+         const IntegerT selection_end_nanos = GetCurrentTimeNanos();
+         metrics_->variation_secs->Observe(
+            static_cast<double>(evaluation_start_nanos - variation_start_nanos) / kNanosPerSecond);
+         metrics_->evaluation_secs->Observe(
+            static_cast<double>(selection_start_nanos - evaluation_start_nanos) / kNanosPerSecond);
+         metrics_->selection_secs->Observe(
+            static_cast<double>(selection_end_nanos - selection_start_nanos) / kNanosPerSecond);
+      }
 
       // Count survived children.
       IntegerT count_survived_children = 0;
@@ -315,6 +429,61 @@ namespace automl_zero {
       }
    }
 
+   void NSGA2::UpdateMetrics() {
+      if(metrics_ == nullptr)
+         return;
+      // Only push the differences, so that the counters keep adding up
+      // across calls to Run.
+      const IntegerT train_steps = evaluator_->GetNumTrainStepsCompleted();
+      const IntegerT cache_hits = evaluator_->NumFunctionalCacheHits();
+      const IntegerT cache_misses = evaluator_->NumFunctionalCacheMisses();
+      const IntegerT timeouts = evaluator_->NumTimeouts();
+      metrics_->evaluations->Add(num_individuals_ - metrics_individuals_);
+      metrics_->train_steps->Add(train_steps - metrics_train_steps_);
+      metrics_->functional_cache_hits->Add(cache_hits - metrics_functional_cache_hits_);
+      metrics_->functional_cache_misses->Add(cache_misses - metrics_functional_cache_misses_);
+      metrics_->timeouts->Add(timeouts - metrics_timeouts_);
+      metrics_individuals_ = num_individuals_;
+      metrics_train_steps_ = train_steps;
+      metrics_functional_cache_hits_ = cache_hits;
+      metrics_functional_cache_misses_ = cache_misses;
+      metrics_timeouts_ = timeouts;
+      metrics_->front_size->Set(archive_.Size());
+      if(archive_.TracksHypervolume()){
+         metrics_->hypervolume->Set(archive_.Hypervolume());
+      }
+      double best_error = std::numeric_limits<double>::infinity();
+      for(const std::pair<std::vector<double>, std::vector<double>>& temp_fitness : fitness){
+         best_error = std::min(best_error, temp_fitness.first[0]);
+      }
+      metrics_->best_error->Set(best_error);
+      const HugePageStats huge_page_stats = GetHugePageStats();
+      metrics_->explicit_huge_page_bytes->Set(huge_page_stats.explicit_bytes);
+      metrics_->transparent_huge_page_bytes->Set(
+            huge_page_stats.transparent_bytes);
+      metrics_->regular_page_bytes->Set(huge_page_stats.regular_bytes);
+      metrics_->stranded_huge_page_bytes->Set(huge_page_stats.stranded_bytes);
+   }
+
+   bool NSGA2::CheckHypervolumeConverged() const {
+      // Converged if the hypervolume grew by less than a fraction hv_stop_epsilon_
+      // over the last hv_stop_generations_ generations. A zero hypervolume means
+      // that nothing within the reference point was found yet, so keep going.
+      if(hv_stop_generations_ <= 0 || static_cast<IntegerT>(hv_history_.size()) <= hv_stop_generations_)
+         return false;
+      const double current_hv = hv_history_.back();
+      const double past_hv = hv_history_[hv_history_.size() - 1 - hv_stop_generations_];
+      return current_hv > 0 && current_hv - past_hv <= hv_stop_epsilon_ * past_hv;
+   }
+
+   bool NSGA2::HypervolumeConverged() const {
+      return hv_converged_;
+   }
+
+   const std::vector<double>& NSGA2::GetHypervolumeHistory() const {
+      return hv_history_;
+   }
+
    IntegerT NSGA2::GetFirstFeasibleError(){
       return first_feasible_error_found_;
    }
@@ -342,13 +511,13 @@ namespace automl_zero {
          idx_list_2.push_back(i);
       }
       // Randomly shuffle the parent indices.
-      std::random_shuffle(idx_list_1.begin(), idx_list_1.end());
-      std::random_shuffle(idx_list_2.begin(), idx_list_2.end());
+      rand_gen_->Shuffle(idx_list_1.begin(), idx_list_1.end());
+      rand_gen_->Shuffle(idx_list_2.begin(), idx_list_2.end());
 
       // Initialize resulting child solutions. 
       std::shared_ptr<Algorithm> child_1, child_2;
-      child_1 = make_shared<Algorithm>(generator_->TheInitModel());
-      child_2 = make_shared<Algorithm>(generator_->TheInitModel()); 
+      child_1 = arena_.NewAlgorithm(generator_->TheInitModel());
+      child_2 = arena_.NewAlgorithm(generator_->TheInitModel());
 
       // Index of the parents.
       IntegerT parent_1, parent_2;
@@ -374,27 +543,162 @@ namespace automl_zero {
       // mutation function
       std::vector<std::pair<std::vector<double>, std::vector<double>>> child_fitness;
       double min_child_error = std::numeric_limits<double>::infinity();
+
+      // Hashes of the algorithms in this generation, starting with the parents.
+      std::unordered_set<size_t> generation_hashes;
+      for(const shared_ptr<const Algorithm>& parent: population){
+         generation_hashes.insert(parent->Hash());
+      }
+
+      // Children discarded by the surrogate are removed from child_pop.
+      std::vector<std::shared_ptr<const Algorithm>> kept_children;
+
+      // Without a surrogate, which screens each child against the archive as
+      // left by the children before it, the children are executed together
+      // after the loop. Pairs of (index in child_fitness, index in
+      // batch_children), and the index in batch_children of each hash.
+      std::vector<std::shared_ptr<const Algorithm>> batch_children;
+      std::vector<std::pair<IntegerT, IntegerT>> batch_fitness_indices;
+      std::unordered_map<size_t, IntegerT> batch_hashes;
       for(IntegerT count = 0; count < child_pop.size(); count++){
          // Mutate every child population member.
          std::shared_ptr<const Algorithm> temp_child = child_pop[count];
-         mutator_->Mutate(max_mut_, &temp_child);
 
-         // Set effective instructions
-         auto mutated = make_unique<Algorithm>(*temp_child);
-//         (mutated.get())->SetEffectiveInstructions();
-         (&temp_child)->reset(mutated.release());
+         // The error of the algorithm before mutation, if it was evaluated.
+         bool has_parent_error = false;
+         double parent_error = 0.0;
+         if(surrogate_ != nullptr){
+            const SeenFitnessCache::Fitness* parent = seen_fitness_.Lookup(temp_child->Hash());
+            if(parent != nullptr){
+               has_parent_error = true;
+               parent_error = parent->first[0];
+            }
+         }
+
+         MutateInArena(max_mut_, &temp_child);
 
+         std::pair<std::vector<double>, std::vector<double>> cur_fitness;
+         const bool cached = handle_duplicate(&temp_child, &generation_hashes, &cur_fitness);
          child_pop[count] = temp_child;
-         std::pair<std::vector<double>, std::vector<double>> cur_fitness = Execute(child_pop[count]);
+         if(!cached && surrogate_ == nullptr){
+            // A duplicate of a child that is waiting for the batch gets its
+            // fitness, as handle_duplicate would have given it, had that
+            // child been executed already.
+            const size_t hash = temp_child->Hash();
+            auto pending = batch_hashes.find(hash);
+            if(pending != batch_hashes.end() && duplicate_handling_ != EVALUATE_DUPLICATES){
+               ++num_reused_fitness_;
+               batch_fitness_indices.emplace_back(child_fitness.size(), pending->second);
+            }
+            else{
+               batch_hashes[hash] = batch_children.size();
+               batch_fitness_indices.emplace_back(child_fitness.size(), batch_children.size());
+               batch_children.push_back(temp_child);
+            }
+            kept_children.push_back(temp_child);
+            child_fitness.emplace_back();
+            continue;
+         }
+         if(!cached){
+            std::vector<double> features;
+            double predicted_error = std::numeric_limits<double>::quiet_NaN();
+            bool predicted_dominated = false;
+            if(surrogate_ != nullptr){
+               features = SurrogateFeatures(*temp_child, has_parent_error, parent_error);
+               if(!surrogate_screen(*temp_child, features, &predicted_error, &predicted_dominated))
+                  continue;
+            }
+            cur_fitness = Execute(child_pop[count]);
+            if(surrogate_ != nullptr){
+               if(!std::isnan(predicted_error)){
+                  ++num_surrogate_predictions_;
+                  surrogate_abs_error_sum_ += abs(predicted_error - cur_fitness.first[0]);
+               }
+               if(predicted_dominated){
+                  ++num_surrogate_explored_;
+                  if(!last_inserted_into_archive_)
+                     ++num_surrogate_explored_dominated_;
+               }
+               surrogate_->Add(features, cur_fitness.first[0]);
+            }
+         }
+         kept_children.push_back(child_pop[count]);
+         child_fitness.push_back(cur_fitness);
+      }
+      child_pop = std::move(kept_children);
+
+      if(!batch_children.empty()){
+         std::vector<std::pair<std::vector<double>, std::vector<double>>> batch_fitness;
+         ExecuteBatch(batch_children, &batch_fitness);
+         for(const std::pair<IntegerT, IntegerT>& indices : batch_fitness_indices)
+            child_fitness[indices.first] = batch_fitness[indices.second];
+      }
+      for(const std::pair<std::vector<double>, std::vector<double>>& cur_fitness : child_fitness){
          if(cur_fitness.first[0] < min_child_error){
             min_child_error = cur_fitness.first[0];
          }
-         child_fitness.push_back(cur_fitness);
       }
 
       return child_fitness;
    }
 
+   bool NSGA2::surrogate_screen(const Algorithm& child,
+                                const std::vector<double>& features,
+                                double* predicted_error,
+                                bool* predicted_dominated){
+      *predicted_dominated = false;
+      if(!surrogate_->IsReady())
+         return true;
+      *predicted_error = surrogate_->Predict(features);
+
+      // Only filter the children that would be dominated even if they were
+      // better than predicted by the margin. The complexity is exact.
+      const std::pair<std::vector<double>, std::vector<double>> optimistic_fitness(
+         {*predicted_error - surrogate_dominance_margin_, 0.0}, evaluator_->Complexity(child));
+      *predicted_dominated = archive_.IsDominated(optimistic_fitness);
+      if(!*predicted_dominated)
+         return true;
+      if(rand_gen_->UniformProbability() < surrogate_exploration_rate_)
+         return true;
+      ++num_surrogate_filtered_;
+      return false;
+   }
+
+   bool NSGA2::handle_duplicate(std::shared_ptr<const Algorithm>* child,
+                                std::unordered_set<size_t>* generation_hashes,
+                                std::pair<std::vector<double>, std::vector<double>>* child_fitness){
+      size_t hash = (*child)->Hash();
+      bool in_generation = generation_hashes->count(hash) > 0;
+      bool seen = in_generation || seen_fitness_.Contains(hash);
+      if(in_generation)
+         ++num_generation_duplicates_;
+      else if(seen)
+         ++num_seen_duplicates_;
+
+      if(seen && duplicate_handling_ == REMUTATE_DUPLICATES){
+         // Keep mutating until the child is novel.
+         for(IntegerT attempt = 0; seen && attempt < max_duplicate_remutations_; attempt++){
+            MutateInArena(1, child);
+            ++num_remutations_;
+            hash = (*child)->Hash();
+            seen = generation_hashes->count(hash) > 0 || seen_fitness_.Contains(hash);
+         }
+      }
+      generation_hashes->insert(hash);
+
+      if(seen && duplicate_handling_ != EVALUATE_DUPLICATES){
+         // Every algorithm in the generation was evaluated, so it is in the
+         // cache, unless it was evicted since.
+         const SeenFitnessCache::Fitness* cached = seen_fitness_.Lookup(hash);
+         if(cached != nullptr){
+            *child_fitness = *cached;
+            ++num_reused_fitness_;
+            return true;
+         }
+      }
+      return false;
+   }
+
    void NSGA2::fill_non_dominated_sort (
          std::vector<std::shared_ptr<const Algorithm>> temp_population,
          std::vector<std::pair<std::vector<double>, std::vector<double>>> temp_fitness,
@@ -724,7 +1028,7 @@ namespace automl_zero {
          if(crowd_dist_[option_1] > crowd_dist_[option_2])return option_1;
          else if(crowd_dist_[option_1] < crowd_dist_[option_2]) return option_2;
          else{
-            float r = static_cast <float> (std::rand()) / static_cast <float> (RAND_MAX);
+            double r = rand_gen_->UniformDouble(0.0, 1.0);
             if(r < 0.5) return option_1;
             else return option_2;
          }
@@ -737,8 +1041,8 @@ namespace automl_zero {
          std::shared_ptr<Algorithm>& child_2,
          std::string module){
          
-         child_1 = make_shared<Algorithm>(generator_->TheInitModel());
-         child_2 = make_shared<Algorithm>(generator_->TheInitModel());
+         child_1 = arena_.NewAlgorithm(generator_->TheInitModel());
+         child_2 = arena_.NewAlgorithm(generator_->TheInitModel());
 
          // Initialize child_1 and child_2 to parent_1 and parent_2, respectively.
          child_1->setup_ = std::move(parent_1->setup_);
@@ -783,7 +1087,7 @@ namespace automl_zero {
       std::vector<std::string> modules{"setup", "predict", "learn"};
 
       // Random number generation for comparing with probability.
-      double p = static_cast <float> (std::rand()) / static_cast <float> (RAND_MAX);
+      double p = rand_gen_->UniformDouble(0.0, 1.0);
 
       // Initialize child_1 and child_2 to parent_1 and parent_2, respectively.
       child_1->setup_ = std::move(parent_1->setup_);
@@ -795,7 +1099,7 @@ namespace automl_zero {
 
       // Probabilisitically perform the crossover.
       if(p < cross_prob_){
-         IntegerT rand_module_idx = std::rand() % modules.size();
+         IntegerT rand_module_idx = rand_gen_->UniformInteger(0, modules.size());
 
          // Check if the parents are compatible for crossover.
          bool compatible = check_crossover_compatibility(parent_1, parent_2, modules[rand_module_idx]);
@@ -922,47 +1226,92 @@ namespace automl_zero {
 
    void NSGA2::InitAlgorithm(
          shared_ptr<const Algorithm>* algorithm) {
-      *algorithm = make_shared<Algorithm>(generator_->TheInitModel());
-      mutator_->Mutate(0, algorithm);
-      // Set effective instructions
-      auto mutated = make_unique<Algorithm>(**algorithm);
-//      (mutated.get())->SetEffectiveInstructions();
-      algorithm->reset(mutated.release());
+      shared_ptr<Algorithm> initial =
+         arena_.NewAlgorithm(generator_->TheInitModel());
+      mutator_->Mutate(0, &arena_, initial.get());
+      *algorithm = std::move(initial);
+   }
+
+   void NSGA2::MutateInArena(const IntegerT num_mutations,
+         shared_ptr<const Algorithm>* algorithm) {
+      shared_ptr<Algorithm> mutated = arena_.NewAlgorithm(**algorithm);
+      mutator_->Mutate(num_mutations, &arena_, mutated.get());
+      *algorithm = std::move(mutated);
    }
 
    std::pair<std::vector<double>, std::vector<double>> NSGA2::Execute(shared_ptr<const Algorithm> algorithm) {
       // Executes a single algorithm and return the fitness.
-      ++num_individuals_;
-      epoch_secs_ = GetCurrentTimeNanos() / kNanosPerSecond;
       // std::cout << algorithm->ToReadable() << std::endl;
       std::pair<std::vector<double>, std::vector<double>> fitness_temp = evaluator_->EvaluateMulti(*algorithm);
+      RecordFitness(algorithm, fitness_temp);
       return fitness_temp;
    }
 
+   void NSGA2::ExecuteBatch(const std::vector<std::shared_ptr<const Algorithm>>& algorithms,
+                            std::vector<std::pair<std::vector<double>, std::vector<double>>>* fitnesses) {
+      evaluator_->EvaluateMultiBatch(algorithms, fitnesses);
+      for(IntegerT i = 0; i < algorithms.size(); i++)
+         RecordFitness(algorithms[i], (*fitnesses)[i]);
+   }
+
+   void NSGA2::RecordFitness(shared_ptr<const Algorithm> algorithm,
+                             const std::pair<std::vector<double>, std::vector<double>>& fitness) {
+      ++num_individuals_;
+      epoch_secs_ = GetCurrentTimeNanos() / kNanosPerSecond;
+      // The archive may keep the algorithm indefinitely, so it is promoted out
+      // of the nursery first.
+      if(!archive_.IsDominated(fitness))
+         arena_.Promote(&algorithm);
+      last_inserted_into_archive_ = archive_.Insert(algorithm, fitness);
+      seen_fitness_.Insert(algorithm->Hash(), fitness);
+   }
+
    void NSGA2::MaybePrintProgress() {
       if (num_individuals_ < num_individuals_last_progress_ + progress_every_) {
           return;
       }
 
-      animation_out_ << "\n" << num_individuals_ << std::endl;
-      for(auto fit: fitness){
-          animation_out_ << fit.first[0] << "\t" << fit.second[fit.second.size()-1] << std::endl;
-      }
       num_individuals_last_progress_ = num_individuals_;
       double error_mean, error_stdev, best_error, complexity_mean, complexity_std, best_complexity;
       //  shared_ptr<const Algorithm> pop_best_algorithm;
       PopulationStats(
             &error_mean, &error_stdev, &best_error, &complexity_mean, &complexity_std, &best_complexity);
-      std::cout << "indivs=" << num_individuals_ << ", " << setprecision(0) << fixed
+      // Printed at once, so that the lines of concurrent searches don't
+      // interleave.
+      std::ostringstream progress;
+      progress << "indivs=" << num_individuals_ << ", " << setprecision(0) << fixed
          << "elapsed_secs=" << epoch_secs_ - start_secs_ << ", "
          << "error: mean=" << setprecision(6) << fixed << error_mean << ", "
          << "stdev=" << setprecision(6) << fixed << error_stdev << ", "
          << "best value=" << setprecision(6) << fixed << best_error << "; "
          << "complexity: mean=" << setprecision(6) << fixed << complexity_mean << ", "
          << "stdev=" << setprecision(6) << fixed << complexity_std << ", "
-         << "best value=" << setprecision(6) << fixed << best_complexity << ", "
-         << std::endl;
-
+         << "best value=" << setprecision(6) << fixed << best_complexity << "; "
+         << "archive size=" << archive_.Size();
+      if(archive_.TracksHypervolume()){
+         progress << ", hypervolume=" << setprecision(6) << fixed << archive_.Hypervolume();
+      }
+      progress << "; "
+         << "duplicates: in generation=" << num_generation_duplicates_ << ", "
+         << "seen before=" << num_seen_duplicates_ << ", "
+         << "remutated=" << num_remutations_ << ", "
+         << "reused fitness=" << num_reused_fitness_ << ", "
+         << "seen fitnesses=" << seen_fitness_.Size() << ", ";
+      if(surrogate_ != nullptr){
+         // Mean absolute error of the predictions and fraction of the explored
+         // children that were predicted dominated and indeed were.
+         const double surrogate_mae = num_surrogate_predictions_ > 0 ?
+            surrogate_abs_error_sum_ / num_surrogate_predictions_ : 0.0;
+         const double surrogate_precision = num_surrogate_explored_ > 0 ?
+            static_cast<double>(num_surrogate_explored_dominated_) / num_surrogate_explored_ : 0.0;
+         progress << "surrogate: history=" << surrogate_->HistorySize() << ", "
+            << "filtered=" << num_surrogate_filtered_ << ", "
+            << "explored=" << num_surrogate_explored_ << ", "
+            << "mae=" << setprecision(6) << fixed << surrogate_mae << ", "
+            << "precision=" << setprecision(6) << fixed << surrogate_precision;
+      }
+      progress << "\n";
+      std::cout << progress.str();
       std::cout.flush();
    }
 
@@ -978,4 +1327,8 @@ namespace automl_zero {
       return pf_comb;
    }
 
+   const ParetoArchive& NSGA2::GetParetoArchive() const {
+      return archive_;
+   }
+
 }  // namespace automl_zero
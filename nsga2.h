@@ -3,27 +3,70 @@
 #ifndef AUTOML_ZERO_NSGA2_H_
 #define AUTOML_ZERO_NSGA2_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 #include <iostream>
-#include <fstream>
+#include <list>
 
 #include "nsga2.h"
 #include "algorithm.h"
+#include "algorithm_arena.h"
 #include "definitions.h"
 #include "evaluator.h"
+#include "experiment.pb.h"
 #include "generator.h"
+#include "metrics.h"
 #include "mutator.h"
+#include "pareto_archive.h"
 #include "random_generator.h"
+#include "surrogate.h"
+#include "surrogate.pb.h"
 #include "absl/flags/flag.h"
 #include "absl/time/time.h"
 #include "gtest/gtest_prod.h"
 
 namespace automl_zero {
 
+// The fitnesses of the evaluated algorithms, by algorithm hash. Keeps at most
+// max_size of them, forgetting the least recently used ones.
+class SeenFitnessCache {
+    public:
+        typedef std::pair<std::vector<double>, std::vector<double>> Fitness;
+
+        // A max_size of 0 means no limit.
+        explicit SeenFitnessCache(IntegerT max_size);
+
+        SeenFitnessCache(const SeenFitnessCache& other) = delete;
+        SeenFitnessCache& operator=(const SeenFitnessCache& other) = delete;
+
+        // Returns the fitness of the algorithm with this hash, or nullptr if
+        // it is not in the cache. A hit makes it the most recently used.
+        const Fitness* Lookup(size_t hash);
+
+        // Whether the algorithm with this hash is in the cache. Leaves it
+        // where it is in the LRU order.
+        bool Contains(size_t hash) const;
+
+        // Inserts or replaces the fitness of the algorithm with this hash, as
+        // the most recently used. Once full, reuses the node of the least
+        // recently used entry.
+        void Insert(size_t hash, const Fitness& fitness);
+
+        IntegerT Size() const { return map_.size(); }
+
+    private:
+        typedef std::list<std::pair<size_t, Fitness>> List;
+
+        const IntegerT max_size_;
+        List list_;  // Least recently used at back.
+        std::unordered_map<size_t, List::iterator> map_;
+};
+
 class NSGA2 {
     public:
         NSGA2(
@@ -56,7 +99,30 @@ class NSGA2 {
             double max_allowed_error,
             double max_allowed_complexity,
             double feasible_error,
-            double max_sd_error_consider);
+            double max_sd_error_consider,
+            // Reference (worst) point for the hypervolume of the archive.
+            std::pair<double, double> hv_reference_point,
+            // Stop when the hypervolume grew by less than a fraction
+            // hv_stop_epsilon over the last hv_stop_generations generations.
+            // 0 generations disables the rule.
+            IntegerT hv_stop_generations,
+            double hv_stop_epsilon,
+            // What the archive compares. Only kErrorAndComplexityObjectives
+            // tracks the hypervolume, so the others require 0
+            // hv_stop_generations.
+            ParetoArchiveObjectives archive_objectives,
+            // What to do with children identical to an evaluated algorithm.
+            DuplicateHandling duplicate_handling,
+            IntegerT max_duplicate_remutations,
+            // How many fitnesses of evaluated algorithms to remember for
+            // the duplicate handling. 0 means no limit.
+            IntegerT max_seen_fitnesses,
+            // Pre-screening of the children with a surrogate model. Can be
+            // nullptr, in which case every child is evaluated.
+            const SurrogateSpec* surrogate_spec,
+            // Where to report the progress of the search, once per
+            // generation. Can be nullptr.
+            SearchMetrics* metrics = nullptr);
 
         NSGA2(const NSGA2& other) = delete;
 
@@ -68,9 +134,12 @@ class NSGA2 {
 
         // Runs for a given amount of time (rounded up to the nearest generation) or
         // for a certain number of train steps (rounded up to the nearest generation),
-        // whichever is first. Assumes that Init has been called. Returns the number
-        // of train steps executed in this call.
-        IntegerT Run(IntegerT max_train_steps, IntegerT max_nanos);
+        // whichever is first, or until the hypervolume stops improving. Assumes that
+        // Init has been called. Returns the number of train steps executed in this
+        // call. If `stop` is not nullptr, also returns at the end of the first
+        // generation after `*stop` became true.
+        IntegerT Run(IntegerT max_train_steps, IntegerT max_nanos,
+                     const std::atomic<bool>* stop = nullptr);
 
         // Returns the CUs/number of individuals evaluated so far. Returns an exact
         // number.
@@ -89,6 +158,16 @@ class NSGA2 {
 
         // Returns the pareto front .
         std::vector<std::pair<std::shared_ptr<const Algorithm>, std::pair<std::vector<double>, std::vector<double>>>> GetParetoFront();
+
+        // Returns every non-dominated algorithm evaluated so far, including
+        // the ones that were later crowded out of the population.
+        const ParetoArchive& GetParetoArchive() const;
+
+        // Hypervolume of the archive after each generation.
+        const std::vector<double>& GetHypervolumeHistory() const;
+
+        // Whether the last call to Run stopped because the hypervolume converged.
+        bool HypervolumeConverged() const;
         
         // Displays the statistics of the current population.
         void PopulationStats(double* error_mean, double* error_stdev, double* best_error,
@@ -97,6 +176,7 @@ class NSGA2 {
     private:
         // Used for testing. Don't know well.
         FRIEND_TEST(NSGA2Test, TimesCorrectly);
+        friend class NSGA2BenchmarkPeer;
 
         friend IntegerT PutsInPosition(
             const Algorithm&, NSGA2*);
@@ -109,12 +189,32 @@ class NSGA2 {
         // Initalize a single algorithm.
         void InitAlgorithm(std::shared_ptr<const Algorithm>* algorithm);
 
+        // Replaces the algorithm with a mutated copy, created in the arena.
+        void MutateInArena(IntegerT num_mutations,
+                           std::shared_ptr<const Algorithm>* algorithm);
+
         // Executes an algorithm and returns the pair (complexity, error).
         std::pair<std::vector<double>, std::vector<double>> Execute(std::shared_ptr<const Algorithm> algorithm);
 
+        // Executes the algorithms together, as a sequence of Execute calls
+        // would, and writes their fitnesses into `fitnesses`.
+        void ExecuteBatch(const std::vector<std::shared_ptr<const Algorithm>>& algorithms,
+                          std::vector<std::pair<std::vector<double>, std::vector<double>>>* fitnesses);
+
+        // Records the fitness of an executed algorithm in the archive and the
+        // history.
+        void RecordFitness(std::shared_ptr<const Algorithm> algorithm,
+                           const std::pair<std::vector<double>, std::vector<double>>& fitness);
+
         // Prints the progress after every progress_every function evaluations.
         void MaybePrintProgress();
 
+        // Reports the progress since the last call to metrics_, if any.
+        void UpdateMetrics();
+
+        // Checks the hypervolume-based stopping rule.
+        bool CheckHypervolumeConverged() const;
+
         // NSGA2 specific functions //
         // Perform parent selection and crossover for the population.
         void select_cross(std::vector<std::shared_ptr<const Algorithm>>& child_pop);
@@ -143,6 +243,24 @@ class NSGA2 {
         // Mutate the child population.
         std::vector<std::pair<std::vector<double>, std::vector<double>>> mutation(std::vector<std::shared_ptr<const Algorithm>>& child_pop);
 
+        // Checks whether a mutated child duplicates an algorithm in this generation
+        // or one evaluated before, and handles it according to duplicate_handling_.
+        // Returns true if the child's fitness was taken from the cache, in which case
+        // it does not need to be evaluated.
+        bool handle_duplicate(std::shared_ptr<const Algorithm>* child,
+                              std::unordered_set<size_t>* generation_hashes,
+                              std::pair<std::vector<double>, std::vector<double>>* child_fitness);
+
+        // Predicts the error of a child with the surrogate and returns whether
+        // it should be evaluated. Children predicted to be deeply dominated by
+        // the archive are discarded, except with probability
+        // surrogate_exploration_rate_. Sets `predicted_error` to NaN if the
+        // surrogate is not trained yet.
+        bool surrogate_screen(const Algorithm& child,
+                              const std::vector<double>& features,
+                              double* predicted_error,
+                              bool* predicted_dominated);
+
         // Check domination of one solution wrt the other based on the objective scores.
         IntegerT check_dominance(std::pair<std::vector<double>, std::vector<double>> fitness_1, std::pair<std::vector<double>, std::vector<double>> fitness_2);
 
@@ -199,7 +317,51 @@ class NSGA2 {
         const IntegerT max_mut_;
         const double cross_prob_;
         std::vector<double> crowd_dist_;
-        std::ofstream animation_out_;
+
+        // Search metrics, and the totals already reported to them.
+        SearchMetrics* metrics_;
+        IntegerT metrics_individuals_;
+        IntegerT metrics_train_steps_;
+        IntegerT metrics_functional_cache_hits_;
+        IntegerT metrics_functional_cache_misses_;
+        IntegerT metrics_timeouts_;
+
+        // External archive of all the non-dominated evaluated algorithms. It
+        // compares the objectives by plain Pareto dominance, without the
+        // constraints and the lexicographic complexity order of
+        // check_dominance, so it can keep algorithms that the population
+        // ranks as dominated.
+        ParetoArchive archive_;
+
+        // Hypervolume-based stopping.
+        const IntegerT hv_stop_generations_;
+        const double hv_stop_epsilon_;
+        std::vector<double> hv_history_;
+        bool hv_converged_;
+
+        // Duplicate elimination.
+        const DuplicateHandling duplicate_handling_;
+        const IntegerT max_duplicate_remutations_;
+        // Fitness of the algorithms evaluated so far, by algorithm hash.
+        SeenFitnessCache seen_fitness_;
+        IntegerT num_generation_duplicates_;
+        IntegerT num_seen_duplicates_;
+        IntegerT num_remutations_;
+        IntegerT num_reused_fitness_;
+
+        // Surrogate pre-screening. surrogate_ is nullptr if disabled.
+        std::unique_ptr<KnnSurrogate> surrogate_;
+        double surrogate_exploration_rate_;
+        double surrogate_dominance_margin_;
+        // Whether the last algorithm passed to Execute entered the archive.
+        bool last_inserted_into_archive_;
+        IntegerT num_surrogate_predictions_;
+        double surrogate_abs_error_sum_;
+        IntegerT num_surrogate_filtered_;
+        // Children predicted to be dominated but evaluated anyway, and how many
+        // of them were indeed dominated.
+        IntegerT num_surrogate_explored_;
+        IntegerT num_surrogate_explored_dominated_;
 
         // Size of the components.
         IntegerT min_setup_size_;
@@ -223,6 +385,10 @@ class NSGA2 {
         double min_allowed_complexity_;
         double max_error_sd_consider_;
 
+        // Storage of the algorithms created by the search. The children are
+        // created in its nursery, and the survivors are promoted out of it.
+        AlgorithmArena arena_;
+
         // Serializable components.
         const IntegerT population_size_;
         std::vector<std::shared_ptr<const Algorithm>> population;
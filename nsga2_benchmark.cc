@@ -0,0 +1,160 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Microbenchmarks of the survivor selection of NSGA2, at population sizes up to
+// 100k.
+
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "definitions.h"
+#include "evaluator.h"
+#include "experiment.pb.h"
+#include "generator.h"
+#include "mutator.h"
+#include "nsga2.h"
+#include "random_generator.h"
+#include "task.pb.h"
+#include "benchmark/benchmark.h"
+
+namespace automl_zero {
+
+using ::std::pair;  // NOLINT
+using ::std::vector;  // NOLINT
+
+typedef vector<pair<vector<double>, vector<double>>> FitnessList;
+
+// Gives the benchmarks access to the private selection functions.
+class NSGA2BenchmarkPeer {
+ public:
+  explicit NSGA2BenchmarkPeer(NSGA2* nsga2) : nsga2_(nsga2) {}
+
+  vector<vector<IntegerT>> NonDominatedSorting(const FitnessList& fitness) {
+    return nsga2_->non_dominated_sorting(fitness);
+  }
+
+  vector<double> CrowdingDistances(const FitnessList& fitness) {
+    return nsga2_->crowding_dist_calc(fitness);
+  }
+
+ private:
+  NSGA2* nsga2_;
+};
+
+namespace {
+
+constexpr RandomSeedT kBenchmarkSeed = 100000;
+constexpr double kMaxError = 0.5;
+constexpr double kMaxComplexity = 200.0;
+
+// Random (error, complexity) pairs, mostly within the allowed region, with
+// ties in the integer complexities as in a real search.
+FitnessList RandomFitness(const IntegerT size, std::mt19937* bit_gen) {
+  std::uniform_real_distribution<double> error(0.0, kMaxError * 1.1);
+  std::uniform_int_distribution<int> complexity(0, kMaxComplexity * 1.1);
+  FitnessList fitness;
+  fitness.reserve(size);
+  for (IntegerT i = 0; i < size; ++i) {
+    const double predict = complexity(*bit_gen);
+    const double learn = complexity(*bit_gen);
+    const double setup = complexity(*bit_gen);
+    fitness.emplace_back(
+        vector<double>({error(*bit_gen), 0.0}),
+        vector<double>({(predict + learn + setup) / 3.0, predict, learn,
+                        setup}));
+  }
+  return fitness;
+}
+
+// Builds an NSGA2 with the constraints of run_search_experiment_nsga2 and
+// runs `body` with it. Nothing is evaluated.
+template <typename Body>
+void WithNSGA2(Body body) {
+  std::mt19937 bit_gen(kBenchmarkSeed);
+  RandomGenerator rand_gen(&bit_gen);
+  Generator generator;
+  const auto task_collection = ParseTextFormat<TaskCollection>(
+      "tasks { "
+      "  scalar_linear_regression_task {} "
+      "  features_size: 4 "
+      "  num_train_examples: 10 "
+      "  num_valid_examples: 10 "
+      "  num_tasks: 1 "
+      "  eval_type: RMS_ERROR "
+      "} ");
+  Evaluator evaluator(MULTI_OBJECTIVE, task_collection, &rand_gen,
+                      nullptr,  // functional_cache
+                      nullptr,  // train_budget
+                      1000000000.0);
+  Mutator mutator;
+  NSGA2 nsga2(&rand_gen, 4, kUnlimitedIndividuals, &generator, &evaluator,
+              &mutator, true, 5, 0.7, 5, 11, 5, 11, 5, 11,
+              0.0,  // min_allowed_error
+              0.0,  // min_allowed_complexity
+              kMaxError, kMaxComplexity,
+              0.0,  // feasible_error
+              0.1,  // max_sd_error_consider
+              std::make_pair(1.0, kMaxComplexity),
+              0,  // hv_stop_generations
+              0.0,  // hv_stop_epsilon
+              kErrorAndComplexityObjectives,
+              EVALUATE_DUPLICATES, 0,
+              0,  // max_seen_fitnesses
+              nullptr);  // surrogate_spec
+  NSGA2BenchmarkPeer peer(&nsga2);
+  body(&peer, &bit_gen);
+}
+
+// Non-dominated sorting takes quadratic time per front, so it is only
+// benchmarked up to 10k individuals.
+void BM_NonDominatedSorting(benchmark::State& state) {
+  WithNSGA2([&state](NSGA2BenchmarkPeer* peer, std::mt19937* bit_gen) {
+    const FitnessList fitness = RandomFitness(state.range(0), bit_gen);
+    IntegerT num_fronts = 0;
+    for (auto _ : state) {
+      const vector<vector<IntegerT>> fronts = peer->NonDominatedSorting(fitness);
+      num_fronts = fronts.size();
+    }
+    state.counters["fronts"] = num_fronts;
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+  });
+}
+BENCHMARK(BM_NonDominatedSorting)
+    ->ArgName("population")
+    ->RangeMultiplier(10)
+    ->Range(100, 10000)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_CrowdingDistances(benchmark::State& state) {
+  WithNSGA2([&state](NSGA2BenchmarkPeer* peer, std::mt19937* bit_gen) {
+    const FitnessList fitness = RandomFitness(state.range(0), bit_gen);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(peer->CrowdingDistances(fitness));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+  });
+}
+BENCHMARK(BM_CrowdingDistances)
+    ->ArgName("population")
+    ->RangeMultiplier(10)
+    ->Range(100, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+}  // namespace automl_zero
+
+BENCHMARK_MAIN();
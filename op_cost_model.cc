@@ -0,0 +1,187 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "op_cost_model.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "executor.h"
+#include "instruction.pb.h"
+#include "memory.h"
+#include "absl/strings/str_cat.h"
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+using ::std::shared_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace {
+
+// Number of instructions executed between two clock reads, so that the
+// overhead of reading the clock is negligible even for scalar ops.
+constexpr IntegerT kCalibrationBatchSize = 256;
+
+// Keeps the compiler from optimizing away the benchmarked instructions.
+volatile double calibration_sink;
+
+// Random values in a range that is valid for every op (e.g. log, arcsin).
+template <FeatureIndexT F>
+void RandomizeMemory(RandomGenerator* rand_gen, Memory<F>* memory) {
+  for (Scalar& value : memory->scalar_) {
+    value = rand_gen->UniformDouble(0.1, 0.9);
+  }
+  for (Vector<F>& value : memory->vector_) {
+    for (FeatureIndexT i = 0; i < F; ++i) {
+      value(i) = rand_gen->UniformDouble(0.1, 0.9);
+    }
+  }
+  for (Matrix<F>& value : memory->matrix_) {
+    for (FeatureIndexT i = 0; i < F; ++i) {
+      for (FeatureIndexT j = 0; j < F; ++j) {
+        value(i, j) = rand_gen->UniformDouble(0.1, 0.9);
+      }
+    }
+  }
+}
+
+template <FeatureIndexT F>
+double MeasureOpNanos(const Op op, const IntegerT num_rounds,
+                      RandomGenerator* rand_gen) {
+  vector<Instruction> instructions;
+  instructions.reserve(kCalibrationBatchSize);
+  for (IntegerT i = 0; i < kCalibrationBatchSize; ++i) {
+    instructions.emplace_back(op, rand_gen);
+  }
+  Memory<F> memory;
+  vector<double> round_nanos;
+  round_nanos.reserve(num_rounds);
+  for (IntegerT round = 0; round < num_rounds; ++round) {
+    // Fresh memory for every round, so that repeated ops do not drift into
+    // infinities or denormals.
+    RandomizeMemory<F>(rand_gen, &memory);
+    const auto start = std::chrono::steady_clock::now();
+    for (const Instruction& instruction : instructions) {
+      ExecuteInstruction<F>(instruction, rand_gen, &memory);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    round_nanos.push_back(
+        std::chrono::duration<double, std::nano>(end - start).count());
+    calibration_sink = memory.scalar_[0];
+  }
+  std::nth_element(round_nanos.begin(),
+                   round_nanos.begin() + round_nanos.size() / 2,
+                   round_nanos.end());
+  return round_nanos[round_nanos.size() / 2] /
+         static_cast<double>(kCalibrationBatchSize);
+}
+
+template <FeatureIndexT F>
+void CalibrateOpCostsImpl(const IntegerT num_rounds, RandomGenerator* rand_gen,
+                          OpCostTable* table) {
+  for (int op = 0; op < Op_ARRAYSIZE; ++op) {
+    if (!Op_IsValid(op)) continue;
+    OpCost* cost = table->add_costs();
+    cost->set_op(static_cast<Op>(op));
+    cost->set_features_size(F);
+    cost->set_nanos(MeasureOpNanos<F>(static_cast<Op>(op), num_rounds,
+                                      rand_gen));
+  }
+}
+
+}  // namespace
+
+OpCostModel::OpCostModel(const OpCostTable& table,
+                         const FeatureIndexT features_size)
+    : nanos_(Op_ARRAYSIZE, -1.0) {
+  for (const OpCost& cost : table.costs()) {
+    if (cost.features_size() != features_size) continue;
+    CHECK_GE(cost.nanos(), 0.0);
+    nanos_[cost.op()] = cost.nanos();
+  }
+  for (int op = 0; op < Op_ARRAYSIZE; ++op) {
+    if (!Op_IsValid(op)) continue;
+    CHECK_GE(nanos_[op], 0.0)
+        << "Missing cost for op " << Op_Name(static_cast<Op>(op))
+        << " with features size " << features_size << "." << std::endl;
+  }
+}
+
+double OpCostModel::Cost(const Instruction& instruction) const {
+  return nanos_[instruction.op_];
+}
+
+double OpCostModel::Cost(
+    const vector<shared_ptr<const Instruction>>& component_function) const {
+  double cost = 0.0;
+  for (const shared_ptr<const Instruction>& instruction : component_function) {
+    cost += Cost(*instruction);
+  }
+  return cost;
+}
+
+OpCostTable ReadOpCostTable(const std::string& path) {
+  std::ifstream file(path);
+  CHECK(file.is_open()) << "Could not open " << path << "." << std::endl;
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return ParseTextFormat<OpCostTable>(contents.str());
+}
+
+OpCostTable CalibrateOpCosts(const vector<FeatureIndexT>& features_sizes,
+                             const IntegerT num_rounds,
+                             RandomGenerator* rand_gen) {
+  CHECK_GT(num_rounds, 0);
+  OpCostTable table;
+  table.set_description(absl::StrCat(
+      "Median of ", num_rounds, " rounds of ", kCalibrationBatchSize,
+      " instructions per op."));
+  for (const FeatureIndexT features_size : features_sizes) {
+    switch (features_size) {
+      case 2:
+        CalibrateOpCostsImpl<2>(num_rounds, rand_gen, &table);
+        break;
+      case 4:
+        CalibrateOpCostsImpl<4>(num_rounds, rand_gen, &table);
+        break;
+      case 8:
+        CalibrateOpCostsImpl<8>(num_rounds, rand_gen, &table);
+        break;
+      case 16:
+        CalibrateOpCostsImpl<16>(num_rounds, rand_gen, &table);
+        break;
+      case 32:
+        CalibrateOpCostsImpl<32>(num_rounds, rand_gen, &table);
+        break;
+      case 64:
+        CalibrateOpCostsImpl<64>(num_rounds, rand_gen, &table);
+        break;
+      case 128:
+        CalibrateOpCostsImpl<128>(num_rounds, rand_gen, &table);
+        break;
+      case 256:
+        CalibrateOpCostsImpl<256>(num_rounds, rand_gen, &table);
+        break;
+      default:
+        LOG(FATAL) << "Unsupported features size." << std::endl;
+    }
+  }
+  return table;
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,59 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_OP_COST_MODEL_H_
+#define AUTOML_ZERO_OP_COST_MODEL_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+#include "instruction.h"
+#include "op_cost_table.pb.h"
+#include "random_generator.h"
+
+namespace automl_zero {
+
+// Latency-based cost of instructions, looked up in a calibrated OpCostTable.
+// Unlike ComputeCostNew, which counts FLOPs, the cost is in nanoseconds on the
+// machine the table was measured on, so the cost of a component function
+// predicts the time it takes to run it once.
+class OpCostModel {
+ public:
+  // Uses the costs measured for the given features size. Dies if the table
+  // does not contain every op for this features size.
+  OpCostModel(const OpCostTable& table, FeatureIndexT features_size);
+
+  double Cost(const Instruction& instruction) const;
+  double Cost(const std::vector<std::shared_ptr<const Instruction>>&
+                  component_function) const;
+
+ private:
+  // Indexed by op.
+  std::vector<double> nanos_;
+};
+
+// Reads a text-format OpCostTable.
+OpCostTable ReadOpCostTable(const std::string& path);
+
+// Measures the latency of every op for each of the given features sizes by
+// executing batches of randomly parameterized instructions on random memory.
+// Each op is timed over `num_rounds` batches and the median is kept.
+OpCostTable CalibrateOpCosts(const std::vector<FeatureIndexT>& features_sizes,
+                             IntegerT num_rounds, RandomGenerator* rand_gen);
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_OP_COST_MODEL_H_
@@ -0,0 +1,84 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "op_cost_model.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "definitions.h"
+#include "instruction.h"
+#include "instruction.pb.h"
+#include "op_cost_table.pb.h"
+#include "random_generator.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::make_shared;  // NOLINT
+using ::std::mt19937;  // NOLINT
+using ::std::shared_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+// A table where every op costs 1ns, except for the given one.
+OpCostTable UniformTable(FeatureIndexT features_size, Op op, double nanos) {
+  OpCostTable table;
+  for (int i = 0; i < Op_ARRAYSIZE; ++i) {
+    if (!Op_IsValid(i)) continue;
+    OpCost* cost = table.add_costs();
+    cost->set_op(static_cast<Op>(i));
+    cost->set_features_size(features_size);
+    cost->set_nanos(i == op ? nanos : 1.0);
+  }
+  return table;
+}
+
+TEST(OpCostModelTest, SumsTheCostsOfTheInstructions) {
+  OpCostTable table = UniformTable(4, MATRIX_MATRIX_PRODUCT_OP, 50.0);
+  // Costs for another features size are ignored.
+  table.MergeFrom(UniformTable(8, MATRIX_MATRIX_PRODUCT_OP, 500.0));
+  const OpCostModel model(table, 4);
+  const vector<shared_ptr<const Instruction>> component_function = {
+      make_shared<const Instruction>(MATRIX_MATRIX_PRODUCT_OP, 0, 1, 2),
+      make_shared<const Instruction>(SCALAR_SUM_OP, 0, 1, 2),
+      make_shared<const Instruction>(MATRIX_MATRIX_PRODUCT_OP, 1, 1, 2)};
+  EXPECT_DOUBLE_EQ(model.Cost(*component_function[0]), 50.0);
+  EXPECT_DOUBLE_EQ(model.Cost(component_function), 101.0);
+}
+
+TEST(OpCostModelTest, CalibratesEveryOp) {
+  mt19937 bit_gen(1000);
+  RandomGenerator rand_gen(&bit_gen);
+  const OpCostTable table = CalibrateOpCosts({4, 32}, 20, &rand_gen);
+  IntegerT num_valid_ops = 0;
+  for (int i = 0; i < Op_ARRAYSIZE; ++i) {
+    if (Op_IsValid(i)) ++num_valid_ops;
+  }
+  EXPECT_EQ(table.costs_size(), 2 * num_valid_ops);
+  for (const OpCost& cost : table.costs()) {
+    EXPECT_GE(cost.nanos(), 0.0);
+  }
+
+  // Every op is covered, so the models can be built.
+  const OpCostModel small_model(table, 4);
+  const OpCostModel large_model(table, 32);
+  const Instruction matrix_product(MATRIX_MATRIX_PRODUCT_OP, 0, 1, 2);
+  EXPECT_GT(large_model.Cost(matrix_product),
+            small_model.Cost(matrix_product));
+  EXPECT_GT(large_model.Cost(matrix_product),
+            large_model.Cost(Instruction(SCALAR_SUM_OP, 0, 1, 2)));
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,254 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "cpu_topology.h"
+
+namespace automl_zero {
+
+void ParallelFor(const IntegerT num_iterations, const IntegerT num_threads,
+                 const std::function<void(IntegerT)>& body) {
+  const IntegerT num_workers = std::min(num_threads, num_iterations);
+  if (num_workers <= 1) {
+    for (IntegerT i = 0; i < num_iterations; ++i) {
+      body(i);
+    }
+    return;
+  }
+
+  std::atomic<IntegerT> next_iteration(0);
+  auto work = [&]() {
+    for (IntegerT i = next_iteration++; i < num_iterations;
+         i = next_iteration++) {
+      body(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_workers - 1);
+  for (IntegerT i = 0; i < num_workers - 1; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+IntegerT ParallelForUntil(
+    const IntegerT num_iterations, const IntegerT num_threads,
+    const std::function<bool(IntegerT, const std::atomic<bool>* stop)>& body) {
+  // Handing out the next iteration and stopping happen together, so that the
+  // started iterations are always a prefix.
+  std::mutex mutex;
+  IntegerT num_started = 0;  // Guarded by mutex.
+  // The lowest iteration that returned true, or num_iterations.
+  IntegerT first_stopping = num_iterations;  // Guarded by mutex.
+  std::vector<std::atomic<bool>> stops(num_iterations);
+  auto next_iteration = [&](IntegerT* iteration) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (first_stopping < num_iterations || num_started >= num_iterations) {
+      return false;
+    }
+    *iteration = num_started++;
+    stops[*iteration] = false;
+    return true;
+  };
+  auto stop_after = [&](const IntegerT iteration) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (iteration >= first_stopping) return;
+    first_stopping = iteration;
+    for (IntegerT i = iteration + 1; i < num_started; ++i) stops[i] = true;
+  };
+  ParallelFor(std::min(num_threads, num_iterations), num_threads,
+              [&](IntegerT) {
+                IntegerT iteration;
+                while (next_iteration(&iteration)) {
+                  if (body(iteration, &stops[iteration])) {
+                    stop_after(iteration);
+                  }
+                }
+              });
+  return num_started;
+}
+
+IntegerT NumHardwareThreads() {
+  return std::max<IntegerT>(1, std::thread::hardware_concurrency());
+}
+
+namespace {
+
+// The pool the calling thread belongs to, if any, and the index of its queue.
+thread_local const ThreadPool* current_thread_pool = nullptr;
+thread_local IntegerT current_queue_index = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(const IntegerT num_threads,
+                       const CpuTopology* topology)
+    : num_threads_(std::max<IntegerT>(1, num_threads)),
+      num_queued_ranges_(0),
+      next_queue_index_(0),
+      num_waiting_threads_(0),
+      stop_(false) {
+  for (IntegerT i = 0; i < num_threads_ - 1; ++i) {
+    queues_.push_back(std::make_unique<WorkQueue>());
+  }
+  threads_.reserve(num_threads_ - 1);
+  for (IntegerT i = 0; i < num_threads_ - 1; ++i) {
+    if (topology == nullptr) {
+      threads_.emplace_back([this, i]() { Work(i); });
+      continue;
+    }
+    const int cpu = topology->ThreadCpu(i);
+    const IntegerT node = topology->ThreadNode(i);
+    threads_.emplace_back([this, i, cpu, node]() {
+      if (!PinCurrentThread({cpu}, node)) {
+        LOG(WARNING) << "Could not pin a thread to CPU " << cpu << ".";
+      }
+      Work(i);
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  state_changed_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+IntegerT ThreadPool::NumThreads() const {
+  return num_threads_;
+}
+
+void ThreadPool::ParallelFor(const IntegerT num_iterations,
+                             const std::function<void(IntegerT)>& body) {
+  if (num_threads_ <= 1 || num_iterations <= 1) {
+    for (IntegerT i = 0; i < num_iterations; ++i) {
+      body(i);
+    }
+    return;
+  }
+  Loop loop;
+  loop.body = &body;
+  loop.num_unfinished = num_iterations;
+  const IntegerT queue_index = QueueIndex();
+  Run(queue_index, {&loop, 0, num_iterations});
+  // Help with whatever is queued until the other threads finish the last
+  // iterations of the loop.
+  Range range;
+  while (loop.num_unfinished > 0) {
+    if (Take(queue_index, &range)) {
+      Run(queue_index, range);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++num_waiting_threads_;
+    state_changed_.wait(lock, [this, &loop]() {
+      return loop.num_unfinished == 0 || num_queued_ranges_ > 0;
+    });
+    --num_waiting_threads_;
+  }
+}
+
+IntegerT ThreadPool::QueueIndex() {
+  if (current_thread_pool == this) return current_queue_index;
+  return next_queue_index_++ % queues_.size();
+}
+
+void ThreadPool::Push(const IntegerT queue_index, const Range& range) {
+  {
+    std::lock_guard<std::mutex> lock(queues_[queue_index]->mutex);
+    queues_[queue_index]->ranges.push_back(range);
+  }
+  ++num_queued_ranges_;
+  // A thread about to wait counts itself before it checks for ranges, so
+  // either it sees this one or it is counted here.
+  if (num_waiting_threads_ == 0) return;
+  {
+    // Taking the lock orders the push with the checks of the waiting
+    // threads, so none of them misses it.
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  state_changed_.notify_one();
+}
+
+bool ThreadPool::Take(const IntegerT queue_index, Range* range) {
+  if (num_queued_ranges_ == 0) return false;
+  for (IntegerT i = 0; i < queues_.size(); ++i) {
+    WorkQueue& queue = *queues_[(queue_index + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.ranges.empty()) continue;
+    if (i == 0) {
+      *range = queue.ranges.back();
+      queue.ranges.pop_back();
+    } else {
+      *range = queue.ranges.front();
+      queue.ranges.pop_front();
+    }
+    --num_queued_ranges_;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::Run(const IntegerT queue_index, Range range) {
+  while (range.end - range.begin > 1) {
+    const IntegerT middle = range.begin + (range.end - range.begin) / 2;
+    Push(queue_index, {range.loop, middle, range.end});
+    range.end = middle;
+  }
+  Loop* loop = range.loop;
+  (*loop->body)(range.begin);
+  if (--loop->num_unfinished == 0 && num_waiting_threads_ > 0) {
+    // The caller of ParallelFor may be waiting for it. The loop may be gone
+    // as soon as the count reaches zero, so it must not be touched anymore.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+    }
+    state_changed_.notify_all();
+  }
+}
+
+void ThreadPool::Work(const IntegerT queue_index) {
+  current_thread_pool = this;
+  current_queue_index = queue_index;
+  Range range;
+  while (true) {
+    if (Take(queue_index, &range)) {
+      Run(queue_index, range);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++num_waiting_threads_;
+    state_changed_.wait(
+        lock, [this]() { return stop_ || num_queued_ranges_ > 0; });
+    --num_waiting_threads_;
+    if (stop_) return;
+  }
+}
+
+}  // namespace automl_zero
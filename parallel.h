@@ -0,0 +1,143 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_PARALLEL_H_
+#define AUTOML_ZERO_PARALLEL_H_
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "definitions.h"
+
+namespace automl_zero {
+
+class CpuTopology;
+
+// Calls `body(i)` for every i in [0, num_iterations), spread over up to
+// `num_threads` threads (including the calling one). Iterations are handed out
+// one at a time, so uneven iterations balance out. Returns once all the
+// iterations are done. `body` must be safe to call concurrently for different
+// iterations. With `num_threads` <= 1, runs the iterations in order.
+void ParallelFor(IntegerT num_iterations, IntegerT num_threads,
+                 const std::function<void(IntegerT)>& body);
+
+// Like ParallelFor, but iterations are started in increasing order, and an
+// iteration that returns true stops the ones after it, as if they had run one
+// after the other: no new iteration is started, and `*stop` becomes true for
+// the running iterations numbered above it, which may poll it to return
+// early. The iterations numbered below it are not stopped, and may stop the
+// others in turn. Returns the number of iterations that were started, which
+// are always the first ones.
+IntegerT ParallelForUntil(
+    IntegerT num_iterations, IntegerT num_threads,
+    const std::function<bool(IntegerT, const std::atomic<bool>* stop)>& body);
+
+// The number of hardware threads, or 1 if it cannot be determined.
+IntegerT NumHardwareThreads();
+
+// A fixed set of threads that run the iterations of ParallelFor calls. Unlike
+// the free ParallelFor, the threads are started once, so the loops can be
+// short, e.g. over the tasks of one evaluation. Thread-safe: several threads
+// can run loops on the same pool at once, e.g. the experiments, and share its
+// threads.
+//
+// The iterations are scheduled by work stealing: each thread has a deque of
+// ranges of iterations. A thread splits the range it takes in halves, keeping
+// one and pushing the other to the back of its deque, down to single
+// iterations; it then takes its next range from the back of its deque, or,
+// if that is empty, steals one from the front of the deque of another thread.
+// The stolen ranges are thus the largest ones, and threads only contend when
+// one runs out of work: a split only locks the deque of its thread, and only
+// wakes up a thread, under the lock of the pool, if one is waiting. So
+// iterations whose costs differ by orders of magnitude still keep all the
+// threads busy.
+class ThreadPool {
+ public:
+  // Starts `num_threads` - 1 threads. The thread that calls ParallelFor makes
+  // up the last one. If `topology` is not nullptr, each thread of the pool is
+  // pinned to a CPU of it, spread over the NUMA nodes as by
+  // CpuTopology::ThreadCpu, so that CurrentNumaNode tells the iterations which
+  // node they run on.
+  explicit ThreadPool(IntegerT num_threads,
+                      const CpuTopology* topology = nullptr);
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+  ~ThreadPool();
+
+  IntegerT NumThreads() const;
+
+  // As the free ParallelFor, on the threads of this pool. The calling thread
+  // runs iterations too, possibly of other loops while it waits for the last
+  // ones of its own, so it can be called from within an iteration.
+  void ParallelFor(IntegerT num_iterations,
+                   const std::function<void(IntegerT)>& body);
+
+ private:
+  // The iterations of one ParallelFor call.
+  struct Loop {
+    const std::function<void(IntegerT)>* body;
+    std::atomic<IntegerT> num_unfinished;
+  };
+
+  // The iterations [begin, end) of a loop.
+  struct Range {
+    Loop* loop;
+    IntegerT begin;
+    IntegerT end;
+  };
+
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Range> ranges;  // Guarded by mutex.
+  };
+
+  // The index of the queue of the calling thread. Threads from outside the
+  // pool get the queues in turn.
+  IntegerT QueueIndex();
+
+  void Push(IntegerT queue_index, const Range& range);
+  // Takes the range at the back of the queue, or, if it is empty, the one at
+  // the front of another queue. Returns false if all the queues are empty.
+  bool Take(IntegerT queue_index, Range* range);
+
+  // Runs the first iteration of `range`, after pushing the others.
+  void Run(IntegerT queue_index, Range range);
+
+  void Work(IntegerT queue_index);
+
+  const IntegerT num_threads_;
+  // One per thread of the pool.
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::atomic<IntegerT> num_queued_ranges_;
+  std::atomic<IntegerT> next_queue_index_;
+
+  // Idle threads wait on state_changed_ for new ranges, or for the end of
+  // their loop. num_waiting_threads_ counts them, so that the threads that
+  // push ranges or end loops only notify them when there are any.
+  std::atomic<IntegerT> num_waiting_threads_;
+  std::mutex mutex_;
+  std::condition_variable state_changed_;
+  bool stop_;  // Guarded by mutex_.
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_PARALLEL_H_
@@ -0,0 +1,220 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel.h"
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "cpu_topology.h"
+#include "definitions.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+TEST(ParallelForTest, RunsEveryIterationOnce) {
+  for (const IntegerT num_threads : {0, 1, 4, 100}) {
+    std::vector<std::atomic<IntegerT>> counts(37);
+    for (std::atomic<IntegerT>& count : counts) count = 0;
+    ParallelFor(counts.size(), num_threads,
+                [&counts](IntegerT i) { ++counts[i]; });
+    for (const std::atomic<IntegerT>& count : counts) {
+      EXPECT_EQ(count, 1);
+    }
+  }
+}
+
+TEST(ParallelForTest, RunsInOrderWithOneThread) {
+  std::vector<IntegerT> order;
+  ParallelFor(5, 1, [&order](IntegerT i) { order.push_back(i); });
+  EXPECT_EQ(order, std::vector<IntegerT>({0, 1, 2, 3, 4}));
+}
+
+TEST(ParallelForTest, HandlesNoIterations) {
+  ParallelFor(0, 4, [](IntegerT i) { FAIL(); });
+}
+
+TEST(ParallelForUntilTest, RunsEveryIterationIfNotStopped) {
+  for (const IntegerT num_threads : {1, 4}) {
+    std::vector<std::atomic<IntegerT>> counts(37);
+    for (std::atomic<IntegerT>& count : counts) count = 0;
+    EXPECT_EQ(ParallelForUntil(counts.size(), num_threads,
+                               [&counts](IntegerT i,
+                                         const std::atomic<bool>* stop) {
+                                 EXPECT_FALSE(*stop);
+                                 ++counts[i];
+                                 return false;
+                               }),
+              counts.size());
+    for (const std::atomic<IntegerT>& count : counts) {
+      EXPECT_EQ(count, 1);
+    }
+  }
+}
+
+TEST(ParallelForUntilTest, StopsAfterIterationReturnsTrue) {
+  std::vector<IntegerT> order;
+  EXPECT_EQ(ParallelForUntil(10, 1,
+                             [&order](IntegerT i,
+                                      const std::atomic<bool>* stop) {
+                               order.push_back(i);
+                               return i == 3;
+                             }),
+            4);
+  EXPECT_EQ(order, std::vector<IntegerT>({0, 1, 2, 3}));
+}
+
+TEST(ParallelForUntilTest, StartsAPrefixWhenStoppedConcurrently) {
+  for (IntegerT repeat = 0; repeat < 20; ++repeat) {
+    std::vector<std::atomic<IntegerT>> counts(1000);
+    for (std::atomic<IntegerT>& count : counts) count = 0;
+    const IntegerT num_started = ParallelForUntil(
+        counts.size(), 8, [&counts](IntegerT i, const std::atomic<bool>*) {
+          ++counts[i];
+          return i == 100;
+        });
+    EXPECT_GT(num_started, 100);
+    for (IntegerT i = 0; i < counts.size(); ++i) {
+      EXPECT_EQ(counts[i], i < num_started ? 1 : 0);
+    }
+  }
+}
+
+TEST(ParallelForUntilTest, OnlyStopsTheLaterIterations) {
+  // Iteration 3 stops once iterations 0 to 4 are all running. Iteration 4,
+  // and any later one, waits to be stopped, and the earlier ones wait for
+  // iteration 4 to be stopped before they check that they were not.
+  std::atomic<IntegerT> num_running(0);
+  std::atomic<bool> fourth_stopped(false);
+  std::vector<std::atomic<bool>> stopped(8);
+  for (std::atomic<bool>& iteration_stopped : stopped) {
+    iteration_stopped = false;
+  }
+  const IntegerT num_started = ParallelForUntil(
+      8, 8, [&](IntegerT i, const std::atomic<bool>* stop) {
+        if (i <= 4) ++num_running;
+        if (i == 3) {
+          while (num_running < 5) std::this_thread::yield();
+          return true;
+        }
+        if (i > 3) {
+          while (!*stop) std::this_thread::yield();
+          if (i == 4) fourth_stopped = true;
+        } else {
+          while (!fourth_stopped) std::this_thread::yield();
+        }
+        stopped[i] = stop->load();
+        return false;
+      });
+  EXPECT_GE(num_started, 5);
+  for (IntegerT i = 0; i < num_started; ++i) {
+    EXPECT_EQ(stopped[i], i > 3) << i;
+  }
+}
+
+TEST(ThreadPoolTest, RunsEveryIterationOnce) {
+  for (const IntegerT num_threads : {0, 1, 4}) {
+    ThreadPool thread_pool(num_threads);
+    for (const IntegerT num_iterations : {0, 1, 37}) {
+      std::vector<std::atomic<IntegerT>> counts(num_iterations);
+      for (std::atomic<IntegerT>& count : counts) count = 0;
+      thread_pool.ParallelFor(counts.size(),
+                              [&counts](IntegerT i) { ++counts[i]; });
+      for (const std::atomic<IntegerT>& count : counts) {
+        EXPECT_EQ(count, 1);
+      }
+    }
+  }
+}
+
+TEST(ThreadPoolTest, RunsLoopsFromSeveralThreadsAndWithinIterations) {
+  ThreadPool thread_pool(4);
+  EXPECT_EQ(thread_pool.NumThreads(), 4);
+  std::vector<std::atomic<IntegerT>> counts(8 * 100);
+  for (std::atomic<IntegerT>& count : counts) count = 0;
+  ParallelFor(8, 8, [&](IntegerT caller) {
+    thread_pool.ParallelFor(10, [&](IntegerT outer) {
+      thread_pool.ParallelFor(10, [&](IntegerT inner) {
+        ++counts[caller * 100 + outer * 10 + inner];
+      });
+    });
+  });
+  for (const std::atomic<IntegerT>& count : counts) {
+    EXPECT_EQ(count, 1);
+  }
+}
+
+TEST(ThreadPoolTest, SpreadsTheIterationsOverTheThreads) {
+  ThreadPool thread_pool(4);
+  // Each iteration waits for all of them to start, which they only can if
+  // the other threads take their share.
+  std::atomic<IntegerT> num_started(0);
+  std::atomic<IntegerT> num_all_started(0);
+  thread_pool.ParallelFor(4, [&](IntegerT i) {
+    ++num_started;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (num_started < 4 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+    if (num_started == 4) ++num_all_started;
+  });
+  EXPECT_EQ(num_all_started, 4);
+}
+
+TEST(ThreadPoolTest, OtherThreadsRunTheRestDuringASlowIteration) {
+  ThreadPool thread_pool(4);
+  // The first iteration only ends once all the others are done.
+  std::atomic<IntegerT> num_finished(0);
+  bool slow_iteration_saw_the_others = false;
+  thread_pool.ParallelFor(1000, [&](IntegerT i) {
+    if (i == 0) {
+      const auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(30);
+      while (num_finished < 999 &&
+             std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+      }
+      slow_iteration_saw_the_others = num_finished == 999;
+    } else {
+      ++num_finished;
+    }
+  });
+  EXPECT_TRUE(slow_iteration_saw_the_others);
+}
+
+TEST(ThreadPoolTest, PinnedThreadsRunOnTheirNodes) {
+  // Two nodes that share a CPU that is surely available.
+  const int cpu = CpuTopology::Detect().NodeCpus(0)[0];
+  const CpuTopology topology({{cpu}, {cpu}});
+  ThreadPool thread_pool(3, &topology);
+  std::vector<std::atomic<IntegerT>> counts(100);
+  for (std::atomic<IntegerT>& count : counts) count = 0;
+  std::atomic<IntegerT> num_bad_nodes(0);
+  thread_pool.ParallelFor(counts.size(), [&](IntegerT i) {
+    ++counts[i];
+    const IntegerT node = CurrentNumaNode();
+    if (node < 0 || node >= topology.NumNodes()) ++num_bad_nodes;
+  });
+  for (const std::atomic<IntegerT>& count : counts) {
+    EXPECT_EQ(count, 1);
+  }
+  EXPECT_EQ(num_bad_nodes, 0);
+  // The calling thread is not pinned.
+  EXPECT_EQ(CurrentNumaNode(), 0);
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,487 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pareto_archive.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "definitions.h"
+#include "absl/memory/memory.h"
+
+namespace automl_zero {
+
+using ::absl::make_unique;  // NOLINT
+using ::std::map;  // NOLINT
+using ::std::move;  // NOLINT
+using ::std::shared_ptr;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+// Leaves holding more points than this are split.
+constexpr IntegerT kNdTreeMaxLeafSize = 20;
+// Number of children created when splitting a leaf.
+constexpr IntegerT kNdTreeNumChildren = 6;
+
+namespace internal {
+
+struct NdTreeNode {
+  bool IsLeaf() const { return children.empty(); }
+
+  // Componentwise min and max over all points in the subtree. Empty if the
+  // subtree is empty.
+  vector<double> ideal;
+  vector<double> nadir;
+
+  // Only one of these is non-empty.
+  vector<unique_ptr<NdTreeNode>> children;
+  vector<ParetoArchive::Entry> entries;
+};
+
+}  // namespace internal
+
+using internal::NdTreeNode;
+
+namespace {
+
+double SquaredDistance(const vector<double>& a, const vector<double>& b) {
+  double distance = 0.0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    distance += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return distance;
+}
+
+double SquaredDistanceToMidpoint(
+    const NdTreeNode& node, const vector<double>& point) {
+  double distance = 0.0;
+  for (size_t i = 0; i < point.size(); ++i) {
+    const double midpoint = 0.5 * (node.ideal[i] + node.nadir[i]);
+    distance += (point[i] - midpoint) * (point[i] - midpoint);
+  }
+  return distance;
+}
+
+void ExtendBounds(const vector<double>& lower, const vector<double>& upper,
+                  NdTreeNode* node) {
+  if (node->ideal.empty()) {
+    node->ideal = lower;
+    node->nadir = upper;
+    return;
+  }
+  for (size_t i = 0; i < lower.size(); ++i) {
+    node->ideal[i] = std::min(node->ideal[i], lower[i]);
+    node->nadir[i] = std::max(node->nadir[i], upper[i]);
+  }
+}
+
+void RecomputeBounds(NdTreeNode* node) {
+  node->ideal.clear();
+  node->nadir.clear();
+  for (const ParetoArchive::Entry& entry : node->entries) {
+    ExtendBounds(entry.objectives, entry.objectives, node);
+  }
+  for (const unique_ptr<NdTreeNode>& child : node->children) {
+    ExtendBounds(child->ideal, child->nadir, node);
+  }
+}
+
+// Returns false if `point` is weakly dominated by a point in the subtree.
+// Otherwise removes from the subtree all the points that `point` dominates and
+// counts them in `num_removed`. The subtree must not be empty.
+bool UpdateNode(const vector<double>& point, NdTreeNode* node,
+                IntegerT* num_removed) {
+  if (WeaklyDominates(node->nadir, point)) {
+    // Every point in the subtree weakly dominates `point`.
+    return false;
+  }
+  if (!WeaklyDominates(node->ideal, point) &&
+      !WeaklyDominates(point, node->nadir)) {
+    // No point in the subtree can dominate or be dominated by `point`.
+    return true;
+  }
+  if (node->IsLeaf()) {
+    auto entry_it = node->entries.begin();
+    while (entry_it != node->entries.end()) {
+      if (WeaklyDominates(entry_it->objectives, point)) {
+        return false;
+      } else if (Dominates(point, entry_it->objectives)) {
+        entry_it = node->entries.erase(entry_it);
+        ++*num_removed;
+      } else {
+        ++entry_it;
+      }
+    }
+  } else {
+    auto child_it = node->children.begin();
+    while (child_it != node->children.end()) {
+      NdTreeNode* child = child_it->get();
+      if (Dominates(point, child->ideal)) {
+        // `point` dominates the whole subtree.
+        vector<NdTreeNode*> pending = {child};
+        while (!pending.empty()) {
+          NdTreeNode* current = pending.back();
+          pending.pop_back();
+          *num_removed += current->entries.size();
+          for (unique_ptr<NdTreeNode>& grandchild : current->children) {
+            pending.push_back(grandchild.get());
+          }
+        }
+        child_it = node->children.erase(child_it);
+        continue;
+      }
+      if (!UpdateNode(point, child, num_removed)) {
+        // Points in a mutually non-dominated set that dominate `point` cannot
+        // coexist with points dominated by it, so nothing was removed yet.
+        return false;
+      }
+      if (child->entries.empty() && child->children.empty()) {
+        child_it = node->children.erase(child_it);
+      } else {
+        ++child_it;
+      }
+    }
+    if (node->children.size() == 1) {
+      // Collapse chains of single children.
+      unique_ptr<NdTreeNode> only_child = move(node->children[0]);
+      *node = move(*only_child);
+    }
+  }
+  RecomputeBounds(node);
+  return true;
+}
+
+// Returns true if `point` is weakly dominated by a point in the subtree.
+bool IsCovered(const vector<double>& point, const NdTreeNode& node) {
+  if (node.ideal.empty() || !WeaklyDominates(node.ideal, point)) {
+    return false;
+  }
+  if (WeaklyDominates(node.nadir, point)) {
+    return true;
+  }
+  for (const ParetoArchive::Entry& entry : node.entries) {
+    if (WeaklyDominates(entry.objectives, point)) return true;
+  }
+  for (const unique_ptr<NdTreeNode>& child : node.children) {
+    if (IsCovered(point, *child)) return true;
+  }
+  return false;
+}
+
+// Distributes the entries of an overfull leaf among new children. The seeds of
+// the children are chosen to be far apart from each other.
+void SplitLeaf(NdTreeNode* node) {
+  vector<ParetoArchive::Entry> entries = move(node->entries);
+  node->entries.clear();
+  const size_t num_entries = entries.size();
+
+  // The first seed is the point farthest, on average, from all the others.
+  size_t first_seed = 0;
+  double max_total_distance = -1.0;
+  for (size_t i = 0; i < num_entries; ++i) {
+    double total_distance = 0.0;
+    for (size_t j = 0; j < num_entries; ++j) {
+      total_distance +=
+          SquaredDistance(entries[i].objectives, entries[j].objectives);
+    }
+    if (total_distance > max_total_distance) {
+      max_total_distance = total_distance;
+      first_seed = i;
+    }
+  }
+
+  // Each next seed is the point farthest from the closest seed so far.
+  vector<bool> is_seed(num_entries, false);
+  vector<double> distance_to_seeds(
+      num_entries, std::numeric_limits<double>::infinity());
+  size_t seed = first_seed;
+  for (IntegerT child_index = 0; child_index < kNdTreeNumChildren;
+       ++child_index) {
+    is_seed[seed] = true;
+    auto child = make_unique<NdTreeNode>();
+    ExtendBounds(entries[seed].objectives, entries[seed].objectives,
+                 child.get());
+    child->entries.push_back(move(entries[seed]));
+    node->children.push_back(move(child));
+    const vector<double>& seed_objectives =
+        node->children.back()->entries.back().objectives;
+    size_t next_seed = num_entries;
+    double max_distance = -1.0;
+    for (size_t i = 0; i < num_entries; ++i) {
+      if (is_seed[i]) continue;
+      distance_to_seeds[i] = std::min(
+          distance_to_seeds[i],
+          SquaredDistance(entries[i].objectives, seed_objectives));
+      if (distance_to_seeds[i] > max_distance) {
+        max_distance = distance_to_seeds[i];
+        next_seed = i;
+      }
+    }
+    if (next_seed == num_entries) break;
+    seed = next_seed;
+  }
+
+  // Every other point goes to the child with the closest midpoint.
+  for (size_t i = 0; i < num_entries; ++i) {
+    if (is_seed[i]) continue;
+    NdTreeNode* closest = nullptr;
+    double min_distance = std::numeric_limits<double>::infinity();
+    for (unique_ptr<NdTreeNode>& child : node->children) {
+      const double distance =
+          SquaredDistanceToMidpoint(*child, entries[i].objectives);
+      if (closest == nullptr || distance < min_distance) {
+        min_distance = distance;
+        closest = child.get();
+      }
+    }
+    ExtendBounds(entries[i].objectives, entries[i].objectives, closest);
+    closest->entries.push_back(move(entries[i]));
+  }
+}
+
+// Inserts a point known to be non-dominated by, and to not dominate, any point
+// in the subtree.
+void InsertIntoNode(ParetoArchive::Entry entry, NdTreeNode* node) {
+  ExtendBounds(entry.objectives, entry.objectives, node);
+  if (node->IsLeaf()) {
+    node->entries.push_back(move(entry));
+    if (node->entries.size() > kNdTreeMaxLeafSize) {
+      SplitLeaf(node);
+    }
+    return;
+  }
+  NdTreeNode* closest = nullptr;
+  double min_distance = std::numeric_limits<double>::infinity();
+  for (unique_ptr<NdTreeNode>& child : node->children) {
+    const double distance =
+        SquaredDistanceToMidpoint(*child, entry.objectives);
+    if (closest == nullptr || distance < min_distance) {
+      min_distance = distance;
+      closest = child.get();
+    }
+  }
+  InsertIntoNode(move(entry), closest);
+}
+
+void CollectEntries(const NdTreeNode& node,
+                    vector<ParetoArchive::Entry>* entries) {
+  for (const ParetoArchive::Entry& entry : node.entries) {
+    entries->push_back(entry);
+  }
+  for (const unique_ptr<NdTreeNode>& child : node.children) {
+    CollectEntries(*child, entries);
+  }
+}
+
+}  // namespace
+
+bool WeaklyDominates(const vector<double>& a, const vector<double>& b) {
+  CHECK_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] > b[i]) return false;
+  }
+  return true;
+}
+
+bool Dominates(const vector<double>& a, const vector<double>& b) {
+  return WeaklyDominates(a, b) && a != b;
+}
+
+ParetoArchive::ParetoArchive(const ParetoArchiveObjectives objectives)
+    : objectives_(objectives),
+      track_hypervolume_(false),
+      reference_error_(0.0),
+      reference_complexity_(0.0),
+      hypervolume_(0.0),
+      nd_tree_root_(make_unique<NdTreeNode>()),
+      nd_tree_size_(0) {}
+
+ParetoArchive::~ParetoArchive() {}
+
+bool ParetoArchive::Insert(shared_ptr<const Algorithm> algorithm,
+                           const MultiFitness& fitness) {
+  Entry entry;
+  entry.objectives = ExtractObjectives(fitness);
+  for (const double objective : entry.objectives) {
+    if (std::isnan(objective)) return false;
+  }
+  entry.algorithm = move(algorithm);
+  entry.fitness = fitness;
+
+  if (objectives_ == kErrorAndComplexityObjectives) {
+    return Insert2D(move(entry));
+  }
+
+  if (nd_tree_size_ > 0) {
+    IntegerT num_removed = 0;
+    if (!UpdateNode(entry.objectives, nd_tree_root_.get(), &num_removed)) {
+      return false;
+    }
+    nd_tree_size_ -= num_removed;
+    if (nd_tree_size_ == 0) {
+      nd_tree_root_ = make_unique<NdTreeNode>();
+    }
+  }
+  InsertIntoNode(move(entry), nd_tree_root_.get());
+  ++nd_tree_size_;
+  return true;
+}
+
+void ParetoArchive::Merge(const ParetoArchive& other) {
+  for (const Entry& entry : other.Entries()) {
+    Insert(entry.algorithm, entry.fitness);
+  }
+}
+
+bool ParetoArchive::IsDominated(const MultiFitness& fitness) const {
+  const vector<double> objectives = ExtractObjectives(fitness);
+  if (objectives_ == kErrorAndComplexityObjectives) {
+    return IsDominated2D(objectives);
+  }
+  return IsCovered(objectives, *nd_tree_root_);
+}
+
+vector<ParetoArchive::Entry> ParetoArchive::Entries() const {
+  vector<Entry> entries;
+  if (objectives_ == kErrorAndComplexityObjectives) {
+    entries.reserve(front_2d_.size());
+    for (const auto& error_and_entry : front_2d_) {
+      entries.push_back(error_and_entry.second);
+    }
+    return entries;
+  }
+  entries.reserve(nd_tree_size_);
+  CollectEntries(*nd_tree_root_, &entries);
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.objectives < b.objectives;
+            });
+  return entries;
+}
+
+IntegerT ParetoArchive::Size() const {
+  if (objectives_ == kErrorAndComplexityObjectives) {
+    return front_2d_.size();
+  }
+  return nd_tree_size_;
+}
+
+IntegerT ParetoArchive::NumObjectives() const {
+  switch (objectives_) {
+    case kErrorAndComplexityObjectives:
+      return 2;
+    case kErrorAndComponentComplexityObjectives:
+      return 4;
+  }
+  LOG(FATAL) << "Unsupported archive objectives." << std::endl;
+}
+
+vector<double> ParetoArchive::ExtractObjectives(
+    const MultiFitness& fitness) const {
+  CHECK(!fitness.first.empty());
+  switch (objectives_) {
+    case kErrorAndComplexityObjectives:
+      CHECK(!fitness.second.empty());
+      return {fitness.first[0], fitness.second.back()};
+    case kErrorAndComponentComplexityObjectives:
+      CHECK_GE(fitness.second.size(), 3);
+      return {fitness.first[0], fitness.second[0], fitness.second[1],
+              fitness.second[2]};
+  }
+  LOG(FATAL) << "Unsupported archive objectives." << std::endl;
+}
+
+void ParetoArchive::TrackHypervolume(const double reference_error,
+                                     const double reference_complexity) {
+  CHECK(objectives_ == kErrorAndComplexityObjectives)
+      << "Hypervolume is only tracked for two objectives." << std::endl;
+  track_hypervolume_ = true;
+  reference_error_ = reference_error;
+  reference_complexity_ = reference_complexity;
+  hypervolume_ = 0.0;
+  for (auto it = front_2d_.begin(); it != front_2d_.end(); ++it) {
+    auto next_it = std::next(it);
+    hypervolume_ += HypervolumeSlice(
+        it->second,
+        next_it == front_2d_.end() ? reference_error_ : next_it->first);
+  }
+}
+
+double ParetoArchive::Hypervolume() const {
+  CHECK(track_hypervolume_);
+  return hypervolume_;
+}
+
+bool ParetoArchive::TracksHypervolume() const { return track_hypervolume_; }
+
+double ParetoArchive::HypervolumeSlice(const Entry& entry,
+                                       const double next_error) const {
+  const double width =
+      std::min(next_error, reference_error_) - entry.objectives[0];
+  const double height = reference_complexity_ - entry.objectives[1];
+  if (width <= 0.0 || height <= 0.0) return 0.0;
+  return width * height;
+}
+
+bool ParetoArchive::Insert2D(Entry entry) {
+  const double error = entry.objectives[0];
+  const double complexity = entry.objectives[1];
+  if (IsDominated2D(entry.objectives)) return false;
+
+  auto it = front_2d_.lower_bound(error);
+  auto previous_it = it == front_2d_.begin() ? front_2d_.end() : std::prev(it);
+  if (track_hypervolume_ && previous_it != front_2d_.end()) {
+    hypervolume_ -= HypervolumeSlice(
+        previous_it->second,
+        it == front_2d_.end() ? reference_error_ : it->first);
+  }
+
+  // Along the front, complexity strictly decreases as error increases, so the
+  // points dominated by the new one are contiguous and start at its error.
+  while (it != front_2d_.end() && it->second.objectives[1] >= complexity) {
+    if (track_hypervolume_) {
+      auto next_it = std::next(it);
+      hypervolume_ -= HypervolumeSlice(
+          it->second,
+          next_it == front_2d_.end() ? reference_error_ : next_it->first);
+    }
+    it = front_2d_.erase(it);
+  }
+
+  if (track_hypervolume_) {
+    hypervolume_ += HypervolumeSlice(
+        entry, it == front_2d_.end() ? reference_error_ : it->first);
+    if (previous_it != front_2d_.end()) {
+      hypervolume_ += HypervolumeSlice(previous_it->second, error);
+    }
+  }
+  front_2d_.emplace_hint(it, error, move(entry));
+  return true;
+}
+
+bool ParetoArchive::IsDominated2D(const vector<double>& objectives) const {
+  // The only candidate is the point with the largest error not exceeding the
+  // new one, since it has the lowest complexity among those points.
+  auto it = front_2d_.upper_bound(objectives[0]);
+  if (it == front_2d_.begin()) return false;
+  --it;
+  return it->second.objectives[1] <= objectives[1];
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,141 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_PARETO_ARCHIVE_H_
+#define AUTOML_ZERO_PARETO_ARCHIVE_H_
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+
+namespace automl_zero {
+
+// The multi-objective fitness returned by Evaluator::EvaluateMulti. The first
+// element holds {mean error, error stdev}, the second one holds
+// {predict, learn, setup, overall} complexity.
+typedef std::pair<std::vector<double>, std::vector<double>> MultiFitness;
+
+// Which components of a MultiFitness the archive compares. All objectives are
+// minimized.
+enum ParetoArchiveObjectives : IntegerT {
+  // (mean error, overall complexity). Uses the sorted 2-D index.
+  kErrorAndComplexityObjectives = 0,
+  // (mean error, predict, learn, setup complexity). Uses the ND-tree.
+  kErrorAndComponentComplexityObjectives = 1
+};
+
+namespace internal {
+struct NdTreeNode;
+}  // namespace internal
+
+// An unbounded archive of every mutually non-dominated point that was ever
+// inserted. Unlike the front of a fixed-size population, points are only
+// removed from the archive when a newly inserted point dominates them, so good
+// trade-offs found mid-search survive even if the population later drifts
+// away from them.
+//
+// With two objectives the archive is a balanced tree keyed by the first
+// objective, along which the second objective is strictly decreasing. Both the
+// dominance check and the insertion are then O(log n) (plus the amortized
+// removal of dominated points). With more objectives it is an ND-tree (see
+// Jaszkiewicz & Lust, "ND-Tree-based update", IEEE TEVC 2018), which prunes
+// whole subtrees using the ideal and nadir points of each node.
+class ParetoArchive {
+ public:
+  struct Entry {
+    std::shared_ptr<const Algorithm> algorithm;
+    MultiFitness fitness;
+    // The objectives extracted from `fitness` that the archive compares.
+    std::vector<double> objectives;
+  };
+
+  explicit ParetoArchive(
+      ParetoArchiveObjectives objectives = kErrorAndComplexityObjectives);
+  ~ParetoArchive();
+
+  ParetoArchive(const ParetoArchive& other) = delete;
+  ParetoArchive& operator=(const ParetoArchive& other) = delete;
+
+  // Inserts the point unless it is weakly dominated by an archived point (this
+  // includes exact duplicates). Removes all archived points that the new point
+  // dominates. Returns whether the point was inserted.
+  bool Insert(std::shared_ptr<const Algorithm> algorithm,
+              const MultiFitness& fitness);
+
+  // Merges all the entries of another archive into this one.
+  void Merge(const ParetoArchive& other);
+
+  // Whether the given fitness is weakly dominated by an archived point.
+  bool IsDominated(const MultiFitness& fitness) const;
+
+  // Returns the archived entries sorted lexicographically by objectives. In
+  // the 2-D case this is the order of increasing error and decreasing
+  // complexity.
+  std::vector<Entry> Entries() const;
+
+  IntegerT Size() const;
+  IntegerT NumObjectives() const;
+
+  // Starts tracking the hypervolume of the archive with respect to the given
+  // reference (worst) point. After this call, the hypervolume is updated
+  // incrementally on every insertion, touching only the neighbors of the new
+  // point and the points it removes. Only supported with two objectives.
+  void TrackHypervolume(double reference_error, double reference_complexity);
+
+  // The area dominated by the archive and bounded by the reference point.
+  // Requires TrackHypervolume to have been called.
+  double Hypervolume() const;
+  bool TracksHypervolume() const;
+
+  // The objectives compared for a given fitness.
+  std::vector<double> ExtractObjectives(const MultiFitness& fitness) const;
+
+ private:
+  bool Insert2D(Entry entry);
+  bool IsDominated2D(const std::vector<double>& objectives) const;
+
+  // The hypervolume of the slice between a point of the 2-D front and the
+  // next point, which has the given error.
+  double HypervolumeSlice(const Entry& entry, double next_error) const;
+
+  const ParetoArchiveObjectives objectives_;
+
+  // Used with kErrorAndComplexityObjectives: error -> entry.
+  std::map<double, Entry> front_2d_;
+  bool track_hypervolume_;
+  double reference_error_;
+  double reference_complexity_;
+  double hypervolume_;
+
+  // Used otherwise.
+  std::unique_ptr<internal::NdTreeNode> nd_tree_root_;
+  IntegerT nd_tree_size_;
+};
+
+// Returns true if `a` weakly dominates `b`, i.e. it is no worse in every
+// objective. All objectives are minimized.
+bool WeaklyDominates(const std::vector<double>& a,
+                     const std::vector<double>& b);
+
+// Returns true if `a` dominates `b`, i.e. it weakly dominates it and is
+// strictly better in at least one objective.
+bool Dominates(const std::vector<double>& a, const std::vector<double>& b);
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_PARETO_ARCHIVE_H_
@@ -0,0 +1,210 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pareto_archive.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::make_shared;
+using ::std::mt19937;
+using ::std::vector;
+
+MultiFitness MakeFitness(double error, double complexity) {
+  return MultiFitness({error, 0.0}, {0.0, 0.0, 0.0, complexity});
+}
+
+MultiFitness MakeFitness(double error, double predict, double learn,
+                         double setup) {
+  return MultiFitness({error, 0.0},
+                      {predict, learn, setup, predict + learn + setup});
+}
+
+// The non-dominated subset of `points`, without duplicates, sorted.
+vector<vector<double>> BruteForceFront(const vector<vector<double>>& points) {
+  vector<vector<double>> front;
+  for (size_t i = 0; i < points.size(); ++i) {
+    bool keep = true;
+    for (size_t j = 0; j < points.size(); ++j) {
+      if (Dominates(points[j], points[i]) ||
+          (j < i && points[j] == points[i])) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) front.push_back(points[i]);
+  }
+  std::sort(front.begin(), front.end());
+  return front;
+}
+
+vector<vector<double>> ArchivedObjectives(const ParetoArchive& archive) {
+  vector<vector<double>> objectives;
+  for (const ParetoArchive::Entry& entry : archive.Entries()) {
+    objectives.push_back(entry.objectives);
+  }
+  return objectives;
+}
+
+TEST(ParetoArchiveTest, Dominance) {
+  EXPECT_TRUE(Dominates({1.0, 2.0}, {1.0, 3.0}));
+  EXPECT_FALSE(Dominates({1.0, 2.0}, {1.0, 2.0}));
+  EXPECT_FALSE(Dominates({1.0, 3.0}, {2.0, 2.0}));
+  EXPECT_TRUE(WeaklyDominates({1.0, 2.0}, {1.0, 2.0}));
+  EXPECT_FALSE(WeaklyDominates({1.0, 3.0}, {2.0, 2.0}));
+}
+
+TEST(ParetoArchiveTest, KeepsNonDominatedPoints2D) {
+  ParetoArchive archive;
+  auto algorithm = make_shared<const Algorithm>();
+  EXPECT_TRUE(archive.Insert(algorithm, MakeFitness(0.5, 10.0)));
+  EXPECT_TRUE(archive.Insert(algorithm, MakeFitness(0.3, 20.0)));
+  EXPECT_TRUE(archive.Insert(algorithm, MakeFitness(0.7, 5.0)));
+  EXPECT_EQ(archive.Size(), 3);
+
+  // Dominated and duplicate points are rejected.
+  EXPECT_FALSE(archive.Insert(algorithm, MakeFitness(0.6, 10.0)));
+  EXPECT_FALSE(archive.Insert(algorithm, MakeFitness(0.5, 10.0)));
+  EXPECT_TRUE(archive.IsDominated(MakeFitness(0.4, 25.0)));
+  EXPECT_FALSE(archive.IsDominated(MakeFitness(0.4, 15.0)));
+  EXPECT_EQ(archive.Size(), 3);
+
+  // A point dominating two archived points replaces them.
+  EXPECT_TRUE(archive.Insert(algorithm, MakeFitness(0.3, 9.0)));
+  EXPECT_EQ(ArchivedObjectives(archive),
+            vector<vector<double>>({{0.3, 9.0}, {0.7, 5.0}}));
+}
+
+TEST(ParetoArchiveTest, KeepsTheAlgorithm) {
+  ParetoArchive archive;
+  auto algorithm = make_shared<const Algorithm>();
+  archive.Insert(algorithm, MakeFitness(0.5, 10.0));
+  ASSERT_EQ(archive.Size(), 1);
+  EXPECT_EQ(archive.Entries()[0].algorithm, algorithm);
+  EXPECT_EQ(archive.Entries()[0].fitness, MakeFitness(0.5, 10.0));
+}
+
+TEST(ParetoArchiveTest, MatchesBruteForce2D) {
+  mt19937 bit_gen(100000);
+  std::uniform_int_distribution<int> distribution(0, 50);
+  ParetoArchive archive;
+  vector<vector<double>> points;
+  for (IntegerT i = 0; i < 2000; ++i) {
+    const double error = distribution(bit_gen) / 50.0;
+    const double complexity = distribution(bit_gen);
+    points.push_back({error, complexity});
+    archive.Insert(make_shared<const Algorithm>(),
+                   MakeFitness(error, complexity));
+  }
+  EXPECT_EQ(ArchivedObjectives(archive), BruteForceFront(points));
+}
+
+TEST(ParetoArchiveTest, MatchesBruteForceND) {
+  mt19937 bit_gen(100000);
+  std::uniform_int_distribution<int> distribution(0, 20);
+  ParetoArchive archive(kErrorAndComponentComplexityObjectives);
+  EXPECT_EQ(archive.NumObjectives(), 4);
+  vector<vector<double>> points;
+  for (IntegerT i = 0; i < 3000; ++i) {
+    // Points close to a hyperplane, so that many are non-dominated.
+    const double predict = distribution(bit_gen);
+    const double learn = distribution(bit_gen);
+    const double setup = distribution(bit_gen);
+    const double error =
+        (60.0 - predict - learn - setup + distribution(bit_gen) / 4.0) / 70.0;
+    const MultiFitness fitness = MakeFitness(error, predict, learn, setup);
+    points.push_back({error, predict, learn, setup});
+    const bool was_dominated = archive.IsDominated(fitness);
+    EXPECT_EQ(archive.Insert(make_shared<const Algorithm>(), fitness),
+              !was_dominated);
+  }
+  const vector<vector<double>> expected = BruteForceFront(points);
+  // Large enough for the ND-tree to split its leaves.
+  EXPECT_GT(expected.size(), 100);
+  EXPECT_EQ(ArchivedObjectives(archive), expected);
+}
+
+// Computes the 2-D hypervolume from scratch.
+double BruteForceHypervolume(const vector<vector<double>>& front,
+                             double reference_error,
+                             double reference_complexity) {
+  double hypervolume = 0.0;
+  for (size_t i = 0; i < front.size(); ++i) {
+    const double next_error = std::min(
+        reference_error,
+        i + 1 < front.size() ? front[i + 1][0] : reference_error);
+    hypervolume += std::max(0.0, next_error - front[i][0]) *
+                   std::max(0.0, reference_complexity - front[i][1]);
+  }
+  return hypervolume;
+}
+
+TEST(ParetoArchiveTest, TracksHypervolume) {
+  ParetoArchive archive;
+  auto algorithm = make_shared<const Algorithm>();
+  archive.Insert(algorithm, MakeFitness(0.5, 10.0));
+  EXPECT_FALSE(archive.TracksHypervolume());
+  archive.TrackHypervolume(1.0, 20.0);
+  EXPECT_TRUE(archive.TracksHypervolume());
+  EXPECT_DOUBLE_EQ(archive.Hypervolume(), 0.5 * 10.0);
+  archive.Insert(algorithm, MakeFitness(0.25, 15.0));
+  EXPECT_DOUBLE_EQ(archive.Hypervolume(), 0.5 * 10.0 + 0.25 * 5.0);
+  // Outside of the reference point.
+  archive.Insert(algorithm, MakeFitness(0.1, 25.0));
+  EXPECT_DOUBLE_EQ(archive.Hypervolume(), 0.5 * 10.0 + 0.25 * 5.0);
+  // Dominates everything.
+  archive.Insert(algorithm, MakeFitness(0.0, 0.0));
+  EXPECT_EQ(archive.Size(), 1);
+  EXPECT_DOUBLE_EQ(archive.Hypervolume(), 20.0);
+}
+
+TEST(ParetoArchiveTest, HypervolumeMatchesBruteForce) {
+  mt19937 bit_gen(100000);
+  std::uniform_real_distribution<double> distribution(0.0, 1.2);
+  ParetoArchive archive;
+  archive.TrackHypervolume(1.0, 1.0);
+  double previous_hypervolume = 0.0;
+  for (IntegerT i = 0; i < 1000; ++i) {
+    archive.Insert(make_shared<const Algorithm>(),
+                   MakeFitness(distribution(bit_gen), distribution(bit_gen)));
+    EXPECT_NEAR(archive.Hypervolume(),
+                BruteForceHypervolume(ArchivedObjectives(archive), 1.0, 1.0),
+                1e-9);
+    // The archive only grows the dominated region.
+    EXPECT_GE(archive.Hypervolume(), previous_hypervolume - 1e-12);
+    previous_hypervolume = archive.Hypervolume();
+  }
+}
+
+TEST(ParetoArchiveTest, Merges) {
+  ParetoArchive archive;
+  ParetoArchive other;
+  auto algorithm = make_shared<const Algorithm>();
+  archive.Insert(algorithm, MakeFitness(0.5, 10.0));
+  other.Insert(algorithm, MakeFitness(0.4, 10.0));
+  other.Insert(algorithm, MakeFitness(0.6, 5.0));
+  archive.Merge(other);
+  EXPECT_EQ(ArchivedObjectives(archive),
+            vector<vector<double>>({{0.4, 10.0}, {0.6, 5.0}}));
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,121 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "philox.h"
+
+#include <cmath>
+
+namespace automl_zero {
+
+namespace {
+
+// Blocks encrypted together. Each round is then a loop over the lanes, with
+// no dependencies between iterations.
+constexpr size_t kLanes = 8;
+// Each block gives two doubles.
+constexpr size_t kValuesPerBatch = 2 * kLanes;
+
+// A double in the open interval (0, 1) from 53 of the 64 bits.
+inline double UnitUniform(const uint32_t high, const uint32_t low) {
+  const uint64_t bits =
+      (static_cast<uint64_t>(high) << 21) ^ static_cast<uint64_t>(low >> 11);
+  return (static_cast<double>(bits) + 0.5) * 0x1p-53;
+}
+
+}  // namespace
+
+void PhiloxBitGen::FillUnitUniform(double* values, size_t size) {
+  uint32_t x0[kLanes], x1[kLanes], x2[kLanes], x3[kLanes];
+  while (size > 0) {
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      const uint64_t block = block_ + lane;
+      x0[lane] = static_cast<uint32_t>(block);
+      x1[lane] = static_cast<uint32_t>(block >> 32);
+      x2[lane] = stream_[0];
+      x3[lane] = stream_[1];
+    }
+    uint32_t key0 = key_[0];
+    uint32_t key1 = key_[1];
+    for (int round = 0; round < kPhiloxRounds; ++round) {
+      for (size_t lane = 0; lane < kLanes; ++lane) {
+        const uint64_t product0 =
+            static_cast<uint64_t>(kPhiloxMultiplier0) * x0[lane];
+        const uint64_t product1 =
+            static_cast<uint64_t>(kPhiloxMultiplier1) * x2[lane];
+        const uint32_t y0 =
+            static_cast<uint32_t>(product1 >> 32) ^ x1[lane] ^ key0;
+        const uint32_t y2 =
+            static_cast<uint32_t>(product0 >> 32) ^ x3[lane] ^ key1;
+        x1[lane] = static_cast<uint32_t>(product1);
+        x3[lane] = static_cast<uint32_t>(product0);
+        x0[lane] = y0;
+        x2[lane] = y2;
+      }
+      key0 += kPhiloxKeyBump0;
+      key1 += kPhiloxKeyBump1;
+    }
+    block_ += kLanes;
+
+    if (size >= kValuesPerBatch) {
+      for (size_t lane = 0; lane < kLanes; ++lane) {
+        values[2 * lane] = UnitUniform(x0[lane], x1[lane]);
+        values[2 * lane + 1] = UnitUniform(x2[lane], x3[lane]);
+      }
+      values += kValuesPerBatch;
+      size -= kValuesPerBatch;
+    } else {
+      for (size_t i = 0; i < size; ++i) {
+        const size_t lane = i / 2;
+        values[i] = i % 2 == 0 ? UnitUniform(x0[lane], x1[lane])
+                               : UnitUniform(x2[lane], x3[lane]);
+      }
+      size = 0;
+    }
+  }
+  // The rest of the current block, if any, is skipped.
+  next_output_ = 4;
+}
+
+void PhiloxBitGen::FillUniform(const double low, const double high,
+                               double* values, const size_t size) {
+  FillUnitUniform(values, size);
+  const double range = high - low;
+  for (size_t i = 0; i < size; ++i) {
+    values[i] = low + range * values[i];
+  }
+}
+
+void PhiloxBitGen::FillGaussian(const double mean, const double stdev,
+                                double* values, const size_t size) {
+  // Box-Muller, which turns each pair of uniform values into a pair of
+  // independent Gaussian values.
+  FillUnitUniform(values, size);
+  for (size_t i = 0; i + 1 < size; i += 2) {
+    const double radius = stdev * std::sqrt(-2.0 * std::log(values[i]));
+    const double angle = 2.0 * M_PI * values[i + 1];
+    values[i] = mean + radius * std::cos(angle);
+    values[i + 1] = mean + radius * std::sin(angle);
+  }
+  if (size % 2 == 1) {
+    // The odd one out takes a pair of its own.
+    double pair[2];
+    FillUnitUniform(pair, 2);
+    values[size - 1] =
+        mean + stdev * std::sqrt(-2.0 * std::log(pair[0])) *
+                   std::cos(2.0 * M_PI * pair[1]);
+  }
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,115 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// A counter-based random bit generator: Philox4x32-10, from Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3", SC 2011. The n-th output of
+// a stream is a bijective function of (key, stream, n), so independent and
+// reproducible streams can be created for free, e.g. one per (seed,
+// individual, task), instead of seeding and advancing a stateful generator.
+
+#ifndef AUTOML_ZERO_PHILOX_H_
+#define AUTOML_ZERO_PHILOX_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace automl_zero {
+
+// The Philox4x32 rounds applied to a block counter.
+constexpr int kPhiloxRounds = 10;
+constexpr uint32_t kPhiloxMultiplier0 = 0xD2511F53;
+constexpr uint32_t kPhiloxMultiplier1 = 0xCD9E8D57;
+constexpr uint32_t kPhiloxKeyBump0 = 0x9E3779B9;
+constexpr uint32_t kPhiloxKeyBump1 = 0xBB67AE85;
+
+// Encrypts the counter in place with the given key.
+inline void PhiloxBlock(std::array<uint32_t, 4>* counter,
+                        const std::array<uint32_t, 2>& key) {
+  uint32_t key0 = key[0];
+  uint32_t key1 = key[1];
+  std::array<uint32_t, 4>& x = *counter;
+  for (int round = 0; round < kPhiloxRounds; ++round) {
+    const uint64_t product0 = static_cast<uint64_t>(kPhiloxMultiplier0) * x[0];
+    const uint64_t product1 = static_cast<uint64_t>(kPhiloxMultiplier1) * x[2];
+    x = {static_cast<uint32_t>(product1 >> 32) ^ x[1] ^ key0,
+         static_cast<uint32_t>(product1),
+         static_cast<uint32_t>(product0 >> 32) ^ x[3] ^ key1,
+         static_cast<uint32_t>(product0)};
+    key0 += kPhiloxKeyBump0;
+    key1 += kPhiloxKeyBump1;
+  }
+}
+
+// Satisfies the UniformRandomBitGenerator requirements, so it can be used with
+// the absl and std distributions. Thread-compatible, but not thread-safe.
+class PhiloxBitGen {
+ public:
+  typedef uint32_t result_type;
+
+  // The stream `stream` of the generator keyed by `key`.
+  explicit PhiloxBitGen(uint64_t key = 0, uint64_t stream = 0) {
+    seed(key, stream);
+  }
+
+  // Restarts at the beginning of the given stream.
+  void seed(const uint64_t key, const uint64_t stream = 0) {
+    key_ = {static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)};
+    stream_ = {static_cast<uint32_t>(stream),
+               static_cast<uint32_t>(stream >> 32)};
+    block_ = 0;
+    next_output_ = 4;
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    if (next_output_ == 4) {
+      output_ = {static_cast<uint32_t>(block_),
+                 static_cast<uint32_t>(block_ >> 32), stream_[0],
+                 stream_[1]};
+      PhiloxBlock(&output_, key_);
+      ++block_;
+      next_output_ = 0;
+    }
+    return output_[next_output_++];
+  }
+
+  // Fill `size` values with draws from the uniform distribution on the open
+  // interval (low, high), or from a Gaussian distribution. These encrypt many
+  // blocks at once, which the compiler can vectorize, and continue the
+  // stream from the next block, skipping what remains of the current one.
+  void FillUniform(double low, double high, double* values, size_t size);
+  void FillGaussian(double mean, double stdev, double* values, size_t size);
+
+ private:
+  // Draws `size` uniform values in the open interval (0, 1).
+  void FillUnitUniform(double* values, size_t size);
+
+  std::array<uint32_t, 2> key_;
+  std::array<uint32_t, 2> stream_;
+  // The next block of the stream.
+  uint64_t block_;
+  std::array<uint32_t, 4> output_;
+  int next_output_;
+};
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_PHILOX_H_
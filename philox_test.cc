@@ -0,0 +1,148 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "philox.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "definitions.h"
+#include "gtest/gtest.h"
+#include "absl/random/distributions.h"
+
+namespace automl_zero {
+
+using ::std::array;  // NOLINT
+using ::std::vector;  // NOLINT
+
+// The known-answer tests of the Random123 library.
+TEST(PhiloxTest, MatchesKnownAnswers) {
+  array<uint32_t, 4> counter = {0, 0, 0, 0};
+  PhiloxBlock(&counter, {0, 0});
+  EXPECT_EQ(counter,
+            (array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+                                0x9b00dbd8}));
+
+  counter = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+  PhiloxBlock(&counter, {0xffffffff, 0xffffffff});
+  EXPECT_EQ(counter,
+            (array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6,
+                                0x6d5451fd}));
+
+  counter = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+  PhiloxBlock(&counter, {0xa4093822, 0x299f31d0});
+  EXPECT_EQ(counter,
+            (array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420,
+                                0x24126ea1}));
+}
+
+TEST(PhiloxTest, OutputsTheBlocksOfTheStream) {
+  PhiloxBitGen bit_gen(0x299f31d0a4093822, 0x0370734413198a2e);
+  for (uint32_t block = 0; block < 3; ++block) {
+    array<uint32_t, 4> counter = {block, 0, 0x13198a2e, 0x03707344};
+    PhiloxBlock(&counter, {0xa4093822, 0x299f31d0});
+    for (const uint32_t expected : counter) {
+      EXPECT_EQ(bit_gen(), expected);
+    }
+  }
+}
+
+TEST(PhiloxTest, StreamsAreReproducibleAndIndependent) {
+  PhiloxBitGen bit_gen(1000, 7);
+  PhiloxBitGen same_bit_gen(1000, 7);
+  PhiloxBitGen other_stream_bit_gen(1000, 8);
+  PhiloxBitGen other_key_bit_gen(1001, 7);
+  IntegerT num_same_as_other_stream = 0;
+  IntegerT num_same_as_other_key = 0;
+  for (IntegerT i = 0; i < 100; ++i) {
+    const uint32_t value = bit_gen();
+    EXPECT_EQ(value, same_bit_gen());
+    num_same_as_other_stream += value == other_stream_bit_gen();
+    num_same_as_other_key += value == other_key_bit_gen();
+  }
+  EXPECT_LT(num_same_as_other_stream, 2);
+  EXPECT_LT(num_same_as_other_key, 2);
+
+  // Seeding restarts the stream.
+  const uint32_t first = PhiloxBitGen(1000, 7)();
+  bit_gen.seed(1000, 7);
+  EXPECT_EQ(bit_gen(), first);
+}
+
+TEST(PhiloxTest, BulkFillsMatchTheBlocks) {
+  // Enough values for more than one batch of blocks.
+  constexpr size_t kSize = 37;
+  PhiloxBitGen bit_gen(123, 456);
+  bit_gen();  // The rest of the first block is skipped by the fill.
+  vector<double> values(kSize);
+  bit_gen.FillUniform(0.0, 1.0, values.data(), kSize);
+
+  PhiloxBitGen expected_bit_gen(123, 456);
+  for (IntegerT i = 0; i < 4; ++i) expected_bit_gen();
+  for (size_t i = 0; i < kSize; ++i) {
+    const uint64_t high = expected_bit_gen();
+    const uint64_t low = expected_bit_gen();
+    const double expected =
+        (static_cast<double>((high << 21) ^ (low >> 11)) + 0.5) * 0x1p-53;
+    EXPECT_EQ(values[i], expected);
+  }
+}
+
+TEST(PhiloxTest, FillUniformHasTheRightDistribution) {
+  constexpr size_t kSize = 100000;
+  PhiloxBitGen bit_gen(1, 2);
+  vector<double> values(kSize);
+  bit_gen.FillUniform(-2.0, 6.0, values.data(), kSize);
+  double sum = 0.0;
+  for (const double value : values) {
+    EXPECT_GT(value, -2.0);
+    EXPECT_LT(value, 6.0);
+    sum += value;
+  }
+  EXPECT_NEAR(sum / kSize, 2.0, 0.05);
+}
+
+TEST(PhiloxTest, FillGaussianHasTheRightDistribution) {
+  // Odd, to cover the last value.
+  constexpr size_t kSize = 100001;
+  PhiloxBitGen bit_gen(3, 4);
+  vector<double> values(kSize);
+  bit_gen.FillGaussian(1.0, 2.0, values.data(), kSize);
+  double sum = 0.0;
+  double sum_squares = 0.0;
+  for (const double value : values) {
+    ASSERT_TRUE(std::isfinite(value));
+    sum += value;
+    sum_squares += value * value;
+  }
+  const double mean = sum / kSize;
+  EXPECT_NEAR(mean, 1.0, 0.03);
+  EXPECT_NEAR(std::sqrt(sum_squares / kSize - mean * mean), 2.0, 0.03);
+}
+
+TEST(PhiloxTest, WorksWithTheAbslDistributions) {
+  PhiloxBitGen bit_gen(5, 6);
+  vector<IntegerT> counts(4, 0);
+  for (IntegerT i = 0; i < 4000; ++i) {
+    ++counts[absl::Uniform<IntegerT>(bit_gen, 0, 4)];
+  }
+  for (const IntegerT count : counts) {
+    EXPECT_GT(count, 800);
+  }
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,251 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+using ::std::string;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace {
+
+struct ProfileRegistry {
+  ProfileRegistry()
+      : start_cycles(ReadCycleCounter()),
+        start_time(std::chrono::steady_clock::now()),
+        timer_overhead_cycles(MeasureTimerOverhead()) {}
+
+  // The cycles between two back-to-back reads of the counter, which every
+  // sampled op is charged for.
+  static IntegerT MeasureTimerOverhead() {
+    IntegerT overhead = std::numeric_limits<IntegerT>::max();
+    for (IntegerT i = 0; i < 1000; ++i) {
+      const IntegerT start = ReadCycleCounter();
+      overhead = std::min(overhead, ReadCycleCounter() - start);
+    }
+    return overhead;
+  }
+
+  std::mutex mutex;
+  vector<unique_ptr<ExecutionProfile>> profiles;
+  // To convert cycles to seconds.
+  const IntegerT start_cycles;
+  const std::chrono::steady_clock::time_point start_time;
+  const IntegerT timer_overhead_cycles;
+};
+
+ProfileRegistry* GetProfileRegistry() {
+  static ProfileRegistry* const registry = new ProfileRegistry();
+  return registry;
+}
+
+// Estimated from the cycles and the time elapsed since the first profile was
+// registered.
+double CyclesPerSecond() {
+  ProfileRegistry* registry = GetProfileRegistry();
+  const double secs = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - registry->start_time).count();
+  const IntegerT cycles = ReadCycleCounter() - registry->start_cycles;
+  return secs > 0.0 && cycles > 0 ? cycles / secs : 1.0e9;
+}
+
+// The time of all the calls of an op, extrapolated from the sampled calls,
+// without the overhead of the timer.
+double EstimatedOpCycles(const ExecutionProfile& profile, const int op) {
+  if (profile.op_sampled_calls[op] == 0) return 0.0;
+  const double sampled_cycles = std::max<double>(
+      0.0, profile.op_sampled_cycles[op] -
+               profile.op_sampled_calls[op] *
+                   GetProfileRegistry()->timer_overhead_cycles);
+  return sampled_cycles * profile.op_calls[op] / profile.op_sampled_calls[op];
+}
+
+const char* PhaseName(const int phase) {
+  switch (phase) {
+    case kSetupProfilePhase:
+      return "setup";
+    case kTrainProfilePhase:
+      return "train";
+    case kValidateProfilePhase:
+      return "validate";
+    case kFunctionalCacheProfilePhase:
+      return "functional_cache";
+    case kEvaluationProfilePhase:
+      return "evaluation";
+  }
+  LOG(FATAL) << "Unknown phase: " << phase << std::endl;
+}
+
+const char* EarlyStopName(const int reason) {
+  switch (reason) {
+    case kTrainNanErrorStop:
+      return "train_nan_error";
+    case kTrainLargeErrorStop:
+      return "train_large_error";
+    case kValidNanErrorStop:
+      return "valid_nan_error";
+    case kValidLargeErrorStop:
+      return "valid_large_error";
+    case kTimeoutStop:
+      return "timeout";
+  }
+  LOG(FATAL) << "Unknown early stop reason: " << reason << std::endl;
+}
+
+}  // namespace
+
+ExecutionProfile::ExecutionProfile()
+    : sample_countdown(kOpProfileSamplingPeriod), sample_state(2463534242) {
+  op_calls.fill(0);
+  op_sampled_calls.fill(0);
+  op_sampled_cycles.fill(0);
+  phase_calls.fill(0);
+  phase_cycles.fill(0);
+  early_stops.fill(0);
+}
+
+void ExecutionProfile::Merge(const ExecutionProfile& other) {
+  for (int op = 0; op < Op_ARRAYSIZE; ++op) {
+    op_calls[op] += other.op_calls[op];
+    op_sampled_calls[op] += other.op_sampled_calls[op];
+    op_sampled_cycles[op] += other.op_sampled_cycles[op];
+  }
+  for (int phase = 0; phase < kNumProfilePhases; ++phase) {
+    phase_calls[phase] += other.phase_calls[phase];
+    phase_cycles[phase] += other.phase_cycles[phase];
+  }
+  for (int reason = 0; reason < kNumEarlyStopReasons; ++reason) {
+    early_stops[reason] += other.early_stops[reason];
+  }
+}
+
+ExecutionProfile* RegisterThreadExecutionProfile() {
+  ProfileRegistry* registry = GetProfileRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  registry->profiles.emplace_back(new ExecutionProfile());
+  return registry->profiles.back().get();
+}
+
+ExecutionProfile MergedExecutionProfile() {
+  ProfileRegistry* registry = GetProfileRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  ExecutionProfile merged;
+  for (const unique_ptr<ExecutionProfile>& profile : registry->profiles) {
+    merged.Merge(*profile);
+  }
+  return merged;
+}
+
+IntegerT NumProfiledThreads() {
+  ProfileRegistry* registry = GetProfileRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  return registry->profiles.size();
+}
+
+void ResetExecutionProfiles() {
+  ProfileRegistry* registry = GetProfileRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  for (unique_ptr<ExecutionProfile>& profile : registry->profiles) {
+    // Keeps the sampling state, so that the next samples stay spread out.
+    const IntegerT sample_countdown = profile->sample_countdown;
+    const uint32_t sample_state = profile->sample_state;
+    *profile = ExecutionProfile();
+    profile->sample_countdown = sample_countdown;
+    profile->sample_state = sample_state;
+  }
+}
+
+void WriteExecutionProfile(const ExecutionProfile& profile,
+                           const IntegerT num_threads, std::ostream* output) {
+  const double cycles_per_second = CyclesPerSecond();
+  std::ostream& out = *output;
+  out << "Execution profile (" << num_threads << " threads, ops timed for "
+      << "1 in " << kOpProfileSamplingPeriod << " instructions, "
+      << std::fixed << std::setprecision(3) << cycles_per_second / 1.0e9
+      << " Gcycles/s):" << std::endl;
+
+  out << std::left << std::setw(20) << "phase" << std::right << std::setw(14)
+      << "calls" << std::setw(14) << "secs" << std::setw(14) << "us/call"
+      << std::endl;
+  for (int phase = 0; phase < kNumProfilePhases; ++phase) {
+    const double secs = profile.phase_cycles[phase] / cycles_per_second;
+    const IntegerT calls = profile.phase_calls[phase];
+    out << std::left << std::setw(20) << PhaseName(phase) << std::right
+        << std::setw(14) << calls << std::setw(14) << std::setprecision(3)
+        << secs << std::setw(14)
+        << (calls > 0 ? secs * 1.0e6 / calls : 0.0) << std::endl;
+  }
+
+  out << "early stops:";
+  for (int reason = 0; reason < kNumEarlyStopReasons; ++reason) {
+    out << " " << EarlyStopName(reason) << "=" << profile.early_stops[reason];
+  }
+  out << std::endl;
+
+  vector<int> ops;
+  double total_op_cycles = 0.0;
+  for (int op = 0; op < Op_ARRAYSIZE; ++op) {
+    if (profile.op_calls[op] == 0) continue;
+    ops.push_back(op);
+    total_op_cycles += EstimatedOpCycles(profile, op);
+  }
+  std::sort(ops.begin(), ops.end(), [&profile](const int op1, const int op2) {
+    return EstimatedOpCycles(profile, op1) > EstimatedOpCycles(profile, op2);
+  });
+  out << std::left << std::setw(32) << "op" << std::right << std::setw(14)
+      << "calls" << std::setw(14) << "sampled" << std::setw(14) << "est_secs"
+      << std::setw(14) << "ns/call" << std::setw(10) << "share" << std::endl;
+  for (const int op : ops) {
+    const double cycles = EstimatedOpCycles(profile, op);
+    out << std::left << std::setw(32) << Op_Name(static_cast<Op>(op))
+        << std::right << std::setw(14) << profile.op_calls[op] << std::setw(14)
+        << profile.op_sampled_calls[op] << std::setw(14)
+        << std::setprecision(3) << cycles / cycles_per_second << std::setw(14)
+        << std::setprecision(1)
+        << cycles * 1.0e9 / cycles_per_second / profile.op_calls[op]
+        << std::setw(9)
+        << (total_op_cycles > 0.0 ? 100.0 * cycles / total_op_cycles : 0.0)
+        << "%" << std::endl;
+  }
+}
+
+void DumpExecutionProfile(const string& path) {
+  if (!kProfileExecution) return;
+  const ExecutionProfile profile = MergedExecutionProfile();
+  const IntegerT num_threads = NumProfiledThreads();
+  if (path.empty()) {
+    WriteExecutionProfile(profile, num_threads, &std::cout);
+    return;
+  }
+  std::ofstream output(path);
+  CHECK(output.is_open()) << "Could not open " << path << std::endl;
+  WriteExecutionProfile(profile, num_threads, &output);
+}
+
+}  // namespace automl_zero
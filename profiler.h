@@ -0,0 +1,208 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A sampling profiler of the execution of the algorithms: where the time goes
+// between the setup, train and validate phases, which ops dominate and how
+// often the execution stops early.
+//
+// Enabled by building with --copt=-DPROFILE_EXECUTION=1. Otherwise, the
+// profiling scopes are empty classes and cost nothing. When enabled, every
+// thread records into its own ExecutionProfile, without synchronization, and
+// the profiles are merged at the end of the run.
+
+#ifndef AUTOML_ZERO_PROFILER_H_
+#define AUTOML_ZERO_PROFILER_H_
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "definitions.h"
+#include "instruction.pb.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>  // NOLINT
+#endif
+
+namespace automl_zero {
+
+enum ProfilePhase {
+  // Wiping the memory and running the setup component function.
+  kSetupProfilePhase = 0,
+  kTrainProfilePhase = 1,
+  kValidateProfilePhase = 2,
+  // The short execution used to look the algorithm up in the functional
+  // cache. Includes its own setup, train and validate phases.
+  kFunctionalCacheProfilePhase = 3,
+  // The evaluation of an algorithm on one task. Includes all the above.
+  kEvaluationProfilePhase = 4,
+  kNumProfilePhases = 5
+};
+
+enum EarlyStopReason {
+  kTrainNanErrorStop = 0,
+  kTrainLargeErrorStop = 1,
+  kValidNanErrorStop = 2,
+  kValidLargeErrorStop = 3,
+  // The ExecutionWatchdog ended the evaluation.
+  kTimeoutStop = 4,
+  kNumEarlyStopReasons = 5
+};
+
+// The time of each op is measured for about one in this many executed
+// instructions. The calls are always counted.
+constexpr IntegerT kOpProfileSamplingPeriod = 64;
+
+struct ExecutionProfile {
+  ExecutionProfile();
+
+  // Adds the counts of `other` to this profile.
+  void Merge(const ExecutionProfile& other);
+
+  std::array<IntegerT, Op_ARRAYSIZE> op_calls;
+  std::array<IntegerT, Op_ARRAYSIZE> op_sampled_calls;
+  std::array<IntegerT, Op_ARRAYSIZE> op_sampled_cycles;
+  std::array<IntegerT, kNumProfilePhases> phase_calls;
+  std::array<IntegerT, kNumProfilePhases> phase_cycles;
+  std::array<IntegerT, kNumEarlyStopReasons> early_stops;
+
+  // Instructions left until the next sample. Randomized, so that programs
+  // whose length divides the sampling period are not always sampled at the
+  // same instruction.
+  IntegerT sample_countdown;
+  uint32_t sample_state;
+};
+
+// Cycles of a time stamp counter, or nanoseconds where there is none.
+inline IntegerT ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return static_cast<IntegerT>(__rdtsc());
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Registers a new profile for the calling thread. Use
+// ThreadExecutionProfile instead.
+ExecutionProfile* RegisterThreadExecutionProfile();
+
+// The profile of the calling thread. The profiles outlive their threads.
+inline ExecutionProfile* ThreadExecutionProfile() {
+  static thread_local ExecutionProfile* const profile =
+      RegisterThreadExecutionProfile();
+  return profile;
+}
+
+// The sum of the profiles of all the threads, and how many there are. Must
+// not be called while algorithms are being executed.
+ExecutionProfile MergedExecutionProfile();
+IntegerT NumProfiledThreads();
+
+// Clears the profiles of all the threads. Must not be called while
+// algorithms are being executed.
+void ResetExecutionProfiles();
+
+// Writes a human-readable report, with the ops sorted by their estimated
+// share of the time.
+void WriteExecutionProfile(const ExecutionProfile& profile,
+                           IntegerT num_threads, std::ostream* output);
+
+// Writes the merged profile to `path`, or to stdout if `path` is empty. Does
+// nothing if the profiler is compiled out.
+void DumpExecutionProfile(const std::string& path);
+
+// Counts one execution of an op, and times it if it is sampled. Empty unless
+// `enabled`.
+template <bool enabled>
+class OpProfileScope {
+ public:
+  explicit OpProfileScope(int op) {}
+};
+
+template <>
+class OpProfileScope<true> {
+ public:
+  explicit OpProfileScope(const int op)
+      : profile_(ThreadExecutionProfile()), op_(op), start_cycles_(-1) {
+    ++profile_->op_calls[op];
+    if (--profile_->sample_countdown <= 0) {
+      // A xorshift step, for a period uniform in [1, 2 * sampling period).
+      uint32_t state = profile_->sample_state;
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      profile_->sample_state = state;
+      profile_->sample_countdown =
+          1 + state % (2 * kOpProfileSamplingPeriod - 1);
+      start_cycles_ = ReadCycleCounter();
+    }
+  }
+  OpProfileScope(const OpProfileScope& other) = delete;
+  OpProfileScope& operator=(const OpProfileScope& other) = delete;
+
+  ~OpProfileScope() {
+    if (start_cycles_ >= 0) {
+      profile_->op_sampled_cycles[op_] += ReadCycleCounter() - start_cycles_;
+      ++profile_->op_sampled_calls[op_];
+    }
+  }
+
+ private:
+  ExecutionProfile* const profile_;
+  const int op_;
+  IntegerT start_cycles_;
+};
+
+// Times the enclosing scope as a phase. Empty unless `enabled`.
+template <bool enabled>
+class PhaseProfileScope {
+ public:
+  explicit PhaseProfileScope(ProfilePhase phase) {}
+};
+
+template <>
+class PhaseProfileScope<true> {
+ public:
+  explicit PhaseProfileScope(const ProfilePhase phase)
+      : profile_(ThreadExecutionProfile()),
+        phase_(phase),
+        start_cycles_(ReadCycleCounter()) {}
+  PhaseProfileScope(const PhaseProfileScope& other) = delete;
+  PhaseProfileScope& operator=(const PhaseProfileScope& other) = delete;
+
+  ~PhaseProfileScope() {
+    profile_->phase_cycles[phase_] += ReadCycleCounter() - start_cycles_;
+    ++profile_->phase_calls[phase_];
+  }
+
+ private:
+  ExecutionProfile* const profile_;
+  const ProfilePhase phase_;
+  const IntegerT start_cycles_;
+};
+
+// Counts an early stop. Does nothing unless `enabled`.
+template <bool enabled>
+inline void ProfileEarlyStop(const EarlyStopReason reason) {
+  if (enabled) ++ThreadExecutionProfile()->early_stops[reason];
+}
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_PROFILER_H_
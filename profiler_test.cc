@@ -0,0 +1,154 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "profiler.h"
+
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <type_traits>
+#include <vector>
+
+#include "definitions.h"
+#include "instruction.pb.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::string;  // NOLINT
+using ::std::vector;  // NOLINT
+
+static_assert(std::is_empty<OpProfileScope<false>>::value,
+              "A disabled op scope must cost nothing.");
+static_assert(std::is_empty<PhaseProfileScope<false>>::value,
+              "A disabled phase scope must cost nothing.");
+
+TEST(ProfilerTest, CountsEveryOpCall) {
+  ResetExecutionProfiles();
+  for (IntegerT i = 0; i < 1000; ++i) {
+    OpProfileScope<true> profile_scope(SCALAR_SUM_OP);
+  }
+  for (IntegerT i = 0; i < 10; ++i) {
+    OpProfileScope<true> profile_scope(MATRIX_MATRIX_PRODUCT_OP);
+  }
+  const ExecutionProfile profile = MergedExecutionProfile();
+  EXPECT_EQ(profile.op_calls[SCALAR_SUM_OP], 1000);
+  EXPECT_EQ(profile.op_calls[MATRIX_MATRIX_PRODUCT_OP], 10);
+  EXPECT_EQ(profile.op_calls[SCALAR_DIFF_OP], 0);
+}
+
+TEST(ProfilerTest, SamplesAboutOneInAPeriod) {
+  ResetExecutionProfiles();
+  const IntegerT num_calls = 100000;
+  for (IntegerT i = 0; i < num_calls; ++i) {
+    OpProfileScope<true> profile_scope(SCALAR_SUM_OP);
+  }
+  const ExecutionProfile profile = MergedExecutionProfile();
+  const double expected_samples =
+      static_cast<double>(num_calls) / kOpProfileSamplingPeriod;
+  EXPECT_GT(profile.op_sampled_calls[SCALAR_SUM_OP], expected_samples * 0.8);
+  EXPECT_LT(profile.op_sampled_calls[SCALAR_SUM_OP], expected_samples * 1.2);
+  EXPECT_GT(profile.op_sampled_cycles[SCALAR_SUM_OP], 0);
+}
+
+TEST(ProfilerTest, TimesPhases) {
+  ResetExecutionProfiles();
+  {
+    PhaseProfileScope<true> profile_scope(kTrainProfilePhase);
+    volatile double sum = 0.0;
+    for (IntegerT i = 0; i < 100000; ++i) sum = sum + 1.0;
+  }
+  {
+    PhaseProfileScope<true> profile_scope(kTrainProfilePhase);
+  }
+  const ExecutionProfile profile = MergedExecutionProfile();
+  EXPECT_EQ(profile.phase_calls[kTrainProfilePhase], 2);
+  EXPECT_GT(profile.phase_cycles[kTrainProfilePhase], 0);
+  EXPECT_EQ(profile.phase_calls[kValidateProfilePhase], 0);
+  EXPECT_EQ(profile.phase_cycles[kValidateProfilePhase], 0);
+}
+
+TEST(ProfilerTest, CountsEarlyStops) {
+  ResetExecutionProfiles();
+  ProfileEarlyStop<true>(kTrainNanErrorStop);
+  ProfileEarlyStop<true>(kTrainNanErrorStop);
+  ProfileEarlyStop<true>(kValidLargeErrorStop);
+  ProfileEarlyStop<false>(kValidLargeErrorStop);
+  const ExecutionProfile profile = MergedExecutionProfile();
+  EXPECT_EQ(profile.early_stops[kTrainNanErrorStop], 2);
+  EXPECT_EQ(profile.early_stops[kTrainLargeErrorStop], 0);
+  EXPECT_EQ(profile.early_stops[kValidLargeErrorStop], 1);
+}
+
+TEST(ProfilerTest, MergesTheThreads) {
+  ResetExecutionProfiles();
+  const IntegerT num_threads_before = NumProfiledThreads();
+  vector<std::thread> threads;
+  for (IntegerT t = 0; t < 4; ++t) {
+    threads.emplace_back([]() {
+      for (IntegerT i = 0; i < 500; ++i) {
+        OpProfileScope<true> profile_scope(VECTOR_SUM_OP);
+      }
+      PhaseProfileScope<true> profile_scope(kEvaluationProfilePhase);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  // The profiles outlive their threads.
+  EXPECT_EQ(NumProfiledThreads(), num_threads_before + 4);
+  const ExecutionProfile profile = MergedExecutionProfile();
+  EXPECT_EQ(profile.op_calls[VECTOR_SUM_OP], 2000);
+  EXPECT_EQ(profile.phase_calls[kEvaluationProfilePhase], 4);
+}
+
+TEST(ProfilerTest, ResetClearsTheCounts) {
+  {
+    OpProfileScope<true> profile_scope(SCALAR_SUM_OP);
+  }
+  ProfileEarlyStop<true>(kValidNanErrorStop);
+  ResetExecutionProfiles();
+  const ExecutionProfile profile = MergedExecutionProfile();
+  EXPECT_EQ(profile.op_calls[SCALAR_SUM_OP], 0);
+  EXPECT_EQ(profile.early_stops[kValidNanErrorStop], 0);
+}
+
+TEST(ProfilerTest, WritesTheReport) {
+  ExecutionProfile profile;
+  profile.op_calls[SCALAR_SUM_OP] = 1000;
+  profile.op_sampled_calls[SCALAR_SUM_OP] = 10;
+  profile.op_sampled_cycles[SCALAR_SUM_OP] = 100;
+  profile.op_calls[MATRIX_MATRIX_PRODUCT_OP] = 10;
+  profile.op_sampled_calls[MATRIX_MATRIX_PRODUCT_OP] = 1;
+  profile.op_sampled_cycles[MATRIX_MATRIX_PRODUCT_OP] = 100000;
+  profile.phase_calls[kTrainProfilePhase] = 3;
+  profile.early_stops[kTrainLargeErrorStop] = 7;
+  std::ostringstream output;
+  WriteExecutionProfile(profile, 2, &output);
+  const string report = output.str();
+  EXPECT_NE(report.find("2 threads"), string::npos);
+  EXPECT_NE(report.find("train_large_error=7"), string::npos);
+  // Sorted by the estimated time: 1e6 cycles for the product, 1e4 for the
+  // sum.
+  const size_t product_position = report.find("MATRIX_MATRIX_PRODUCT_OP");
+  const size_t sum_position = report.find("SCALAR_SUM_OP");
+  ASSERT_NE(product_position, string::npos);
+  ASSERT_NE(sum_position, string::npos);
+  EXPECT_LT(product_position, sum_position);
+  // Ops that were never called are left out.
+  EXPECT_EQ(report.find("SCALAR_DIFF_OP"), string::npos);
+}
+
+}  // namespace automl_zero
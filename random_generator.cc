@@ -28,10 +28,16 @@ using ::std::mt19937;
 using ::std::numeric_limits;
 using ::std::string;
 
-RandomGenerator::RandomGenerator(mt19937* bit_gen) : bit_gen_(bit_gen) {}
+RandomGenerator::RandomGenerator(mt19937* bit_gen)
+    : bit_gen_(bit_gen), philox_(nullptr) {}
+
+RandomGenerator::RandomGenerator(PhiloxBitGen* philox)
+    : bit_gen_(nullptr), philox_(philox) {}
 
 float RandomGenerator::GaussianFloat(float mean, float stdev) {
-  return ::absl::Gaussian<float>(*bit_gen_, mean, stdev);
+  return WithBitGen([&](auto& bit_gen) {
+    return ::absl::Gaussian<float>(bit_gen, mean, stdev);
+  });
 }
 
 IntegerT RandomGenerator::UniformInteger(IntegerT low, IntegerT high) {
@@ -39,26 +45,36 @@ IntegerT RandomGenerator::UniformInteger(IntegerT low, IntegerT high) {
   // LeanClient::PutGetAndCount. Probably affects random number generation.
   CHECK_GE(low, std::numeric_limits<int32_t>::min());
   CHECK_LE(high, std::numeric_limits<int32_t>::max());
-  return ::absl::Uniform<int32_t>(*bit_gen_, low, high);
+  return WithBitGen([&](auto& bit_gen) {
+    return ::absl::Uniform<int32_t>(bit_gen, low, high);
+  });
 }
 
 RandomSeedT RandomGenerator::UniformRandomSeed() {
-  return absl::Uniform<RandomSeedT>(
-      absl::IntervalOpen, *bit_gen_,
-      1, std::numeric_limits<RandomSeedT>::max());
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<RandomSeedT>(
+        absl::IntervalOpen, bit_gen,
+        1, std::numeric_limits<RandomSeedT>::max());
+  });
 }
 
 double RandomGenerator::UniformDouble(double low, double high) {
-  return ::absl::Uniform<double>(*bit_gen_, low, high);
+  return WithBitGen([&](auto& bit_gen) {
+    return ::absl::Uniform<double>(bit_gen, low, high);
+  });
 }
 
 float RandomGenerator::UniformFloat(float low, float high) {
-  return ::absl::Uniform<float>(*bit_gen_, low, high);
+  return WithBitGen([&](auto& bit_gen) {
+    return ::absl::Uniform<float>(bit_gen, low, high);
+  });
 }
 
 ProbabilityT RandomGenerator::UniformProbability(
     const ProbabilityT low, const ProbabilityT high) {
-  return ::absl::Uniform<ProbabilityT>(*bit_gen_, low, high);
+  return WithBitGen([&](auto& bit_gen) {
+    return ::absl::Uniform<ProbabilityT>(bit_gen, low, high);
+  });
 }
 
 string RandomGenerator::UniformString(const size_t size) {
@@ -88,67 +104,94 @@ FeatureIndexT RandomGenerator::FeatureIndex(
     const FeatureIndexT features_size) {
   // TODO(ereal): below should have FeatureIndexT instead of InstructionIndexT;
   // affects random number generation.
-  return absl::Uniform<InstructionIndexT>(*bit_gen_, 0, features_size);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<InstructionIndexT>(bit_gen, 0, features_size);
+  });
 }
 
 AddressT RandomGenerator::ScalarInAddress() {
-  return absl::Uniform<AddressT>(*bit_gen_, 0, kMaxScalarAddresses);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<AddressT>(bit_gen, 0, kMaxScalarAddresses);
+  });
 }
 
 AddressT RandomGenerator::VectorInAddress() {
-  return absl::Uniform<AddressT>(*bit_gen_, 0, kMaxVectorAddresses);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<AddressT>(bit_gen, 0, kMaxVectorAddresses);
+  });
 }
 
 AddressT RandomGenerator::MatrixInAddress() {
-  return absl::Uniform<AddressT>(*bit_gen_, 0, kMaxMatrixAddresses);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<AddressT>(bit_gen, 0, kMaxMatrixAddresses);
+  });
 }
 
 AddressT RandomGenerator::ScalarOutAddress() {
-  return absl::Uniform<AddressT>(
-      *bit_gen_, kFirstOutScalarAddress, kMaxScalarAddresses);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<AddressT>(
+        bit_gen, kFirstOutScalarAddress, kMaxScalarAddresses);
+  });
 }
 
 AddressT RandomGenerator::VectorOutAddress() {
-  return absl::Uniform<AddressT>(
-      *bit_gen_, kFirstOutVectorAddress, kMaxVectorAddresses);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<AddressT>(
+        bit_gen, kFirstOutVectorAddress, kMaxVectorAddresses);
+  });
 }
 
 AddressT RandomGenerator::MatrixOutAddress() {
-  return absl::Uniform<AddressT>(
-      *bit_gen_, kFirstOutMatrixAddress, kMaxMatrixAddresses);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<AddressT>(
+        bit_gen, kFirstOutMatrixAddress, kMaxMatrixAddresses);
+  });
 }
 
 Choice2T RandomGenerator::Choice2() {
-  return static_cast<Choice2T>(absl::Uniform<IntegerT>(*bit_gen_, 0, 2));
+  return WithBitGen([&](auto& bit_gen) {
+    return static_cast<Choice2T>(absl::Uniform<IntegerT>(bit_gen, 0, 2));
+  });
 }
 
 Choice3T RandomGenerator::Choice3() {
-  return static_cast<Choice3T>(absl::Uniform<IntegerT>(*bit_gen_, 0, 3));
+  return WithBitGen([&](auto& bit_gen) {
+    return static_cast<Choice3T>(absl::Uniform<IntegerT>(bit_gen, 0, 3));
+  });
 }
 
 IntegerT RandomGenerator::UniformPopulationSize(
     IntegerT high) {
-  return static_cast<IntegerT>(absl::Uniform<uint32_t>(*bit_gen_, 0, high));
+  return WithBitGen([&](auto& bit_gen) {
+    return static_cast<IntegerT>(absl::Uniform<uint32_t>(bit_gen, 0, high));
+  });
 }
 
 double RandomGenerator::UniformActivation(
     double low, double high) {
-  return absl::Uniform<double>(absl::IntervalOpen, *bit_gen_, low, high);
+  return WithBitGen([&](auto& bit_gen) {
+    return absl::Uniform<double>(absl::IntervalOpen, bit_gen, low, high);
+  });
 }
 
 double RandomGenerator::GaussianActivation(
     const double mean, const double stdev) {
-  return ::absl::Gaussian<double>(*bit_gen_, mean, stdev);
+  return WithBitGen([&](auto& bit_gen) {
+    return ::absl::Gaussian<double>(bit_gen, mean, stdev);
+  });
 }
 
 double RandomGenerator::BetaActivation(
     const double alpha, const double beta) {
-  return ::absl::Beta<double>(*bit_gen_, alpha, beta);
+  return WithBitGen([&](auto& bit_gen) {
+    return ::absl::Beta<double>(bit_gen, alpha, beta);
+  });
 }
 
 RandomGenerator::RandomGenerator()
     : bit_gen_owned_(make_unique<mt19937>(GenerateRandomSeed())),
-      bit_gen_(bit_gen_owned_.get()) {}
+      bit_gen_(bit_gen_owned_.get()),
+      philox_(nullptr) {}
 
 RandomSeedT GenerateRandomSeed() {
   RandomSeedT seed = 0;
@@ -15,27 +15,53 @@
 #ifndef AUTOML_ZERO_RANDOM_GENERATOR_H_
 #define AUTOML_ZERO_RANDOM_GENERATOR_H_
 
+#include <algorithm>
 #include <limits>
 #include <random>
+#include <utility>
 
 #include "definitions.h"
+#include "philox.h"
 #include "absl/random/random.h"
 
 namespace automl_zero {
 
-// Thread-compatible, but not thread-safe.
+// Thread-compatible, but not thread-safe. Draws from either a std::mt19937
+// or a counter-based PhiloxBitGen. With the latter, the Fill* methods draw
+// whole vectors and matrices at once.
 class RandomGenerator {
  public:
   explicit RandomGenerator(std::mt19937* gen);
+  explicit RandomGenerator(PhiloxBitGen* philox);
   RandomGenerator(const RandomGenerator& other) = delete;
   RandomGenerator& operator=(const RandomGenerator& other) = delete;
 
+  // Null with the Philox backend.
   inline std::mt19937* BitGen() {return bit_gen_;}
 
-  // Resets the generator with a new random seed.
+  // Resets the generator with a new random seed. With the Philox backend,
+  // restarts at the beginning of stream 0 of that seed.
   void SetSeed(RandomSeedT seed) {
     assert(seed != 0);
-    bit_gen_->seed(seed);
+    if (philox_ != nullptr) {
+      philox_->seed(seed);
+    } else {
+      bit_gen_->seed(seed);
+    }
+  }
+
+  // Returns a uniform T between low (incl) and high (excl), as absl::Uniform.
+  template <typename T>
+  T Uniform(const T low, const T high) {
+    return WithBitGen([&](auto& bit_gen) {
+      return absl::Uniform<T>(bit_gen, low, high);
+    });
+  }
+
+  // Shuffles the range, as std::shuffle.
+  template <typename RandomIt>
+  void Shuffle(const RandomIt first, const RandomIt last) {
+    WithBitGen([&](auto& bit_gen) { std::shuffle(first, last, bit_gen); });
   }
 
   float GaussianFloat(float mean, float stdev);
@@ -101,8 +127,19 @@ class RandomGenerator {
  private:
   friend RandomGenerator RandomGenerator();
 
+  // Calls `draw` with the bit generator of the backend.
+  template <typename Draw>
+  auto WithBitGen(Draw draw) -> decltype(draw(std::declval<std::mt19937&>())) {
+    if (philox_ != nullptr) {
+      return draw(*philox_);
+    }
+    return draw(*bit_gen_);
+  }
+
   std::unique_ptr<std::mt19937> bit_gen_owned_;
+  // Exactly one of these is set.
   std::mt19937* bit_gen_;
+  PhiloxBitGen* philox_;
 };
 
 // Generate a random seed using current time.
@@ -111,6 +148,10 @@ RandomSeedT GenerateRandomSeed();
 template<FeatureIndexT F>
 void RandomGenerator::FillUniform(
     double low, double high, Vector<F>* vector) {
+  if (philox_ != nullptr) {
+    philox_->FillUniform(low, high, vector->data(), vector->size());
+    return;
+  }
   for (FeatureIndexT i = 0; i < F; ++i) {
     (*vector)(i) =
         absl::Uniform<double>(absl::IntervalOpen, *bit_gen_, low, high);
@@ -120,6 +161,10 @@ void RandomGenerator::FillUniform(
 template<FeatureIndexT F>
 void RandomGenerator::FillUniform(
     double low, double high, Matrix<F>* matrix) {
+  if (philox_ != nullptr) {
+    philox_->FillUniform(low, high, matrix->data(), matrix->size());
+    return;
+  }
   for (FeatureIndexT i = 0; i < F; ++i) {
     for (FeatureIndexT j = 0; j < F; ++j) {
       (*matrix)(i, j) =
@@ -131,6 +176,10 @@ void RandomGenerator::FillUniform(
 template<FeatureIndexT F>
 void RandomGenerator::FillGaussian(
     const double mean, const double stdev, Vector<F>* vector) {
+  if (philox_ != nullptr) {
+    philox_->FillGaussian(mean, stdev, vector->data(), vector->size());
+    return;
+  }
   for (FeatureIndexT i = 0; i < F; ++i) {
     (*vector)(i) = ::absl::Gaussian<double>(*bit_gen_, mean, stdev);
   }
@@ -139,6 +188,10 @@ void RandomGenerator::FillGaussian(
 template<FeatureIndexT F>
 void RandomGenerator::FillGaussian(
     const double mean, const double stdev, Matrix<F>* matrix) {
+  if (philox_ != nullptr) {
+    philox_->FillGaussian(mean, stdev, matrix->data(), matrix->size());
+    return;
+  }
   for (FeatureIndexT i = 0; i < F; ++i) {
     for (FeatureIndexT j = 0; j < F; ++j) {
       (*matrix)(i, j) = ::absl::Gaussian<double>(*bit_gen_, mean, stdev);
@@ -150,7 +203,9 @@ template<FeatureIndexT F>
 void RandomGenerator::FillBeta(
     const double alpha, const double beta, Vector<F>* vector) {
   for (FeatureIndexT i = 0; i < F; ++i) {
-    (*vector)(i) = ::absl::Beta<double>(*bit_gen_, alpha, beta);
+    (*vector)(i) = WithBitGen([&](auto& bit_gen) {
+      return ::absl::Beta<double>(bit_gen, alpha, beta);
+    });
   }
 }
 
@@ -159,7 +214,9 @@ void RandomGenerator::FillBeta(
     const double alpha, const double beta, Matrix<F>* matrix) {
   for (FeatureIndexT i = 0; i < F; ++i) {
     for (FeatureIndexT j = 0; j < F; ++j) {
-      (*matrix)(i, j) = ::absl::Beta<double>(*bit_gen_, alpha, beta);
+      (*matrix)(i, j) = WithBitGen([&](auto& bit_gen) {
+        return ::absl::Beta<double>(bit_gen, alpha, beta);
+      });
     }
   }
 }
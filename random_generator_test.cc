@@ -17,8 +17,10 @@
 #include <cmath>
 #include <random>
 #include <unordered_set>
+#include <vector>
 
 #include "definitions.h"
+#include "philox.h"
 #include "test_util.h"
 #include "gtest/gtest.h"
 #include "absl/container/node_hash_set.h"
@@ -422,6 +424,55 @@ TEST(RandomGeneratorTest, FillBetaMatrixTest_Fis4) {
       Range<IntegerT>(0, 11)));
 }
 
+TEST(RandomGeneratorTest, PhiloxFillUniformMatrixTest_Fis4) {
+  PhiloxBitGen philox(GenerateRandomSeed());
+  RandomGenerator rand_gen(&philox);
+  FeatureIndexT index_x = rand_gen.FeatureIndex(4);
+  FeatureIndexT index_y = rand_gen.FeatureIndex(4);
+  EXPECT_TRUE(IsEventually(
+      function<IntegerT(void)>([&](){
+        return FillUniformMatrixHelper<4>(index_x, index_y, &rand_gen);}),
+      Range<IntegerT>(-5, 11),
+      Range<IntegerT>(-5, 11)));
+}
+
+TEST(RandomGeneratorTest, PhiloxFillGaussianVectorTest_Fis8) {
+  PhiloxBitGen philox(GenerateRandomSeed());
+  RandomGenerator rand_gen(&philox);
+  FeatureIndexT index = rand_gen.FeatureIndex(8);
+  EXPECT_TRUE(IsEventually(
+      function<IntegerT(void)>([&](){
+        Vector<8> vector;
+        rand_gen.FillGaussian<8>(0.0, 10.0, &vector);
+        return std::round(vector(index));}),
+      Range<IntegerT>(-100, 101),
+      Range<IntegerT>(-10, 11)));
+}
+
+TEST(RandomGeneratorTest, PhiloxIsReproducible) {
+  PhiloxBitGen philox1(12345, 7);
+  PhiloxBitGen philox2(12345, 7);
+  RandomGenerator rand_gen1(&philox1);
+  RandomGenerator rand_gen2(&philox2);
+  EXPECT_EQ(rand_gen1.BitGen(), nullptr);
+  Matrix<4> matrix1;
+  Matrix<4> matrix2;
+  rand_gen1.FillGaussian<4>(0.0, 1.0, &matrix1);
+  rand_gen2.FillGaussian<4>(0.0, 1.0, &matrix2);
+  EXPECT_EQ(matrix1, matrix2);
+  EXPECT_EQ(rand_gen1.Uniform<IntegerT>(0, 1000),
+            rand_gen2.Uniform<IntegerT>(0, 1000));
+  std::vector<IntegerT> list1 = {0, 1, 2, 3, 4, 5, 6, 7};
+  std::vector<IntegerT> list2 = list1;
+  rand_gen1.Shuffle(list1.begin(), list1.end());
+  rand_gen2.Shuffle(list2.begin(), list2.end());
+  EXPECT_EQ(list1, list2);
+
+  rand_gen1.SetSeed(12345);
+  PhiloxBitGen philox3(12345);
+  EXPECT_EQ(philox1(), philox3());
+}
+
 TEST(GenerateRandomSeedTest, GeneratesDifferentSeeds) {
   RandomSeedT seed1 = GenerateRandomSeed();
   usleep(100);
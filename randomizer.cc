@@ -69,20 +69,20 @@ void Randomizer::RandomizeLearn(Algorithm* algorithm) {
 }
 
 Op Randomizer::SetupOp() {
-  IntegerT op_index = absl::Uniform<DeprecatedOpIndexT>(
-      *bit_gen_, 0, allowed_setup_ops_.size());
+  IntegerT op_index = rand_gen_->Uniform<DeprecatedOpIndexT>(
+      0, allowed_setup_ops_.size());
   return allowed_setup_ops_[op_index];
 }
 
 Op Randomizer::PredictOp() {
-  IntegerT op_index = absl::Uniform<DeprecatedOpIndexT>(
-      *bit_gen_, 0, allowed_predict_ops_.size());
+  IntegerT op_index = rand_gen_->Uniform<DeprecatedOpIndexT>(
+      0, allowed_predict_ops_.size());
   return allowed_predict_ops_[op_index];
 }
 
 Op Randomizer::LearnOp() {
-  IntegerT op_index = absl::Uniform<DeprecatedOpIndexT>(
-      *bit_gen_, 0, allowed_learn_ops_.size());
+  IntegerT op_index = rand_gen_->Uniform<DeprecatedOpIndexT>(
+      0, allowed_learn_ops_.size());
   return allowed_learn_ops_[op_index];
 }
 
@@ -40,6 +40,7 @@ class Randomizer {
       // Ops that can be introduced into the learn component function.
       // Empty means the component function is not randomized.
       std::vector<Op> allowed_learn_ops,
+      // Only kept for the callers; all the draws go through rand_gen.
       std::mt19937* bit_gen,
       RandomGenerator* rand_gen);
 
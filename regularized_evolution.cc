@@ -90,13 +90,17 @@ namespace automl_zero {
    IntegerT RegularizedEvolution::Init() {
       // Otherwise, initialize the population from scratch.
       const IntegerT start_individuals = num_individuals_;
-      std::vector<double>::iterator fitness_it = fitnesses_.begin();
       for (shared_ptr<const Algorithm>& algorithm : algorithms_) {
          InitAlgorithm(&algorithm);
-         *fitness_it = Execute(algorithm);
-         ++fitness_it;
       }
-      CHECK(fitness_it == fitnesses_.end());
+      // The initial algorithms don't depend on each other's fitness, unlike
+      // the children of Run, so they are evaluated together.
+      const IntegerT start_evaluations = evaluator_->GetNumEvaluations();
+      evaluator_->EvaluateSingleBatch(algorithms_, &fitnesses_);
+      CHECK_EQ(fitnesses_.size(), population_size_);
+      for (IntegerT i = 0; i < population_size_; ++i) {
+         RecordFitness(fitnesses_[i], start_evaluations + i + 1);
+      }
 
       MaybePrintProgress();
       initialized_ = true;
@@ -104,14 +108,16 @@ namespace automl_zero {
    }
 
     IntegerT RegularizedEvolution::Run(const IntegerT max_train_steps,
-                                       const IntegerT max_nanos) {
+                                       const IntegerT max_nanos,
+                                       const std::atomic<bool>* stop) {
         CHECK(initialized_) << "RegularizedEvolution not initialized."
                             << std::endl;
         const IntegerT start_nanos = GetCurrentTimeNanos();
         const IntegerT start_train_steps = evaluator_->GetNumTrainStepsCompleted();
         while (evaluator_->GetNumTrainStepsCompleted() - start_train_steps <
                max_train_steps &&
-               GetCurrentTimeNanos() - start_nanos < max_nanos) {
+               GetCurrentTimeNanos() - start_nanos < max_nanos &&
+               (stop == nullptr || !*stop)) {
             vector<double>::iterator next_fitness_it = fitnesses_.begin();
             next_fitness_it = fitnesses_.begin();
             for (shared_ptr<const Algorithm>& next_algorithm : algorithms_) {
@@ -211,18 +217,23 @@ namespace automl_zero {
    }
 
    double RegularizedEvolution::Execute(shared_ptr<const Algorithm> algorithm) {
+      const double fitness = evaluator_->EvaluateSingle(*algorithm);
+      RecordFitness(fitness, evaluator_->GetNumEvaluations());
+      return fitness;
+   }
+
+   void RegularizedEvolution::RecordFitness(const double fitness,
+                                            const IntegerT num_evaluations) {
       ++num_individuals_;
       epoch_secs_ = GetCurrentTimeNanos() / kNanosPerSecond;
-      const double fitness = evaluator_->EvaluateSingle(*algorithm);
       if(fitness<best_error_){
 //          std::cout << "best error till now: " << fitness << std::endl;
          best_error_ = fitness;
          if((first_feasible_error_found_==-1) && (best_error_ < feasible_error_)) {
 //             std::cout << best_error_ << " " << feasible_error_ << std::endl;
-             first_feasible_error_found_ = evaluator_->GetNumEvaluations();
+             first_feasible_error_found_ = num_evaluations;
          }
       }
-      return fitness;
    }
 
    shared_ptr<const Algorithm>
@@ -15,6 +15,7 @@
 #ifndef AUTOML_ZERO_REGULARIZED_EVOLUTION_H_
 #define AUTOML_ZERO_REGULARIZED_EVOLUTION_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <unordered_set>
@@ -62,8 +63,10 @@ class RegularizedEvolution {
   // Runs for a given amount of time (rounded up to the nearest generation) or
   // for a certain number of train steps (rounded up to the nearest generation),
   // whichever is first. Assumes that Init has been called. Returns the number
-  // of train steps executed in this call.
-  IntegerT Run(IntegerT max_train_steps, IntegerT max_nanos);
+  // of train steps executed in this call. If `stop` is not nullptr, also
+  // returns at the end of the first generation after `*stop` became true.
+  IntegerT Run(IntegerT max_train_steps, IntegerT max_nanos,
+               const std::atomic<bool>* stop = nullptr);
 
   // Returns the CUs/number of individuals evaluated so far. Returns an exact
   // number.
@@ -105,6 +108,8 @@ class RegularizedEvolution {
 
   void InitAlgorithm(std::shared_ptr<const Algorithm>* algorithm);
   double Execute(std::shared_ptr<const Algorithm> algorithm);
+  // Records the fitness of the evaluation numbered `num_evaluations`.
+  void RecordFitness(double fitness, IntegerT num_evaluations);
   std::shared_ptr<const Algorithm> BestFitnessTournament();
   void SingleParentSelect(std::shared_ptr<const Algorithm>* algorithm);
   void MaybePrintProgress();
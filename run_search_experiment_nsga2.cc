@@ -15,6 +15,8 @@
 // Runs the RegularizedEvolution algorithm locally.
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -22,6 +24,7 @@
 #include <string>
 #include <fstream>
 #include <ctime>
+#include <iomanip>
 #include <filesystem>
 
 
@@ -31,15 +34,26 @@
 #include "definitions.h"
 #include "instruction.pb.h"
 #include "evaluator.h"
+#include "metrics.h"
 #include "experiment.pb.h"
 #include "compute_cost_new.h"
+#include "cpu_topology.h"
+#include "execution_watchdog.h"
 #include "experiment_util.h"
 #include "fec_cache.h"
 #include "generator.h"
+#include "huge_page_allocator.h"
 #include "mutator.h"
 #include "random_generator.h"
 #include "regularized_evolution.h"
 #include "nsga2.h"
+#include "op_cost_model.h"
+#include "parallel.h"
+#include "pareto_archive.h"
+#include "philox.h"
+#include "profiler.h"
+#include "task_disk_cache.h"
+#include "task_store.h"
 #include "train_budget.h"
 #include "google/protobuf/text_format.h"
 #include "absl/flags/flag.h"
@@ -65,8 +79,8 @@ ABSL_FLAG(
 ABSL_FLAG(
         RandomSeedT, random_seed, 0,
 "Seed for random generator. Use `0` to not specify a seed (creates a new "
-"seed each time). If running multiple experiments, this seed is set at the "
-"beginning of the first experiment. Does not affect tasks.");
+"seed each time). If running multiple experiments, each one derives its own "
+"seed from this one. Does not affect tasks.");
 ABSL_FLAG(
         bool, randomize_task_seeds, false,
 "If true, the data in T_search and T_select is randomized for every "
@@ -82,6 +96,77 @@ ABSL_FLAG(
         double, sufficient_fitness, std::numeric_limits<double>::max(),
 "Experimentation stops when any experiment reaches this select fitness. "
 "If not specified, keeps experimenting until max_experiments is reached.");
+ABSL_FLAG(
+        IntegerT, parallel_experiments, 1,
+"Number of experiments to run at the same time, each on its own thread. "
+"Every experiment has its own random stream, derived from `random_seed` and "
+"the experiment number. Once an experiment reaches `sufficient_fitness`, no "
+"new experiment is started and the running experiments numbered above it "
+"stop at the end of their current generation, while those numbered below it "
+"run to the end, as when they run one after the other. So the results do not "
+"depend on this flag.");
+ABSL_FLAG(
+        IntegerT, task_threads, 1,
+"Number of threads that evaluate the search tasks concurrently. The "
+"(algorithm, task) pairs of the children of a generation are scheduled "
+"together, so that cheap and expensive algorithms balance out. The threads "
+"are shared by all the experiments, which run the tasks of their own "
+"algorithms too. Each (evaluation, task) pair has its own random stream, so "
+"the results do not depend on this flag. If `0`, uses all the hardware "
+"threads.");
+ABSL_FLAG(
+        bool, pin_threads, false,
+"Whether to pin each of the `task_threads` to a CPU, alternating between the "
+"NUMA nodes, and to copy the search tasks into the memory of every node, so "
+"that the threads read the examples from their local node. The copies are "
+"identical, so the results do not depend on this flag.");
+ABSL_FLAG(
+        IntegerT, task_generation_threads, 0,
+"Number of threads used to generate the task data. Tasks are generated "
+"once and shared by all the experiments that use them. If `0`, uses all "
+"the hardware threads.");
+ABSL_FLAG(
+        std::string, task_cache_dir, "",
+"Directory in which the data of the generated regression tasks is saved, "
+"to be reloaded instead of regenerated by later runs. Can be shared by "
+"several runs. If empty, the data is not saved.");
+ABSL_FLAG(
+        IntegerT, final_evaluation_threads, 0,
+"Number of threads used to evaluate the candidate algorithms on the select "
+"and final tasks. Each (algorithm, task) pair is evaluated separately, with "
+"its own random seed, so the results do not depend on this flag. If `0`, "
+"uses all the hardware threads.");
+ABSL_FLAG(
+        std::string, final_evaluation_csv, "",
+"If set, the candidate algorithms (the pareto front, then the archive) and "
+"their errors on the search, select and final tasks are written to this CSV "
+"file, one row per algorithm, in the order in which they are printed.");
+ABSL_FLAG(
+        bool, final_evaluate_archive, false,
+"If true, the final evaluation also covers every non-dominated algorithm "
+"found during the search (across all experiments), not only the pareto "
+"front of the last population. Archived algorithms that are also in that "
+"pareto front are evaluated only once.");
+ABSL_FLAG(
+        std::string, metrics_output, "",
+"If set, metrics of the search progress (evaluations and train steps per "
+"second, functional cache hits, archive size, hypervolume, time per phase, "
+"per experiment) are written to this file, from a background thread. If "
+"empty, no metrics are collected.");
+ABSL_FLAG(
+        std::string, metrics_format, "jsonl",
+"Format of `metrics_output`: `jsonl` appends one JSON object per flush, "
+"`prometheus` rewrites the file in the Prometheus text format on every "
+"flush (e.g. for the textfile collector of the node exporter).");
+ABSL_FLAG(
+        double, metrics_flush_secs, 10.0,
+"How often `metrics_output` is written, in seconds. It is also written once "
+"at the end of the search.");
+ABSL_FLAG(
+        std::string, profile_output, "",
+"Where to write the execution profile (time per phase and per op, early "
+"stops) at the end of the run. Only used in builds with "
+"--copt=-DPROFILE_EXECUTION=1. If empty, it is written to stdout.");
 
 namespace automl_zero {
 
@@ -92,7 +177,6 @@ namespace automl_zero {
         using ::std::cout;  // NOLINT
         using ::std::endl;  // NOLINT
         using ::std::make_shared;  // NOLINT
-        using ::std::mt19937;  // NOLINT
         using ::std::numeric_limits;  // NOLINT
         using ::std::shared_ptr;  // NOLINT
         using ::std::unique_ptr;  // NOLINT
@@ -100,11 +184,92 @@ namespace automl_zero {
     }  // namespace
 
 
-    double compute_complexity(shared_ptr<const Algorithm> algo){
-        double algorithm_complexity = 0.0;
-        algorithm_complexity = ComputeCostNew(algo->setup_) + ComputeCostNew(algo->predict_) + ComputeCostNew(algo->learn_);
+    double compute_complexity(shared_ptr<const Algorithm> algo,
+                              const OpCostModel* op_cost_model){
+        // The overall complexity.
+        return AlgorithmComplexity(*algo, op_cost_model).back();
+    }
+
+    // The outcome of one search experiment.
+    struct ExperimentResult {
+        std::vector<std::pair<std::shared_ptr<const Algorithm>, std::pair<std::vector<double>, std::vector<double>>>> pareto_front;
+        std::vector<ParetoArchive::Entry> archive_entries;
+        double best_error = numeric_limits<double>::max();
+        IntegerT first_feasible_error_found = -1;
+        IntegerT num_evaluations = 0;
+        // Evaluations ended by the watchdog.
+        IntegerT num_timeouts = 0;
+        // When the hypervolume converged. 0 generations if it did not.
+        IntegerT hv_converged_generations = 0;
+        IntegerT hv_converged_train_steps = 0;
+        double hypervolume = 0.0;
+    };
+
+    // An algorithm evaluated after the search.
+    struct Candidate {
+        shared_ptr<const Algorithm> algorithm;
+        // "pareto_front" or "archive".
+        std::string source;
+        std::pair<std::vector<double>, std::vector<double>> train_fitness;
+        // Empty if there are no select tasks.
+        std::pair<std::vector<double>, std::vector<double>> select_fitness;
+        std::pair<std::vector<double>, std::vector<double>> final_fitness;
+    };
+
+    HugePageMode ToHugePageMode(const HugePages huge_pages) {
+        switch (huge_pages) {
+            case NO_HUGE_PAGES:
+                return kNoHugePages;
+            case TRANSPARENT_HUGE_PAGES:
+                return kTransparentHugePages;
+            case EXPLICIT_HUGE_PAGES:
+                return kExplicitHugePages;
+        }
+        LOG(FATAL) << "Unknown huge pages option." << endl;
+    }
+
+    ParetoArchiveObjectives ToArchiveObjectives(
+            const ArchiveObjectives archive_objectives) {
+        switch (archive_objectives) {
+            case ERROR_AND_COMPLEXITY:
+                return kErrorAndComplexityObjectives;
+            case ERROR_AND_COMPONENT_COMPLEXITIES:
+                return kErrorAndComponentComplexityObjectives;
+        }
+        LOG(FATAL) << "Unknown archive objectives option." << endl;
+    }
 
-        return algorithm_complexity;
+    // Writes one row per candidate, with its errors on each set of tasks and
+    // its complexity objectives.
+    void WriteCandidatesCsv(const std::vector<Candidate>& candidates,
+                            const OpCostModel* op_cost_model,
+                            const std::string& path) {
+        std::ofstream output(path);
+        CHECK(output.is_open()) << "Could not open " << path << endl;
+        output << std::setprecision(numeric_limits<double>::max_digits10);
+        output << "candidate,source,train_error,train_error_stdev,"
+               << "select_error,select_error_stdev,final_error,final_error_stdev,"
+               << "predict_complexity,learn_complexity,setup_complexity,complexity\n";
+        for (IntegerT i = 0; i < candidates.size(); ++i) {
+            const Candidate& candidate = candidates[i];
+            output << i << "," << candidate.source << ","
+                   << candidate.train_fitness.first[0] << ","
+                   << candidate.train_fitness.first[1] << ",";
+            if (candidate.select_fitness.first.empty()) {
+                output << ",,";
+            } else {
+                output << candidate.select_fitness.first[0] << ","
+                       << candidate.select_fitness.first[1] << ",";
+            }
+            output << candidate.final_fitness.first[0] << ","
+                   << candidate.final_fitness.first[1];
+            for (const double complexity :
+                    AlgorithmComplexity(*candidate.algorithm, op_cost_model)) {
+                output << "," << complexity;
+            }
+            output << "\n";
+        }
+        CHECK(output.good()) << "Could not write " << path << endl;
     }
 
     void run_NSGA2(){
@@ -112,6 +277,8 @@ namespace automl_zero {
         CHECK(!GetFlag(FLAGS_search_experiment_spec).empty());
         auto experiment_spec = ParseTextFormat<SearchExperimentSpec>(
                 GetFlag(FLAGS_search_experiment_spec));
+        // Before the tasks and the caches it backs are allocated.
+        SetHugePageMode(ToHugePageMode(experiment_spec.huge_pages()));
 
         // Specify some parameters for NSGA2.
         IntegerT max_mut = 5;
@@ -129,62 +296,127 @@ namespace automl_zero {
         if (random_seed == 0) {
             random_seed = GenerateRandomSeed();
         }
-        mt19937 bit_gen(random_seed);
+        // Stream 0 of the seed. The experiments use the next ones.
+        PhiloxBitGen bit_gen(random_seed);
         RandomGenerator rand_gen(&bit_gen);
 
         const double sufficient_error = GetFlag(FLAGS_sufficient_fitness);
         const IntegerT max_experiments = GetFlag(FLAGS_max_experiments);
-
-        Generator generator(
-                experiment_spec.initial_population(),
-                experiment_spec.setup_size_init(),
-                experiment_spec.predict_size_init(),
-                experiment_spec.learn_size_init(),
-                ExtractOps(experiment_spec.setup_ops()),
-                ExtractOps(experiment_spec.predict_ops()),
-                ExtractOps(experiment_spec.learn_ops()), &bit_gen,
-                &rand_gen);
-        unique_ptr<TrainBudget> train_budget;
-        if (experiment_spec.has_train_budget()) {
-            train_budget =
-                    BuildTrainBudget(experiment_spec.train_budget(), &generator);
-        }
-
-        Mutator mutator(
-                experiment_spec.allowed_mutation_types(),
-                experiment_spec.mutate_prob(),
-                ExtractOps(experiment_spec.setup_ops()),
-                ExtractOps(experiment_spec.predict_ops()),
-                ExtractOps(experiment_spec.learn_ops()),
-                experiment_spec.mutate_setup_size_min(),
-                experiment_spec.mutate_setup_size_max(),
-                experiment_spec.mutate_predict_size_min(),
-                experiment_spec.mutate_predict_size_max(),
-                experiment_spec.mutate_learn_size_min(),
-                experiment_spec.mutate_learn_size_max(),
-                &bit_gen, &rand_gen);
         auto select_tasks =
                 ParseTextFormat<TaskCollection>(GetFlag(FLAGS_select_tasks));
 
         std::cout << "max experiments: " << max_experiments << std::endl;
 
         // Run search experiments and select best algorithm.
-        IntegerT num_experiments = 0;
         double best_select_fitness = numeric_limits<double>::lowest();
         shared_ptr<const Algorithm> best_algorithm = make_shared<const Algorithm>();
         std::vector<std::pair<std::shared_ptr<const Algorithm>, std::pair<std::vector<double>, std::vector<double>>>> pf;
+        // Non-dominated algorithms found across all the experiments.
+        const ParetoArchiveObjectives archive_objectives =
+                ToArchiveObjectives(experiment_spec.archive_objectives());
+        ParetoArchive archive(archive_objectives);
         std::cout << "Random Seed: " << random_seed << std::endl;
         IntegerT feature_dim = experiment_spec.search_tasks().tasks()[0].features_size();
+        unique_ptr<OpCostModel> op_cost_model =
+                experiment_spec.has_op_cost_table() ?
+                make_unique<OpCostModel>(
+                        ReadOpCostTable(experiment_spec.op_cost_table()),
+                        feature_dim) :
+                nullptr;
+        std::unique_ptr<TaskDiskCache> task_disk_cache =
+                GetFlag(FLAGS_task_cache_dir).empty() ?
+                nullptr :
+                make_unique<TaskDiskCache>(GetFlag(FLAGS_task_cache_dir));
+        const CpuTopology cpu_topology = CpuTopology::Detect();
+        std::cout << "CPU topology: " << cpu_topology.ToString() << std::endl;
+        const CpuTopology* pinning_topology =
+                GetFlag(FLAGS_pin_threads) ? &cpu_topology : nullptr;
+        TaskStore task_store(
+                GetFlag(FLAGS_task_generation_threads) > 0 ?
+                GetFlag(FLAGS_task_generation_threads) :
+                NumHardwareThreads(),
+                task_disk_cache.get(), pinning_topology);
         const clock_t begin_time = clock();
         IntegerT first_time_feasible_soln = 0;
 
-        double best_error;
-        IntegerT first_feasible_error_found;
+        // Population size for NSGA2 should be a multiple of 4
+        population_size = (population_size % 4 == 0)? population_size : (4 * static_cast<IntegerT> (population_size/4 + 1));
+
+        // Search metrics, exported until the end of the experiments.
+        std::unique_ptr<MetricsRegistry> metrics_registry;
+        std::unique_ptr<MetricsExporter> metrics_exporter;
+        if (!GetFlag(FLAGS_metrics_output).empty()) {
+            metrics_registry = make_unique<MetricsRegistry>();
+            metrics_exporter = make_unique<MetricsExporter>(
+                    metrics_registry.get(), GetFlag(FLAGS_metrics_output),
+                    ParseMetricsFormat(GetFlag(FLAGS_metrics_format)),
+                    std::chrono::milliseconds(static_cast<IntegerT>(
+                            GetFlag(FLAGS_metrics_flush_secs) * 1000)));
+        }
+
+        // Shared by the evaluators of all the experiments.
+        const IntegerT task_threads =
+                GetFlag(FLAGS_task_threads) > 0 ?
+                GetFlag(FLAGS_task_threads) :
+                NumHardwareThreads();
+        std::unique_ptr<ThreadPool> task_thread_pool =
+                task_threads > 1 ?
+                make_unique<ThreadPool>(task_threads, pinning_topology) :
+                nullptr;
+
+        // Runs at least one experiment.
+        std::vector<ExperimentResult> results(std::max<IntegerT>(max_experiments, 1));
+
+        // Runs one experiment. Everything it modifies is its own, except for
+        // the thread-safe task store and thread pool, so experiments can run
+        // concurrently.
+        // Returns whether the experiment reached the sufficient error. Stops
+        // early once `*stop` is true, when an experiment numbered below it
+        // reached the sufficient error.
+        auto run_experiment = [&](const IntegerT experiment,
+                                  const std::atomic<bool>* stop) {
+            // Each experiment has its own Philox stream of the seed, so it
+            // only depends on the seed and the experiment number.
+            PhiloxBitGen experiment_bit_gen(random_seed, experiment + 1);
+            RandomGenerator experiment_rand_gen(&experiment_bit_gen);
+
+            Generator generator(
+                    experiment_spec.initial_population(),
+                    experiment_spec.setup_size_init(),
+                    experiment_spec.predict_size_init(),
+                    experiment_spec.learn_size_init(),
+                    ExtractOps(experiment_spec.setup_ops()),
+                    ExtractOps(experiment_spec.predict_ops()),
+                    ExtractOps(experiment_spec.learn_ops()),
+                    nullptr,  // bit_gen
+                    &experiment_rand_gen);
+            unique_ptr<TrainBudget> train_budget;
+            if (experiment_spec.has_train_budget()) {
+                train_budget =
+                        BuildTrainBudget(experiment_spec.train_budget(), &generator);
+            }
+
+            Mutator mutator(
+                    experiment_spec.allowed_mutation_types(),
+                    experiment_spec.mutate_prob(),
+                    ExtractOps(experiment_spec.setup_ops()),
+                    ExtractOps(experiment_spec.predict_ops()),
+                    ExtractOps(experiment_spec.learn_ops()),
+                    experiment_spec.mutate_setup_size_min(),
+                    experiment_spec.mutate_setup_size_max(),
+                    experiment_spec.mutate_predict_size_min(),
+                    experiment_spec.mutate_predict_size_max(),
+                    experiment_spec.mutate_learn_size_min(),
+                    experiment_spec.mutate_learn_size_max(),
+                    nullptr,  // bit_gen
+                    &experiment_rand_gen);
 
-        while (true) {
             // Randomize T_search tasks.
+            TaskCollection search_tasks = experiment_spec.search_tasks();
             if (GetFlag(FLAGS_randomize_task_seeds)) {
-                RandomizeTaskSeeds(experiment_spec.mutable_search_tasks(), 4);
+                RandomizeTaskSeeds(&search_tasks, 4);
+                // The tasks of the previous experiments won't be used again.
+                task_store.EvictUnused();
             }
 
             // Build non-reusable search structures.
@@ -192,20 +424,33 @@ namespace automl_zero {
                     experiment_spec.has_fec() ?
                     make_unique<FECCache>(experiment_spec.fec()) :
                     nullptr;
+            unique_ptr<ExecutionWatchdog> watchdog =
+                    experiment_spec.max_evaluation_instructions() > 0 ||
+                    experiment_spec.max_evaluation_secs() > 0.0 ?
+                    make_unique<ExecutionWatchdog>(
+                            experiment_spec.max_evaluation_instructions(),
+                            experiment_spec.max_evaluation_secs()) :
+                    nullptr;
 
             Evaluator evaluator(
                     experiment_spec.fitness_combination_mode(),
-                    experiment_spec.search_tasks(),
-                    &rand_gen,
+                    search_tasks,
+                    &experiment_rand_gen,
                     functional_cache.get(),
                     train_budget.get(),
-                    experiment_spec.max_abs_error());
-
-            // Population size for NSGA2 should be a multiple of 4
-            population_size = (population_size % 4 == 0)? population_size : (4 * static_cast<IntegerT> (population_size/4 + 1));
+                    experiment_spec.max_abs_error(),
+                    op_cost_model.get(),
+                    &task_store,
+                    watchdog.get(),
+                    task_thread_pool.get());
+
+            unique_ptr<SearchMetrics> search_metrics =
+                    metrics_registry != nullptr ?
+                    make_unique<SearchMetrics>(metrics_registry.get(), experiment) :
+                    nullptr;
 
             NSGA2 search_algo(
-                    &rand_gen, population_size,
+                    &experiment_rand_gen, population_size,
                     experiment_spec.progress_every(),
                     &generator, &evaluator, &mutator, crossover, max_mut, cross_prob,
                     experiment_spec.mutate_setup_size_min(),
@@ -219,7 +464,18 @@ namespace automl_zero {
                     max_error,
                     max_complexity,
                     sufficient_error,
-                    max_error_sd_consider);
+                    max_error_sd_consider,
+                    std::make_pair(experiment_spec.hv_reference_error(),
+                                   experiment_spec.hv_reference_complexity()),
+                    experiment_spec.hv_stop_generations(),
+                    experiment_spec.hv_stop_epsilon(),
+                    archive_objectives,
+                    experiment_spec.duplicate_handling(),
+                    experiment_spec.max_duplicate_remutations(),
+                    experiment_spec.max_seen_fitnesses(),
+                    experiment_spec.has_surrogate() ?
+                            &experiment_spec.surrogate() : nullptr,
+                    search_metrics.get());
 
             // Run one experiment.
             search_algo.Init();
@@ -227,73 +483,221 @@ namespace automl_zero {
                     experiment_spec.max_train_steps() -
                     search_algo.NumTrainSteps();
 
-            search_algo.Run(remaining_train_steps, kUnlimitedTime);
+            search_algo.Run(remaining_train_steps, kUnlimitedTime, stop);
+
+            ExperimentResult& result = results[experiment];
+            if (search_algo.HypervolumeConverged()) {
+                result.hv_converged_generations =
+                        search_algo.GetHypervolumeHistory().size();
+                result.hv_converged_train_steps = search_algo.NumTrainSteps();
+                result.hypervolume = search_algo.GetHypervolumeHistory().back();
+            }
 
             // Get the pareto front.
-            pf = search_algo.GetParetoFront();
+            result.pareto_front = search_algo.GetParetoFront();
+            result.archive_entries = search_algo.GetParetoArchive().Entries();
+            result.best_error = search_algo.GetBestError();
+            result.first_feasible_error_found = search_algo.GetFirstFeasibleError();
+            result.num_evaluations = evaluator.GetNumEvaluations();
+            result.num_timeouts = evaluator.NumTimeouts();
+            return result.best_error <= sufficient_error;
+        };
+        const IntegerT num_experiments = ParallelForUntil(
+                results.size(), GetFlag(FLAGS_parallel_experiments),
+                run_experiment);
+        // Writes the final metrics.
+        metrics_exporter.reset();
+
+        // Aggregate the experiments in order, as if they had run one after the
+        // other. Experiments started after the first one that reached the
+        // sufficient error only contribute to the archive.
+        bool sufficient_error_found = false;
+        for (IntegerT experiment = 0; experiment < num_experiments; ++experiment) {
+            const ExperimentResult& result = results[experiment];
+            for (const ParetoArchive::Entry& entry : result.archive_entries) {
+                archive.Insert(entry.algorithm, entry.fitness);
+            }
+            if (sufficient_error_found) {
+                continue;
+            }
+            if (result.hv_converged_generations > 0) {
+                std::cout << "Hypervolume converged after "
+                          << result.hv_converged_generations
+                          << " generations (" << result.hv_converged_train_steps
+                          << " train steps), hypervolume: "
+                          << result.hypervolume << std::endl;
+            }
+
+            if (result.num_timeouts > 0) {
+                std::cout << "Experiment " << experiment << ": "
+                          << result.num_timeouts << " of "
+                          << result.num_evaluations
+                          << " evaluations timed out." << std::endl;
+            }
 
-            best_error = search_algo.GetBestError();
-            first_feasible_error_found = search_algo.GetFirstFeasibleError();
+            pf = result.pareto_front;
 
-            if(first_feasible_error_found == -1) {
-                if(num_experiments == max_experiments-1){
+            if(result.first_feasible_error_found == -1) {
+                if(experiment == max_experiments-1){
                     first_time_feasible_soln = -1;
                 }
                 else {
-                    first_time_feasible_soln += evaluator.GetNumEvaluations();
+                    first_time_feasible_soln += result.num_evaluations;
                 }
             }
             else
-                first_time_feasible_soln += first_feasible_error_found;
+                first_time_feasible_soln += result.first_feasible_error_found;
 
-            std::cout << "The best error for this experiment is: " << best_error << std::endl;
+            std::cout << "The best error for this experiment is: " << result.best_error << std::endl;
 
-
-            if(best_error <= sufficient_error)
-                break;
-
-            ++num_experiments;
-
-            if(num_experiments >= max_experiments)
-                break;
+            if(result.best_error <= sufficient_error)
+                sufficient_error_found = true;
         }
 
         std::cout << "Number of evaluations required to get the first feasible error: " << first_time_feasible_soln << std::endl;
+        if (task_disk_cache != nullptr) {
+            cout << "Task cache: " << task_disk_cache->NumHits() << " hits, "
+                 << task_disk_cache->NumMisses() << " misses." << endl;
+        }
+        if (GetHugePageMode() != kNoHugePages) {
+            const HugePageStats huge_page_stats = GetHugePageStats();
+            cout << "Huge pages: " << huge_page_stats.explicit_bytes
+                 << " bytes explicit, " << huge_page_stats.transparent_bytes
+                 << " bytes transparent, " << huge_page_stats.regular_bytes
+                 << " bytes on regular pages, "
+                 << huge_page_stats.stranded_bytes << " bytes stranded, "
+                 << huge_page_stats.num_fallbacks << " fallbacks." << endl;
+        }
         double time_requirement = double( clock () - begin_time ) /  CLOCKS_PER_SEC;
 
         cout << "Experiment done. Retrieving candidate algorithm." << endl;
 
         // Get the final train set results.
         for(auto it = pf.begin(); it != pf.end(); it++){
-            std::cout << "Error: " << it->second.first[0] << ", Std: " << it->second.first[1] << ", Complexity: " << compute_complexity(it->first) << std::endl;
+            std::cout << "Error: " << it->second.first[0] << ", Std: " << it->second.first[1] << ", Complexity: " << compute_complexity(it->first, op_cost_model.get()) << std::endl;
+        }
+
+        // The algorithms to evaluate on the select and final tasks.
+        std::vector<Candidate> candidates;
+        for (const auto& member : pf) {
+            candidates.push_back({member.first, "pareto_front", member.second});
+        }
+        if (GetFlag(FLAGS_final_evaluate_archive)) {
+            for (const ParetoArchive::Entry& entry : archive.Entries()) {
+                // The pareto front of the last population is mostly archived
+                // too; its members are already candidates.
+                const bool in_pf = std::any_of(
+                        pf.begin(), pf.end(), [&entry](const auto& member) {
+                            return *member.first == *entry.algorithm;
+                        });
+                if (in_pf) continue;
+                candidates.push_back({entry.algorithm, "archive", entry.fitness});
+            }
+        }
+        std::vector<shared_ptr<const Algorithm>> candidate_algorithms;
+        for (const Candidate& candidate : candidates) {
+            candidate_algorithms.push_back(candidate.algorithm);
+        }
+        const IntegerT final_evaluation_threads =
+                GetFlag(FLAGS_final_evaluation_threads) > 0 ?
+                GetFlag(FLAGS_final_evaluation_threads) :
+                NumHardwareThreads();
+        // Seeds of the (algorithm, task) pairs of each stage.
+        const RandomSeedT select_seed = rand_gen.UniformRandomSeed();
+        const RandomSeedT final_seed = rand_gen.UniformRandomSeed();
+        PhiloxBitGen final_bit_gen(rand_gen.UniformRandomSeed());
+        RandomGenerator final_rand_gen(&final_bit_gen);
+
+        // Evaluate on the select tasks, if any.
+        if (select_tasks.tasks_size() > 0) {
+            Evaluator select_evaluator(
+                    experiment_spec.fitness_combination_mode(),
+                    select_tasks,
+                    &final_rand_gen,
+                    nullptr,  // functional_cache
+                    nullptr,  // train_budget
+                    experiment_spec.max_abs_error(),
+                    op_cost_model.get(),
+                    &task_store);
+            const std::vector<std::vector<double>> select_task_fitnesses =
+                    EvaluateTaskFitnesses(select_evaluator, candidate_algorithms,
+                                          select_seed, final_evaluation_threads);
+            for (IntegerT i = 0; i < candidates.size(); ++i) {
+                candidates[i].select_fitness = select_evaluator.CombineTaskFitnesses(
+                        select_task_fitnesses[i], *candidates[i].algorithm);
+            }
         }
 
         // Do a final evaluation on unseen tasks.
-        cout << endl;
-        cout << "Final evaluation of pf algorithm "
-             << "(on unseen tasks)..." << endl;
         const auto final_tasks = ParseTextFormat<TaskCollection>(GetFlag(FLAGS_final_tasks));
-        mt19937 final_bit_gen(rand_gen.UniformRandomSeed());
-        RandomGenerator final_rand_gen(&final_bit_gen);
         Evaluator final_evaluator(
                 experiment_spec.fitness_combination_mode(),
                 final_tasks,
                 &final_rand_gen,
                 nullptr,  // functional_cache
                 nullptr,  // train_budget
-                experiment_spec.max_abs_error());
-
-        std::vector<std::pair<std::vector<double>, std::vector<double>>> test_fitness;
-        std::pair<std::vector<double>, std::vector<double>> cur_fitness;
+                experiment_spec.max_abs_error(),
+                op_cost_model.get(),
+                &task_store);
+        const std::vector<std::vector<double>> final_task_fitnesses =
+                EvaluateTaskFitnesses(final_evaluator, candidate_algorithms,
+                                      final_seed, final_evaluation_threads);
+        for (IntegerT i = 0; i < candidates.size(); ++i) {
+            candidates[i].final_fitness = final_evaluator.CombineTaskFitnesses(
+                    final_task_fitnesses[i], *candidates[i].algorithm);
+        }
 
-        for(auto it = pf.begin(); it != pf.end(); it++){
-            cur_fitness = final_evaluator.EvaluateMulti(*(it->first));
-            double algorithm_complexity = compute_complexity(it->first);
+        cout << endl;
+        cout << "Final evaluation of pf algorithm "
+             << "(on unseen tasks)..." << endl;
+        for (const Candidate& candidate : candidates) {
+            if (candidate.source != "pareto_front") continue;
             // Provide the evaluation metrics on train and test data.
-            std::cout << "Error: " << cur_fitness.first[0] << ", Complexity: " << compute_complexity(it->first)  << std::endl;
-            std::cout << "Algorithm: " << (*(it->first)).ToReadable() << std::endl;
-            test_fitness.push_back(cur_fitness);
-            // }
+            std::cout << "Error: " << candidate.final_fitness.first[0] << ", Complexity: " << compute_complexity(candidate.algorithm, op_cost_model.get())  << std::endl;
+            std::cout << "Algorithm: " << candidate.algorithm->ToReadable() << std::endl;
+        }
+
+        if (GetFlag(FLAGS_final_evaluate_archive)) {
+            cout << endl;
+            const IntegerT num_archive_candidates = std::count_if(
+                    candidates.begin(), candidates.end(),
+                    [](const Candidate& candidate) {
+                        return candidate.source == "archive";
+                    });
+            cout << "Final evaluation of the " << num_archive_candidates
+                 << " archived non-dominated algorithms not in the pf "
+                 << "(on unseen tasks)..." << endl;
+            for (const Candidate& candidate : candidates) {
+                if (candidate.source != "archive") continue;
+                std::cout << "Train Error: " << candidate.train_fitness.first[0]
+                          << ", Test Error: " << candidate.final_fitness.first[0]
+                          << ", Complexity: " << compute_complexity(candidate.algorithm, op_cost_model.get()) << std::endl;
+                std::cout << "Algorithm: " << candidate.algorithm->ToReadable() << std::endl;
+            }
+        }
+
+        if (select_tasks.tasks_size() > 0) {
+            // The algorithm with the lowest select error.
+            const Candidate* selected = nullptr;
+            for (const Candidate& candidate : candidates) {
+                if (selected == nullptr ||
+                    candidate.select_fitness.first[0] < selected->select_fitness.first[0]) {
+                    selected = &candidate;
+                }
+            }
+            if (selected != nullptr) {
+                cout << endl;
+                cout << "Selected algorithm (lowest error on the select tasks)..." << endl;
+                std::cout << "Select Error: " << selected->select_fitness.first[0]
+                          << ", Test Error: " << selected->final_fitness.first[0]
+                          << ", Complexity: " << compute_complexity(selected->algorithm, op_cost_model.get()) << std::endl;
+                std::cout << "Algorithm: " << selected->algorithm->ToReadable() << std::endl;
+            }
+        }
+
+        if (!GetFlag(FLAGS_final_evaluation_csv).empty()) {
+            WriteCandidatesCsv(candidates, op_cost_model.get(),
+                               GetFlag(FLAGS_final_evaluation_csv));
         }
     }
 
@@ -305,5 +709,6 @@ namespace automl_zero {
 int main(int argc, char** argv) {
     absl::ParseCommandLine(argc, argv);
     automl_zero::run();
+    automl_zero::DumpExecutionProfile(absl::GetFlag(FLAGS_profile_output));
     return 0;
 }
@@ -15,6 +15,7 @@
 // Runs the RegularizedEvolution algorithm locally.
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -41,6 +42,8 @@
 #include "random_generator.h"
 #include "regularized_evolution.h"
 #include "nsga2.h"
+#include "parallel.h"
+#include "profiler.h"
 #include "train_budget.h"
 #include "google/protobuf/text_format.h"
 #include "absl/flags/flag.h"
@@ -66,8 +69,8 @@ ABSL_FLAG(
 ABSL_FLAG(
         RandomSeedT, random_seed, 0,
 "Seed for random generator. Use `0` to not specify a seed (creates a new "
-"seed each time). If running multiple experiments, this seed is set at the "
-"beginning of the first experiment. Does not affect tasks.");
+"seed each time). If running multiple experiments, each one derives its own "
+"seed from this one. Does not affect tasks.");
 ABSL_FLAG(
         bool, randomize_task_seeds, false,
 "If true, the data in T_search and T_select is randomized for every "
@@ -83,6 +86,20 @@ ABSL_FLAG(
         double, sufficient_fitness, std::numeric_limits<double>::max(),
 "Experimentation stops when any experiment reaches this select fitness. "
 "If not specified, keeps experimenting until max_experiments is reached.");
+ABSL_FLAG(
+        IntegerT, parallel_experiments, 1,
+"Number of experiments to run at the same time, each on its own thread. "
+"Every experiment has its own random stream, derived from `random_seed` and "
+"the experiment number. Once an experiment reaches `sufficient_fitness`, no "
+"new experiment is started and the running experiments numbered above it "
+"stop at the end of their current generation, while those numbered below it "
+"run to the end, as when they run one after the other. So the results do not "
+"depend on this flag.");
+ABSL_FLAG(
+        std::string, profile_output, "",
+"Where to write the execution profile (time per phase and per op, early "
+"stops) at the end of the run. Only used in builds with "
+"--copt=-DPROFILE_EXECUTION=1. If empty, it is written to stdout.");
 
 namespace automl_zero {
 
@@ -109,6 +126,16 @@ namespace automl_zero {
     }
 
 
+    // The outcome of one search experiment.
+    struct ExperimentResult {
+        shared_ptr<const Algorithm> best_algorithm;
+        // The error of best_algorithm.
+        double train_error = 1.1;
+        double best_error = numeric_limits<double>::max();
+        IntegerT first_feasible_error_found = -1;
+        IntegerT num_evaluations = 0;
+    };
+
     void run_RE(){
         // Set random seed.
         RandomSeedT random_seed = GetFlag(FLAGS_random_seed);
@@ -124,42 +151,11 @@ namespace automl_zero {
                 GetFlag(FLAGS_search_experiment_spec));
         const double sufficient_error = GetFlag(FLAGS_sufficient_fitness);
         const IntegerT max_experiments = GetFlag(FLAGS_max_experiments);
-
-        // cout << experiment_spec.initial_population() << endl;
-        Generator generator(
-                experiment_spec.initial_population(),
-                experiment_spec.setup_size_init(),
-                experiment_spec.predict_size_init(),
-                experiment_spec.learn_size_init(),
-                ExtractOps(experiment_spec.setup_ops()),
-                ExtractOps(experiment_spec.predict_ops()),
-                ExtractOps(experiment_spec.learn_ops()), &bit_gen,
-                &rand_gen);
-        unique_ptr<TrainBudget> train_budget;
-        if (experiment_spec.has_train_budget()) {
-            train_budget =
-                    BuildTrainBudget(experiment_spec.train_budget(), &generator);
-        }
-
-        Mutator mutator(
-                experiment_spec.allowed_mutation_types(),
-                experiment_spec.mutate_prob(),
-                ExtractOps(experiment_spec.setup_ops()),
-                ExtractOps(experiment_spec.predict_ops()),
-                ExtractOps(experiment_spec.learn_ops()),
-                experiment_spec.mutate_setup_size_min(),
-                experiment_spec.mutate_setup_size_max(),
-                experiment_spec.mutate_predict_size_min(),
-                experiment_spec.mutate_predict_size_max(),
-                experiment_spec.mutate_learn_size_min(),
-                experiment_spec.mutate_learn_size_max(),
-                &bit_gen, &rand_gen);
         auto select_tasks =
                 ParseTextFormat<TaskCollection>(GetFlag(FLAGS_select_tasks));
 
 
         // Run search experiments and select best algorithm.
-        IntegerT num_experiments = 0;
         double best_select_fitness = numeric_limits<double>::lowest();
         shared_ptr<const Algorithm> best_algorithm = make_shared<const Algorithm>();
 
@@ -177,13 +173,54 @@ namespace automl_zero {
         std::string animation_output ="/home/ritz/projects/coin_lab/Research_Directions/AutoML/moaz_outputs/"
                                       "pf_animation_az_output.txt";
 
-        while (true) {
-            double best_error;
-            IntegerT first_feasible_error_found;
+        // Runs at least one experiment.
+        std::vector<ExperimentResult> results(std::max<IntegerT>(max_experiments, 1));
+
+        // Runs one experiment. Everything it modifies is its own, so
+        // experiments can run concurrently. Returns whether the experiment
+        // reached the sufficient error. Stops early once `*stop` is true, when
+        // an experiment numbered below it reached the sufficient error.
+        auto run_experiment = [&](const IntegerT experiment,
+                                  const std::atomic<bool>* stop) {
+            // Each experiment has its own random stream, which only depends
+            // on the seed and the experiment number.
+            mt19937 experiment_bit_gen(HashMix<RandomSeedT>(
+                    random_seed, static_cast<RandomSeedT>(experiment)));
+            RandomGenerator experiment_rand_gen(&experiment_bit_gen);
+
+            Generator generator(
+                    experiment_spec.initial_population(),
+                    experiment_spec.setup_size_init(),
+                    experiment_spec.predict_size_init(),
+                    experiment_spec.learn_size_init(),
+                    ExtractOps(experiment_spec.setup_ops()),
+                    ExtractOps(experiment_spec.predict_ops()),
+                    ExtractOps(experiment_spec.learn_ops()), &experiment_bit_gen,
+                    &experiment_rand_gen);
+            unique_ptr<TrainBudget> train_budget;
+            if (experiment_spec.has_train_budget()) {
+                train_budget =
+                        BuildTrainBudget(experiment_spec.train_budget(), &generator);
+            }
+
+            Mutator mutator(
+                    experiment_spec.allowed_mutation_types(),
+                    experiment_spec.mutate_prob(),
+                    ExtractOps(experiment_spec.setup_ops()),
+                    ExtractOps(experiment_spec.predict_ops()),
+                    ExtractOps(experiment_spec.learn_ops()),
+                    experiment_spec.mutate_setup_size_min(),
+                    experiment_spec.mutate_setup_size_max(),
+                    experiment_spec.mutate_predict_size_min(),
+                    experiment_spec.mutate_predict_size_max(),
+                    experiment_spec.mutate_learn_size_min(),
+                    experiment_spec.mutate_learn_size_max(),
+                    &experiment_bit_gen, &experiment_rand_gen);
 
             // Randomize T_search tasks.
+            TaskCollection search_tasks = experiment_spec.search_tasks();
             if (GetFlag(FLAGS_randomize_task_seeds)) {
-                RandomizeTaskSeeds(experiment_spec.mutable_search_tasks(), 4);
+                RandomizeTaskSeeds(&search_tasks, 4);
             }
 
             // Build non-reusable search structures.
@@ -194,17 +231,19 @@ namespace automl_zero {
 
             Evaluator evaluator(
                     experiment_spec.fitness_combination_mode(),
-                    experiment_spec.search_tasks(),
-                    &rand_gen,
+                    search_tasks,
+                    &experiment_rand_gen,
                     functional_cache.get(),
                     train_budget.get(),
                     experiment_spec.max_abs_error());
 
+            // Experiments may run concurrently, so the evaluations in the
+            // animation of each one are counted from 0.
             RegularizedEvolution search_algo(
-                    &rand_gen, experiment_spec.population_size(),
+                    &experiment_rand_gen, experiment_spec.population_size(),
                     experiment_spec.tournament_size(),
                     experiment_spec.progress_every(),
-                    &generator, &evaluator, sufficient_error, &mutator, animation_output, first_time_feasible_soln);
+                    &generator, &evaluator, sufficient_error, &mutator, animation_output, 0);
 
             // Run one experiment.
             search_algo.Init();
@@ -212,36 +251,43 @@ namespace automl_zero {
                     experiment_spec.max_train_steps() -
                     search_algo.NumTrainSteps();
 
-            search_algo.Run(remaining_train_steps, kUnlimitedTime);
+            search_algo.Run(remaining_train_steps, kUnlimitedTime, stop);
 
-            // Compute the minimum error of the pareto front.
-            double min_error = 1.1;
-
-            best_algo = search_algo.GetBest(&min_error);
-            best_error = search_algo.GetBestError();
-            first_feasible_error_found = search_algo.GetFirstFeasibleError();
-
-            if(first_feasible_error_found == -1) {
-                if(num_experiments == max_experiments-1){
+            ExperimentResult& result = results[experiment];
+            result.best_algorithm = search_algo.GetBest(&result.train_error);
+            result.best_error = search_algo.GetBestError();
+            result.first_feasible_error_found = search_algo.GetFirstFeasibleError();
+            result.num_evaluations = evaluator.GetNumEvaluations();
+            // If min error crosses the sufficient error threshold,
+            // Stop the experimentation.
+            return result.train_error <= sufficient_error;
+        };
+        const IntegerT num_experiments = ParallelForUntil(
+                results.size(), GetFlag(FLAGS_parallel_experiments),
+                run_experiment);
+
+        // Aggregate the experiments in order, as if they had run one after the
+        // other, up to the first one that reached the sufficient error.
+        for (IntegerT experiment = 0; experiment < num_experiments; ++experiment) {
+            const ExperimentResult& result = results[experiment];
+
+            best_algo = result.best_algorithm;
+            train_error = result.train_error;
+
+            if(result.first_feasible_error_found == -1) {
+                if(experiment == max_experiments-1){
                     first_time_feasible_soln = -1;
                 }
                 else {
-                    first_time_feasible_soln += evaluator.GetNumEvaluations();
+                    first_time_feasible_soln += result.num_evaluations;
                 }
             }
             else
-                first_time_feasible_soln += first_feasible_error_found;
-
-            std::cout << "The best error for this experiment is: " << best_error << std::endl;
-            train_error = min_error;
-            // If min error crosses the sufficient error threshold,
-            // Stop the experimentation.
-            if(min_error <= sufficient_error)
-                break;
+                first_time_feasible_soln += result.first_feasible_error_found;
 
-            ++num_experiments;
+            std::cout << "The best error for this experiment is: " << result.best_error << std::endl;
 
-            if(num_experiments >= max_experiments)
+            if(result.train_error <= sufficient_error)
                 break;
         }
 
@@ -284,5 +330,6 @@ namespace automl_zero {
 int main(int argc, char** argv) {
     absl::ParseCommandLine(argc, argv);
     automl_zero::run();
+    automl_zero::DumpExecutionProfile(absl::GetFlag(FLAGS_profile_output));
     return 0;
 }
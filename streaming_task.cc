@@ -0,0 +1,72 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "streaming_task.h"
+
+namespace automl_zero {
+
+namespace {
+
+// The SplitMix64 finalizer.
+uint64_t Mix(uint64_t value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+}  // namespace
+
+RandomPermutation::RandomPermutation(const IntegerT size,
+                                     const RandomSeedT seed,
+                                     const IntegerT stream)
+    : size_(size), half_bits_(1) {
+  CHECK_GT(size, 0);
+  while ((1LL << (2 * half_bits_)) < size) {
+    ++half_bits_;
+  }
+  half_mask_ = (1ULL << half_bits_) - 1;
+  uint64_t key = Mix(Mix(seed) ^ static_cast<uint64_t>(stream));
+  for (uint64_t& round_key : keys_) {
+    key = Mix(key + 0x9e3779b97f4a7c15ULL);
+    round_key = key;
+  }
+}
+
+IntegerT RandomPermutation::operator()(const IntegerT index) const {
+  CHECK_GE(index, 0);
+  CHECK_LT(index, size_);
+  // The network permutes [0, 4^half_bits_), so walking the cycle of `index`
+  // eventually comes back into [0, size).
+  uint64_t value = index;
+  do {
+    value = Encrypt(value);
+  } while (value >= static_cast<uint64_t>(size_));
+  return value;
+}
+
+uint64_t RandomPermutation::Encrypt(const uint64_t value) const {
+  uint64_t left = value >> half_bits_;
+  uint64_t right = value & half_mask_;
+  for (const uint64_t round_key : keys_) {
+    const uint64_t next_right = left ^ (Mix(right ^ round_key) & half_mask_);
+    left = right;
+    right = next_right;
+  }
+  return (left << half_bits_) | right;
+}
+
+}  // namespace automl_zero
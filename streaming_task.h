@@ -0,0 +1,370 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_STREAMING_TASK_H_
+#define AUTOML_ZERO_STREAMING_TASK_H_
+
+#include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "columnar_dataset.h"
+#include "definitions.h"
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+// A seeded pseudo-random permutation of [0, size), evaluated one index at a
+// time in O(1) time and memory. It is a 4-round Feistel network over the
+// smallest even power of two >= size, restricted to [0, size) by cycle
+// walking (at most 4 steps on average).
+class RandomPermutation {
+ public:
+  // Different (seed, stream) pairs give independent permutations.
+  RandomPermutation(IntegerT size, RandomSeedT seed, IntegerT stream);
+
+  // The image of `index`, which must be in [0, size).
+  IntegerT operator()(IntegerT index) const;
+
+ private:
+  uint64_t Encrypt(uint64_t value) const;
+
+  const IntegerT size_;
+  IntegerT half_bits_;
+  uint64_t half_mask_;
+  uint64_t keys_[4];
+};
+
+// The examples of one block, in the order in which they are visited.
+template <FeatureIndexT F>
+struct StreamingBlock {
+  std::vector<Vector<F>> features;
+  std::vector<Scalar> labels;
+};
+
+// The examples of one split of a columnar dataset file, visited over several
+// epochs without being loaded into memory. The examples are read in blocks of
+// consecutive rows. In each epoch, the order of the blocks and the order of
+// the examples within each block are random permutations, so the shuffle
+// needs no index storage and still reads the file sequentially, one block at
+// a time. As in GenerateEpochs, the first epoch visits the examples in order.
+//
+// Immutable, so it can be shared by several readers.
+template <FeatureIndexT F>
+class StreamingExamples {
+ public:
+  // Uses the first `num_examples` examples of the split.
+  StreamingExamples(std::shared_ptr<const MappedColumnarDataset> dataset,
+                    ColumnarSplit split, IntegerT num_examples,
+                    IntegerT num_epochs, IntegerT block_size,
+                    RandomSeedT shuffle_seed);
+  StreamingExamples(const StreamingExamples& other) = delete;
+  StreamingExamples& operator=(const StreamingExamples& other) = delete;
+
+  IntegerT NumExamples() const { return num_examples_; }
+  IntegerT NumEpochs() const { return num_epochs_; }
+  IntegerT BlockSize() const { return block_size_; }
+  IntegerT NumBlocksPerEpoch() const { return num_blocks_per_epoch_; }
+
+  // The number of examples in the `block`-th block visited, counting from the
+  // start of the first epoch. Only the blocks at the end of the file can be
+  // smaller than the block size.
+  IntegerT BlockExamples(IntegerT block) const;
+
+  // Reads the `block`-th block visited, counting from the start of the first
+  // epoch.
+  void ReadBlock(IntegerT block, StreamingBlock<F>* output) const;
+
+  // Like above, but only reads the examples visited at positions [begin, end)
+  // of the block.
+  void ReadBlockRange(IntegerT block, IntegerT begin, IntegerT end,
+                      StreamingBlock<F>* output) const;
+
+ private:
+  // The block of the file visited as the `block`-th block.
+  IntegerT FileBlock(IntegerT block) const;
+
+  const std::shared_ptr<const MappedColumnarDataset> dataset_;
+  const ColumnarSplit split_;
+  const IntegerT num_examples_;
+  const IntegerT num_epochs_;
+  const IntegerT block_size_;
+  const IntegerT num_blocks_per_epoch_;
+  const RandomSeedT shuffle_seed_;
+};
+
+// Iterates over the blocks of a StreamingExamples, in segments: the first one
+// can be a part of the first block, sized to the examples needed first, and
+// the next one is then the rest of that block. From the first Advance on,
+// while the current segment is being used, the next one is read by a
+// background thread into a second buffer, so the reads from the file overlap
+// with the computation.
+//
+// Can be restarted on other examples, keeping its buffers and its thread, so
+// that e.g. an Executor reuses one across its executions.
+template <FeatureIndexT F>
+class StreamingReader {
+ public:
+  // Idle until Start is called.
+  StreamingReader();
+  // Starts on `examples`, with a whole first block.
+  explicit StreamingReader(const StreamingExamples<F>* examples);
+  ~StreamingReader();
+  StreamingReader(const StreamingReader& other) = delete;
+  StreamingReader& operator=(const StreamingReader& other) = delete;
+
+  // Starts iterating over `examples`, from the first example, which is read
+  // with the next `first_read_size` ones, up to a block. Abandons the
+  // previous iteration, if any.
+  void Start(const StreamingExamples<F>* examples, IntegerT first_read_size);
+
+  const StreamingBlock<F>& Current() const { return buffers_[current_]; }
+
+  // Moves to the next segment, reading it or waiting for it to be read, and
+  // starts reading the one after.
+  void Advance();
+
+ private:
+  // The examples visited at positions [begin, end) of a block.
+  struct Segment {
+    IntegerT block;
+    IntegerT begin;
+    IntegerT end;
+  };
+
+  // The segment after `segment`. It must not be the last one.
+  Segment Following(const Segment& segment) const;
+  bool IsLast(const Segment& segment) const;
+
+  // The loop of the background thread.
+  void Prefetch();
+
+  const StreamingExamples<F>* examples_;
+  IntegerT num_blocks_;
+  StreamingBlock<F> buffers_[2];
+  // Index of the buffer holding the current segment.
+  IntegerT current_;
+  Segment current_segment_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // The segment to read into the other buffer, when `requested_`.
+  Segment request_;  // Guarded by mutex_.
+  bool requested_;  // Guarded by mutex_.
+  // Whether the background thread is reading the requested segment.
+  bool reading_;  // Guarded by mutex_.
+  // Whether the other buffer holds the requested segment.
+  bool prefetched_;  // Guarded by mutex_.
+  bool stop_;  // Guarded by mutex_.
+  // Started by the first Advance that has a segment to prefetch.
+  std::thread thread_;
+};
+
+template <FeatureIndexT F>
+StreamingExamples<F>::StreamingExamples(
+    std::shared_ptr<const MappedColumnarDataset> dataset,
+    const ColumnarSplit split, const IntegerT num_examples,
+    const IntegerT num_epochs, const IntegerT block_size,
+    const RandomSeedT shuffle_seed)
+    : dataset_(std::move(dataset)),
+      split_(split),
+      num_examples_(num_examples),
+      num_epochs_(num_epochs),
+      block_size_(block_size),
+      num_blocks_per_epoch_((num_examples + block_size - 1) / block_size),
+      shuffle_seed_(shuffle_seed) {
+  CHECK_EQ(dataset_->FeaturesSize(), F) << "Incorrect feature size.";
+  CHECK_GT(num_examples_, 0);
+  CHECK_LE(num_examples_, dataset_->NumExamples(split_))
+      << "Not enough examples in the dataset.";
+  CHECK_GT(num_epochs_, 0);
+  CHECK_GT(block_size_, 0);
+}
+
+template <FeatureIndexT F>
+IntegerT StreamingExamples<F>::FileBlock(const IntegerT block) const {
+  const IntegerT epoch = block / num_blocks_per_epoch_;
+  CHECK_LT(epoch, num_epochs_);
+  const IntegerT file_block = block % num_blocks_per_epoch_;
+  if (epoch == 0) return file_block;
+  return RandomPermutation(num_blocks_per_epoch_, shuffle_seed_,
+                           2 * epoch)(file_block);
+}
+
+template <FeatureIndexT F>
+IntegerT StreamingExamples<F>::BlockExamples(const IntegerT block) const {
+  return std::min(block_size_, num_examples_ - FileBlock(block) * block_size_);
+}
+
+template <FeatureIndexT F>
+void StreamingExamples<F>::ReadBlock(const IntegerT block,
+                                     StreamingBlock<F>* output) const {
+  ReadBlockRange(block, 0, BlockExamples(block), output);
+}
+
+template <FeatureIndexT F>
+void StreamingExamples<F>::ReadBlockRange(const IntegerT block,
+                                          const IntegerT begin,
+                                          const IntegerT end,
+                                          StreamingBlock<F>* output) const {
+  const IntegerT epoch = block / num_blocks_per_epoch_;
+  const IntegerT file_block = FileBlock(block);
+  const IntegerT first_example = file_block * block_size_;
+  const IntegerT size = std::min(block_size_, num_examples_ - first_example);
+  CHECK_GE(begin, 0);
+  CHECK_LE(begin, end);
+  CHECK_LE(end, size);
+  output->features.resize(end - begin);
+  output->labels.resize(end - begin);
+  if (epoch == 0) {
+    for (IntegerT i = begin; i < end; ++i) {
+      dataset_->CopyExample<F>(split_, first_example + i,
+                               &output->features[i - begin],
+                               &output->labels[i - begin]);
+    }
+  } else {
+    const IntegerT stream = epoch * num_blocks_per_epoch_ + file_block;
+    const RandomPermutation permutation(size, shuffle_seed_, 2 * stream + 1);
+    for (IntegerT i = begin; i < end; ++i) {
+      dataset_->CopyExample<F>(split_, first_example + permutation(i),
+                               &output->features[i - begin],
+                               &output->labels[i - begin]);
+    }
+  }
+}
+
+template <FeatureIndexT F>
+StreamingReader<F>::StreamingReader()
+    : examples_(nullptr),
+      num_blocks_(0),
+      current_(0),
+      current_segment_{0, 0, 0},
+      request_{0, 0, 0},
+      requested_(false),
+      reading_(false),
+      prefetched_(false),
+      stop_(false) {}
+
+template <FeatureIndexT F>
+StreamingReader<F>::StreamingReader(const StreamingExamples<F>* examples)
+    : StreamingReader() {
+  Start(examples, examples->BlockSize());
+}
+
+template <FeatureIndexT F>
+StreamingReader<F>::~StreamingReader() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_all();
+    thread_.join();
+  }
+}
+
+template <FeatureIndexT F>
+void StreamingReader<F>::Start(const StreamingExamples<F>* examples,
+                               const IntegerT first_read_size) {
+  CHECK_GT(first_read_size, 0);
+  {
+    // Drops the segment prefetched for the previous iteration, if any.
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return !reading_; });
+    requested_ = false;
+    prefetched_ = false;
+    examples_ = examples;
+    current_ = 0;
+  }
+  num_blocks_ = examples->NumBlocksPerEpoch() * examples->NumEpochs();
+  current_segment_ = {
+      0, 0, std::min(first_read_size, examples->BlockExamples(0))};
+  examples->ReadBlockRange(0, 0, current_segment_.end, &buffers_[0]);
+}
+
+template <FeatureIndexT F>
+typename StreamingReader<F>::Segment StreamingReader<F>::Following(
+    const Segment& segment) const {
+  const IntegerT block_examples = examples_->BlockExamples(segment.block);
+  if (segment.end < block_examples) {
+    return {segment.block, segment.end, block_examples};
+  }
+  CHECK_LT(segment.block + 1, num_blocks_);
+  return {segment.block + 1, 0, examples_->BlockExamples(segment.block + 1)};
+}
+
+template <FeatureIndexT F>
+bool StreamingReader<F>::IsLast(const Segment& segment) const {
+  return segment.block + 1 == num_blocks_ &&
+         segment.end == examples_->BlockExamples(segment.block);
+}
+
+template <FeatureIndexT F>
+void StreamingReader<F>::Advance() {
+  const Segment next = Following(current_segment_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (requested_) {
+    condition_.wait(lock, [this] { return prefetched_; });
+  } else {
+    // The first Advance since Start, with nothing prefetched yet.
+    lock.unlock();
+    examples_->ReadBlockRange(next.block, next.begin, next.end,
+                              &buffers_[1 - current_]);
+    lock.lock();
+  }
+  requested_ = false;
+  prefetched_ = false;
+  current_ = 1 - current_;
+  current_segment_ = next;
+  if (!IsLast(next)) {
+    request_ = Following(next);
+    requested_ = true;
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&StreamingReader<F>::Prefetch, this);
+    }
+    condition_.notify_all();
+  }
+}
+
+template <FeatureIndexT F>
+void StreamingReader<F>::Prefetch() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this] {
+      return stop_ || (requested_ && !prefetched_ && !reading_);
+    });
+    if (stop_) return;
+    const Segment segment = request_;
+    const StreamingExamples<F>* examples = examples_;
+    // Not the current buffer, which is only swapped once this segment is
+    // read.
+    StreamingBlock<F>* buffer = &buffers_[1 - current_];
+    reading_ = true;
+    lock.unlock();
+    examples->ReadBlockRange(segment.block, segment.begin, segment.end,
+                             buffer);
+    lock.lock();
+    reading_ = false;
+    prefetched_ = true;
+    condition_.notify_all();
+  }
+}
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_STREAMING_TASK_H_
@@ -0,0 +1,224 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "streaming_task.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "columnar_dataset.h"
+#include "definitions.h"
+#include "executor.h"
+#include "generator.h"
+#include "random_generator.h"
+#include "task.h"
+#include "task.pb.h"
+#include "task_util.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+
+namespace automl_zero {
+
+using ::absl::StrCat;  // NOLINT
+using ::std::set;  // NOLINT
+using ::std::string;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+constexpr IntegerT kNumExamples = 50;
+
+// Writes a dataset in which the first feature of each example is its index
+// and the label is the index plus 0.5.
+string WriteIndexDataset(const string& name) {
+  ScalarLabelDataset dataset;
+  for (IntegerT k = 0; k < kNumExamples; ++k) {
+    FeatureVector* train = dataset.add_train_features();
+    FeatureVector* valid = dataset.add_valid_features();
+    for (IntegerT i = 0; i < 4; ++i) {
+      train->add_features(i == 0 ? k : 1.0);
+      valid->add_features(i == 0 ? -k : 1.0);
+    }
+    dataset.add_train_labels(k + 0.5);
+    dataset.add_valid_labels(-k + 0.5);
+  }
+  const string path = ::testing::TempDir() + "/" + name;
+  WriteColumnarDataset(dataset, path);
+  return path;
+}
+
+TaskSpec ColumnarTaskSpec(const string& path, const bool streaming,
+                          const IntegerT num_train_epochs) {
+  return ParseTextFormat<TaskSpec>(StrCat(
+      "columnar_file_task { path: '", path, "' streaming: ",
+      streaming ? "true" : "false", " block_size: 7 } "
+      "features_size: 4 eval_type: RMS_ERROR num_train_examples: ",
+      kNumExamples, " num_valid_examples: 20 num_train_epochs: ",
+      num_train_epochs));
+}
+
+TEST(RandomPermutationTest, IsBijective) {
+  for (IntegerT size = 1; size < 300; size += 7) {
+    for (RandomSeedT seed : {1, 2, 3}) {
+      const RandomPermutation permutation(size, seed, 0);
+      set<IntegerT> images;
+      for (IntegerT i = 0; i < size; ++i) {
+        const IntegerT image = permutation(i);
+        EXPECT_GE(image, 0);
+        EXPECT_LT(image, size);
+        images.insert(image);
+      }
+      EXPECT_EQ(images.size(), size);
+    }
+  }
+}
+
+TEST(RandomPermutationTest, DependsOnTheSeedAndStream) {
+  const RandomPermutation permutation(1000, 1, 0);
+  const RandomPermutation other_seed(1000, 2, 0);
+  const RandomPermutation other_stream(1000, 1, 1);
+  IntegerT num_same_seed = 0;
+  IntegerT num_same_stream = 0;
+  IntegerT num_fixed_points = 0;
+  for (IntegerT i = 0; i < 1000; ++i) {
+    if (permutation(i) == other_seed(i)) ++num_same_seed;
+    if (permutation(i) == other_stream(i)) ++num_same_stream;
+    if (permutation(i) == i) ++num_fixed_points;
+  }
+  EXPECT_LT(num_same_seed, 20);
+  EXPECT_LT(num_same_stream, 20);
+  EXPECT_LT(num_fixed_points, 20);
+}
+
+TEST(StreamingTaskTest, VisitsEveryExampleInEachEpoch) {
+  const string path = WriteIndexDataset("visits");
+  unique_ptr<Task<4>> task =
+      CreateTask<4>(0, 1, 11, ColumnarTaskSpec(path, true, 3));
+  ASSERT_TRUE(task->IsStreaming());
+  EXPECT_EQ(task->TrainExamplesPerEpoch(), kNumExamples);
+  EXPECT_EQ(task->NumTrainEpochs(), 3);
+  EXPECT_EQ(task->ValidSteps(), 20);
+
+  vector<vector<IntegerT>> epochs(3);
+  TaskIterator<4> train_it = task->TrainIterator();
+  for (vector<IntegerT>& epoch : epochs) {
+    for (IntegerT k = 0; k < kNumExamples; ++k) {
+      ASSERT_FALSE(train_it.Done());
+      const IntegerT index = train_it.GetFeatures()(0);
+      EXPECT_EQ(train_it.GetLabel(), index + 0.5);
+      epoch.push_back(index);
+      train_it.Next();
+    }
+  }
+  EXPECT_TRUE(train_it.Done());
+
+  vector<IntegerT> in_order;
+  for (IntegerT k = 0; k < kNumExamples; ++k) in_order.push_back(k);
+  EXPECT_EQ(epochs[0], in_order);
+  for (IntegerT e = 1; e < 3; ++e) {
+    EXPECT_NE(epochs[e], in_order);
+    vector<IntegerT> sorted = epochs[e];
+    std::sort(sorted.begin(), sorted.end());
+    EXPECT_EQ(sorted, in_order);
+  }
+  EXPECT_NE(epochs[1], epochs[2]);
+
+  TaskIterator<4> valid_it = task->ValidIterator();
+  for (IntegerT k = 0; k < 20; ++k) {
+    ASSERT_FALSE(valid_it.Done());
+    EXPECT_EQ(valid_it.GetFeatures()(0), -k);
+    valid_it.Next();
+  }
+  EXPECT_TRUE(valid_it.Done());
+}
+
+TEST(StreamingTaskTest, StopsEarly) {
+  const string path = WriteIndexDataset("stops_early");
+  unique_ptr<Task<4>> task =
+      CreateTask<4>(0, 1, 11, ColumnarTaskSpec(path, true, 3));
+  // The background read of the next block must be stopped cleanly.
+  TaskIterator<4> train_it = task->TrainIterator();
+  for (IntegerT k = 0; k < 10; ++k) train_it.Next();
+  EXPECT_EQ(train_it.GetFeatures()(0), 10);
+}
+
+TEST(StreamingReaderTest, SizesTheFirstReadAndRestarts) {
+  const string path = WriteIndexDataset("reader");
+  auto dataset = std::make_shared<const MappedColumnarDataset>(path);
+  const StreamingExamples<4> train(dataset, kColumnarTrainSplit, kNumExamples,
+                                   1, 7, 11);
+  const StreamingExamples<4> valid(dataset, kColumnarValidSplit, 20, 1, 7, 11);
+  StreamingReader<4> reader;
+  for (IntegerT run = 0; run < 2; ++run) {
+    reader.Start(&train, 3);
+    ASSERT_EQ(reader.Current().features.size(), 3);
+    EXPECT_EQ(reader.Current().features[2](0), 2);
+    // The rest of the first block, then the next blocks.
+    reader.Advance();
+    ASSERT_EQ(reader.Current().features.size(), 4);
+    EXPECT_EQ(reader.Current().features[0](0), 3);
+    reader.Advance();
+    ASSERT_EQ(reader.Current().features.size(), 7);
+    EXPECT_EQ(reader.Current().features[0](0), 7);
+    EXPECT_EQ(reader.Current().labels[0], 7.5);
+
+    // Abandons the train examples, whose next block may be being read.
+    reader.Start(&valid, 100);
+    ASSERT_EQ(reader.Current().features.size(), 7);
+    EXPECT_EQ(reader.Current().features[6](0), -6);
+  }
+}
+
+TEST(StreamingTaskTest, ExecutesLikeAnInMemoryTask) {
+  const string path = WriteIndexDataset("executes");
+  unique_ptr<Task<4>> streamed =
+      CreateTask<4>(0, 1, 11, ColumnarTaskSpec(path, true, 1));
+  unique_ptr<Task<4>> loaded =
+      CreateTask<4>(0, 1, 11, ColumnarTaskSpec(path, false, 1));
+  ASSERT_FALSE(loaded->IsStreaming());
+
+  Generator generator(NO_OP_ALGORITHM, 0, 0, 0, {}, {}, {}, nullptr, nullptr);
+  Algorithm algorithm = generator.LinearModel(0.001);
+  algorithm.CopyAllComponentsToEffective();
+  RandomGenerator rand_gen;
+  Executor<4> streamed_executor(algorithm, *streamed, kNumExamples, 20,
+                                &rand_gen, 100.0);
+  Executor<4> loaded_executor(algorithm, *loaded, kNumExamples, 20, &rand_gen,
+                              100.0);
+  vector<double> streamed_errors;
+  vector<double> loaded_errors;
+  const double streamed_fitness =
+      streamed_executor.Execute(nullptr, &streamed_errors);
+  const double loaded_fitness =
+      loaded_executor.Execute(nullptr, &loaded_errors);
+  EXPECT_GT(loaded_fitness, kMinFitness);
+  EXPECT_EQ(streamed_fitness, loaded_fitness);
+  EXPECT_EQ(streamed_errors, loaded_errors);
+
+  // Again, after a probe, with the readers of the first execution.
+  streamed_executor.Reset(algorithm, *streamed, kNumExamples, 20, &rand_gen,
+                          100.0);
+  loaded_executor.Reset(algorithm, *loaded, kNumExamples, 20, &rand_gen,
+                        100.0);
+  vector<double> streamed_probe_errors;
+  vector<double> loaded_probe_errors;
+  EXPECT_TRUE(streamed_executor.Probe(10, 5, nullptr, &streamed_probe_errors));
+  EXPECT_TRUE(loaded_executor.Probe(10, 5, nullptr, &loaded_probe_errors));
+  EXPECT_EQ(streamed_probe_errors, loaded_probe_errors);
+  EXPECT_EQ(streamed_executor.Execute(nullptr, nullptr),
+            loaded_executor.Execute(nullptr, nullptr));
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,147 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "surrogate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "instruction.pb.h"
+#include "glog/logging.h"
+
+namespace automl_zero {
+
+using ::std::pair;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace {
+
+// Features with a smaller variance over the history are ignored.
+constexpr double kMinFeatureVariance = 1e-12;
+
+// The parent error is a much better predictor than any single op count, so it
+// weighs more in the distance than the other standardized features.
+constexpr double kParentErrorWeight = 4.0;
+
+void CountOps(const vector<std::shared_ptr<const Instruction>>& component,
+              vector<double>* features) {
+  for (const std::shared_ptr<const Instruction>& instruction : component) {
+    ++(*features)[instruction->op_];
+  }
+}
+
+}  // namespace
+
+vector<double> SurrogateFeatures(
+    const Algorithm& algorithm, const bool has_parent_error,
+    const double parent_error) {
+  vector<double> features(Op_ARRAYSIZE, 0.0);
+  CountOps(algorithm.setup_, &features);
+  CountOps(algorithm.predict_, &features);
+  CountOps(algorithm.learn_, &features);
+  features.push_back(static_cast<double>(algorithm.setup_.size()));
+  features.push_back(static_cast<double>(algorithm.predict_.size()));
+  features.push_back(static_cast<double>(algorithm.learn_.size()));
+  features.push_back(has_parent_error ? 1.0 : 0.0);
+  // Must be last, see kParentErrorWeight.
+  features.push_back(has_parent_error ? parent_error : 0.0);
+  return features;
+}
+
+KnnSurrogate::KnnSurrogate(const SurrogateSpec& spec)
+    : num_neighbors_(spec.num_neighbors()),
+      min_history_(spec.min_history()),
+      max_history_(spec.max_history()),
+      next_(0) {
+  CHECK_GT(num_neighbors_, 0);
+  CHECK_GE(min_history_, num_neighbors_);
+  CHECK_GE(max_history_, min_history_);
+  CHECK_GE(spec.exploration_rate(), 0.0);
+  CHECK_LE(spec.exploration_rate(), 1.0);
+  CHECK_GE(spec.dominance_margin(), 0.0);
+}
+
+void KnnSurrogate::Add(const vector<double>& features, const double error) {
+  if (feature_sums_.empty()) {
+    feature_sums_.resize(features.size(), 0.0);
+    feature_square_sums_.resize(features.size(), 0.0);
+  }
+  CHECK_EQ(features.size(), feature_sums_.size());
+  if (static_cast<IntegerT>(errors_.size()) < max_history_) {
+    features_.push_back(features);
+    errors_.push_back(error);
+  } else {
+    const vector<double>& evicted = features_[next_];
+    for (size_t j = 0; j < evicted.size(); ++j) {
+      feature_sums_[j] -= evicted[j];
+      feature_square_sums_[j] -= evicted[j] * evicted[j];
+    }
+    features_[next_] = features;
+    errors_[next_] = error;
+    next_ = (next_ + 1) % max_history_;
+  }
+  for (size_t j = 0; j < features.size(); ++j) {
+    feature_sums_[j] += features[j];
+    feature_square_sums_[j] += features[j] * features[j];
+  }
+}
+
+bool KnnSurrogate::IsReady() const {
+  return static_cast<IntegerT>(errors_.size()) >= min_history_;
+}
+
+double KnnSurrogate::Predict(const vector<double>& features) const {
+  CHECK(IsReady());
+  CHECK_EQ(features.size(), feature_sums_.size());
+  const double history_size = static_cast<double>(errors_.size());
+
+  // The inverse standard deviation of each feature.
+  vector<double> scales(features.size(), 0.0);
+  for (size_t j = 0; j < features.size(); ++j) {
+    const double mean = feature_sums_[j] / history_size;
+    const double variance =
+        feature_square_sums_[j] / history_size - mean * mean;
+    if (variance > kMinFeatureVariance) {
+      scales[j] = 1.0 / std::sqrt(variance);
+    }
+  }
+  scales.back() *= kParentErrorWeight;
+
+  vector<pair<double, IntegerT>> distances;
+  distances.reserve(errors_.size());
+  for (size_t i = 0; i < features_.size(); ++i) {
+    double distance = 0.0;
+    for (size_t j = 0; j < features.size(); ++j) {
+      const double difference = (features[j] - features_[i][j]) * scales[j];
+      distance += difference * difference;
+    }
+    distances.emplace_back(distance, i);
+  }
+  std::nth_element(distances.begin(), distances.begin() + num_neighbors_ - 1,
+                   distances.end());
+
+  double error_sum = 0.0;
+  for (IntegerT i = 0; i < num_neighbors_; ++i) {
+    error_sum += errors_[distances[i].second];
+  }
+  return error_sum / static_cast<double>(num_neighbors_);
+}
+
+IntegerT KnnSurrogate::HistorySize() const {
+  return errors_.size();
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,73 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_SURROGATE_H_
+#define AUTOML_ZERO_SURROGATE_H_
+
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "surrogate.pb.h"
+
+namespace automl_zero {
+
+// The features from which the surrogate predicts the error of an algorithm:
+// the number of instructions of each op (over all component functions), the
+// sizes of the component functions and, if known, the error of the parent the
+// algorithm was mutated from.
+std::vector<double> SurrogateFeatures(
+    const Algorithm& algorithm, bool has_parent_error, double parent_error);
+
+// A k-nearest-neighbors regressor of the error of an algorithm, trained online
+// on the most recently evaluated algorithms. Each feature is standardized with
+// the statistics of the history, so that the distance does not depend on the
+// scale of the features.
+class KnnSurrogate {
+ public:
+  explicit KnnSurrogate(const SurrogateSpec& spec);
+  KnnSurrogate(const KnnSurrogate& other) = delete;
+  KnnSurrogate& operator=(const KnnSurrogate& other) = delete;
+
+  // Adds an evaluated algorithm to the history, evicting the oldest one if the
+  // history is full.
+  void Add(const std::vector<double>& features, double error);
+
+  // Whether the history is large enough to make predictions.
+  bool IsReady() const;
+
+  // The mean error of the nearest neighbors. Requires IsReady().
+  double Predict(const std::vector<double>& features) const;
+
+  IntegerT HistorySize() const;
+
+ private:
+  const IntegerT num_neighbors_;
+  const IntegerT min_history_;
+  const IntegerT max_history_;
+
+  // A ring buffer of the history. next_ is the position of the oldest entry
+  // once the buffer is full.
+  std::vector<std::vector<double>> features_;
+  std::vector<double> errors_;
+  IntegerT next_;
+
+  // Running sums used to standardize the features.
+  std::vector<double> feature_sums_;
+  std::vector<double> feature_square_sums_;
+};
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_SURROGATE_H_
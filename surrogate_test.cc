@@ -0,0 +1,103 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "surrogate.h"
+
+#include <memory>
+#include <vector>
+
+#include "algorithm.h"
+#include "definitions.h"
+#include "generator_test_util.h"
+#include "instruction.h"
+#include "instruction.pb.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::make_shared;  // NOLINT
+using ::std::vector;  // NOLINT
+
+SurrogateSpec MakeSpec(IntegerT num_neighbors, IntegerT min_history,
+                       IntegerT max_history) {
+  SurrogateSpec spec;
+  spec.set_num_neighbors(num_neighbors);
+  spec.set_min_history(min_history);
+  spec.set_max_history(max_history);
+  return spec;
+}
+
+TEST(SurrogateFeaturesTest, CountsOpsAndSizes) {
+  Algorithm algorithm = SimpleNoOpAlgorithm();
+  algorithm.predict_[1] =
+      make_shared<const Instruction>(VECTOR_SUM_OP, 1, 2, 3);
+  algorithm.learn_[0] = make_shared<const Instruction>(VECTOR_SUM_OP, 1, 2, 3);
+  const vector<double> features = SurrogateFeatures(algorithm, true, 0.25);
+  ASSERT_EQ(features.size(), Op_ARRAYSIZE + 5);
+  EXPECT_EQ(features[VECTOR_SUM_OP], 2.0);
+  EXPECT_EQ(features[NO_OP], 6.0 + 3.0 + 9.0 - 2.0);
+  EXPECT_EQ(features[Op_ARRAYSIZE], 6.0);
+  EXPECT_EQ(features[Op_ARRAYSIZE + 1], 3.0);
+  EXPECT_EQ(features[Op_ARRAYSIZE + 2], 9.0);
+  EXPECT_EQ(features[Op_ARRAYSIZE + 3], 1.0);
+  EXPECT_EQ(features[Op_ARRAYSIZE + 4], 0.25);
+
+  const vector<double> no_parent = SurrogateFeatures(algorithm, false, 0.25);
+  EXPECT_EQ(no_parent[Op_ARRAYSIZE + 3], 0.0);
+  EXPECT_EQ(no_parent[Op_ARRAYSIZE + 4], 0.0);
+}
+
+TEST(KnnSurrogateTest, WaitsForMinHistory) {
+  KnnSurrogate surrogate(MakeSpec(1, 3, 10));
+  surrogate.Add({0.0, 1.0}, 0.5);
+  surrogate.Add({1.0, 1.0}, 0.5);
+  EXPECT_FALSE(surrogate.IsReady());
+  surrogate.Add({2.0, 1.0}, 0.5);
+  EXPECT_TRUE(surrogate.IsReady());
+  EXPECT_EQ(surrogate.HistorySize(), 3);
+}
+
+TEST(KnnSurrogateTest, PredictsTheNearestNeighbors) {
+  KnnSurrogate surrogate(MakeSpec(2, 2, 10));
+  surrogate.Add({0.0, 0.0}, 0.1);
+  surrogate.Add({1.0, 0.0}, 0.3);
+  surrogate.Add({10.0, 0.0}, 0.9);
+  surrogate.Add({11.0, 0.0}, 0.7);
+  EXPECT_DOUBLE_EQ(surrogate.Predict({0.5, 0.0}), 0.2);
+  EXPECT_DOUBLE_EQ(surrogate.Predict({12.0, 0.0}), 0.8);
+}
+
+TEST(KnnSurrogateTest, StandardizesTheFeatures) {
+  KnnSurrogate surrogate(MakeSpec(1, 1, 10));
+  // The first feature varies much more, but the second one is closer once
+  // both are standardized.
+  surrogate.Add({0.0, 0.0}, 0.1);
+  surrogate.Add({1000.0, 1.0}, 0.9);
+  EXPECT_DOUBLE_EQ(surrogate.Predict({400.0, 0.9}), 0.9);
+}
+
+TEST(KnnSurrogateTest, EvictsTheOldestEntries) {
+  KnnSurrogate surrogate(MakeSpec(1, 1, 2));
+  surrogate.Add({0.0, 0.0}, 0.1);
+  surrogate.Add({5.0, 0.0}, 0.5);
+  surrogate.Add({10.0, 0.0}, 0.9);
+  EXPECT_EQ(surrogate.HistorySize(), 2);
+  EXPECT_DOUBLE_EQ(surrogate.Predict({0.0, 0.0}), 0.5);
+  surrogate.Add({1.0, 0.0}, 0.2);
+  EXPECT_DOUBLE_EQ(surrogate.Predict({0.0, 0.0}), 0.2);
+  EXPECT_DOUBLE_EQ(surrogate.Predict({5.0, 0.0}), 0.2);
+  EXPECT_DOUBLE_EQ(surrogate.Predict({9.0, 0.0}), 0.9);
+}
+
+}  // namespace automl_zero
@@ -20,11 +20,14 @@
 #define AUTOML_ZERO_TASK_H_
 
 #include <algorithm>
+#include <memory>
 #include <random>
 #include <vector>
 
 #include "task.pb.h"
 #include "definitions.h"
+#include "huge_page_allocator.h"
+#include "streaming_task.h"
 #include "gtest/gtest_prod.h"
 
 namespace automl_zero {
@@ -43,12 +46,13 @@ class TaskBuffer {
 
   // How the tasks are filled is up to each task Creator struct. By the
   // end of task creation, the train/valid features/labels should be
-  // assigned correctly.
-  std::vector<Vector<F>> train_features_;
-  std::vector<Vector<F>> valid_features_;
+  // assigned correctly. Allocated like the examples of a Task, so that they
+  // can be moved into it.
+  HugePageVector<Vector<F>> train_features_;
+  HugePageVector<Vector<F>> valid_features_;
   EvalType eval_type_;
-  std::vector<Scalar> train_labels_;
-  std::vector<Scalar> valid_labels_;
+  HugePageVector<Scalar> train_labels_;
+  HugePageVector<Scalar> valid_labels_;
 
  private:
   // Whether this object has already been consumed by moving the data into
@@ -76,6 +80,12 @@ class TaskInterface {
   virtual IntegerT NumTrainEpochs() const = 0;
   virtual IntegerT MaxTrainExamples() const = 0;
   virtual IntegerT ValidSteps() const = 0;
+
+  // Returns a copy of the task, allocated by the calling thread, e.g. on the
+  // NUMA node it is pinned to (see cpu_topology.h). Evaluations on the copy
+  // give the same fitnesses. Returns nullptr for the tasks that are not held
+  // in memory.
+  virtual std::unique_ptr<TaskInterface> Replicate() const = 0;
 };
 
 template <FeatureIndexT F>
@@ -90,9 +100,9 @@ inline bool ItemEquals<Scalar>(const Scalar& data1, const Scalar& data2) {
   return abs(data1 - data2) < kDataTolerance;
 }
 
-template <typename RankT>
-bool DataEquals(const std::vector<RankT>& data1,
-                const std::vector<RankT>& data2) {
+template <typename RankT, typename Allocator1, typename Allocator2>
+bool DataEquals(const std::vector<RankT, Allocator1>& data1,
+                const std::vector<RankT, Allocator2>& data2) {
   if (data1.size() != data2.size()) return false;
   for (IntegerT index = 0; index < data1.size(); ++index) {
     if (!ItemEquals(data1[index], data2[index])) {
@@ -138,6 +148,20 @@ class Task : public TaskInterface {
     CHECK_EQ(valid_features_.size(), valid_labels_.size());
   }
 
+  // A task whose examples are not held in memory, but read from a file while
+  // they are iterated over. See StreamingExamples.
+  Task(const size_t index, const EvalType eval_type,
+       std::unique_ptr<const StreamingExamples<F>> train_stream,
+       std::unique_ptr<const StreamingExamples<F>> valid_stream)
+      : index_(index),
+        eval_type_(eval_type),
+        train_stream_(std::move(train_stream)),
+        valid_stream_(std::move(valid_stream)) {
+    CHECK(train_stream_ != nullptr);
+    CHECK(valid_stream_ != nullptr);
+    CHECK_EQ(valid_stream_->NumEpochs(), 1);
+  }
+
   Task(const Task&) = delete;
   Task& operator=(const Task&) = delete;
 
@@ -149,7 +173,9 @@ class Task : public TaskInterface {
         train_epochs_(std::move(other.train_epochs_)),
         valid_features_(std::move(other.valid_features_)),
         valid_labels_(std::move(other.valid_labels_)),
-        valid_epochs_(std::move(other.valid_epochs_)) {}
+        valid_epochs_(std::move(other.valid_epochs_)),
+        train_stream_(std::move(other.train_stream_)),
+        valid_stream_(std::move(other.valid_stream_)) {}
 
   Task& operator=(Task&& other) {
     this->index_ = other.index_;
@@ -160,10 +186,16 @@ class Task : public TaskInterface {
     this->valid_features_ = std::move(other.valid_features_);
     this->valid_labels_ = std::move(other.valid_labels_);
     this->valid_epochs_ = std::move(other.valid_epochs_);
+    this->train_stream_ = std::move(other.train_stream_);
+    this->valid_stream_ = std::move(other.valid_stream_);
     return *this;
   }
 
   bool operator==(const Task<F>& other) const {
+    if (IsStreaming() || other.IsStreaming()) {
+      // The data is not in memory.
+      return this == &other;
+    }
     CHECK_EQ(train_features_.size(), train_labels_.size());
     CHECK_EQ(other.train_features_.size(), other.train_labels_.size());
     if (!DataEquals(train_features_, other.train_features_)) {
@@ -194,29 +226,59 @@ class Task : public TaskInterface {
   FeatureIndexT FeaturesSize() const override {return F;}
   EvalType GetEvalType() const override {return eval_type_;}
   IntegerT TrainExamplesPerEpoch() const override {
-    return train_features_.size();
+    return IsStreaming() ? train_stream_->NumExamples()
+                         : train_features_.size();
   }
   IntegerT NumTrainEpochs() const override {
-    return train_epochs_.size();
+    return IsStreaming() ? train_stream_->NumEpochs() : train_epochs_.size();
   }
   IntegerT MaxTrainExamples() const override {
     return TrainExamplesPerEpoch() * NumTrainEpochs();
   }
   IntegerT ValidSteps() const override {
-    return valid_features_.size();
+    return IsStreaming() ? valid_stream_->NumExamples()
+                         : valid_features_.size();
+  }
+
+  std::unique_ptr<TaskInterface> Replicate() const override {
+    if (IsStreaming()) return nullptr;
+    return std::unique_ptr<TaskInterface>(new Task(*this, ReplicaTag()));
   }
 
+  // Whether the examples are read from a file while iterating.
+  bool IsStreaming() const { return train_stream_ != nullptr; }
+
   // Iterate.
   TaskIterator<F> TrainIterator() const {
+    if (IsStreaming()) return TaskIterator<F>(train_stream_.get());
     return TaskIterator<F>(&train_features_, &train_labels_, &train_epochs_);
   }
   TaskIterator<F> ValidIterator() const {
+    if (IsStreaming()) return TaskIterator<F>(valid_stream_.get());
     return TaskIterator<F>(&valid_features_, &valid_labels_, &valid_epochs_);
   }
 
+  // Like above, but a streaming task reads its examples with `reader`, which
+  // is reused across iterations, and only reads the first `num_steps`
+  // examples before the first one is used.
+  TaskIterator<F> TrainIterator(StreamingReader<F>* reader,
+                                IntegerT num_steps) const {
+    if (IsStreaming()) {
+      return TaskIterator<F>(train_stream_.get(), reader, num_steps);
+    }
+    return TrainIterator();
+  }
+  TaskIterator<F> ValidIterator(StreamingReader<F>* reader,
+                                IntegerT num_steps) const {
+    if (IsStreaming()) {
+      return TaskIterator<F>(valid_stream_.get(), reader, num_steps);
+    }
+    return ValidIterator();
+  }
+
   // ***IMPORTANT***: if you add a member variable below, you *must* also add it
-  // to the move constructor. Or else it may just disappear in the middle of
-  // your experiment.
+  // to the move and replica constructors. Or else it may just disappear in the
+  // middle of your experiment.
 
   // Task index. Used to distinguish between different task caches.
   const size_t index_;
@@ -261,32 +323,82 @@ class Task : public TaskInterface {
   FRIEND_TEST(CreateTaskWithRandomMulticlassRationalDataTest,
               SameParamSeedsUsesOnlyTwoLabelIndexes);
 
+  // Copies the in-memory data of `other`. Only for Replicate, so that tasks
+  // are not copied by accident.
+  struct ReplicaTag {};
+  Task(const Task& other, ReplicaTag)
+      : index_(other.index_),
+        eval_type_(other.eval_type_),
+        train_features_(other.train_features_),
+        train_labels_(other.train_labels_),
+        train_epochs_(other.train_epochs_),
+        valid_features_(other.valid_features_),
+        valid_labels_(other.valid_labels_),
+        valid_epochs_(other.valid_epochs_) {
+    CHECK(!other.IsStreaming());
+  }
+
   // ***IMPORTANT***: if you add a member variable below, you *must* also add it
-  // to the move constructor. Or else it may just disappear in the middle of
-  // your experiment.
+  // to the move and replica constructors. Or else it may just disappear in the
+  // middle of your experiment.
 
   // The xx_features_ and xx_labels_ only contain one epoch worth of examples.
   // The xx_epochs_ is a list of lists where the outer index is the epoch number
-  // and the inner list is the order of the examples in that epoch.
-  const std::vector<Vector<F>> train_features_;
-  const std::vector<Scalar> train_labels_;
+  // and the inner list is the order of the examples in that epoch. The
+  // examples are read in the shuffled order, so they are allocated with the
+  // HugePageAllocator.
+  const HugePageVector<Vector<F>> train_features_;
+  const HugePageVector<Scalar> train_labels_;
   const std::vector<std::vector<IntegerT>> train_epochs_;
-  const std::vector<Vector<F>> valid_features_;
-  const std::vector<Scalar> valid_labels_;
+  const HugePageVector<Vector<F>> valid_features_;
+  const HugePageVector<Scalar> valid_labels_;
   const std::vector<std::vector<IntegerT>> valid_epochs_;
+
+  // Only set for streaming tasks, in which case the members above are empty.
+  std::unique_ptr<const StreamingExamples<F>> train_stream_;
+  std::unique_ptr<const StreamingExamples<F>> valid_stream_;
 };
 
 template <FeatureIndexT F>
 class TaskIterator {
  public:
-  TaskIterator(const std::vector<Vector<F>>* features,
-                  const std::vector<Scalar>* labels,
+  TaskIterator(const HugePageVector<Vector<F>>* features,
+                  const HugePageVector<Scalar>* labels,
                   const std::vector<std::vector<IntegerT>>* epochs)
       : features_(features),
         labels_(labels),
         epochs_(epochs),
+        stream_(nullptr),
+        current_example_(0),
+        current_epoch_(0),
+        block_position_(0) {}
+
+  // Iterates over streamed examples, which are read in the background.
+  explicit TaskIterator(const StreamingExamples<F>* stream)
+      : features_(nullptr),
+        labels_(nullptr),
+        epochs_(nullptr),
+        stream_(stream),
+        owned_reader_(new StreamingReader<F>(stream)),
+        reader_(owned_reader_.get()),
         current_example_(0),
-        current_epoch_(0) {}
+        current_epoch_(0),
+        block_position_(0) {}
+
+  // Like above, with a reader that is reused across iterations. Only reads
+  // `first_read_size` examples before the first one is used.
+  TaskIterator(const StreamingExamples<F>* stream, StreamingReader<F>* reader,
+               IntegerT first_read_size)
+      : features_(nullptr),
+        labels_(nullptr),
+        epochs_(nullptr),
+        stream_(stream),
+        reader_(reader),
+        current_example_(0),
+        current_epoch_(0),
+        block_position_(0) {
+    reader_->Start(stream, first_read_size);
+  }
 
   TaskIterator(const TaskIterator&) = delete;
   TaskIterator& operator=(const TaskIterator&) = delete;
@@ -295,23 +407,36 @@ class TaskIterator {
       : features_(other.features_),
         labels_(other.labels_),
         epochs_(other.epochs_),
+        stream_(other.stream_),
+        owned_reader_(std::move(other.owned_reader_)),
+        reader_(other.reader_),
         current_example_(other.current_example_),
-        current_epoch_(other.current_epoch_) {}
+        current_epoch_(other.current_epoch_),
+        block_position_(other.block_position_) {}
 
   TaskIterator& operator=(TaskIterator&& other) {
     this->features_ = other.features_;
     this->labels_ = other.labels_;
     this->epochs_ = other.epochs_;
+    this->stream_ = other.stream_;
+    this->owned_reader_ = std::move(other.owned_reader_);
+    this->reader_ = other.reader_;
     this->current_example_ = other.current_example_;
     this->current_epoch_ = other.current_epoch_;
+    this->block_position_ = other.block_position_;
     return *this;
   }
 
   bool Done() const {
+    if (stream_ != nullptr) return current_epoch_ >= stream_->NumEpochs();
     return current_epoch_ >= epochs_->size();
   }
 
   void Next() {
+    if (stream_ != nullptr) {
+      NextStreamed();
+      return;
+    }
     CHECK_LE(current_epoch_, epochs_->size());
     ++current_example_;
     if (current_example_ >= features_->size()) {
@@ -321,19 +446,46 @@ class TaskIterator {
   }
 
   inline const Vector<F>& GetFeatures() const {
+    if (stream_ != nullptr) {
+      return reader_->Current().features[block_position_];
+    }
     return features_->at(epochs_->at(current_epoch_).at(current_example_));
   }
 
   inline const Scalar& GetLabel() const {
+    if (stream_ != nullptr) {
+      return reader_->Current().labels[block_position_];
+    }
     return labels_->at(epochs_->at(current_epoch_).at(current_example_));
   }
 
  private:
-  const std::vector<Vector<F>>* features_;
-  const std::vector<Scalar>* labels_;
+  void NextStreamed() {
+    CHECK_LT(current_epoch_, stream_->NumEpochs());
+    ++current_example_;
+    ++block_position_;
+    if (current_example_ >= stream_->NumExamples()) {
+      current_example_ = 0;
+      ++current_epoch_;
+    }
+    if (block_position_ >= reader_->Current().features.size() && !Done()) {
+      reader_->Advance();
+      block_position_ = 0;
+    }
+  }
+
+  const HugePageVector<Vector<F>>* features_;
+  const HugePageVector<Scalar>* labels_;
   const std::vector<std::vector<IntegerT>>* epochs_;
+  // Only set when streaming.
+  const StreamingExamples<F>* stream_;
+  // Null if the reader is not owned.
+  std::unique_ptr<StreamingReader<F>> owned_reader_;
+  StreamingReader<F>* reader_;
   IntegerT current_example_;
   IntegerT current_epoch_;
+  // Position of the current example in the current block, when streaming.
+  IntegerT block_position_;
 };
 
 }  // namespace automl_zero
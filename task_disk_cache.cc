@@ -0,0 +1,92 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "task_disk_cache.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <thread>  // NOLINT
+
+#include "absl/strings/str_cat.h"
+
+namespace automl_zero {
+
+namespace {
+
+// 64-bit FNV-1a. Unlike std::hash, it is the same across builds and
+// platforms, so the file names stay valid.
+uint64_t Fnv1aHash(const std::string& data) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char c : data) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+}  // namespace
+
+TaskDiskCache::TaskDiskCache(const std::string& directory)
+    : directory_(directory), num_hits_(0), num_misses_(0) {
+  CHECK(!directory.empty());
+  std::filesystem::create_directories(directory);
+}
+
+bool TaskDiskCache::IsCacheable(const TaskSpec& task_spec) {
+  switch (task_spec.task_type_case()) {
+    case TaskSpec::kScalarLinearRegressionTask:
+    case TaskSpec::kScalar2LayerNnRegressionTask:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::string TaskDiskCache::Path(const TaskSpec& task_spec,
+                                const RandomSeedT param_seed,
+                                const RandomSeedT data_seed) const {
+  TaskSpec seedless_task_spec = task_spec;
+  seedless_task_spec.clear_param_seeds();
+  seedless_task_spec.clear_data_seeds();
+  seedless_task_spec.clear_num_tasks();
+  const std::string key =
+      absl::StrCat(kTaskDiskCacheVersion, ",", param_seed, ",", data_seed, ",",
+                   seedless_task_spec.SerializeAsString());
+  return absl::StrCat(directory_, "/task_",
+                      absl::Hex(Fnv1aHash(key), absl::kZeroPad16), ".col");
+}
+
+void TaskDiskCache::Write(const FeatureIndexT features_size,
+                          const std::vector<ColumnarSplitData>& splits,
+                          const std::string& path) const {
+  const std::string temp_path = absl::StrCat(
+      path, ".tmp.", getpid(), ".",
+      std::hash<std::thread::id>()(std::this_thread::get_id()));
+  // Only renamed once fully written. The search goes on with the generated
+  // task either way.
+  if (!WriteColumnarDataset(features_size, splits, temp_path)) {
+    LOG(WARNING) << "Could not write the cached task " << temp_path << ".";
+    std::remove(temp_path.c_str());
+    return;
+  }
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Could not rename " << temp_path << " to " << path << ".";
+    std::remove(temp_path.c_str());
+  }
+}
+
+}  // namespace automl_zero
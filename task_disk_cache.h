@@ -0,0 +1,148 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_TASK_DISK_CACHE_H_
+#define AUTOML_ZERO_TASK_DISK_CACHE_H_
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "columnar_dataset.h"
+#include "definitions.h"
+#include "task.h"
+#include "task.pb.h"
+
+namespace automl_zero {
+
+// Bump when a task creator changes the data it generates, to invalidate the
+// files cached by previous versions.
+constexpr IntegerT kTaskDiskCacheVersion = 1;
+
+// A content-addressed directory of generated task data. The train and valid
+// examples of a task are stored in the columnar format (see
+// columnar_dataset.h), in a file named after a hash of the TaskSpec (excluding
+// the seeds and the number of tasks), the param seed and the data seed. Only
+// the synthetic tasks whose labels are computed by running an algorithm are
+// cached; the others are cheap to create or are already read from disk.
+//
+// Files are written to a temporary name and renamed, so several processes
+// can share the same directory.
+//
+// Thread-safe.
+class TaskDiskCache {
+ public:
+  // Creates the directory if needed.
+  explicit TaskDiskCache(const std::string& directory);
+  TaskDiskCache(const TaskDiskCache& other) = delete;
+  TaskDiskCache& operator=(const TaskDiskCache& other) = delete;
+
+  // Whether the tasks of this spec are cached.
+  static bool IsCacheable(const TaskSpec& task_spec);
+
+  // The file holding the data of a task.
+  std::string Path(const TaskSpec& task_spec, RandomSeedT param_seed,
+                   RandomSeedT data_seed) const;
+
+  // Fills the buffer from the cache. Returns false if the task is not cached,
+  // or if its file is invalid, in which case Store replaces it.
+  template <FeatureIndexT F>
+  bool Load(const TaskSpec& task_spec, RandomSeedT param_seed,
+            RandomSeedT data_seed, TaskBuffer<F>* buffer) const;
+
+  // Saves the data of a task. Best-effort: if the file cannot be written,
+  // e.g. because the disk is full, logs a warning and leaves the task
+  // uncached.
+  template <FeatureIndexT F>
+  void Store(const TaskSpec& task_spec, RandomSeedT param_seed,
+             RandomSeedT data_seed, const TaskBuffer<F>& buffer) const;
+
+  IntegerT NumHits() const { return num_hits_; }
+  IntegerT NumMisses() const { return num_misses_; }
+
+ private:
+  // Writes the file atomically, or not at all.
+  void Write(FeatureIndexT features_size,
+             const std::vector<ColumnarSplitData>& splits,
+             const std::string& path) const;
+
+  const std::string directory_;
+  mutable std::atomic<IntegerT> num_hits_;
+  mutable std::atomic<IntegerT> num_misses_;
+};
+
+template <FeatureIndexT F>
+bool TaskDiskCache::Load(const TaskSpec& task_spec,
+                         const RandomSeedT param_seed,
+                         const RandomSeedT data_seed,
+                         TaskBuffer<F>* buffer) const {
+  const std::string path = Path(task_spec, param_seed, data_seed);
+  // A bad file, e.g. one truncated by a full disk, is regenerated and then
+  // replaced like a missing one.
+  if (!IsCompleteColumnarDataset(path)) {
+    if (std::filesystem::exists(path)) {
+      LOG(WARNING) << "Regenerating the invalid cached task " << path;
+    }
+    ++num_misses_;
+    return false;
+  }
+  MappedColumnarDataset mapped_dataset(path);
+  if (mapped_dataset.FeaturesSize() != F ||
+      mapped_dataset.NumExamples(kColumnarTrainSplit) !=
+          task_spec.num_train_examples() ||
+      mapped_dataset.NumExamples(kColumnarValidSplit) !=
+          task_spec.num_valid_examples()) {
+    LOG(WARNING) << "Regenerating the cached task " << path
+                 << ", which has unexpected contents.";
+    ++num_misses_;
+    return false;
+  }
+  buffer->train_features_.resize(task_spec.num_train_examples());
+  buffer->train_labels_.resize(task_spec.num_train_examples());
+  buffer->valid_features_.resize(task_spec.num_valid_examples());
+  buffer->valid_labels_.resize(task_spec.num_valid_examples());
+  mapped_dataset.CopyExamples<F>(kColumnarTrainSplit, &buffer->train_features_,
+                                 &buffer->train_labels_);
+  mapped_dataset.CopyExamples<F>(kColumnarValidSplit, &buffer->valid_features_,
+                                 &buffer->valid_labels_);
+  ++num_hits_;
+  return true;
+}
+
+template <FeatureIndexT F>
+void TaskDiskCache::Store(const TaskSpec& task_spec,
+                          const RandomSeedT param_seed,
+                          const RandomSeedT data_seed,
+                          const TaskBuffer<F>& buffer) const {
+  static_assert(sizeof(Vector<F>) == F * sizeof(double),
+                "Vector<F> must be a contiguous array of doubles.");
+  // The splits can be empty, in which case their vectors have no elements to
+  // get the data of.
+  const std::vector<ColumnarSplitData> splits = {
+      {buffer.train_features_.empty() ? nullptr
+                                      : buffer.train_features_.data()->data(),
+       buffer.train_labels_.data(),
+       static_cast<IntegerT>(buffer.train_features_.size())},
+      {buffer.valid_features_.empty() ? nullptr
+                                      : buffer.valid_features_.data()->data(),
+       buffer.valid_labels_.data(),
+       static_cast<IntegerT>(buffer.valid_features_.size())},
+      {nullptr, nullptr, 0}};
+  Write(F, splits, Path(task_spec, param_seed, data_seed));
+}
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_TASK_DISK_CACHE_H_
@@ -0,0 +1,123 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "task_disk_cache.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "definitions.h"
+#include "task.h"
+#include "task.pb.h"
+#include "task_util.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::string;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+
+TaskSpec NnRegressionTaskSpec() {
+  return ParseTextFormat<TaskSpec>(
+      "scalar_2layer_nn_regression_task {} features_size: 8 "
+      "num_train_examples: 50 num_valid_examples: 10 eval_type: RMS_ERROR "
+      "num_train_epochs: 2 ");
+}
+
+// A fresh cache directory for each test.
+string CacheDirectory(const string& name) {
+  const string directory = ::testing::TempDir() + "/task_disk_cache_" + name;
+  std::filesystem::remove_all(directory);
+  return directory;
+}
+
+TEST(TaskDiskCacheTest, ReloadsIdenticalTasks) {
+  TaskDiskCache disk_cache(CacheDirectory("reloads"));
+  const TaskSpec task_spec = NnRegressionTaskSpec();
+  unique_ptr<Task<8>> expected = CreateTask<8>(0, 1001, 11001, task_spec);
+  unique_ptr<Task<8>> generated =
+      CreateTask<8>(0, 1001, 11001, task_spec, &disk_cache);
+  EXPECT_EQ(disk_cache.NumMisses(), 1);
+  unique_ptr<Task<8>> reloaded =
+      CreateTask<8>(0, 1001, 11001, task_spec, &disk_cache);
+  EXPECT_EQ(disk_cache.NumHits(), 1);
+  EXPECT_TRUE(*generated == *expected);
+  EXPECT_TRUE(*reloaded == *expected);
+}
+
+TEST(TaskDiskCacheTest, RegeneratesTruncatedFiles) {
+  TaskDiskCache disk_cache(CacheDirectory("truncated"));
+  const TaskSpec task_spec = NnRegressionTaskSpec();
+  unique_ptr<Task<8>> expected = CreateTask<8>(0, 1001, 11001, task_spec);
+  CreateTask<8>(0, 1001, 11001, task_spec, &disk_cache);
+  const string path = disk_cache.Path(task_spec, 1001, 11001);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+  unique_ptr<Task<8>> regenerated =
+      CreateTask<8>(0, 1001, 11001, task_spec, &disk_cache);
+  EXPECT_EQ(disk_cache.NumMisses(), 2);
+  EXPECT_TRUE(*regenerated == *expected);
+  unique_ptr<Task<8>> reloaded =
+      CreateTask<8>(0, 1001, 11001, task_spec, &disk_cache);
+  EXPECT_EQ(disk_cache.NumHits(), 1);
+  EXPECT_TRUE(*reloaded == *expected);
+}
+
+TEST(TaskDiskCacheTest, KeepsTheTaskIfItCannotBeWritten) {
+  const string directory = CacheDirectory("unwritable");
+  TaskDiskCache disk_cache(directory);
+  // The files cannot be created once the directory is gone.
+  std::filesystem::remove_all(directory);
+  const TaskSpec task_spec = NnRegressionTaskSpec();
+  unique_ptr<Task<8>> expected = CreateTask<8>(0, 1001, 11001, task_spec);
+  unique_ptr<Task<8>> generated =
+      CreateTask<8>(0, 1001, 11001, task_spec, &disk_cache);
+  EXPECT_TRUE(*generated == *expected);
+  EXPECT_FALSE(std::filesystem::exists(directory));
+}
+
+TEST(TaskDiskCacheTest, PathDependsOnTheTask) {
+  TaskDiskCache disk_cache(CacheDirectory("paths"));
+  TaskSpec task_spec = NnRegressionTaskSpec();
+  const string path = disk_cache.Path(task_spec, 1001, 11001);
+  EXPECT_NE(disk_cache.Path(task_spec, 1002, 11001), path);
+  EXPECT_NE(disk_cache.Path(task_spec, 1001, 11002), path);
+
+  // The seed lists and the number of tasks do not change the data of a task.
+  task_spec.set_num_tasks(5);
+  task_spec.add_param_seeds(1234);
+  EXPECT_EQ(disk_cache.Path(task_spec, 1001, 11001), path);
+
+  task_spec.set_num_train_examples(51);
+  EXPECT_NE(disk_cache.Path(task_spec, 1001, 11001), path);
+}
+
+TEST(TaskDiskCacheTest, OnlyCachesGeneratedTasks) {
+  EXPECT_TRUE(TaskDiskCache::IsCacheable(NnRegressionTaskSpec()));
+  EXPECT_TRUE(TaskDiskCache::IsCacheable(ParseTextFormat<TaskSpec>(
+      "scalar_linear_regression_task {} ")));
+  EXPECT_FALSE(TaskDiskCache::IsCacheable(ParseTextFormat<TaskSpec>(
+      "unit_test_zeros_task {} ")));
+
+  TaskDiskCache disk_cache(CacheDirectory("uncached"));
+  CreateTask<4>(0, 1, 1,
+                ParseTextFormat<TaskSpec>(
+                    "unit_test_zeros_task {} features_size: 4 "
+                    "num_train_examples: 5 num_valid_examples: 5 "
+                    "eval_type: RMS_ERROR "),
+                &disk_cache);
+  EXPECT_EQ(disk_cache.NumHits() + disk_cache.NumMisses(), 0);
+}
+
+}  // namespace automl_zero
@@ -0,0 +1,176 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "task_store.h"
+
+#include <utility>
+#include <vector>
+
+#include "parallel.h"
+#include "task_util.h"
+#include "absl/strings/str_cat.h"
+
+namespace automl_zero {
+
+using ::std::pair;  // NOLINT
+using ::std::shared_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+namespace {
+
+// The key of one task of a TaskSpec.
+std::string TaskKey(const std::string& serialized_task_spec,
+                    const RandomSeedT param_seed,
+                    const RandomSeedT data_seed) {
+  return absl::StrCat(param_seed, ",", data_seed, ",", serialized_task_spec);
+}
+
+}  // namespace
+
+TaskStore::TaskStore(const IntegerT num_threads,
+                     const TaskDiskCache* disk_cache,
+                     const CpuTopology* topology)
+    : num_threads_(num_threads),
+      disk_cache_(disk_cache),
+      topology_(topology),
+      num_tasks_created_(0) {}
+
+vector<shared_ptr<const TaskInterface>> TaskStore::GetTasks(
+    const TaskCollection& task_collection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  vector<std::string> keys;
+  return GetTasksLocked(task_collection, &keys);
+}
+
+vector<vector<shared_ptr<const TaskInterface>>> TaskStore::GetNodeTasks(
+    const TaskCollection& task_collection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  vector<std::string> keys;
+  const IntegerT num_nodes = topology_ == nullptr ? 1 : topology_->NumNodes();
+  vector<vector<shared_ptr<const TaskInterface>>> node_tasks(num_nodes);
+  node_tasks[0] = GetTasksLocked(task_collection, &keys);
+  const vector<shared_ptr<const TaskInterface>>& tasks = node_tasks[0];
+  for (IntegerT node = 1; node < num_nodes; ++node) {
+    // Copy the missing tasks on the node, so that their data is allocated
+    // there.
+    RunOnNode(*topology_, node, [&]() {
+      for (IntegerT i = 0; i < tasks.size(); ++i) {
+        vector<shared_ptr<const TaskInterface>>& replicas = replicas_[keys[i]];
+        replicas.resize(num_nodes - 1);
+        if (replicas[node - 1] == nullptr) {
+          replicas[node - 1] = tasks[i]->Replicate();
+        }
+      }
+    });
+    for (IntegerT i = 0; i < tasks.size(); ++i) {
+      const shared_ptr<const TaskInterface>& replica =
+          replicas_[keys[i]][node - 1];
+      // The tasks that cannot be copied are shared with node 0.
+      node_tasks[node].push_back(replica == nullptr ? tasks[i] : replica);
+    }
+  }
+  return node_tasks;
+}
+
+vector<shared_ptr<const TaskInterface>> TaskStore::GetTasksLocked(
+    const TaskCollection& task_collection, vector<std::string>* keys) {
+  // Look up every task, remembering the missing ones.
+  struct TaskToCreate {
+    const TaskSpec* task_spec;
+    RandomSeedT param_seed;
+    RandomSeedT data_seed;
+    // Index of the task in the collection.
+    IntegerT task_index;
+  };
+  vector<shared_ptr<const TaskInterface>> tasks;
+  keys->clear();
+  vector<TaskToCreate> tasks_to_create;
+  std::unordered_map<std::string, IntegerT> pending_keys;
+  for (const TaskSpec& task_spec : task_collection.tasks()) {
+    TaskSpec seedless_task_spec = task_spec;
+    seedless_task_spec.clear_param_seeds();
+    seedless_task_spec.clear_data_seeds();
+    seedless_task_spec.clear_num_tasks();
+    const std::string serialized_task_spec =
+        seedless_task_spec.SerializeAsString();
+    for (const pair<RandomSeedT, RandomSeedT>& seeds : TaskSeeds(task_spec)) {
+      keys->push_back(
+          TaskKey(serialized_task_spec, seeds.first, seeds.second));
+      auto it = tasks_.find(keys->back());
+      if (it != tasks_.end()) {
+        tasks.push_back(it->second);
+        continue;
+      }
+      // The same task may appear more than once in the collection.
+      if (pending_keys.emplace(keys->back(), tasks_to_create.size()).second) {
+        tasks_to_create.push_back({&task_spec, seeds.first, seeds.second,
+                                   static_cast<IntegerT>(tasks.size())});
+      }
+      tasks.push_back(nullptr);
+    }
+  }
+
+  // Generate the missing tasks in parallel.
+  vector<shared_ptr<const TaskInterface>> created_tasks(tasks_to_create.size());
+  ParallelFor(tasks_to_create.size(), num_threads_,
+              [this, &tasks_to_create, &created_tasks](IntegerT i) {
+                const TaskToCreate& task = tasks_to_create[i];
+                created_tasks[i] = CreateTaskInterface(
+                    task.task_index, task.param_seed, task.data_seed,
+                    *task.task_spec, disk_cache_);
+              });
+  num_tasks_created_ += created_tasks.size();
+
+  for (IntegerT i = 0; i < tasks.size(); ++i) {
+    if (tasks[i] == nullptr) {
+      tasks[i] = created_tasks[pending_keys[(*keys)[i]]];
+      tasks_[(*keys)[i]] = tasks[i];
+    }
+  }
+  return tasks;
+}
+
+IntegerT TaskStore::EvictUnused() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  IntegerT num_evicted = 0;
+  for (auto it = tasks_.begin(); it != tasks_.end();) {
+    bool unused = it->second.use_count() == 1;
+    auto replicas = replicas_.find(it->first);
+    if (replicas != replicas_.end()) {
+      for (const shared_ptr<const TaskInterface>& replica : replicas->second) {
+        if (replica != nullptr && replica.use_count() > 1) unused = false;
+      }
+    }
+    if (unused) {
+      if (replicas != replicas_.end()) replicas_.erase(replicas);
+      it = tasks_.erase(it);
+      ++num_evicted;
+    } else {
+      ++it;
+    }
+  }
+  return num_evicted;
+}
+
+IntegerT TaskStore::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tasks_.size();
+}
+
+IntegerT TaskStore::NumTasksCreated() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_tasks_created_;
+}
+
+}  // namespace automl_zero
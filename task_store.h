@@ -0,0 +1,105 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUTOML_ZERO_TASK_STORE_H_
+#define AUTOML_ZERO_TASK_STORE_H_
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cpu_topology.h"
+#include "definitions.h"
+#include "task.h"
+#include "task.pb.h"
+#include "task_disk_cache.h"
+
+namespace automl_zero {
+
+// Generates tasks and shares them among Evaluators. A task is identified by
+// its TaskSpec (excluding the seeds and the number of tasks), its param seed
+// and its data seed, so a collection that repeats tasks already in the store
+// is served without regenerating or copying any data. Tasks are immutable
+// once created, so they can be read by several threads at once. The tasks are
+// reference-counted and stay in the store until EvictUnused is called while
+// nobody else holds them.
+//
+// Note that Task::index_ is the index of the task in the collection that
+// created it, which may differ from its index in later collections.
+//
+// On a machine with several NUMA nodes, the store can also keep a copy of
+// every task on each node, so that the threads pinned to a node read the
+// examples from its local memory.
+//
+// Thread-safe.
+class TaskStore {
+ public:
+  // Missing tasks are generated with up to `num_threads` threads. If
+  // `disk_cache` is not nullptr, it is used to save and reload the generated
+  // data across runs. If `topology` is not nullptr, GetNodeTasks replicates
+  // the tasks on its nodes. Both must outlive the store.
+  explicit TaskStore(IntegerT num_threads,
+                     const TaskDiskCache* disk_cache = nullptr,
+                     const CpuTopology* topology = nullptr);
+  TaskStore(const TaskStore& other) = delete;
+  TaskStore& operator=(const TaskStore& other) = delete;
+
+  // Returns the tasks of the collection, in the same order as FillTasks.
+  std::vector<std::shared_ptr<const TaskInterface>> GetTasks(
+      const TaskCollection& task_collection);
+
+  // The tasks of the collection on each node of the topology, indexed by
+  // [node][task]. Those of node 0 are the ones GetTasks returns. Those of the
+  // other nodes are copies first touched by a thread pinned to the node, or
+  // the same tasks if they cannot be copied. Without a topology, there is
+  // only node 0.
+  std::vector<std::vector<std::shared_ptr<const TaskInterface>>> GetNodeTasks(
+      const TaskCollection& task_collection);
+
+  // Releases the tasks that are not used outside of the store, with their
+  // copies. Returns the number of tasks released.
+  IntegerT EvictUnused();
+
+  // The number of tasks in the store.
+  IntegerT Size() const;
+
+  // The number of tasks generated since construction.
+  IntegerT NumTasksCreated() const;
+
+  // The topology the tasks are replicated on, or nullptr.
+  const CpuTopology* topology() const { return topology_; }
+
+ private:
+  // As GetTasks, with mutex_ held. Writes the key of each task into `keys`.
+  std::vector<std::shared_ptr<const TaskInterface>> GetTasksLocked(
+      const TaskCollection& task_collection, std::vector<std::string>* keys);
+
+  const IntegerT num_threads_;
+  const TaskDiskCache* disk_cache_;
+  const CpuTopology* topology_;
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<const TaskInterface>> tasks_;
+  // The copies of each task on the nodes past the first, or nullptr where the
+  // task cannot be copied.
+  std::unordered_map<std::string,
+                     std::vector<std::shared_ptr<const TaskInterface>>>
+      replicas_;
+  IntegerT num_tasks_created_;
+};
+
+}  // namespace automl_zero
+
+#endif  // AUTOML_ZERO_TASK_STORE_H_
@@ -0,0 +1,148 @@
+// Copyright 2021 The Google Research Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "task_store.h"
+
+#include <memory>
+#include <vector>
+
+#include "cpu_topology.h"
+#include "definitions.h"
+#include "task.h"
+#include "task.pb.h"
+#include "task_util.h"
+#include "gtest/gtest.h"
+
+namespace automl_zero {
+
+using ::std::shared_ptr;  // NOLINT
+using ::std::unique_ptr;  // NOLINT
+using ::std::vector;  // NOLINT
+
+// Tasks with consecutive seeds, starting from `first_seed`.
+TaskCollection LinearRegressionTasks(IntegerT num_tasks,
+                                     RandomSeedT first_seed) {
+  TaskCollection task_collection = ParseTextFormat<TaskCollection>(
+      "tasks { scalar_linear_regression_task {} features_size: 4 "
+      "        num_train_examples: 100 num_valid_examples: 10 "
+      "        eval_type: RMS_ERROR } ");
+  task_collection.mutable_tasks(0)->set_num_tasks(num_tasks);
+  task_collection.mutable_tasks(0)->add_param_seeds(first_seed);
+  task_collection.mutable_tasks(0)->add_data_seeds(first_seed);
+  return task_collection;
+}
+
+TEST(TaskStoreTest, MatchesFillTasks) {
+  TaskStore task_store(4);
+  const TaskCollection task_collection = LinearRegressionTasks(6, 100);
+  const vector<shared_ptr<const TaskInterface>> tasks =
+      task_store.GetTasks(task_collection);
+  vector<unique_ptr<TaskInterface>> expected_tasks;
+  FillTasks(task_collection, &expected_tasks);
+  ASSERT_EQ(tasks.size(), expected_tasks.size());
+  for (IntegerT i = 0; i < tasks.size(); ++i) {
+    EXPECT_TRUE(*SafeDowncast<4>(tasks[i].get()) ==
+                *SafeDowncast<4>(expected_tasks[i].get()));
+  }
+}
+
+TEST(TaskStoreTest, SharesTasks) {
+  TaskStore task_store(4);
+  const vector<shared_ptr<const TaskInterface>> tasks =
+      task_store.GetTasks(LinearRegressionTasks(3, 100));
+  EXPECT_EQ(task_store.NumTasksCreated(), 3);
+
+  // Overlaps in the tasks with seeds 101 and 102.
+  const vector<shared_ptr<const TaskInterface>> other_tasks =
+      task_store.GetTasks(LinearRegressionTasks(3, 101));
+  EXPECT_EQ(task_store.NumTasksCreated(), 4);
+  EXPECT_EQ(task_store.Size(), 4);
+  EXPECT_EQ(other_tasks[0], tasks[1]);
+  EXPECT_EQ(other_tasks[1], tasks[2]);
+  EXPECT_NE(other_tasks[2], tasks[2]);
+}
+
+TEST(TaskStoreTest, DistinguishesTaskSpecs) {
+  TaskStore task_store(1);
+  TaskCollection task_collection = LinearRegressionTasks(1, 100);
+  *task_collection.add_tasks() = task_collection.tasks(0);
+  task_collection.mutable_tasks(1)->set_num_train_examples(50);
+  const vector<shared_ptr<const TaskInterface>> tasks =
+      task_store.GetTasks(task_collection);
+  ASSERT_EQ(tasks.size(), 2);
+  EXPECT_NE(tasks[0], tasks[1]);
+  EXPECT_EQ(tasks[1]->TrainExamplesPerEpoch(), 50);
+}
+
+TEST(TaskStoreTest, CreatesRepeatedTasksOnce) {
+  TaskStore task_store(4);
+  TaskCollection task_collection = LinearRegressionTasks(2, 100);
+  *task_collection.add_tasks() = task_collection.tasks(0);
+  const vector<shared_ptr<const TaskInterface>> tasks =
+      task_store.GetTasks(task_collection);
+  ASSERT_EQ(tasks.size(), 4);
+  EXPECT_EQ(task_store.NumTasksCreated(), 2);
+  EXPECT_EQ(tasks[0], tasks[2]);
+  EXPECT_EQ(tasks[1], tasks[3]);
+}
+
+TEST(TaskStoreTest, EvictsUnusedTasks) {
+  TaskStore task_store(1);
+  vector<shared_ptr<const TaskInterface>> tasks =
+      task_store.GetTasks(LinearRegressionTasks(2, 100));
+  EXPECT_EQ(task_store.EvictUnused(), 0);
+  tasks.pop_back();
+  EXPECT_EQ(task_store.EvictUnused(), 1);
+  EXPECT_EQ(task_store.Size(), 1);
+  tasks.clear();
+  EXPECT_EQ(task_store.EvictUnused(), 1);
+  EXPECT_EQ(task_store.Size(), 0);
+}
+
+TEST(TaskStoreTest, ReplicatesTasksOnEachNode) {
+  // Two nodes that share a CPU that is surely available.
+  const int cpu = CpuTopology::Detect().NodeCpus(0)[0];
+  const CpuTopology topology({{cpu}, {cpu}});
+  TaskStore task_store(1, nullptr, &topology);
+  const TaskCollection task_collection = LinearRegressionTasks(3, 100);
+  vector<vector<shared_ptr<const TaskInterface>>> node_tasks =
+      task_store.GetNodeTasks(task_collection);
+  ASSERT_EQ(node_tasks.size(), 2);
+  EXPECT_EQ(node_tasks[0], task_store.GetTasks(task_collection));
+  ASSERT_EQ(node_tasks[1].size(), 3);
+  for (IntegerT i = 0; i < 3; ++i) {
+    EXPECT_NE(node_tasks[1][i], node_tasks[0][i]);
+    EXPECT_TRUE(*SafeDowncast<4>(node_tasks[1][i].get()) ==
+                *SafeDowncast<4>(node_tasks[0][i].get()));
+  }
+  // The copies are made once.
+  EXPECT_EQ(task_store.GetNodeTasks(task_collection)[1], node_tasks[1]);
+
+  // A task is only evicted once its copies are unused too.
+  node_tasks[0].clear();
+  EXPECT_EQ(task_store.EvictUnused(), 0);
+  node_tasks[1].clear();
+  EXPECT_EQ(task_store.EvictUnused(), 3);
+}
+
+TEST(TaskStoreTest, HasOneNodeWithoutTopology) {
+  TaskStore task_store(1);
+  const TaskCollection task_collection = LinearRegressionTasks(2, 100);
+  const vector<vector<shared_ptr<const TaskInterface>>> node_tasks =
+      task_store.GetNodeTasks(task_collection);
+  ASSERT_EQ(node_tasks.size(), 1);
+  EXPECT_EQ(node_tasks[0], task_store.GetTasks(task_collection));
+}
+
+}  // namespace automl_zero
@@ -30,6 +30,7 @@
 #include "executor.h"
 #include "generator.h"
 #include "memory.h"
+#include "parallel.h"
 #include "random_generator.h"
 #include "google/protobuf/text_format.h"
 #include "absl/flags/flag.h"
@@ -67,9 +68,7 @@ vector<RandomSeedT> DefaultFirstDataSeeds() {
   return {11001, 11012, 11010, 11000, 11006, 11008, 11007, 11003};
 }
 
-void FillTasksFromTaskSpec(
-    const TaskSpec& task_spec,
-    vector<unique_ptr<TaskInterface>>* return_tasks) {
+vector<pair<RandomSeedT, RandomSeedT>> TaskSeeds(const TaskSpec& task_spec) {
   const IntegerT num_tasks = task_spec.num_tasks();
   CHECK_GT(num_tasks, 0);
   vector<RandomSeedT> first_param_seeds =
@@ -85,6 +84,7 @@ void FillTasksFromTaskSpec(
   CHECK(!first_param_seeds.empty());
   CHECK(!first_data_seeds.empty());
 
+  vector<pair<RandomSeedT, RandomSeedT>> seeds;
   RandomSeedT param_seed;
   RandomSeedT data_seed;
   for (IntegerT i = 0; i < num_tasks; ++i) {
@@ -92,44 +92,74 @@ void FillTasksFromTaskSpec(
         i < first_param_seeds.size() ? first_param_seeds[i] : param_seed + 1;
     data_seed =
         i < first_data_seeds.size() ? first_data_seeds[i] : data_seed + 1;
+    seeds.emplace_back(param_seed, data_seed);
+  }
+  return seeds;
+}
 
-    const IntegerT task_index = return_tasks->size();
-    switch (task_spec.features_size()) {
-      case 2:
-        return_tasks->push_back(CreateTask<2>(task_index, param_seed,
-                                                    data_seed, task_spec));
-        break;
-      case 4:
-        return_tasks->push_back(CreateTask<4>(task_index, param_seed,
-                                                    data_seed, task_spec));
-        break;
-      case 8:
-        return_tasks->push_back(CreateTask<8>(task_index, param_seed,
-                                                    data_seed, task_spec));
-        break;
-      case 16:
-        return_tasks->push_back(CreateTask<16>(task_index, param_seed,
-                                                     data_seed, task_spec));
-        break;
-      case 32:
-        return_tasks->push_back(CreateTask<32>(task_index, param_seed,
-                                                     data_seed, task_spec));
-        break;
-      default:
-        LOG(FATAL) << "Unsupported features size: "
-                   << task_spec.features_size() << std::endl;
-    }
+unique_ptr<TaskInterface> CreateTaskInterface(
+    const IntegerT task_index, const RandomSeedT param_seed,
+    const RandomSeedT data_seed, const TaskSpec& task_spec,
+    const TaskDiskCache* disk_cache) {
+  switch (task_spec.features_size()) {
+    case 2:
+      return CreateTask<2>(task_index, param_seed, data_seed, task_spec,
+                             disk_cache);
+    case 4:
+      return CreateTask<4>(task_index, param_seed, data_seed, task_spec,
+                             disk_cache);
+    case 8:
+      return CreateTask<8>(task_index, param_seed, data_seed, task_spec,
+                             disk_cache);
+    case 16:
+      return CreateTask<16>(task_index, param_seed, data_seed, task_spec,
+                              disk_cache);
+    case 32:
+      return CreateTask<32>(task_index, param_seed, data_seed, task_spec,
+                              disk_cache);
+    case 64:
+      return CreateTask<64>(task_index, param_seed, data_seed, task_spec,
+                            disk_cache);
+    case 128:
+      return CreateTask<128>(task_index, param_seed, data_seed, task_spec,
+                             disk_cache);
+    case 256:
+      return CreateTask<256>(task_index, param_seed, data_seed, task_spec,
+                             disk_cache);
+    default:
+      LOG(FATAL) << "Unsupported features size: "
+                 << task_spec.features_size() << std::endl;
   }
 }
 
 void FillTasks(
     const TaskCollection& task_collection,
-    vector<unique_ptr<TaskInterface>>* return_tasks) {
+    vector<unique_ptr<TaskInterface>>* return_tasks,
+    const IntegerT num_threads) {
   // Check return targets are empty.
   CHECK(return_tasks->empty());
+
+  // Enumerate the tasks serially so that the indexes and seeds do not depend
+  // on the number of threads, then generate their data in parallel.
+  struct TaskToCreate {
+    const TaskSpec* task_spec;
+    RandomSeedT param_seed;
+    RandomSeedT data_seed;
+  };
+  vector<TaskToCreate> tasks_to_create;
   for (const TaskSpec& task_spec : task_collection.tasks()) {
-    FillTasksFromTaskSpec(task_spec, return_tasks);
+    for (const pair<RandomSeedT, RandomSeedT>& seeds : TaskSeeds(task_spec)) {
+      tasks_to_create.push_back({&task_spec, seeds.first, seeds.second});
+    }
   }
+  return_tasks->resize(tasks_to_create.size());
+  ParallelFor(tasks_to_create.size(), num_threads,
+              [&tasks_to_create, return_tasks](IntegerT task_index) {
+                const TaskToCreate& task = tasks_to_create[task_index];
+                (*return_tasks)[task_index] = CreateTaskInterface(
+                    task_index, task.param_seed, task.data_seed,
+                    *task.task_spec);
+              });
 }
 
 void RandomizeTaskSeeds(TaskCollection* task_collection,
@@ -17,17 +17,22 @@
 
 #include <array>
 #include <fstream>
+#include <memory>
 #include <random>
 #include <type_traits>
+#include <utility>
 
+#include "columnar_dataset.h"
 #include "task.h"
 #include "task.pb.h"
+#include "task_disk_cache.h"
 #include "definitions.h"
 #include "executor.h"
 #include "generator.h"
 #include "memory.h"
 #include "compute_cost_new.h"
 #include "random_generator.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 
 namespace automl_zero {
@@ -40,9 +45,24 @@ const RandomSeedT kFirstDataSeedForTest = 19000;
 
 // Fills `return_tasks` with `experiment_tasks` Tasks.
 // `return_tasks` must be empty an empty vector.
+// The tasks are generated with up to `num_threads` threads. The result does not
+// depend on the number of threads.
 void FillTasks(
     const TaskCollection& task_collection,
-    std::vector<std::unique_ptr<TaskInterface>>* return_tasks);
+    std::vector<std::unique_ptr<TaskInterface>>* return_tasks,
+    IntegerT num_threads = 1);
+
+// Returns the (param_seed, data_seed) pair of each of the `num_tasks` tasks of
+// a TaskSpec, in order.
+std::vector<std::pair<RandomSeedT, RandomSeedT>> TaskSeeds(
+    const TaskSpec& task_spec);
+
+// Creates a single task of a TaskSpec, for its features size. If `disk_cache`
+// is not nullptr, the data is read from it if possible and saved to it after
+// being generated otherwise.
+std::unique_ptr<TaskInterface> CreateTaskInterface(
+    IntegerT task_index, RandomSeedT param_seed, RandomSeedT data_seed,
+    const TaskSpec& task_spec, const TaskDiskCache* disk_cache = nullptr);
 
 // Downcasts a TaskInterface. Crashes if the downcast would have been
 // incorrect.
@@ -201,6 +221,18 @@ struct ProjectedBinaryClassificationTaskCreator {
         "-dim_", features_size, "-seed_", data_seed);
 
     std::string full_path = path + "/" + filename;
+    if (IsColumnarDataset(full_path)) {
+      // Memory-mapped and copied one split at a time, without parsing.
+      MappedColumnarDataset mapped_dataset(full_path);
+      mapped_dataset.CopyExamples<F>(kColumnarTrainSplit,
+                                     &buffer->train_features_,
+                                     &buffer->train_labels_);
+      mapped_dataset.CopyExamples<F>(kColumnarValidSplit,
+                                     &buffer->valid_features_,
+                                     &buffer->valid_labels_);
+      CHECK(eval_type == ACCURACY);
+      return;
+    }
     ScalarLabelDataset saved_dataset;
     std::ifstream is(full_path, std::ifstream::binary);
     CHECK(is.good()) << "No data found at " << full_path
@@ -252,6 +284,23 @@ struct ProjectedBinaryClassificationTaskCreator {
   }
 };
 
+// Loads a task from a columnar dataset file.
+template <FeatureIndexT F>
+struct ColumnarFileTaskCreator {
+  static void Create(const ColumnarFileTask& task_spec,
+                     IntegerT num_train_examples, IntegerT num_valid_examples,
+                     TaskBuffer<F>* buffer) {
+    ClearAndResize(num_train_examples, num_valid_examples, buffer);
+    const MappedColumnarDataset mapped_dataset(task_spec.path());
+    mapped_dataset.CopyExamples<F>(kColumnarTrainSplit,
+                                   &buffer->train_features_,
+                                   &buffer->train_labels_);
+    mapped_dataset.CopyExamples<F>(kColumnarValidSplit,
+                                   &buffer->valid_features_,
+                                   &buffer->valid_labels_);
+  }
+};
+
 // Creates a task using the linear regressor with fixed weights. The
 // weights are determined by the seed. Serves as a way to initialize the
 // task.
@@ -547,64 +596,107 @@ struct Scalar2LayerNnRegressionTaskCreator {
 };
 
 
+// Creates a task that reads the examples of a columnar dataset file while it
+// is used, instead of holding them in memory.
 template <FeatureIndexT F>
-std::unique_ptr<Task<F>> CreateTask(const IntegerT task_index,
-                                    const RandomSeedT param_seed,
-                                    const RandomSeedT data_seed,
-                                    const TaskSpec& task_spec) {
-  CHECK_GT(task_spec.num_train_examples(), 0);
-  CHECK_GT(task_spec.num_valid_examples(), 0);
-  TaskBuffer<F> buffer;
+std::unique_ptr<Task<F>> CreateStreamingTask(const IntegerT task_index,
+                                             const RandomSeedT data_seed,
+                                             const TaskSpec& task_spec) {
+  CHECK(task_spec.has_eval_type());
+  const ColumnarFileTask& file_task = task_spec.columnar_file_task();
+  auto mapped_dataset =
+      std::make_shared<const MappedColumnarDataset>(file_task.path());
+  auto train_stream = absl::make_unique<const StreamingExamples<F>>(
+      mapped_dataset, kColumnarTrainSplit, task_spec.num_train_examples(),
+      task_spec.num_train_epochs(), file_task.block_size(),
+      data_seed + 3274582109);
+  auto valid_stream = absl::make_unique<const StreamingExamples<F>>(
+      mapped_dataset, kColumnarValidSplit, task_spec.num_valid_examples(),
+      1, file_task.block_size(), data_seed + 3274582109);
+  return absl::make_unique<Task<F>>(task_index, task_spec.eval_type(),
+                                    std::move(train_stream),
+                                    std::move(valid_stream));
+}
+
+// Generates the data of a task.
+template <FeatureIndexT F>
+void FillTaskBuffer(const RandomSeedT param_seed, const RandomSeedT data_seed,
+                    const TaskSpec& task_spec, TaskBuffer<F>* buffer) {
   switch (task_spec.task_type_case()) {
     case (TaskSpec::kProjectedBinaryClassificationTask):
       ProjectedBinaryClassificationTaskCreator<F>::Create(
           task_spec.eval_type(),
           task_spec.projected_binary_classification_task(),
           task_spec.num_train_examples(), task_spec.num_valid_examples(),
-          task_spec.features_size(), data_seed, &buffer);
+          task_spec.features_size(), data_seed, buffer);
       break;
     case (TaskSpec::kScalarLinearRegressionTask):
       ScalarLinearRegressionTaskCreator<F>::Create(
           task_spec.eval_type(), task_spec.num_train_examples(),
-          task_spec.num_valid_examples(), param_seed, data_seed, &buffer);
+          task_spec.num_valid_examples(), param_seed, data_seed, buffer);
       break;
     case (TaskSpec::kClassicControlTask):
       ClassicControlTaskCreator<F>::Create(
           task_spec.eval_type(), task_spec.num_train_examples(),
-          task_spec.num_valid_examples(), param_seed, data_seed, &buffer);
+          task_spec.num_valid_examples(), param_seed, data_seed, buffer);
       break;
       case (TaskSpec::kScalar2LayerNnRegressionTask):
       Scalar2LayerNnRegressionTaskCreator<F>::Create(
           task_spec.eval_type(), task_spec.num_train_examples(),
-          task_spec.num_valid_examples(), param_seed, data_seed, &buffer);
+          task_spec.num_valid_examples(), param_seed, data_seed, buffer);
       break;
     case (TaskSpec::kUnitTestFixedTask):
       UnitTestFixedTaskCreator<F>::Create(
-          task_spec.unit_test_fixed_task(), &buffer);
+          task_spec.unit_test_fixed_task(), buffer);
       break;
     case (TaskSpec::kUnitTestZerosTask):
       UnitTestZerosTaskCreator<F>::Create(
           task_spec.num_train_examples(),
           task_spec.num_valid_examples(),
           task_spec.unit_test_zeros_task(),
-          &buffer);
+          buffer);
       break;
     case (TaskSpec::kUnitTestOnesTask):
       UnitTestOnesTaskCreator<F>::Create(
           task_spec.num_train_examples(),
           task_spec.num_valid_examples(),
           task_spec.unit_test_ones_task(),
-          &buffer);
+          buffer);
       break;
     case (TaskSpec::kUnitTestIncrementTask):
       UnitTestIncrementTaskCreator<F>::Create(
           task_spec.num_train_examples(), task_spec.num_valid_examples(),
-          task_spec.unit_test_increment_task(), &buffer);
+          task_spec.unit_test_increment_task(), buffer);
+      break;
+    case (TaskSpec::kColumnarFileTask):
+      ColumnarFileTaskCreator<F>::Create(
+          task_spec.columnar_file_task(), task_spec.num_train_examples(),
+          task_spec.num_valid_examples(), buffer);
       break;
     default:
       LOG(FATAL) << "Unknown task type\n";
       break;
   }
+}
+
+template <FeatureIndexT F>
+std::unique_ptr<Task<F>> CreateTask(
+    const IntegerT task_index, const RandomSeedT param_seed,
+    const RandomSeedT data_seed, const TaskSpec& task_spec,
+    const TaskDiskCache* disk_cache = nullptr) {
+  CHECK_GT(task_spec.num_train_examples(), 0);
+  CHECK_GT(task_spec.num_valid_examples(), 0);
+  if (task_spec.has_columnar_file_task() &&
+      task_spec.columnar_file_task().streaming()) {
+    return CreateStreamingTask<F>(task_index, data_seed, task_spec);
+  }
+  TaskBuffer<F> buffer;
+  if (disk_cache == nullptr || !TaskDiskCache::IsCacheable(task_spec)) {
+    FillTaskBuffer<F>(param_seed, data_seed, task_spec, &buffer);
+  } else if (!disk_cache->Load<F>(task_spec, param_seed, data_seed, &buffer)) {
+    FillTaskBuffer<F>(param_seed, data_seed, task_spec, &buffer);
+    disk_cache->Store<F>(task_spec, param_seed, data_seed, buffer);
+  }
 
   std::mt19937 data_bit_gen(data_seed + 3274582109);
   CHECK_EQ(buffer.train_features_.size(), task_spec.num_train_examples());
@@ -151,6 +151,32 @@ TEST(FillTasksTest, WorksCorrectly) {
   EXPECT_EQ(tasks[1]->index_, 1);
 }
 
+TEST(FillTasksTest, ParallelMatchesSerial) {
+  const auto task_collection = ParseTextFormat<TaskCollection>(
+      "tasks { scalar_2layer_nn_regression_task {} features_size: 4 "
+      "        num_train_examples: 100 num_valid_examples: 10 num_tasks: 5 "
+      "        eval_type: RMS_ERROR } "
+      "tasks { scalar_linear_regression_task {} features_size: 8 "
+      "        num_train_examples: 100 num_valid_examples: 10 num_tasks: 7 "
+      "        eval_type: RMS_ERROR } ");
+  vector<unique_ptr<TaskInterface>> serial_tasks;
+  FillTasks(task_collection, &serial_tasks);
+  vector<unique_ptr<TaskInterface>> parallel_tasks;
+  FillTasks(task_collection, &parallel_tasks, 4);
+  ASSERT_EQ(serial_tasks.size(), 12);
+  ASSERT_EQ(parallel_tasks.size(), 12);
+  for (IntegerT i = 0; i < 5; ++i) {
+    EXPECT_TRUE(*SafeDowncast<4>(serial_tasks[i].get()) ==
+                *SafeDowncast<4>(parallel_tasks[i].get()));
+    EXPECT_EQ(SafeDowncast<4>(parallel_tasks[i].get())->index_, i);
+  }
+  for (IntegerT i = 5; i < 12; ++i) {
+    EXPECT_TRUE(*SafeDowncast<8>(serial_tasks[i].get()) ==
+                *SafeDowncast<8>(parallel_tasks[i].get()));
+    EXPECT_EQ(SafeDowncast<8>(parallel_tasks[i].get())->index_, i);
+  }
+}
+
 TEST(FillTaskTest, FillsEvalType) {
   std::string task_spec_string =
       StrCat("scalar_linear_regression_task {} "